@@ -1,14 +1,17 @@
 #include <sys/types.h>  
 #include <sys/socket.h>
 #include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
 
 #include "Acceptor.h"
 #include "Logger.h"
 #include "InetAddress.h"
 
-static int createNonblocking()
+static int createNonblocking(sa_family_t family)
 {
-    int sockfd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP);
+    int protocol = (family == AF_INET) ? IPPROTO_TCP : 0;
+    int sockfd = ::socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, protocol);
     if (sockfd < 0)
     {
         LOG_FATAL("%s %s %d listen socket create failed errno:%d.\n", __FILENAME__, __FUNCTION__, __LINE__, errno);
@@ -19,21 +22,52 @@ static int createNonblocking()
 Acceptor::Acceptor(EventLoop* loop, const InetAddress& listenAddr, bool reusePort)
     :listenning_(false), 
     loop_(loop),
-    acceptSocket_(createNonblocking()),
+    acceptSocket_(createNonblocking(listenAddr.family())),
     acceptChannel_(loop, acceptSocket_.fd())
 {
-    acceptSocket_.setReuseAddr(true);
-    acceptSocket_.setReusePort(true);
+    if (!listenAddr.valid())
+    {
+        LOG_FATAL("%s %s %d invalid listen address\n", __FILENAME__, __FUNCTION__, __LINE__);
+    }
+    if (listenAddr.isUnix())
+    {
+        //文件系统中的Unix域地址，上次进程退出残留的socket文件会导致bind失败
+        if (!listenAddr.isAbstract())
+        {
+            unixPath_ = listenAddr.unixPath();
+            ::unlink(unixPath_.c_str());
+        }
+    }
+    else
+    {
+        acceptSocket_.setReuseAddr(true);
+        acceptSocket_.setReusePort(reusePort);
+    }
     acceptSocket_.bindAddress(listenAddr);
     //TcpServer::start() Acceptor.listen() 有新用户的连接，要执行一个回调(connfd->channel->subloop)
     //baseloop->acceptChannel(listenfd)->handleRead
     acceptChannel_.setReadCallback(std::bind(&Acceptor::handleRead, this));
 }
 
+Acceptor::Acceptor(EventLoop* loop, int listenFd)
+    :listenning_(false),
+    loop_(loop),
+    acceptSocket_(listenFd),
+    acceptChannel_(loop, listenFd)
+{
+    ::fcntl(listenFd, F_SETFL, ::fcntl(listenFd, F_GETFL) | O_NONBLOCK);
+    ::fcntl(listenFd, F_SETFD, FD_CLOEXEC);
+    acceptChannel_.setReadCallback(std::bind(&Acceptor::handleRead, this));
+}
+
 Acceptor::~Acceptor()
 {
     acceptChannel_.disableAll();
     acceptChannel_.remove();
+    if (!unixPath_.empty())
+    {
+        ::unlink(unixPath_.c_str());
+    }
 }
 
 void Acceptor::listen()
@@ -43,6 +77,29 @@ void Acceptor::listen()
     acceptChannel_.enableReading();
 }
 
+void Acceptor::stopListening()
+{
+    listenning_ = false;
+    acceptChannel_.disableAll();
+    unixPath_.clear();
+}
+
+void Acceptor::pauseAccepting()
+{
+    if (acceptChannel_.isReading())
+    {
+        acceptChannel_.disableReading();
+    }
+}
+
+void Acceptor::resumeAccepting()
+{
+    if (listenning_ && !acceptChannel_.isReading())
+    {
+        acceptChannel_.enableReading();
+    }
+}
+
 //listenfd事件发生，就有新用户连接了
 void Acceptor::handleRead()
 {
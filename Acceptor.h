@@ -1,6 +1,7 @@
 #pragma once 
 #include <functional>
 #include <memory>
+#include <string>
 
 #include "Acceptor.h"
 #include "InetAddress.h"
@@ -15,11 +16,18 @@ public:
     using NewConnectionCallback = std::function<void(int sockfd, const InetAddress&)>;
 
     Acceptor(EventLoop* loop, const InetAddress& listenAddr, bool reusePort = true);
+    //接管一个已经bind/listen好的fd，热重启时从旧进程传过来
+    Acceptor(EventLoop* loop, int listenFd);
     ~Acceptor();
 
     void setNewConnectionCallback(const NewConnectionCallback& cb){ newConnectionCallback_ = std::move(cb);}
     bool listenning() const { return listenning_; }
     void listen();
+    //不再accept，fd已经交给别的进程，Unix域socket文件也归新进程所有，析构时不删除
+    void stopListening();
+    //准入控制：暂停accept时新连接留在内核的backlog里，恢复以后继续处理
+    void pauseAccepting();
+    void resumeAccepting();
     int acceptFd() { return acceptSocket_.fd(); }
 private:
     void handleRead();
@@ -30,4 +38,5 @@ private:
     NewConnectionCallback newConnectionCallback_;
     bool listenning_;
     int idleFd_;
+    std::string unixPath_;//监听文件系统中的Unix域地址时记录路径，析构时删除
 };
\ No newline at end of file
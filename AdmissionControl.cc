@@ -0,0 +1,229 @@
+#include "AdmissionControl.h"
+#include "EventLoopThreadPool.h"
+
+PeerCountTable::PeerCountTable()
+    :slots_(16, Slot{0, 0}),
+    shift_(32 - 4),
+    size_(0)
+{
+}
+
+uint32_t PeerCountTable::increment(uint32_t ip)
+{
+    if ((size_ + 1) * 4 > slots_.size() * 3)
+    {
+        grow();
+    }
+    size_t mask = slots_.size() - 1;
+    for (size_t i = indexOf(ip); ; i = (i + 1) & mask)
+    {
+        if (slots_[i].ip == ip)
+        {
+            return ++slots_[i].count;
+        }
+        if (slots_[i].ip == 0)
+        {
+            slots_[i].ip = ip;
+            slots_[i].count = 1;
+            ++size_;
+            return 1;
+        }
+    }
+}
+
+uint32_t PeerCountTable::count(uint32_t ip) const
+{
+    size_t mask = slots_.size() - 1;
+    for (size_t i = indexOf(ip); slots_[i].ip != 0; i = (i + 1) & mask)
+    {
+        if (slots_[i].ip == ip)
+        {
+            return slots_[i].count;
+        }
+    }
+    return 0;
+}
+
+void PeerCountTable::decrement(uint32_t ip)
+{
+    size_t mask = slots_.size() - 1;
+    size_t i = indexOf(ip);
+    while (slots_[i].ip != ip)
+    {
+        if (slots_[i].ip == 0)
+        {
+            return;
+        }
+        i = (i + 1) & mask;
+    }
+    if (--slots_[i].count > 0)
+    {
+        return;
+    }
+    //删除i，把后面探测链上可以放到i的元素前移
+    --size_;
+    size_t j = i;
+    while (true)
+    {
+        slots_[i].ip = 0;
+        slots_[i].count = 0;
+        while (true)
+        {
+            j = (j + 1) & mask;
+            if (slots_[j].ip == 0)
+            {
+                return;
+            }
+            size_t home = indexOf(slots_[j].ip);
+            //home在(i, j]之间说明j不需要移动
+            bool stay = (i <= j) ? (i < home && home <= j) : (i < home || home <= j);
+            if (!stay)
+            {
+                break;
+            }
+        }
+        slots_[i] = slots_[j];
+        i = j;
+    }
+}
+
+void PeerCountTable::grow()
+{
+    std::vector<Slot> old(slots_.size() * 2, Slot{0, 0});
+    old.swap(slots_);
+    --shift_;
+    size_t mask = slots_.size() - 1;
+    for (const Slot& slot : old)
+    {
+        if (slot.ip != 0)
+        {
+            size_t i = indexOf(slot.ip);
+            while (slots_[i].ip != 0)
+            {
+                i = (i + 1) & mask;
+            }
+            slots_[i] = slot;
+        }
+    }
+}
+
+static uint32_t peerIp(const InetAddress& peer)
+{
+    return peer.family() == AF_INET ? peer.getSocketAddr()->sin_addr.s_addr : 0;
+}
+
+AdmissionControl::AdmissionControl()
+    :maxConnections_(0),
+    maxPerLoop_(0),
+    maxPerPeer_(0),
+    action_(kCloseNew),
+    connections_(0)
+{
+    for (int i = 0; i < kNumReasons; ++i)
+    {
+        rejected_[i] = 0;
+    }
+}
+
+bool AdmissionControl::loopFull(EventLoop* loop) const
+{
+    if (maxPerLoop_ == 0)
+    {
+        return false;
+    }
+    auto it = loopConnections_.find(loop);
+    return it != loopConnections_.end() && it->second >= maxPerLoop_;
+}
+
+EventLoop* AdmissionControl::chooseLoop(EventLoopThreadPool* pool)
+{
+    EventLoop* loop = pool->getNextLoop();
+    if (maxPerLoop_ == 0 || !loopFull(loop))
+    {
+        return loop;
+    }
+    //轮询顺序往后找有空位的loop
+    size_t n = pool->getAllLoops().size();
+    for (size_t i = 1; i < n; ++i)
+    {
+        loop = pool->getNextLoop();
+        if (!loopFull(loop))
+        {
+            return loop;
+        }
+    }
+    return nullptr;
+}
+
+bool AdmissionControl::admit(EventLoop* ioLoop, const InetAddress& peer, Timestamp now)
+{
+    Reason reason;
+    uint32_t ip = peerIp(peer);
+    if (maxConnections_ > 0 && connections_ >= maxConnections_)
+    {
+        reason = kTotal;
+    }
+    else if (ioLoop == nullptr)
+    {
+        reason = kPerLoop;
+    }
+    else if (maxPerPeer_ > 0 && ip != 0 && peers_.count(ip) >= maxPerPeer_)
+    {
+        reason = kPerPeer;
+    }
+    else if (!acceptRate_.tryConsume(1, now))
+    {
+        reason = kRate;
+    }
+    else
+    {
+        return true;
+    }
+    ++rejected_[reason];
+    return false;
+}
+
+void AdmissionControl::added(EventLoop* ioLoop, const InetAddress& peer)
+{
+    ++connections_;
+    ++loopConnections_[ioLoop];
+    uint32_t ip = peerIp(peer);
+    if (maxPerPeer_ > 0 && ip != 0)
+    {
+        peers_.increment(ip);
+    }
+}
+
+void AdmissionControl::removed(EventLoop* ioLoop, const InetAddress& peer)
+{
+    --connections_;
+    --loopConnections_[ioLoop];
+    uint32_t ip = peerIp(peer);
+    if (maxPerPeer_ > 0 && ip != 0)
+    {
+        peers_.decrement(ip);
+    }
+}
+
+bool AdmissionControl::saturated(EventLoopThreadPool* pool, Timestamp now, double* retryAfter)
+{
+    *retryAfter = 0;
+    if (maxConnections_ > 0 && connections_ >= maxConnections_)
+    {
+        return true;
+    }
+    if (maxPerLoop_ > 0)
+    {
+        bool allFull = true;
+        for (EventLoop* loop : pool->getAllLoops())
+        {
+            allFull = allFull && loopFull(loop);
+        }
+        if (allFull)
+        {
+            return true;
+        }
+    }
+    *retryAfter = acceptRate_.secondsUntil(1, now);
+    return *retryAfter > 0;
+}
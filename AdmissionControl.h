@@ -0,0 +1,107 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <unordered_map>
+
+#include "noncopyable.h"
+#include "InetAddress.h"
+#include "TokenBucket.h"
+
+class EventLoop;
+class EventLoopThreadPool;
+
+/**
+ * 按IPv4地址计数的开放寻址哈希表，线性探测，删除时把后面的元素前移，不留墓碑
+ * 每个槽8字节，地址0.0.0.0不会是对端地址，用来表示空槽
+*/
+class PeerCountTable : noncopyable
+{
+public:
+    PeerCountTable();
+
+    //返回加一以后的计数
+    uint32_t increment(uint32_t ip);
+    void decrement(uint32_t ip);
+    uint32_t count(uint32_t ip) const;
+    size_t size() const { return size_; }
+private:
+    struct Slot
+    {
+        uint32_t ip;
+        uint32_t count;
+    };
+
+    //ip是网络字节序，同一网段的地址只有主机序的低位不同；乘法哈希的低位只由输入的低位决定，所以取乘积的高位
+    size_t indexOf(uint32_t ip) const { return (ntohl(ip) * 2654435761u) >> shift_; }
+    void grow();
+
+    std::vector<Slot> slots_;//大小是2的幂
+    int shift_;//32 - log2(slots_.size())
+    size_t size_;
+};
+
+/**
+ * TcpServer的准入控制：总连接数、每个subloop的连接数、每个对端IP的连接数以及accept速率
+ * 超过限制时按OverloadAction处理：kCloseNew接受以后立即关闭新连接，
+ * kStopAccept在总数、每个loop的数量或者速率到达上限时暂停监听，连接留在内核的backlog里，等有空位再继续accept
+ * 每个IP的限制只能在accept以后才知道对端地址，无论哪种动作都是关闭
+ * 只在baseloop中使用
+*/
+class AdmissionControl : noncopyable
+{
+public:
+    enum OverloadAction
+    {
+        kCloseNew,
+        kStopAccept,
+    };
+
+    //拒绝的原因，也是rejected()的下标
+    enum Reason
+    {
+        kTotal,
+        kPerLoop,
+        kPerPeer,
+        kRate,
+        kNumReasons,
+    };
+
+    AdmissionControl();
+
+    //0表示不限制
+    void setMaxConnections(size_t n) { maxConnections_ = n; }
+    void setMaxConnectionsPerLoop(size_t n) { maxPerLoop_ = n; }
+    void setMaxConnectionsPerPeer(size_t n) { maxPerPeer_ = n; }
+    //每秒最多接受perSecond个新连接，允许突发burst个
+    void setAcceptRate(double perSecond, double burst) { acceptRate_.reset(perSecond, burst); }
+    void setOverloadAction(OverloadAction action) { action_ = action; }
+    OverloadAction overloadAction() const { return action_; }
+
+    //选择新连接所在的subloop，设置了每个loop的上限时跳过已满的loop，全部满了返回nullptr
+    EventLoop* chooseLoop(EventLoopThreadPool* pool);
+    //accept到的新连接是否可以接受，ioLoop为chooseLoop的结果
+    bool admit(EventLoop* ioLoop, const InetAddress& peer, Timestamp now);
+    //连接建立和移除时更新计数，热重启交接过来的连接不经过admit也要计数
+    void added(EventLoop* ioLoop, const InetAddress& peer);
+    void removed(EventLoop* ioLoop, const InetAddress& peer);
+
+    //kStopAccept时是否应该暂停accept，因为速率暂停时retryAfter返回多少秒以后再检查
+    bool saturated(EventLoopThreadPool* pool, Timestamp now, double* retryAfter);
+
+    size_t connections() const { return connections_; }
+    uint64_t rejected(Reason reason) const { return rejected_[reason]; }
+private:
+    bool loopFull(EventLoop* loop) const;
+
+    size_t maxConnections_;
+    size_t maxPerLoop_;
+    size_t maxPerPeer_;
+    TokenBucket acceptRate_;
+    OverloadAction action_;
+
+    size_t connections_;
+    std::unordered_map<EventLoop*, size_t> loopConnections_;
+    PeerCountTable peers_;
+    uint64_t rejected_[kNumReasons];
+};
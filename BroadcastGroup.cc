@@ -0,0 +1,124 @@
+#include "BroadcastGroup.h"
+#include "EventLoop.h"
+#include "TcpConnection.h"
+
+BroadcastGroup::BroadcastGroup()
+    :broadcasts_(0)
+{
+}
+
+//还没执行的任务持有各自loop的订阅者列表，不依赖BroadcastGroup本身
+BroadcastGroup::~BroadcastGroup() = default;
+
+BroadcastGroup::LoopSubscribersPtr BroadcastGroup::subscribersOf(EventLoop* loop)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const LoopSubscribersPtr& subs : loops_)
+    {
+        if (subs->loop == loop)
+        {
+            return subs;
+        }
+    }
+    LoopSubscribersPtr subs(new LoopSubscribers);
+    subs->loop = loop;
+    subs->count = 0;
+    loops_.push_back(subs);
+    return subs;
+}
+
+void BroadcastGroup::add(const TcpConnectionPtr& conn)
+{
+    LoopSubscribersPtr subs = subscribersOf(conn->getLoop());
+    conn->getLoop()->runInLoop([subs, conn]() {
+        if (subs->index.emplace(conn.get(), subs->conns.size()).second)
+        {
+            subs->conns.push_back(conn);
+            subs->count = subs->conns.size();
+        }
+    });
+}
+
+void BroadcastGroup::remove(const TcpConnectionPtr& conn)
+{
+    LoopSubscribersPtr subs = subscribersOf(conn->getLoop());
+    conn->getLoop()->runInLoop([subs, conn]() {
+        auto it = subs->index.find(conn.get());
+        if (it == subs->index.end())
+        {
+            return;
+        }
+        size_t pos = it->second;
+        subs->index.erase(it);
+        if (pos + 1 != subs->conns.size())
+        {
+            subs->conns[pos] = std::move(subs->conns.back());
+            subs->index[subs->conns[pos].get()] = pos;
+        }
+        subs->conns.pop_back();
+        subs->count = subs->conns.size();
+    });
+}
+
+size_t BroadcastGroup::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t n = 0;
+    for (const LoopSubscribersPtr& subs : loops_)
+    {
+        n += subs->count;
+    }
+    return n;
+}
+
+void BroadcastGroup::broadcast(const SharedPayload& payload)
+{
+    std::vector<LoopSubscribersPtr> loops;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        loops = loops_;
+    }
+    ++broadcasts_;
+    for (const LoopSubscribersPtr& subs : loops)
+    {
+        subs->loop->runInLoop([subs, payload]() { sendAll(subs->conns, payload); });
+    }
+}
+
+void BroadcastGroup::broadcast(const std::vector<TcpConnectionPtr>& conns, const SharedPayload& payload)
+{
+    //按loop分组，通常只有几个loop
+    std::vector<std::pair<EventLoop*, std::vector<TcpConnectionPtr>>> groups;
+    for (const TcpConnectionPtr& conn : conns)
+    {
+        EventLoop* loop = conn->getLoop();
+        size_t i = 0;
+        while (i < groups.size() && groups[i].first != loop)
+        {
+            ++i;
+        }
+        if (i == groups.size())
+        {
+            groups.emplace_back(loop, std::vector<TcpConnectionPtr>());
+        }
+        groups[i].second.push_back(conn);
+    }
+    for (auto& group : groups)
+    {
+        std::shared_ptr<std::vector<TcpConnectionPtr>> members(
+            new std::vector<TcpConnectionPtr>(std::move(group.second)));
+        group.first->runInLoop([members, payload]() { sendAll(*members, payload); });
+    }
+}
+
+void BroadcastGroup::sendAll(const std::vector<TcpConnectionPtr>& conns, const SharedPayload& payload)
+{
+    //send的回调都是排队执行的，遍历期间列表不会变
+    for (const TcpConnectionPtr& conn : conns)
+    {
+        if (conn->connected())
+        {
+            conn->send(payload);
+        }
+    }
+}
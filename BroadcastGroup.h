@@ -0,0 +1,54 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
+#include "noncopyable.h"
+#include "Callbacks.h"
+
+class EventLoop;
+
+/**
+ * 把同一条消息推送给大量连接，订阅者按所属的loop分组保存
+ * 每次广播每个loop只投递一个任务，任务在loop线程里对本组的连接逐个send(SharedPayload)，
+ * 所有连接引用同一个payload，发不完的部分排在输出队列里也不拷贝
+ * add/remove/broadcast可以在任意线程调用，每个loop的订阅者列表只在该loop线程中访问
+*/
+class BroadcastGroup : noncopyable
+{
+public:
+    BroadcastGroup();
+    ~BroadcastGroup();
+
+    //组里持有连接，连接断开时要remove，一般在connectionCallback里调用
+    void add(const TcpConnectionPtr& conn);
+    void remove(const TcpConnectionPtr& conn);
+    void broadcast(const SharedPayload& payload);
+
+    //跨线程的add/remove还没执行时不准确
+    size_t size() const;
+    uint64_t broadcasts() const { return broadcasts_; }
+
+    //不保存订阅关系的一次性广播，同样按loop分组，每个loop一个任务
+    static void broadcast(const std::vector<TcpConnectionPtr>& conns, const SharedPayload& payload);
+private:
+    //一个loop上的订阅者，按下标删除时和最后一个交换
+    struct LoopSubscribers
+    {
+        EventLoop* loop;
+        std::vector<TcpConnectionPtr> conns;
+        std::unordered_map<TcpConnection*, size_t> index;
+        std::atomic<size_t> count;//给其他线程读的conns.size()
+    };
+    using LoopSubscribersPtr = std::shared_ptr<LoopSubscribers>;
+
+    LoopSubscribersPtr subscribersOf(EventLoop* loop);
+    static void sendAll(const std::vector<TcpConnectionPtr>& conns, const SharedPayload& payload);
+
+    mutable std::mutex mutex_;
+    std::vector<LoopSubscribersPtr> loops_;//loop的个数很少，顺序查找
+    std::atomic<uint64_t> broadcasts_;
+};
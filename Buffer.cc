@@ -19,12 +19,12 @@ ssize_t Buffer::readFd(int fd, int* saveErrno)
     vec[1].iov_len = sizeof(extrabuff);
 
     const int iovcnt = (writable < sizeof(extrabuff)) ? 2 : 1;
-    const size_t n = ::readv(fd, vec, iovcnt);
+    const ssize_t n = ::readv(fd, vec, iovcnt);
     if (n < 0)
     {
         *saveErrno = errno;
     }
-    else if (n < writable)
+    else if (static_cast<size_t>(n) <= writable)
     {
         writerIndex_ += n;
     }
@@ -36,9 +36,9 @@ ssize_t Buffer::readFd(int fd, int* saveErrno)
     return n;
 }
 
-ssize_t Buffer::writeFd(int fd, int* saveErrno)
+ssize_t Buffer::writeFd(int fd, int* saveErrno, size_t maxBytes)
 {
-    ssize_t n = ::write(fd, peek(), readableBytes());
+    ssize_t n = ::write(fd, peek(), std::min(readableBytes(), maxBytes));
     if (n < 0)
     {
         *saveErrno = errno;
@@ -1,9 +1,12 @@
 #pragma once
 
+#include <stdint.h>
 #include <vector>
 #include <string>
 #include <algorithm>
 
+#include "ByteSearch.h"
+
 //网络库底层的缓冲器类定义
 class Buffer
 {
@@ -38,6 +41,77 @@ public:
         return begin() + readerIndex_;
     }
 
+    //在可读数据中查找"\r\n"，返回指向'\r'的指针，找不到返回nullptr
+    const char* findCRLF() const
+    {
+        return ByteSearch::findCRLF(peek(), beginWrite());
+    }
+
+    //从start开始查找，start必须在[peek(), beginWrite()]之间
+    const char* findCRLF(const char* start) const
+    {
+        return ByteSearch::findCRLF(start, beginWrite());
+    }
+
+    //查找行尾'\n'
+    const char* findEOL() const
+    {
+        return ByteSearch::findByte(peek(), beginWrite(), '\n');
+    }
+
+    const char* findEOL(const char* start) const
+    {
+        return ByteSearch::findByte(start, beginWrite(), '\n');
+    }
+
+    const char* findByte(char c) const
+    {
+        return ByteSearch::findByte(peek(), beginWrite(), c);
+    }
+
+    const char* findByte(char c, const char* start) const
+    {
+        return ByteSearch::findByte(start, beginWrite(), c);
+    }
+
+    //查找set[0, setLen)中任意一个字节第一次出现的位置
+    const char* findAnyOf(const char* set, size_t setLen) const
+    {
+        return ByteSearch::findAnyOf(peek(), beginWrite(), set, setLen);
+    }
+
+    const char* findAnyOf(const char* set, size_t setLen, const char* start) const
+    {
+        return ByteSearch::findAnyOf(start, beginWrite(), set, setLen);
+    }
+
+    /**
+     * 可续查的查找 scanned保存上次已经扫描过的长度(相对peek())，只扫描新到达的数据
+     * 找到时返回位置并把scanned置为该位置的偏移，找不到时返回nullptr并推进scanned
+     * 偏移相对于readerIndex_，所以readFd扩容/挪动数据后依然有效，retrieve之后调用方需要把scanned清零
+    */
+    const char* scanCRLF(size_t* scanned) const
+    {
+        const char* found = findCRLF(peek() + *scanned);
+        //'\r'可能是最后一个字节，'\n'还没有到达，所以下次要从最后一个字节重新开始
+        *scanned = found ? found - peek() : std::max(*scanned, readableBytes() > 0 ? readableBytes() - 1 : 0);
+        return found;
+    }
+
+    const char* scanByte(char c, size_t* scanned) const
+    {
+        const char* found = findByte(c, peek() + *scanned);
+        *scanned = found ? found - peek() : readableBytes();
+        return found;
+    }
+
+    const char* scanAnyOf(const char* set, size_t setLen, size_t* scanned) const
+    {
+        const char* found = findAnyOf(set, setLen, peek() + *scanned);
+        *scanned = found ? found - peek() : readableBytes();
+        return found;
+    }
+
     //onMessage Buffer_ -> string
     void retrieve(size_t len)
     {
@@ -88,8 +162,8 @@ public:
 
     //从fd上读取数据
     ssize_t readFd(int fd, int* saveErrno);
-    //通过fd发送数据
-    ssize_t writeFd(int fd, int* saveErrno);
+    //通过fd发送数据，最多发送maxBytes字节
+    ssize_t writeFd(int fd, int* saveErrno, size_t maxBytes = SIZE_MAX);
 private:
     char* begin()
     {
@@ -0,0 +1,315 @@
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define KENMUDUO_X86_SIMD 1
+#endif
+
+#include "ByteSearch.h"
+#include "Logger.h"
+
+namespace
+{
+
+//标量实现 memchr在glibc中已经足够快，CRLF先找'\r'再检查下一个字节
+const char* scalarFindByte(const char* begin, const char* end, char c)
+{
+    if (begin >= end)
+    {
+        return nullptr;
+    }
+    return static_cast<const char*>(::memchr(begin, c, end - begin));
+}
+
+const char* scalarFindCRLF(const char* begin, const char* end)
+{
+    while (begin + 1 < end)
+    {
+        const char* cr = static_cast<const char*>(::memchr(begin, '\r', end - 1 - begin));
+        if (cr == nullptr)
+        {
+            return nullptr;
+        }
+        if (cr[1] == '\n')
+        {
+            return cr;
+        }
+        begin = cr + 1;
+    }
+    return nullptr;
+}
+
+const char* scalarFindAnyOf(const char* begin, const char* end, const char* set, size_t setLen)
+{
+    if (setLen == 1)
+    {
+        return scalarFindByte(begin, end, set[0]);
+    }
+
+    uint64_t table[4] = {0, 0, 0, 0};//256位的字节集合
+    for (size_t i = 0; i < setLen; ++i)
+    {
+        unsigned char b = static_cast<unsigned char>(set[i]);
+        table[b >> 6] |= uint64_t(1) << (b & 63);
+    }
+    for (const char* p = begin; p < end; ++p)
+    {
+        unsigned char b = static_cast<unsigned char>(*p);
+        if (table[b >> 6] & (uint64_t(1) << (b & 63)))
+        {
+            return p;
+        }
+    }
+    return nullptr;
+}
+
+#ifdef KENMUDUO_X86_SIMD
+
+//SSE2是x86_64的基础指令集，不需要运行时检测
+const char* sse2FindByte(const char* begin, const char* end, char c)
+{
+    const __m128i needle = _mm_set1_epi8(c);
+    const char* p = begin;
+    for (; p + 16 <= end; p += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, needle));
+        if (mask != 0)
+        {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return scalarFindByte(p, end, c);
+}
+
+//同时比较p[i]=='\r'和p[i+1]=='\n'，两个掩码相与即为CRLF的位置
+const char* sse2FindCRLF(const char* begin, const char* end)
+{
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+    const char* p = begin;
+    for (; p + 17 <= end; p += 16)
+    {
+        __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 1));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v0, cr)) & _mm_movemask_epi8(_mm_cmpeq_epi8(v1, lf));
+        if (mask != 0)
+        {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return scalarFindCRLF(p, end);
+}
+
+const char* sse2FindAnyOf(const char* begin, const char* end, const char* set, size_t setLen)
+{
+    if (setLen == 0 || setLen > ByteSearch::kMaxVectorSet)
+    {
+        return setLen == 0 ? nullptr : scalarFindAnyOf(begin, end, set, setLen);
+    }
+
+    __m128i needles[ByteSearch::kMaxVectorSet];
+    for (size_t i = 0; i < setLen; ++i)
+    {
+        needles[i] = _mm_set1_epi8(set[i]);
+    }
+    const char* p = begin;
+    for (; p + 16 <= end; p += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i hit = _mm_cmpeq_epi8(v, needles[0]);
+        for (size_t i = 1; i < setLen; ++i)
+        {
+            hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, needles[i]));
+        }
+        int mask = _mm_movemask_epi8(hit);
+        if (mask != 0)
+        {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return scalarFindAnyOf(p, end, set, setLen);
+}
+
+//AVX2版本通过target属性单独编译，只有运行时检测到avx2才会被调用
+__attribute__((target("avx2")))
+const char* avx2FindByte(const char* begin, const char* end, char c)
+{
+    const __m256i needle = _mm256_set1_epi8(c);
+    const char* p = begin;
+    //每次处理64字节，两个比较结果先或在一起再判断，减少分支
+    for (; p + 64 <= end; p += 64)
+    {
+        __m256i a = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)), needle);
+        __m256i b = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32)), needle);
+        if (!_mm256_testz_si256(_mm256_or_si256(a, b), _mm256_or_si256(a, b)))
+        {
+            uint64_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(a))
+                | (static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(b))) << 32);
+            return p + __builtin_ctzll(mask);
+        }
+    }
+    for (; p + 32 <= end; p += 32)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, needle)));
+        if (mask != 0)
+        {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return sse2FindByte(p, end, c);
+}
+
+__attribute__((target("avx2")))
+const char* avx2FindCRLF(const char* begin, const char* end)
+{
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const __m256i lf = _mm256_set1_epi8('\n');
+    const char* p = begin;
+    for (; p + 65 <= end; p += 64)
+    {
+        __m256i a = _mm256_and_si256(
+            _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)), cr),
+            _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 1)), lf));
+        __m256i b = _mm256_and_si256(
+            _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32)), cr),
+            _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 33)), lf));
+        if (!_mm256_testz_si256(_mm256_or_si256(a, b), _mm256_or_si256(a, b)))
+        {
+            uint64_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(a))
+                | (static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(b))) << 32);
+            return p + __builtin_ctzll(mask);
+        }
+    }
+    for (; p + 33 <= end; p += 32)
+    {
+        __m256i v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 1));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v0, cr)))
+            & static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v1, lf)));
+        if (mask != 0)
+        {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return sse2FindCRLF(p, end);
+}
+
+__attribute__((target("avx2")))
+const char* avx2FindAnyOf(const char* begin, const char* end, const char* set, size_t setLen)
+{
+    if (setLen == 0 || setLen > ByteSearch::kMaxVectorSet)
+    {
+        return setLen == 0 ? nullptr : scalarFindAnyOf(begin, end, set, setLen);
+    }
+
+    __m256i needles[ByteSearch::kMaxVectorSet];
+    for (size_t i = 0; i < setLen; ++i)
+    {
+        needles[i] = _mm256_set1_epi8(set[i]);
+    }
+    const char* p = begin;
+    for (; p + 32 <= end; p += 32)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i hit = _mm256_cmpeq_epi8(v, needles[0]);
+        for (size_t i = 1; i < setLen; ++i)
+        {
+            hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, needles[i]));
+        }
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(hit));
+        if (mask != 0)
+        {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return sse2FindAnyOf(p, end, set, setLen);
+}
+
+#endif //KENMUDUO_X86_SIMD
+
+const ByteSearch::Impl kScalarImpl = {"scalar", scalarFindByte, scalarFindCRLF, scalarFindAnyOf};
+#ifdef KENMUDUO_X86_SIMD
+const ByteSearch::Impl kSse2Impl = {"sse2", sse2FindByte, sse2FindCRLF, sse2FindAnyOf};
+const ByteSearch::Impl kAvx2Impl = {"avx2", avx2FindByte, avx2FindCRLF, avx2FindAnyOf};
+#endif
+
+//根据CPU能力和环境变量选择实现，只在第一次使用时执行一次
+const ByteSearch::Impl* selectImpl()
+{
+    const ByteSearch::Impl* impl = ByteSearch::avx2Impl();
+    if (impl == nullptr)
+    {
+        impl = ByteSearch::sse2Impl();
+    }
+    if (impl == nullptr)
+    {
+        impl = ByteSearch::scalarImpl();
+    }
+
+    const char* forced = ::getenv("KENMUDUO_BYTESEARCH");
+    if (forced != nullptr)
+    {
+        const ByteSearch::Impl* candidate = nullptr;
+        if (::strcmp(forced, "scalar") == 0)
+        {
+            candidate = ByteSearch::scalarImpl();
+        }
+        else if (::strcmp(forced, "sse2") == 0)
+        {
+            candidate = ByteSearch::sse2Impl();
+        }
+        else if (::strcmp(forced, "avx2") == 0)
+        {
+            candidate = ByteSearch::avx2Impl();
+        }
+
+        if (candidate != nullptr)
+        {
+            impl = candidate;
+        }
+        else
+        {
+            LOG_ERROR("%s %s %d KENMUDUO_BYTESEARCH=%s not supported, use %s\n", __FILENAME__, __FUNCTION__, __LINE__, forced, impl->name);
+        }
+    }
+    return impl;
+}
+
+}
+
+namespace ByteSearch
+{
+    const Impl* scalarImpl()
+    {
+        return &kScalarImpl;
+    }
+
+    const Impl* sse2Impl()
+    {
+#ifdef KENMUDUO_X86_SIMD
+        return &kSse2Impl;
+#else
+        return nullptr;
+#endif
+    }
+
+    const Impl* avx2Impl()
+    {
+#ifdef KENMUDUO_X86_SIMD
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") ? &kAvx2Impl : nullptr;
+#else
+        return nullptr;
+#endif
+    }
+
+    const Impl& active()
+    {
+        static const Impl* impl = selectImpl();
+        return *impl;
+    }
+}
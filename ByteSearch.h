@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stddef.h>
+
+/**
+ * 字节查找原语，Buffer的findCRLF/findEOL/findByte等方法都基于这里实现
+ * 根据CPU能力在运行时选择AVX2/SSE2/标量实现，所有函数都在[begin, end)中查找，找不到返回nullptr
+*/
+namespace ByteSearch
+{
+    using FindByteFunc = const char* (*)(const char* begin, const char* end, char c);
+    using FindCRLFFunc = const char* (*)(const char* begin, const char* end);
+    using FindAnyOfFunc = const char* (*)(const char* begin, const char* end, const char* set, size_t setLen);
+
+    //一组查找实现
+    struct Impl
+    {
+        const char* name;
+        FindByteFunc findByte;
+        FindCRLFFunc findCRLF;//返回指向'\r'的指针
+        FindAnyOfFunc findAnyOf;//set中的任意一个字节，setLen较小时走向量路径
+    };
+
+    //可以向量化处理的字节集合上限，超过的集合退化为查表
+    const size_t kMaxVectorSet = 16;
+
+    //当前CPU上可用的实现，不支持时返回nullptr
+    const Impl* scalarImpl();
+    const Impl* sse2Impl();
+    const Impl* avx2Impl();
+
+    //运行时选中的实现，可以通过环境变量KENMUDUO_BYTESEARCH=scalar/sse2/avx2强制指定
+    const Impl& active();
+
+    inline const char* findByte(const char* begin, const char* end, char c)
+    {
+        return active().findByte(begin, end, c);
+    }
+
+    inline const char* findCRLF(const char* begin, const char* end)
+    {
+        return active().findCRLF(begin, end);
+    }
+
+    inline const char* findAnyOf(const char* begin, const char* end, const char* set, size_t setLen)
+    {
+        return active().findAnyOf(begin, end, set, setLen);
+    }
+}
@@ -8,10 +8,53 @@ const int Channel::kNoneEvent = 0;
 const int Channel::kReadEvent = EPOLLIN | EPOLLPRI;
 const int Channel::kWriteEvent = EPOLLOUT;
 
+//std::function形式的回调
+struct Channel::Callbacks
+{
+    ReadEventCallback read;
+    EventCallback write;
+    EventCallback close;
+    EventCallback error;
+};
+
 //EventLoop: Channel Poller
 Channel::Channel(EventLoop *loop, int fd)
-    : loop_(loop), fd_(fd), events_(0), revents_(0), index_(-1), tied_(false)
+    : loop_(loop), fd_(fd), events_(0), revents_(0), index_(-1), registeredEvents_(0), updatePending_(false), tied_(false),
+    ownerName_(nullptr), callbackCpuNs_(0), handler_(nullptr), readFn_(nullptr), writeFn_(nullptr), closeFn_(nullptr), errorFn_(nullptr)
+{
+}
+
+Channel::Callbacks* Channel::callbacks()
+{
+    if (!callbacks_)
+    {
+        callbacks_.reset(new Callbacks);
+    }
+    return callbacks_.get();
+}
+
+void Channel::setReadCallback(ReadEventCallback cb)
+{
+    callbacks()->read = std::move(cb);
+    readFn_ = [](Channel* c, Timestamp t) { if (c->callbacks_->read) c->callbacks_->read(t); };
+}
+
+void Channel::setWriteCallback(EventCallback cb)
+{
+    callbacks()->write = std::move(cb);
+    writeFn_ = [](Channel* c) { if (c->callbacks_->write) c->callbacks_->write(); };
+}
+
+void Channel::setCloseCallback(EventCallback cb)
+{
+    callbacks()->close = std::move(cb);
+    closeFn_ = [](Channel* c) { if (c->callbacks_->close) c->callbacks_->close(); };
+}
+
+void Channel::setErrorCallback(EventCallback cb)
 {
+    callbacks()->error = std::move(cb);
+    errorFn_ = [](Channel* c) { if (c->callbacks_->error) c->callbacks_->error(); };
 }
 
 Channel::~Channel()
@@ -62,23 +105,23 @@ void Channel::handleEvent(Timestamp receiveTime)
 //根据poller通知的channel发生的具体事件，由channel负责具体的回调操作
 void Channel::handleEventWithGuard(Timestamp receiveTime)
 {
-    LOG_INFO("%s %s %d channel handleEvent fd:%d revents:%d", __FILENAME__, __FUNCTION__, __LINE__, fd_, revents_);
+    LOG_DEBUG("%s %s %d channel handleEvent fd:%d revents:%d", __FILENAME__, __FUNCTION__, __LINE__, fd_, revents_);
     if ((revents_ & EPOLLHUP) && !(revents_ & EPOLLIN))
     {
-        if (closeCallback_) closeCallback_();
+        if (closeFn_) closeFn_(this);
     }
 
     if (revents_ & EPOLLERR)
     {
-        if (errorCallback_) errorCallback_();
+        if (errorFn_) errorFn_(this);
     }
     if (revents_ & (EPOLLIN | EPOLLPRI | EPOLLRDHUP))
     {
-        if (readCallback_) readCallback_(receiveTime);
+        if (readFn_) readFn_(this, receiveTime);
     }
     if (revents_ & EPOLLOUT)
     {
-        if (writeCallback_) writeCallback_();
+        if (writeFn_) writeFn_(this);
     }
 }
 
@@ -2,6 +2,8 @@
 
 #include <functional>
 #include <memory>
+#include <string>
+#include <stdint.h>
 
 #include "noncopyable.h"
 #include "Timestamp.h"
@@ -23,20 +25,51 @@ public:
 
     //fd得到poller通知以后，处理事件
     void handleEvent(Timestamp receiveTime);
-    //设置回调函数
-    void setReadCallback(ReadEventCallback cb){ readCallback_ = std::move(cb); }
-    void setWriteCallback(EventCallback cb){ writeCallback_ = std::move(cb); }
-    void setCloseCallback(EventCallback cb){ closeCallback_ = std::move(cb); }
-    void setErrorCallback(EventCallback cb){ errorCallback_ = std::move(cb); }
+    //设置回调函数，std::function保存在单独分配的结构里，由下面的函数指针转调
+    void setReadCallback(ReadEventCallback cb);
+    void setWriteCallback(EventCallback cb);
+    void setCloseCallback(EventCallback cb);
+    void setErrorCallback(EventCallback cb);
+
+    /**
+     * 编译期绑定的事件处理，T需要有handleRead(Timestamp)、handleWrite()、handleClose()、handleError()四个方法
+     * 分发时只经过一次普通函数指针调用，T的方法在跳板函数里静态解析，可以被内联，也不需要std::bind
+     * 方法是私有的时候把Channel声明为T的友元
+    */
+    template <typename T>
+    void setHandler(T* handler)
+    {
+        handler_ = handler;
+        readFn_ = [](Channel* c, Timestamp t) { static_cast<T*>(c->handler_)->handleRead(t); };
+        writeFn_ = [](Channel* c) { static_cast<T*>(c->handler_)->handleWrite(); };
+        closeFn_ = [](Channel* c) { static_cast<T*>(c->handler_)->handleClose(); };
+        errorFn_ = [](Channel* c) { static_cast<T*>(c->handler_)->handleError(); };
+    }
+
+    //只处理可读事件的编译期绑定，读事件交给T的任意成员方法Read，用于同一个对象拥有多个channel的情况
+    template <typename T, void (T::*Read)(Timestamp)>
+    void setReadHandler(T* handler)
+    {
+        handler_ = handler;
+        readFn_ = [](Channel* c, Timestamp t) { (static_cast<T*>(c->handler_)->*Read)(t); };
+    }
 
     //防止Channel被手动remove掉,Channel还在执行回调操作
     void tie(const std::shared_ptr<void>&);
 
     int fd() const{ return fd_; }
     int events() const{ return events_; }
+    int revents() const{ return revents_; }
     void set_revents(int revt){ revents_ = revt; }
     bool isNoneEvent() const{ return events_ == kNoneEvent; }
 
+    //EventLoop打开回调计时以后，慢回调的报告里用这个名字指明是谁的回调，name要比channel活得久
+    void setOwnerName(const std::string* name) { ownerName_ = name; }
+    const std::string* ownerName() const { return ownerName_; }
+    //回调计时打开期间这个channel的回调累计占用的线程CPU时间，只在loop线程中访问
+    void addCallbackCpuNs(int64_t ns) { callbackCpuNs_ += ns; }
+    uint64_t callbackCpuNs() const { return callbackCpuNs_; }
+
     //设置fd相应的事件状态
     void enableReading(){ events_ |= kReadEvent; update(); }
     void disableReading(){ events_ &= ~kReadEvent; update(); }
@@ -51,12 +84,24 @@ public:
     int index() { return index_; }
     void set_index(int idx) { index_ = idx; }
 
+    //最后一次通过epoll_ctl注册到poller上的事件，和events_相同时update不需要系统调用
+    int registeredEvents() const { return registeredEvents_; }
+    void set_registeredEvents(int events) { registeredEvents_ = events; }
+    //延迟更新模式下，是否已经在EventLoop的待更新列表中
+    bool updatePending() const { return updatePending_; }
+    void set_updatePending(bool pending) { updatePending_ = pending; }
+
     EventLoop* ownerLoop() { return loop_; }
     void remove();
 
 private:
+    using ReadFn = void (*)(Channel*, Timestamp);
+    using EventFn = void (*)(Channel*);
+    struct Callbacks;
+
     void update();
     void handleEventWithGuard(Timestamp receiveTime);
+    Callbacks* callbacks();
 
     static const int kNoneEvent;
     static const int kReadEvent;
@@ -67,13 +112,21 @@ private:
     int events_; //注册fd感兴趣的事件
     int revents_; //poller返回的具体发生的事情
     int index_;
+    int registeredEvents_;
+    bool updatePending_;
 
     std::weak_ptr<void> tie_;
     bool tied_;
 
+    const std::string* ownerName_;
+    uint64_t callbackCpuNs_;
+
     //因为Channel通道里面能够获知fd最终发生的具体的事件revents，所以它负责调用具体的事件回调函数
-    ReadEventCallback readCallback_;
-    EventCallback writeCallback_;
-    EventCallback closeCallback_;
-    EventCallback errorCallback_;
+    //每种事件一个函数指针，指向setHandler生成的跳板或者转调std::function的适配函数，为空表示没有设置
+    void* handler_;
+    ReadFn readFn_;
+    EventFn writeFn_;
+    EventFn closeFn_;
+    EventFn errorFn_;
+    std::unique_ptr<Callbacks> callbacks_;//只有使用std::function接口时才分配
 };
\ No newline at end of file
@@ -0,0 +1,225 @@
+#include <stdio.h>
+
+#include "ComputeThreadPool.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+namespace
+{
+//当前线程所属的线程池和队列下标，计算线程里再提交的任务放进自己的队列
+thread_local ComputeThreadPool* t_pool = nullptr;
+thread_local int t_workerIndex = -1;
+}
+
+ComputeThreadPool::ComputeThreadPool(const std::string& nameArg)
+    :name_(nameArg),
+    numThreads_(1),
+    next_(0),
+    pending_(0),
+    idle_(0),
+    running_(false),
+    steals_(0),
+    completionBatches_(0)
+{
+}
+
+ComputeThreadPool::~ComputeThreadPool()
+{
+    stop();
+}
+
+void ComputeThreadPool::start()
+{
+    running_ = true;
+    for (int i = 0; i < numThreads_; ++i)
+    {
+        workers_.emplace_back(new Worker());
+        workers_.back()->seed = static_cast<uint32_t>(i * 2654435761u + 1);
+    }
+    for (int i = 0; i < numThreads_; ++i)
+    {
+        char buf[name_.size() + 32];
+        snprintf(buf, sizeof(buf), "%s%d", name_.c_str(), i);
+        workers_[i]->thread.reset(new Thread(std::bind(&ComputeThreadPool::runInThread, this, i), buf));
+        workers_[i]->thread->start();
+    }
+    LOG_INFO("%s %s %d %s started %d threads\n", __FILENAME__, __FUNCTION__, __LINE__, name_.c_str(), numThreads_);
+}
+
+void ComputeThreadPool::stop()
+{
+    if (!running_.exchange(false))
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(idleMutex_);
+        idleCond_.notify_all();
+    }
+    for (auto& worker : workers_)
+    {
+        worker->thread->join();
+    }
+}
+
+void ComputeThreadPool::submit(EventLoop* loop, Task work, Task done)
+{
+    Job job;
+    job.work = std::move(work);
+    job.done = std::move(done);
+    job.completion = loop != nullptr && job.done ? completionQueueOf(loop) : nullptr;
+    push(std::move(job));
+}
+
+void ComputeThreadPool::submit(Task work)
+{
+    Job job;
+    job.work = std::move(work);
+    job.completion = nullptr;
+    push(std::move(job));
+}
+
+void ComputeThreadPool::push(Job job)
+{
+    //没有启动工作线程时直接在调用线程中执行
+    if (workers_.empty())
+    {
+        job.work();
+        if (job.completion != nullptr)
+        {
+            job.completion->loop->runInLoop(std::move(job.done));
+        }
+        return;
+    }
+    int index = t_pool == this ? t_workerIndex : static_cast<int>(next_++ % workers_.size());
+    {
+        std::lock_guard<std::mutex> lock(workers_[index]->mutex);
+        workers_[index]->jobs.push_back(std::move(job));
+    }
+    //先增加计数再检查空闲线程，等待条件里读的是pending_，不会丢失唤醒
+    ++pending_;
+    std::lock_guard<std::mutex> lock(idleMutex_);
+    if (idle_ > 0)
+    {
+        idleCond_.notify_one();
+    }
+}
+
+void ComputeThreadPool::runInThread(int index)
+{
+    t_pool = this;
+    t_workerIndex = index;
+    Job job;
+    for (;;)
+    {
+        if (popLocal(index, &job) || steal(index, &job))
+        {
+            --pending_;
+            job.work();
+            if (job.completion != nullptr)
+            {
+                complete(&job);
+            }
+            job = Job();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(idleMutex_);
+        if (!running_ && pending_ == 0)
+        {
+            break;
+        }
+        ++idle_;
+        idleCond_.wait(lock, [this]() { return pending_ > 0 || !running_; });
+        --idle_;
+    }
+}
+
+//自己的队列从尾部取，刚提交的任务数据还在缓存里
+bool ComputeThreadPool::popLocal(int index, Job* job)
+{
+    Worker* worker = workers_[index].get();
+    std::lock_guard<std::mutex> lock(worker->mutex);
+    if (worker->jobs.empty())
+    {
+        return false;
+    }
+    *job = std::move(worker->jobs.back());
+    worker->jobs.pop_back();
+    return true;
+}
+
+//从随机的一个线程开始依次尝试，偷它队列头部最早提交的任务
+bool ComputeThreadPool::steal(int index, Job* job)
+{
+    Worker* self = workers_[index].get();
+    int n = static_cast<int>(workers_.size());
+    self->seed ^= self->seed << 13;
+    self->seed ^= self->seed >> 17;
+    self->seed ^= self->seed << 5;
+    int start = static_cast<int>(self->seed % n);
+    for (int i = 0; i < n; ++i)
+    {
+        int victim = (start + i) % n;
+        if (victim == index)
+        {
+            continue;
+        }
+        Worker* worker = workers_[victim].get();
+        std::lock_guard<std::mutex> lock(worker->mutex);
+        if (!worker->jobs.empty())
+        {
+            *job = std::move(worker->jobs.front());
+            worker->jobs.pop_front();
+            ++steals_;
+            return true;
+        }
+    }
+    return false;
+}
+
+//完成回调放进loop的队列，队列里已经有等待执行的批次时不需要再唤醒loop
+void ComputeThreadPool::complete(Job* job)
+{
+    CompletionQueue* queue = job->completion;
+    bool schedule = false;
+    {
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        queue->done.push_back(std::move(job->done));
+        schedule = !queue->scheduled;
+        queue->scheduled = true;
+    }
+    if (schedule)
+    {
+        ++completionBatches_;
+        queue->loop->queueInLoop(std::bind(&ComputeThreadPool::drain, queue));
+    }
+}
+
+ComputeThreadPool::CompletionQueue* ComputeThreadPool::completionQueueOf(EventLoop* loop)
+{
+    std::lock_guard<std::mutex> lock(completionMutex_);
+    std::unique_ptr<CompletionQueue>& queue = completionQueues_[loop];
+    if (!queue)
+    {
+        queue.reset(new CompletionQueue());
+        queue->loop = loop;
+        queue->scheduled = false;
+    }
+    return queue.get();
+}
+
+//在loop线程中执行一批完成回调
+void ComputeThreadPool::drain(CompletionQueue* queue)
+{
+    std::vector<Task> done;
+    {
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        done.swap(queue->done);
+        queue->scheduled = false;
+    }
+    for (const Task& task : done)
+    {
+        task();
+    }
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <atomic>
+
+#include "noncopyable.h"
+#include "Thread.h"
+
+class EventLoop;
+
+/**
+ * 计算线程池，给压缩、加解密、序列化这类会长时间占用CPU的处理使用，EventLoopThreadPool只负责IO
+ * 每个工作线程有自己的任务队列，自己从尾部取(后进先出，缓存更热)，空闲时从随机选中的其他线程头部偷任务
+ * submit带上loop时，任务完成后的回调自动回到这个loop线程中执行；
+ * 同一个loop的多个完成回调攒成一批，一次queueInLoop，减少对loop的唤醒
+ * 线程池要比提交过任务的loop活得久，stop会执行完已经提交的任务
+*/
+class ComputeThreadPool : noncopyable
+{
+public:
+    using Task = std::function<void()>;
+
+    explicit ComputeThreadPool(const std::string& nameArg = std::string("ComputeThreadPool"));
+    ~ComputeThreadPool();
+
+    void setThreadNum(int numThreads) { numThreads_ = numThreads; }
+    void start();
+    void stop();
+
+    //在计算线程中执行work，完成以后在loop线程中执行done
+    void submit(EventLoop* loop, Task work, Task done);
+    //不需要回到loop的任务，在计算线程中提交时放进当前线程自己的队列
+    void submit(Task work);
+
+    const std::string& name() const { return name_; }
+    //从其他线程偷到的任务数，以及投递到loop的完成批次数
+    uint64_t steals() const { return steals_; }
+    uint64_t completionBatches() const { return completionBatches_; }
+private:
+    //一个loop的待执行完成回调
+    struct CompletionQueue
+    {
+        EventLoop* loop;
+        std::mutex mutex;
+        std::vector<Task> done;
+        bool scheduled;//已经queueInLoop，还没有执行drain
+    };
+
+    struct Job
+    {
+        Task work;
+        Task done;
+        CompletionQueue* completion;
+    };
+
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+        std::unique_ptr<Thread> thread;
+        uint32_t seed;//选择偷取对象的随机数状态，只有自己的线程访问
+    };
+
+    void push(Job job);
+    void runInThread(int index);
+    bool popLocal(int index, Job* job);
+    bool steal(int index, Job* job);
+    void complete(Job* job);
+    CompletionQueue* completionQueueOf(EventLoop* loop);
+    static void drain(CompletionQueue* queue);
+
+    std::string name_;
+    int numThreads_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::atomic<unsigned> next_;//外部线程提交时轮流选择工作线程
+
+    std::mutex idleMutex_;
+    std::condition_variable idleCond_;
+    std::atomic<int> pending_;//已经提交还没有被取走的任务
+    int idle_;//等待中的工作线程，由idleMutex_保护
+    std::atomic<bool> running_;
+
+    std::mutex completionMutex_;
+    std::unordered_map<EventLoop*, std::unique_ptr<CompletionQueue>> completionQueues_;
+
+    std::atomic<uint64_t> steals_;
+    std::atomic<uint64_t> completionBatches_;
+};
@@ -0,0 +1,325 @@
+#include <sys/socket.h>
+#include <strings.h>
+#include <stdio.h>
+#include <algorithm>
+
+#include "ConnectionPool.h"
+#include "Connector.h"
+#include "EventLoop.h"
+#include "TcpConnection.h"
+#include "Logger.h"
+
+ConnectionPool::ConnectionPool(EventLoop* loop, const std::string& name)
+    :loop_(loop),
+    name_(name),
+    maxPerEndpoint_(8),
+    idleTimeout_(0),
+    nextConnId_(1),
+    connectsStarted_(0),
+    reused_(0),
+    guard_(std::make_shared<ConnectionPool*>(this))
+{
+    setIdleTimeout(60.0);
+}
+
+ConnectionPool::~ConnectionPool()
+{
+    guard_.reset();
+    if (evictTimer_.valid())
+    {
+        loop_->cancel(evictTimer_);
+    }
+    for (auto& item : connectors_)
+    {
+        item.second->stop();
+    }
+    for (auto& item : connections_)
+    {
+        //连接可能比池活得更久，关闭回调里不能再访问this
+        TcpConnectionPtr conn(item.second);
+        conn->setCloseCallback([](const TcpConnectionPtr& c) {
+            c->getLoop()->queueInLoop(std::bind(&TcpConnection::connectionDestroyed, c));
+        });
+        conn->forceClose();
+    }
+    //借出的连接随池一起关闭，告诉借用方
+    std::unordered_map<TcpConnection*, CloseCallback> borrowed;
+    borrowed.swap(borrowed_);
+    for (auto& item : borrowed)
+    {
+        auto it = connections_.find(item.first);
+        if (item.second && it != connections_.end())
+        {
+            item.second(it->second);
+        }
+    }
+    for (auto& item : endpoints_)
+    {
+        for (Waiter& waiter : item.second.waiters)
+        {
+            waiter.acquired(TcpConnectionPtr());
+        }
+    }
+}
+
+void ConnectionPool::setIdleTimeout(double seconds)
+{
+    idleTimeout_ = seconds;
+    if (evictTimer_.valid())
+    {
+        loop_->cancel(evictTimer_);
+        evictTimer_ = TimerId();
+    }
+    if (seconds > 0)
+    {
+        evictTimer_ = loop_->runEvery(std::max(seconds / 2, 0.1), std::bind(&ConnectionPool::evictIdle, this));
+    }
+}
+
+ConnectionPool::Endpoint& ConnectionPool::endpoint(const InetAddress& addr)
+{
+    auto it = endpoints_.find(addr.toIpPort());
+    if (it == endpoints_.end())
+    {
+        Endpoint ep;
+        ep.addr = addr;
+        ep.total = 0;
+        ep.connecting = 0;
+        it = endpoints_.emplace(addr.toIpPort(), std::move(ep)).first;
+    }
+    return it->second;
+}
+
+void ConnectionPool::acquire(const InetAddress& serverAddr, const AcquireCallback& cb, const CloseCallback& closeCallback)
+{
+    Waiter waiter{cb, closeCallback};
+    if (loop_->isInLoopThread())
+    {
+        acquireInLoop(serverAddr, waiter);
+        return;
+    }
+    std::weak_ptr<ConnectionPool*> guard(guard_);
+    loop_->queueInLoop([guard, serverAddr, waiter]() {
+        std::shared_ptr<ConnectionPool*> pool(guard.lock());
+        if (!pool)
+        {
+            waiter.acquired(TcpConnectionPtr());
+            return;
+        }
+        (*pool)->acquireInLoop(serverAddr, waiter);
+    });
+}
+
+void ConnectionPool::acquireInLoop(const InetAddress& serverAddr, const Waiter& waiter)
+{
+    Endpoint& ep = endpoint(serverAddr);
+    while (!ep.idle.empty())
+    {
+        TcpConnectionPtr conn(std::move(ep.idle.back().conn));
+        ep.idle.pop_back();
+        if (conn->connected())
+        {
+            ++reused_;
+            lend(conn, waiter);
+            return;
+        }
+    }
+    ep.waiters.push_back(waiter);
+    connectMore(&ep);
+}
+
+void ConnectionPool::lend(const TcpConnectionPtr& conn, const Waiter& waiter)
+{
+    if (conn)
+    {
+        borrowed_[conn.get()] = waiter.closed;
+    }
+    waiter.acquired(conn);
+}
+
+void ConnectionPool::connectMore(Endpoint* ep)
+{
+    const std::string key = ep->addr.toIpPort();
+    while (ep->waiters.size() > ep->connecting && ep->total < maxPerEndpoint_)
+    {
+        ++ep->total;
+        ++ep->connecting;
+        ++connectsStarted_;
+        std::shared_ptr<Connector> connector(new Connector(loop_, ep->addr));
+        Connector* raw = connector.get();
+        //失败的时候让等待的请求尽快知道，不在这里重试
+        connector->setRetry(false);
+        connector->setNewConnectionCallback([this, key, raw](int sockfd) { newConnection(key, raw, sockfd); });
+        connector->setErrorCallback([this, key, raw](int err) { connectFailed(key, raw, err); });
+        connectors_[raw] = connector;
+        connector->start();
+    }
+}
+
+void ConnectionPool::finishConnector(Connector* connector)
+{
+    auto it = connectors_.find(connector);
+    if (it != connectors_.end())
+    {
+        std::shared_ptr<Connector> keep(std::move(it->second));
+        connectors_.erase(it);
+        loop_->queueInLoop([keep]() {});
+    }
+}
+
+void ConnectionPool::newConnection(const std::string& key, Connector* connector, int sockfd)
+{
+    finishConnector(connector);
+    Endpoint& ep = endpoints_[key];
+    --ep.connecting;
+
+    char buf[64] = {0};
+    snprintf(buf, sizeof(buf), ":%s#%d", key.c_str(), nextConnId_);
+    ++nextConnId_;
+    sockaddr_storage local;
+    bzero(&local, sizeof(local));
+    socklen_t addrlen = sizeof(local);
+    ::getsockname(sockfd, (sockaddr*)&local, &addrlen);
+    InetAddress localAddr;
+    localAddr.setSockAddr((sockaddr*)&local, addrlen);
+
+    TcpConnectionPtr conn(new TcpConnection(loop_, name_ + buf, sockfd, localAddr, ep.addr));
+    conn->setConnectionCallback([](const TcpConnectionPtr&) {});
+    conn->setMessageCallback(std::bind(&ConnectionPool::idleMessage, std::placeholders::_1, std::placeholders::_2,
+        std::placeholders::_3));
+    conn->setCloseCallback(std::bind(&ConnectionPool::removeConnection, this, std::placeholders::_1));
+    conn->setTcpNoDelay(true);
+    connections_[conn.get()] = conn;
+    conn->connectEstablished();
+
+    if (!ep.waiters.empty())
+    {
+        Waiter waiter(std::move(ep.waiters.front()));
+        ep.waiters.pop_front();
+        lend(conn, waiter);
+    }
+    else
+    {
+        ep.idle.push_back(IdleConnection{conn, Timestamp::now()});
+    }
+}
+
+void ConnectionPool::connectFailed(const std::string& key, Connector* connector, int err)
+{
+    finishConnector(connector);
+    Endpoint& ep = endpoints_[key];
+    --ep.total;
+    --ep.connecting;
+    LOG_ERROR("%s %s %d %s connect %s failed, error:%d\n", __FILENAME__, __FUNCTION__, __LINE__, name_.c_str(), key.c_str(), err);
+    //为这次连接排队的请求以失败结束，其余的继续等
+    if (ep.waiters.size() > ep.connecting)
+    {
+        Waiter waiter(std::move(ep.waiters.front()));
+        ep.waiters.pop_front();
+        lend(TcpConnectionPtr(), waiter);
+    }
+}
+
+void ConnectionPool::release(const TcpConnectionPtr& conn)
+{
+    //调用方通常在这个连接的messageCallback里归还，这时不能替换正在执行的回调，等这一轮事件处理完再放回池里
+    //池已经析构的话连接也已经被关闭了，什么都不用做
+    if (loop_->isInLoopThread())
+    {
+        borrowed_.erase(conn.get());//归还以后断开不再通知借用方
+    }
+    std::weak_ptr<ConnectionPool*> guard(guard_);
+    loop_->queueInLoop([guard, conn]() {
+        std::shared_ptr<ConnectionPool*> pool(guard.lock());
+        if (pool)
+        {
+            (*pool)->releaseInLoop(conn);
+        }
+    });
+}
+
+void ConnectionPool::releaseInLoop(const TcpConnectionPtr& conn)
+{
+    if (!conn->connected())
+    {
+        return;//关闭回调里已经处理了计数，也通知过借用方
+    }
+    borrowed_.erase(conn.get());
+    conn->setMessageCallback(std::bind(&ConnectionPool::idleMessage, std::placeholders::_1, std::placeholders::_2,
+        std::placeholders::_3));
+    Endpoint& ep = endpoint(conn->peerAddress());
+    if (!ep.waiters.empty())
+    {
+        Waiter waiter(std::move(ep.waiters.front()));
+        ep.waiters.pop_front();
+        ++reused_;
+        lend(conn, waiter);
+        return;
+    }
+    ep.idle.push_back(IdleConnection{conn, Timestamp::now()});
+}
+
+void ConnectionPool::idleMessage(const TcpConnectionPtr& conn, Buffer* buffer, Timestamp)
+{
+    LOG_ERROR("%s %s %d %s unexpected %zu bytes on idle connection\n", __FILENAME__, __FUNCTION__, __LINE__,
+        conn->name().c_str(), buffer->readableBytes());
+    buffer->retrieveAll();
+    conn->forceClose();
+}
+
+void ConnectionPool::removeConnection(const TcpConnectionPtr& conn)
+{
+    connections_.erase(conn.get());
+    Endpoint& ep = endpoint(conn->peerAddress());
+    --ep.total;
+    for (auto it = ep.idle.begin(); it != ep.idle.end(); ++it)
+    {
+        if (it->conn == conn)
+        {
+            ep.idle.erase(it);
+            break;
+        }
+    }
+    loop_->queueInLoop(std::bind(&TcpConnection::connectionDestroyed, conn));
+    CloseCallback closed;
+    auto borrowed = borrowed_.find(conn.get());
+    if (borrowed != borrowed_.end())
+    {
+        closed.swap(borrowed->second);
+        borrowed_.erase(borrowed);
+    }
+    connectMore(&ep);
+    //借用方可能在回调里马上重新acquire，池的状态要先整理好
+    if (closed)
+    {
+        closed(conn);
+    }
+}
+
+void ConnectionPool::evictIdle()
+{
+    Timestamp now = Timestamp::now();
+    for (auto& item : endpoints_)
+    {
+        std::deque<IdleConnection>& idle = item.second.idle;
+        //前面的空闲得最久
+        while (!idle.empty() && timeDifference(now, idle.front().since) > idleTimeout_)
+        {
+            TcpConnectionPtr conn(std::move(idle.front().conn));
+            idle.pop_front();
+            conn->forceClose();
+        }
+    }
+}
+
+size_t ConnectionPool::idleConnections(const InetAddress& serverAddr) const
+{
+    auto it = endpoints_.find(serverAddr.toIpPort());
+    return it == endpoints_.end() ? 0 : it->second.idle.size();
+}
+
+size_t ConnectionPool::totalConnections(const InetAddress& serverAddr) const
+{
+    auto it = endpoints_.find(serverAddr.toIpPort());
+    return it == endpoints_.end() ? 0 : it->second.total;
+}
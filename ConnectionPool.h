@@ -0,0 +1,103 @@
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <functional>
+#include <unordered_map>
+
+#include "noncopyable.h"
+#include "InetAddress.h"
+#include "Callbacks.h"
+#include "TimerId.h"
+#include "Timestamp.h"
+
+class EventLoop;
+class Connector;
+
+/**
+ * 到上游服务的连接池，每个loop一个，按服务端地址分组
+ * 在subloop里发起的请求从本loop的池里借连接，连接和回调都在同一个线程，不需要跨线程转发
+ * 借出的连接由调用方设置messageCallback，用完调用release归还；空闲连接上收到数据说明协议乱了，直接关闭
+ * 借出期间连接断开(包括池析构时关闭)会调用acquire时给的closeCallback，调用方据此结束还在等响应的请求
+ * 每个地址的连接数(空闲、借出、正在建立)有上限，到上限以后acquire排队等待归还；空闲太久的连接被关闭
+ * 在loop线程中析构；acquire和release可以在其他线程调用，池析构以后才执行到的acquire以失败结束
+*/
+class ConnectionPool : noncopyable
+{
+public:
+    //连接失败时conn为空
+    using AcquireCallback = std::function<void(const TcpConnectionPtr& conn)>;
+
+    ConnectionPool(EventLoop* loop, const std::string& name);
+    ~ConnectionPool();
+
+    //默认每个地址最多8个连接
+    void setMaxPerEndpoint(size_t n) { maxPerEndpoint_ = n; }
+    //空闲超过seconds秒的连接被关闭，默认60秒，0表示不关闭
+    void setIdleTimeout(double seconds);
+
+    //有空闲连接时立即回调；没到上限就新建连接，连上以后回调；否则排队等别的请求归还
+    //closeCallback在借出的连接归还之前断开时调用
+    void acquire(const InetAddress& serverAddr, const AcquireCallback& cb,
+        const CloseCallback& closeCallback = CloseCallback());
+    //归还借到的连接，调用方要保证上面没有还没完成的请求，已经断开的连接不会放回池里
+    //可以在这个连接的messageCallback里调用，本轮事件处理完以后才真正放回池里
+    void release(const TcpConnectionPtr& conn);
+
+    size_t idleConnections(const InetAddress& serverAddr) const;
+    size_t totalConnections(const InetAddress& serverAddr) const;
+    //发起过的连接数和直接复用空闲连接的次数
+    uint64_t connectsStarted() const { return connectsStarted_; }
+    uint64_t reused() const { return reused_; }
+private:
+    struct IdleConnection
+    {
+        TcpConnectionPtr conn;
+        Timestamp since;
+    };
+    struct Waiter
+    {
+        AcquireCallback acquired;
+        CloseCallback closed;
+    };
+    struct Endpoint
+    {
+        InetAddress addr;
+        std::deque<IdleConnection> idle;//后面是最近归还的，优先借出
+        std::deque<Waiter> waiters;
+        size_t total;//包括正在建立的
+        size_t connecting;
+    };
+
+    Endpoint& endpoint(const InetAddress& addr);
+    void acquireInLoop(const InetAddress& serverAddr, const Waiter& waiter);
+    //把conn借给waiter，conn为空表示失败
+    void lend(const TcpConnectionPtr& conn, const Waiter& waiter);
+    //排队的请求多于正在建立的连接时，在上限以内补充新连接
+    void connectMore(Endpoint* ep);
+    void newConnection(const std::string& key, Connector* connector, int sockfd);
+    void connectFailed(const std::string& key, Connector* connector, int err);
+    //Connector在自己的回调里，等这一轮事件处理完再释放
+    void finishConnector(Connector* connector);
+    void releaseInLoop(const TcpConnectionPtr& conn);
+    //空闲连接上收到数据说明和服务端的请求应答对不上了
+    static void idleMessage(const TcpConnectionPtr& conn, Buffer* buffer, Timestamp);
+    void removeConnection(const TcpConnectionPtr& conn);
+    void evictIdle();
+
+    EventLoop* loop_;
+    const std::string name_;
+    size_t maxPerEndpoint_;
+    double idleTimeout_;
+    TimerId evictTimer_;
+    int nextConnId_;
+
+    std::unordered_map<std::string, Endpoint> endpoints_;
+    std::unordered_map<Connector*, std::shared_ptr<Connector>> connectors_;
+    std::unordered_map<TcpConnection*, TcpConnectionPtr> connections_;//池建立的所有连接
+    std::unordered_map<TcpConnection*, CloseCallback> borrowed_;//借出的连接和借用方的closeCallback
+    uint64_t connectsStarted_;
+    uint64_t reused_;
+    std::shared_ptr<ConnectionPool*> guard_;//跨线程投递的任务通过它判断池是否已经析构
+};
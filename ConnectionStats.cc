@@ -0,0 +1,53 @@
+#include <algorithm>
+
+#include "ConnectionStats.h"
+
+void TrafficTotals::add(const ConnectionStats& stats, Timestamp now)
+{
+    ++connections;
+    bytesIn += stats.bytesIn;
+    bytesOut += stats.bytesOut;
+    messagesIn += stats.messagesIn;
+    messagesOut += stats.messagesOut;
+    readCalls += stats.readCalls;
+    writeCalls += stats.writeCalls;
+    peakOutputBytes = std::max(peakOutputBytes, stats.peakOutputBytes);
+    pendingOutputUs += stats.pendingOutputUs;
+    if (stats.pendingSince.valid())
+    {
+        pendingOutputUs += now.microSecondsSinceEpoch() - stats.pendingSince.microSecondsSinceEpoch();
+    }
+}
+
+void TrafficTotals::add(const TrafficTotals& other)
+{
+    connections += other.connections;
+    bytesIn += other.bytesIn;
+    bytesOut += other.bytesOut;
+    messagesIn += other.messagesIn;
+    messagesOut += other.messagesOut;
+    readCalls += other.readCalls;
+    writeCalls += other.writeCalls;
+    peakOutputBytes = std::max(peakOutputBytes, other.peakOutputBytes);
+    pendingOutputUs += other.pendingOutputUs;
+}
+
+void TcpInfoSummary::add(const TcpInfoSample& info)
+{
+    ++samples;
+    rttSumUs += info.rttUs;
+    maxRttUs = std::max(maxRttUs, info.rttUs);
+    unacked += info.unacked;
+    lost += info.lost;
+    totalRetrans += info.totalRetrans;
+}
+
+void TcpInfoSummary::add(const TcpInfoSummary& other)
+{
+    samples += other.samples;
+    rttSumUs += other.rttSumUs;
+    maxRttUs = std::max(maxRttUs, other.maxRttUs);
+    unacked += other.unacked;
+    lost += other.lost;
+    totalRetrans += other.totalRetrans;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "Timestamp.h"
+
+class EventLoop;
+
+/**
+ * 一个连接自己的流量统计，由连接所属的loop线程更新，也只在这个线程中读取
+ * pendingOutputUs是输出队列非空的累计时间：对端收得慢或者网络差时会变大，服务端自己处理得慢时不会
+*/
+struct ConnectionStats
+{
+    ConnectionStats()
+        :bytesIn(0), bytesOut(0), messagesIn(0), messagesOut(0), readCalls(0), writeCalls(0),
+        peakOutputBytes(0), pendingOutputUs(0)
+    {
+    }
+
+    uint64_t bytesIn;
+    uint64_t bytesOut;
+    uint64_t messagesIn;//messageCallback的调用次数
+    uint64_t messagesOut;//send的调用次数
+    uint64_t readCalls;
+    uint64_t writeCalls;//write/writev/sendmsg系统调用次数
+    size_t peakOutputBytes;//outputBytes()的最大值
+    int64_t pendingOutputUs;
+    Timestamp pendingSince;//输出队列从什么时候开始非空，为空时无效
+};
+
+//TCP_INFO里和发送质量有关的字段，时间单位是微秒
+struct TcpInfoSample
+{
+    uint32_t rttUs;
+    uint32_t rttVarUs;
+    uint32_t sndCwnd;//拥塞窗口，单位是MSS
+    uint32_t sndMss;
+    uint32_t unacked;//已发送还没确认的段数
+    uint32_t lost;
+    uint32_t retransmits;//当前这次超时重传的次数
+    uint32_t totalRetrans;//整个连接累计重传的段数
+};
+
+//一组连接的流量合计
+struct TrafficTotals
+{
+    TrafficTotals()
+        :connections(0), bytesIn(0), bytesOut(0), messagesIn(0), messagesOut(0), readCalls(0), writeCalls(0),
+        peakOutputBytes(0), pendingOutputUs(0)
+    {
+    }
+
+    void add(const ConnectionStats& stats, Timestamp now);
+    void add(const TrafficTotals& other);
+
+    uint64_t connections;
+    uint64_t bytesIn;
+    uint64_t bytesOut;
+    uint64_t messagesIn;
+    uint64_t messagesOut;
+    uint64_t readCalls;
+    uint64_t writeCalls;
+    size_t peakOutputBytes;//所有连接中的最大值
+    int64_t pendingOutputUs;//包括统计时还在进行中的那一段
+};
+
+//一组连接的TCP_INFO合计
+struct TcpInfoSummary
+{
+    TcpInfoSummary()
+        :samples(0), rttSumUs(0), maxRttUs(0), unacked(0), lost(0), totalRetrans(0)
+    {
+    }
+
+    void add(const TcpInfoSample& info);
+    void add(const TcpInfoSummary& other);
+    double meanRttUs() const { return samples > 0 ? static_cast<double>(rttSumUs) / samples : 0; }
+
+    uint64_t samples;
+    uint64_t rttSumUs;
+    uint32_t maxRttUs;
+    uint64_t unacked;
+    uint64_t lost;
+    uint64_t totalRetrans;
+};
+
+struct ConnectionSample
+{
+    std::string name;
+    EventLoop* loop;
+    ConnectionStats stats;
+    bool hasTcpInfo;//Unix域socket没有TCP_INFO
+    TcpInfoSample tcpInfo;
+};
+
+struct LoopStats
+{
+    LoopStats() : loop(nullptr) {}
+
+    EventLoop* loop;
+    TrafficTotals traffic;
+    TcpInfoSummary tcp;
+};
+
+//TcpServer::collectStats的结果
+struct ServerStats
+{
+    Timestamp when;
+    LoopStats total;//当前所有连接的合计，loop为空
+    std::vector<LoopStats> loops;//每个loop上当前连接的合计
+    TrafficTotals closed;//已经关闭的连接的合计
+    std::vector<ConnectionSample> connections;//collectStats要求时才有
+};
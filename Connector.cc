@@ -0,0 +1,240 @@
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <algorithm>
+
+#include "Connector.h"
+#include "Channel.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+Connector::Connector(EventLoop* loop, const InetAddress& serverAddr)
+    :loop_(loop),
+    serverAddr_(serverAddr),
+    connect_(false),
+    state_(kDisconnected),
+    retry_(true),
+    initRetryDelay_(0.5),
+    maxRetryDelay_(30.0),
+    retryDelay_(0.5)
+{
+}
+
+Connector::~Connector()
+{
+    if (channel_)
+    {
+        LOG_ERROR("%s %s %d connector to %s destroyed while connecting\n", __FILENAME__, __FUNCTION__, __LINE__,
+            serverAddr_.toIpPort().c_str());
+    }
+}
+
+void Connector::setRetryDelay(double initRetryDelay, double maxRetryDelay)
+{
+    initRetryDelay_ = initRetryDelay;
+    maxRetryDelay_ = std::max(initRetryDelay, maxRetryDelay);
+    retryDelay_ = initRetryDelay;
+}
+
+void Connector::start()
+{
+    connect_ = true;
+    loop_->runInLoop(std::bind(&Connector::startInLoop, shared_from_this()));
+}
+
+void Connector::startInLoop()
+{
+    if (connect_ && state_ == kDisconnected)
+    {
+        connect();
+    }
+}
+
+void Connector::restart()
+{
+    setState(kDisconnected);
+    retryDelay_ = initRetryDelay_;
+    connect_ = true;
+    startInLoop();
+}
+
+void Connector::stop()
+{
+    connect_ = false;
+    loop_->queueInLoop(std::bind(&Connector::stopInLoop, shared_from_this()));
+}
+
+void Connector::stopInLoop()
+{
+    if (retryTimer_.valid())
+    {
+        loop_->cancel(retryTimer_);
+        retryTimer_ = TimerId();
+    }
+    if (state_ == kConnecting)
+    {
+        setState(kDisconnected);
+        int sockfd = removeAndResetChannel();
+        ::close(sockfd);
+    }
+}
+
+void Connector::connect()
+{
+    if (!serverAddr_.valid())
+    {
+        //地址本身不对，重试也没有用
+        LOG_ERROR("%s %s %d invalid server address\n", __FILENAME__, __FUNCTION__, __LINE__);
+        if (errorCallback_)
+        {
+            errorCallback_(EINVAL);
+        }
+        return;
+    }
+    int protocol = serverAddr_.isUnix() ? 0 : IPPROTO_TCP;
+    int sockfd = ::socket(serverAddr_.family(), SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, protocol);
+    if (sockfd < 0)
+    {
+        int err = errno;
+        LOG_ERROR("%s %s %d socket error:%d\n", __FILENAME__, __FUNCTION__, __LINE__, err);
+        if (errorCallback_)
+        {
+            errorCallback_(err);
+        }
+        return;
+    }
+    int ret = ::connect(sockfd, serverAddr_.getSockAddr(), serverAddr_.getSockAddrLen());
+    int err = (ret == 0) ? 0 : errno;
+    switch (err)
+    {
+    case 0:
+    case EINPROGRESS:
+    case EINTR:
+    case EISCONN:
+        connecting(sockfd);
+        break;
+    case EAGAIN://本地端口用完或者Unix域监听队列满了，稍后重试
+    case EADDRINUSE:
+    case EADDRNOTAVAIL:
+    case ECONNREFUSED:
+    case ENETUNREACH:
+    case ENOENT:
+        retry(sockfd, err);
+        break;
+    default:
+        LOG_ERROR("%s %s %d connect %s error:%d\n", __FILENAME__, __FUNCTION__, __LINE__, serverAddr_.toIpPort().c_str(), err);
+        ::close(sockfd);
+        if (errorCallback_)
+        {
+            errorCallback_(err);
+        }
+        break;
+    }
+}
+
+void Connector::connecting(int sockfd)
+{
+    setState(kConnecting);
+    channel_.reset(new Channel(loop_, sockfd));
+    channel_->setHandler(this);
+    channel_->enableWriting();
+}
+
+int Connector::removeAndResetChannel()
+{
+    channel_->disableAll();
+    channel_->remove();
+    int sockfd = channel_->fd();
+    //现在还在Channel::handleEvent里，不能在这里析构channel_
+    loop_->queueInLoop(std::bind(&Connector::resetChannel, shared_from_this()));
+    return sockfd;
+}
+
+void Connector::resetChannel()
+{
+    channel_.reset();
+}
+
+void Connector::handleWrite()
+{
+    if (state_ != kConnecting)
+    {
+        return;
+    }
+    int sockfd = removeAndResetChannel();
+    int err = 0;
+    socklen_t len = sizeof(err);
+    if (::getsockopt(sockfd, SOL_SOCKET, SO_ERROR, &err, &len) < 0)
+    {
+        err = errno;
+    }
+    if (err != 0)
+    {
+        retry(sockfd, err);
+        return;
+    }
+    //自连接：本地端口恰好等于目标端口时，connect连到了自己
+    sockaddr_storage local;
+    sockaddr_storage peer;
+    socklen_t localLen = sizeof(local);
+    socklen_t peerLen = sizeof(peer);
+    if (!serverAddr_.isUnix() && ::getsockname(sockfd, (sockaddr*)&local, &localLen) == 0
+        && ::getpeername(sockfd, (sockaddr*)&peer, &peerLen) == 0 && localLen == peerLen && memcmp(&local, &peer, localLen) == 0)
+    {
+        retry(sockfd, ECONNREFUSED);
+        return;
+    }
+    setState(kConnected);
+    if (connect_ && newConnectionCallback_)
+    {
+        newConnectionCallback_(sockfd);
+    }
+    else
+    {
+        ::close(sockfd);
+    }
+}
+
+void Connector::handleError()
+{
+    if (state_ == kConnecting)
+    {
+        int sockfd = removeAndResetChannel();
+        int err = 0;
+        socklen_t len = sizeof(err);
+        ::getsockopt(sockfd, SOL_SOCKET, SO_ERROR, &err, &len);
+        retry(sockfd, err);
+    }
+}
+
+void Connector::retry(int sockfd, int err)
+{
+    ::close(sockfd);
+    setState(kDisconnected);
+    if (!connect_)
+    {
+        return;//已经stop，拥有者可能已经不在了，不再回调
+    }
+    if (errorCallback_)
+    {
+        errorCallback_(err);
+    }
+    if (!retry_)
+    {
+        return;
+    }
+    LOG_INFO("%s %s %d retry connecting to %s in %.2f seconds, error:%d\n", __FILENAME__, __FUNCTION__, __LINE__,
+        serverAddr_.toIpPort().c_str(), retryDelay_, err);
+    std::weak_ptr<Connector> weakSelf(shared_from_this());
+    retryTimer_ = loop_->runAfter(retryDelay_, [weakSelf]() {
+        std::shared_ptr<Connector> self(weakSelf.lock());
+        if (self)
+        {
+            self->retryTimer_ = TimerId();
+            self->startInLoop();
+        }
+    });
+    retryDelay_ = std::min(retryDelay_ * 2, maxRetryDelay_);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <atomic>
+
+#include "noncopyable.h"
+#include "InetAddress.h"
+#include "TimerId.h"
+#include "Timestamp.h"
+
+class Channel;
+class EventLoop;
+
+/**
+ * 非阻塞地主动发起连接，socket可写以后检查SO_ERROR判断是否连上，连上以后把fd交给NewConnectionCallback
+ * 连接失败时按指数退避重试，重试间隔从initRetryDelay开始每次翻倍，最多maxRetryDelay
+ * start/stop可以跨线程调用，其余只在loop线程中使用；由shared_ptr管理，重试定时器不会访问已经销毁的对象
+*/
+class Connector : noncopyable, public std::enable_shared_from_this<Connector>
+{
+public:
+    using NewConnectionCallback = std::function<void(int sockfd)>;
+    //一次连接尝试失败，errno风格的错误码
+    using ErrorCallback = std::function<void(int err)>;
+
+    Connector(EventLoop* loop, const InetAddress& serverAddr);
+    ~Connector();
+
+    void setNewConnectionCallback(const NewConnectionCallback& cb) { newConnectionCallback_ = cb; }
+    void setErrorCallback(const ErrorCallback& cb) { errorCallback_ = cb; }
+    //单位秒，默认0.5秒起步，最多30秒；retry为false时失败以后不再重试
+    void setRetryDelay(double initRetryDelay, double maxRetryDelay);
+    void setRetry(bool on) { retry_ = on; }
+
+    const InetAddress& serverAddress() const { return serverAddr_; }
+
+    void start();
+    //连接断开以后重新连接，重试间隔回到初始值，loop线程中调用
+    void restart();
+    void stop();
+private:
+    friend class Channel;
+    enum States { kDisconnected, kConnecting, kConnected };
+
+    void setState(States s) { state_ = s; }
+    void startInLoop();
+    void stopInLoop();
+    void connect();
+    void connecting(int sockfd);
+    void retry(int sockfd, int err);
+    int removeAndResetChannel();
+    void resetChannel();
+
+    //Channel::setHandler的事件接口，只关心可写和出错
+    void handleRead(Timestamp) {}
+    void handleWrite();
+    void handleClose() { handleError(); }
+    void handleError();
+
+    EventLoop* loop_;
+    InetAddress serverAddr_;
+    std::atomic_bool connect_;
+    States state_;
+    std::unique_ptr<Channel> channel_;
+    NewConnectionCallback newConnectionCallback_;
+    ErrorCallback errorCallback_;
+    bool retry_;
+    double initRetryDelay_;
+    double maxRetryDelay_;
+    double retryDelay_;
+    TimerId retryTimer_;
+};
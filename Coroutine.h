@@ -0,0 +1,402 @@
+#pragma once
+
+/**
+ * C++20协程版本的连接处理，只有头文件，库本身仍然按C++11编译
+ * 使用时打开CMake选项KENMUDUO_COROUTINE并链接KenmuduoCoroutine，或者自己加上-std=c++20
+ *
+ * CoTask echo(CoConnection c)
+ * {
+ *     for (;;)
+ *     {
+ *         std::string_view data = co_await c.readSome();
+ *         if (data.empty() || !co_await c.write(data))
+ *         {
+ *             co_return;
+ *         }
+ *     }
+ * }
+ * CoConnection::serve(&server, echo);
+ *
+ * 协程总是在连接所属的loop线程里被消息、写完成、连接关闭回调或者定时器恢复，没有线程切换
+ * 每次co_await只在协程帧里保存状态，不分配内存；协程帧来自按线程缓存的FramePool
+*/
+#if __cplusplus < 202002L
+#error "Coroutine.h requires C++20, enable KENMUDUO_COROUTINE and link KenmuduoCoroutine"
+#endif
+
+#include <coroutine>
+#include <string_view>
+#include <memory>
+#include <exception>
+#include <algorithm>
+#include <new>
+
+#include "TcpServer.h"
+#include "TcpConnection.h"
+#include "EventLoop.h"
+#include "Buffer.h"
+#include "noncopyable.h"
+
+/**
+ * 协程帧的内存池，按64字节分级的空闲链表，每个线程一份
+ * 协程在loop线程中创建、恢复和结束，帧也在同一个线程里归还，所以不需要加锁
+ * 超过4KB的帧直接使用operator new
+*/
+class FramePool : noncopyable
+{
+public:
+    static void* allocate(size_t size)
+    {
+        size_t cls = sizeClass(size);
+        if (cls >= kNumClasses)
+        {
+            return ::operator new(size);
+        }
+        Block** lists = freeLists();
+        if (lists == nullptr)
+        {
+            return ::operator new((cls + 1) * kGranularity);
+        }
+        Block*& head = lists[cls];
+        if (head != nullptr)
+        {
+            Block* block = head;
+            head = block->next;
+            return block;
+        }
+        return ::operator new((cls + 1) * kGranularity);
+    }
+
+    static void deallocate(void* p, size_t size)
+    {
+        size_t cls = sizeClass(size);
+        Block** lists = freeLists();
+        if (cls >= kNumClasses || lists == nullptr)
+        {
+            ::operator delete(p);
+            return;
+        }
+        Block*& head = lists[cls];
+        Block* block = static_cast<Block*>(p);
+        block->next = head;
+        head = block;
+    }
+private:
+    struct Block
+    {
+        Block* next;
+    };
+
+    static const size_t kGranularity = 64;
+    static const size_t kNumClasses = 64;
+
+    //线程退出时把空闲链表里的块还给operator new
+    struct FreeLists
+    {
+        FreeLists() :lists() {}
+        ~FreeLists()
+        {
+            for (size_t i = 0; i < kNumClasses; ++i)
+            {
+                while (lists[i] != nullptr)
+                {
+                    Block* block = lists[i];
+                    lists[i] = block->next;
+                    ::operator delete(block);
+                }
+            }
+            exited() = true;
+        }
+
+        Block* lists[kNumClasses];
+    };
+
+    static size_t sizeClass(size_t size) { return size == 0 ? 0 : (size - 1) / kGranularity; }
+    //FreeLists析构以后(其他thread_local对象析构时释放协程帧)不再缓存，直接走operator new/delete
+    static bool& exited()
+    {
+        thread_local bool value = false;
+        return value;
+    }
+    static Block** freeLists()
+    {
+        if (exited())
+        {
+            return nullptr;
+        }
+        thread_local FreeLists freeLists;
+        return freeLists.lists;
+    }
+};
+
+/**
+ * 连接处理协程的返回类型，创建后立即执行，结束时自动释放帧，调用方不需要保存它
+*/
+class CoTask
+{
+public:
+    struct promise_type
+    {
+        CoTask get_return_object() { return CoTask(); }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+
+        static void* operator new(size_t size) { return FramePool::allocate(size); }
+        static void operator delete(void* p, size_t size) { FramePool::deallocate(p, size); }
+    };
+};
+
+/**
+ * 协程看到的连接，按值传给处理函数，拷贝进协程帧
+ * 协程帧持有TcpConnectionPtr，等待状态保存在连接的context里，所以这个组件会占用TcpConnection::setContext
+ * readXxx返回的string_view指向连接的inputBuffer，在下一次co_await之前有效；返回空说明连接已经关闭
+*/
+class CoConnection
+{
+public:
+    //server上所有新连接都用handler(CoConnection)处理，handler返回CoTask
+    template <typename F>
+    static void serve(TcpServer* server, F handler)
+    {
+        server->setConnectionCallback([handler](const TcpConnectionPtr& conn) { onConnection(handler, conn); });
+        server->setMessageCallback(&CoConnection::onMessage);
+    }
+
+    //客户端连接，在connectEstablished之前调用
+    template <typename F>
+    static void attach(const TcpConnectionPtr& conn, F handler)
+    {
+        conn->setConnectionCallback([handler](const TcpConnectionPtr& c) { onConnection(handler, c); });
+        conn->setMessageCallback(&CoConnection::onMessage);
+    }
+
+    const TcpConnectionPtr& connection() const { return conn_; }
+    bool closed() const { return state_->closed; }
+
+    class ReadAwaiter;
+    class WriteAwaiter;
+    class SleepAwaiter;
+
+    //正好n个字节
+    ReadAwaiter read(size_t n);
+    //当前收到的全部数据，至少1个字节
+    ReadAwaiter readSome();
+    //直到并且包含delim，delim指向的内存在恢复之前必须有效
+    ReadAwaiter readUntil(std::string_view delim);
+    //数据全部交给内核以后恢复，返回false说明连接已经关闭
+    WriteAwaiter write(std::string_view data);
+    //在连接所属loop的定时器上等待，定时器节点照常由TimerQueue分配
+    SleepAwaiter sleep(double seconds);
+private:
+    enum Waiting { kNone, kRead, kWrite };
+
+    struct State
+    {
+        State() :waiting(kNone), need(0), all(false), scanned(0), found(0), closed(false) {}
+
+        //读取条件是否满足，delim为空时按字节数判断
+        bool satisfied(Buffer* buf)
+        {
+            if (delim.empty())
+            {
+                return buf->readableBytes() >= need;
+            }
+            std::string_view data(buf->peek(), buf->readableBytes());
+            size_t pos = data.find(delim, scanned);
+            if (pos == std::string_view::npos)
+            {
+                scanned = data.size() >= delim.size() ? data.size() - delim.size() + 1 : 0;
+                return false;
+            }
+            found = pos + delim.size();
+            return true;
+        }
+
+        void resume()
+        {
+            std::coroutine_handle<> h = waiter;
+            waiting = kNone;
+            waiter = nullptr;
+            h.resume();
+        }
+
+        std::coroutine_handle<> waiter;
+        Waiting waiting;
+        size_t need;
+        bool all;
+        std::string_view delim;
+        size_t scanned;
+        size_t found;
+        bool closed;
+        WriteCompleteCallback savedWriteComplete;//等待写完成期间替换下来的用户回调
+    };
+
+    CoConnection(const TcpConnectionPtr& conn, State* state) :conn_(conn), state_(state) {}
+
+    static State* stateOf(const TcpConnectionPtr& conn) { return static_cast<State*>(conn->getContext().get()); }
+
+    template <typename F>
+    static void onConnection(const F& handler, const TcpConnectionPtr& conn)
+    {
+        if (conn->connected())
+        {
+            std::shared_ptr<State> state = std::make_shared<State>();
+            conn->setContext(state);
+            handler(CoConnection(conn, state.get()));
+            return;
+        }
+        State* state = stateOf(conn);
+        if (state != nullptr)
+        {
+            state->closed = true;
+            if (state->waiting == kWrite)
+            {
+                conn->setWriteCompleteCallback(state->savedWriteComplete);
+                state->savedWriteComplete = WriteCompleteCallback();
+            }
+            if (state->waiting != kNone)
+            {
+                state->resume();
+            }
+        }
+    }
+
+    static void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+    {
+        State* state = stateOf(conn);
+        if (state != nullptr && state->waiting == kRead && state->satisfied(buf))
+        {
+            state->resume();
+        }
+    }
+
+    //先还原用户的写完成回调并调用它，再恢复协程
+    static void onWriteComplete(const TcpConnectionPtr& conn)
+    {
+        State* state = stateOf(conn);
+        if (state == nullptr)
+        {
+            return;
+        }
+        WriteCompleteCallback userCallback;
+        userCallback.swap(state->savedWriteComplete);
+        conn->setWriteCompleteCallback(userCallback);
+        if (userCallback)
+        {
+            userCallback(conn);
+        }
+        if (state->waiting == kWrite)
+        {
+            state->resume();
+        }
+    }
+
+    TcpConnectionPtr conn_;
+    State* state_;//由conn_的context持有
+};
+
+class CoConnection::ReadAwaiter
+{
+public:
+    ReadAwaiter(CoConnection* c, size_t need, bool all, std::string_view delim) :c_(c)
+    {
+        State* state = c_->state_;
+        state->need = need;
+        state->all = all;
+        state->delim = delim;
+        state->scanned = 0;
+        state->found = 0;
+    }
+
+    bool await_ready() { return c_->state_->satisfied(c_->conn_->inputBuffer()) || c_->state_->closed; }
+    void await_suspend(std::coroutine_handle<> h)
+    {
+        c_->state_->waiter = h;
+        c_->state_->waiting = kRead;
+    }
+    std::string_view await_resume()
+    {
+        State* state = c_->state_;
+        Buffer* buf = c_->conn_->inputBuffer();
+        if (!state->satisfied(buf))
+        {
+            return std::string_view();//连接关闭时数据不够
+        }
+        size_t len = !state->delim.empty() ? state->found : state->all ? buf->readableBytes() : state->need;
+        std::string_view data(buf->peek(), len);
+        //retrieve只移动下标，数据在下一次从socket读取之前不会被覆盖
+        buf->retrieve(len);
+        return data;
+    }
+private:
+    CoConnection* c_;
+};
+
+class CoConnection::WriteAwaiter
+{
+public:
+    WriteAwaiter(CoConnection* c, std::string_view data) :c_(c), data_(data) {}
+
+    bool await_ready()
+    {
+        if (c_->state_->closed)
+        {
+            return true;
+        }
+        c_->conn_->send(data_.data(), data_.size());
+        return c_->conn_->outputBytes() == 0;
+    }
+    void await_suspend(std::coroutine_handle<> h)
+    {
+        //只在真正需要等待时设置写完成回调，否则每次send都会多排队一个回调
+        //用户自己设置的回调先保存起来，写完成时还原并照常调用
+        c_->state_->savedWriteComplete = c_->conn_->writeCompleteCallback();
+        c_->conn_->setWriteCompleteCallback(&CoConnection::onWriteComplete);
+        c_->state_->waiter = h;
+        c_->state_->waiting = kWrite;
+    }
+    bool await_resume() { return !c_->state_->closed; }
+private:
+    CoConnection* c_;
+    std::string_view data_;
+};
+
+class CoConnection::SleepAwaiter
+{
+public:
+    SleepAwaiter(EventLoop* loop, double seconds) :loop_(loop), seconds_(seconds) {}
+
+    bool await_ready() { return seconds_ <= 0; }
+    void await_suspend(std::coroutine_handle<> h) { loop_->runAfter(seconds_, [h]() { h.resume(); }); }
+    void await_resume() {}
+private:
+    EventLoop* loop_;
+    double seconds_;
+};
+
+inline CoConnection::ReadAwaiter CoConnection::read(size_t n)
+{
+    return ReadAwaiter(this, n, false, std::string_view());
+}
+
+inline CoConnection::ReadAwaiter CoConnection::readSome()
+{
+    return ReadAwaiter(this, 1, true, std::string_view());
+}
+
+inline CoConnection::ReadAwaiter CoConnection::readUntil(std::string_view delim)
+{
+    return ReadAwaiter(this, 0, false, delim);
+}
+
+inline CoConnection::WriteAwaiter CoConnection::write(std::string_view data)
+{
+    return WriteAwaiter(this, data);
+}
+
+inline CoConnection::SleepAwaiter CoConnection::sleep(double seconds)
+{
+    return SleepAwaiter(conn_->getLoop(), seconds);
+}
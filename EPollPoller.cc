@@ -34,8 +34,7 @@ EPollPoller::~EPollPoller()
 
 Timestamp EPollPoller::poll(int timeoutMS, ChannelList *activeChannels)
 {
-    //实际上应该用LOG_DEBUG输出日志更为合理
-    LOG_INFO("%s %s %d fd total count:%d\n", __FILENAME__, __FUNCTION__, __LINE__, (int)channels_.size());
+    LOG_DEBUG("%s %s %d fd total count:%d\n", __FILENAME__, __FUNCTION__, __LINE__, (int)numChannels());
 
     int numEvents = ::epoll_wait(epollfd_, &*events_.begin(), static_cast<int>(events_.size()), timeoutMS);
     int savedErrno = errno;
@@ -43,7 +42,7 @@ Timestamp EPollPoller::poll(int timeoutMS, ChannelList *activeChannels)
 
     if (numEvents > 0)
     {  
-        LOG_INFO("%s %s %d %d events happened\n", __FILENAME__, __FUNCTION__, __LINE__, numEvents);
+        LOG_DEBUG("%s %s %d %d events happened\n", __FILENAME__, __FUNCTION__, __LINE__, numEvents);
         fillActiveChannels(numEvents, activeChannels);
         if (numEvents == events_.size())
         {
@@ -75,14 +74,19 @@ Timestamp EPollPoller::poll(int timeoutMS, ChannelList *activeChannels)
 void EPollPoller::updateChannel(Channel *channel)
 {
     const int index = channel->index();
-    LOG_INFO("%s %s %d fd=%d events=%d index=%d\n", __FILENAME__, __FUNCTION__, __LINE__, channel->fd(), channel->events(), index);
+    LOG_DEBUG("%s %s %d fd=%d events=%d index=%d\n", __FILENAME__, __FUNCTION__, __LINE__, channel->fd(), channel->events(), index);
 
     if (index == kNew || index == kDeleted)
     {
         if (index == kNew)
         {
-            int fd = channel->fd();
-            channels_[fd] = channel;
+            addToTable(channel);
+        }
+        //没有感兴趣的事件时只放进表里，等真正有事件时再注册到epoll
+        if (channel->isNoneEvent())
+        {
+            channel->set_index(kDeleted);
+            return;
         }
         channel->set_index(kAdded);
 
@@ -90,16 +94,16 @@ void EPollPoller::updateChannel(Channel *channel)
     }
     else //channel已经在poller上注册过了
     {
-        int fd = channel->fd();
         if (channel->isNoneEvent())
         {
             update(EPOLL_CTL_DEL, channel);
             channel->set_index(kDeleted);
         }
-        else
+        else if (channel->events() != channel->registeredEvents())
         {
             update(EPOLL_CTL_MOD, channel);
         }
+        //注册的事件没有变化，不需要epoll_ctl
     }
 }
 
@@ -107,10 +111,9 @@ void EPollPoller::updateChannel(Channel *channel)
 //从poller中移除channel
 void EPollPoller::removeChannel(Channel *channel)
 {
-    int fd = channel->fd();
-    channels_.erase(fd);
+    removeFromTable(channel);
 
-    LOG_INFO("%s %s %d fd=%d \n", __FILENAME__, __FUNCTION__, __LINE__, channel->fd());
+    LOG_DEBUG("%s %s %d fd=%d \n", __FILENAME__, __FUNCTION__, __LINE__, channel->fd());
 
     int index = channel->index();
     if (index == kAdded)
@@ -125,9 +128,18 @@ void EPollPoller::fillActiveChannels(int numEvents, ChannelList *activeChannel)
 {
     for (int i = 0; i < numEvents; ++i)
     {  
-        Channel* channel = static_cast<Channel*>(events_[i].data.ptr);
+        //data的低32位是fd，高32位是注册时的generation
+        int fd = static_cast<int>(events_[i].data.u64 & 0xffffffff);
+        uint32_t generation = static_cast<uint32_t>(events_[i].data.u64 >> 32);
+        Channel* channel = findChannel(fd, generation);
+        if (channel == nullptr)
+        {
+            //fd已经被关闭复用，或者channel已经被移除，这是旧注册上报的过期事件
+            LOG_DEBUG("%s %s %d stale event fd=%d generation=%u\n", __FILENAME__, __FUNCTION__, __LINE__, fd, generation);
+            continue;
+        }
         channel->set_revents(events_[i].events);
-        LOG_INFO("%s %s %d active channel fd=%d \n", __FILENAME__, __FUNCTION__, __LINE__, channel->fd());
+        LOG_DEBUG("%s %s %d active channel fd=%d \n", __FILENAME__, __FUNCTION__, __LINE__, channel->fd());
         activeChannel->push_back(channel);//EventLoop就拿到了它的Poller给他返回的所有发生事情的channel列表了
     }
 }
@@ -139,8 +151,9 @@ void EPollPoller::update(int operation, Channel *channel)
     epoll_event event;
     memset(&event, 0, sizeof(event));
     event.events = channel->events();
-    event.data.fd = fd;
-    event.data.ptr = channel;
+    event.data.u64 = (static_cast<uint64_t>(generationOf(fd)) << 32) | static_cast<uint32_t>(fd);
+    ++numCtlCalls_;
+    channel->set_registeredEvents(operation == EPOLL_CTL_DEL ? 0 : channel->events());
 
     if (::epoll_ctl(epollfd_, operation, fd, &event) < 0)
     {
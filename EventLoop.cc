@@ -1,12 +1,17 @@
 #include <sys/eventfd.h>
+#include <sys/epoll.h>
 #include <unistd.h>
+#include <time.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <signal.h>
+#include <algorithm>
 
 #include "EventLoop.h"
 #include "Logger.h"
 #include "Poller.h"
 #include "Channel.h"
+#include "TimerQueue.h"
 
 //防止一个线程创建多个EventLoop __thread意味着thread_local，变量只在线程内
 __thread EventLoop* t_loopInThisThread = nullptr;
@@ -14,6 +19,37 @@ __thread EventLoop* t_loopInThisThread = nullptr;
 //默认的Poller IO复用接口的超时时间
 const int kPollTimeMs = 10000;
 
+//对端已经关闭时write/writev/splice会触发SIGPIPE，默认动作是结束进程；忽略以后这些调用返回EPIPE，由各自的错误处理关闭连接
+class IgnoreSigPipe
+{
+public:
+    IgnoreSigPipe() { ::signal(SIGPIPE, SIG_IGN); }
+};
+static IgnoreSigPipe initObj;
+
+static int64_t clockNs(clockid_t clock)
+{
+    struct timespec ts;
+    ::clock_gettime(clock, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+//和Channel::handleEventWithGuard的分发顺序一致
+static const char* eventKind(int revents)
+{
+    if ((revents & EPOLLHUP) && !(revents & EPOLLIN))
+    {
+        return "close";
+    }
+    if (revents & EPOLLERR)
+    {
+        return "error";
+    }
+    bool read = revents & (EPOLLIN | EPOLLPRI | EPOLLRDHUP);
+    bool write = revents & EPOLLOUT;
+    return read && write ? "read+write" : (read ? "read" : (write ? "write" : "none"));
+}
+
 //创建wakeup fd，用来notify唤醒sub reactor来处理新的channel
 int createEventfd()
 {
@@ -27,9 +63,11 @@ int createEventfd()
 }
 
 EventLoop::EventLoop():looping_(false),
-    quit_(false), callPendingFunctor_(false),
+    quit_(false), busyPollUs_(0), deferUpdates_(false), spinning_(false), metricsEnabled_(true),
+    slowThresholdNs_(0), callbackStartNs_(0), callbackKind_(""), callbackFd_(-1), callPendingFunctor_(false),
     threadId_(CurrentThread::tid()),
     poller_(Poller::newDefaultPoller(this)),
+    timerQueue_(new TimerQueue(this)),
     wakeupFd_(createEventfd()),
     wakeupChannel_(new Channel(this, wakeupFd_))
 {
@@ -66,6 +104,10 @@ void EventLoop::handleRead()
   {
     LOG_ERROR("%s %s %d reads %ld bytes instead of 8", __FILENAME__, __FUNCTION__, __LINE__, n);
   }
+  if (metricsEnabled_)
+  {
+    metrics_.recordWakeup();
+  }
 }
 
 //开启事件循环
@@ -78,12 +120,37 @@ void EventLoop::loop()
     while (!quit_)
     {
         activeChannels_.clear();
+        if (!pendingUpdates_.empty())
+        {
+            flushChannelUpdates();
+        }
+        Timestamp pollStart = metricsEnabled_ ? Timestamp::now() : Timestamp();
         //监听两类fd，一种为client的fd，一种是wakeup的fd
-        pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_);
+        if (busyPollUs_ > 0)
+        {
+            spinPoll();
+        }
+        else
+        {
+            pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_);
+        }
         for (Channel* channel : activeChannels_)
         {
             //Poller监听哪些channel发生事件，上报给EventLoop，通知channel处理相应的事件
-            channel->handleEvent(pollReturnTime_);
+            if (slowThresholdNs_ > 0)
+            {
+                handleEventTimed(channel);
+            }
+            else
+            {
+                channel->handleEvent(pollReturnTime_);
+            }
+        }
+        if (metricsEnabled_)
+        {
+            int64_t polled = pollReturnTime_.microSecondsSinceEpoch();
+            metrics_.recordPoll(polled - pollStart.microSecondsSinceEpoch(), activeChannels_.size(),
+                Timestamp::now().microSecondsSinceEpoch() - polled);
         }
         //执行当前EventLoop事件循环需要处理的回调操作
         /**
@@ -96,6 +163,32 @@ void EventLoop::loop()
     LOG_INFO("%s %s %d EventLoop %p stop looping\n", __FILENAME__, __FUNCTION__, __LINE__, this);
 }
 
+/**
+ * spinning_和queueInLoop配合：这边先清spinning_再检查pendingFunctors_，那边先放入回调再检查spinning_，
+ * 所以对方要么看到spinning_已经清掉而写eventfd，要么回调已经能被这里看到，不会在阻塞poll之前漏掉
+*/
+void EventLoop::spinPoll()
+{
+    Timestamp deadline(Timestamp::now().microSecondsSinceEpoch() + busyPollUs_);
+    spinning_ = true;
+    do
+    {
+        pollReturnTime_ = poller_->poll(0, &activeChannels_);
+    } while (activeChannels_.empty() && !quit_ && pollReturnTime_ < deadline && !hasPendingFunctors());
+    spinning_ = false;
+
+    if (activeChannels_.empty() && !quit_ && !hasPendingFunctors())
+    {
+        pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_);
+    }
+}
+
+bool EventLoop::hasPendingFunctors()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    return !pendingFunctors_.empty();
+}
+
 //退出事件循环 1.loop在自己的线程中调用quit 2.在非Loop的线程中调用Loop的quit
 /**
  *          mainLoop
@@ -140,9 +233,9 @@ void EventLoop::queueInLoop(Functor cb)
     /**
      * 
     */
-    if (!isInLoopThread() || callPendingFunctor_) 
+    if ((!isInLoopThread() || callPendingFunctor_) && !spinning_)
     {
-        wakeup();//唤醒所在线程
+        wakeup();//唤醒所在线程，loop在自旋时会自己看到新的回调
     }
 }
 
@@ -157,20 +250,72 @@ void EventLoop::wakeup()
     }
 }
 
+TimerId EventLoop::runAt(Timestamp time, TimerCallback cb)
+{
+    return timerQueue_->addTimer(std::move(cb), time, 0.0);
+}
+
+TimerId EventLoop::runAfter(double delay, TimerCallback cb)
+{
+    Timestamp time(addTime(Timestamp::now(), delay));
+    return runAt(time, std::move(cb));
+}
+
+TimerId EventLoop::runEvery(double interval, TimerCallback cb)
+{
+    Timestamp time(addTime(Timestamp::now(), interval));
+    return timerQueue_->addTimer(std::move(cb), time, interval);
+}
+
+void EventLoop::cancel(TimerId timerId)
+{
+    timerQueue_->cancel(timerId);
+}
+
 //EventLoop的方法->Poller的方法
 void EventLoop::updateChannel(Channel* channel)
 {
+    if (deferUpdates_ && looping_ && isInLoopThread())
+    {
+        if (!channel->updatePending())
+        {
+            channel->set_updatePending(true);
+            pendingUpdates_.push_back(channel);
+        }
+        return;
+    }
     poller_->updateChannel(channel);
 }
 
 void EventLoop::removeChannel(Channel* channel)
 {
+    //删除必须立即生效，channel随后就可能析构
+    if (channel->updatePending())
+    {
+        channel->set_updatePending(false);
+        pendingUpdates_.erase(std::find(pendingUpdates_.begin(), pendingUpdates_.end(), channel));
+    }
     poller_->removeChannel(channel);
 }
 
-void EventLoop::hasChannel(Channel* channel)
+void EventLoop::flushChannelUpdates()
 {
-    poller_->hasChannel(channel);
+    for (Channel* channel : pendingUpdates_)
+    {
+        channel->set_updatePending(false);
+        poller_->updateChannel(channel);
+    }
+    pendingUpdates_.clear();
+}
+
+uint64_t EventLoop::pollerCtlCalls() const
+{
+    return poller_->numCtlCalls();
+}
+
+bool EventLoop::hasChannel(Channel* channel)
+{
+    return poller_->hasChannel(channel);
 }
 
 //执行回调
@@ -184,10 +329,82 @@ void EventLoop::doPendingFunctor()
         functors.swap(pendingFunctors_);
     }
 
+    Timestamp start = metricsEnabled_ && !functors.empty() ? Timestamp::now() : Timestamp();
     for (const Functor& functor : functors)
     {
-        functor();//执行当前loop需要执行的回调操作
+        if (slowThresholdNs_ > 0)
+        {
+            runFunctorTimed(functor);
+        }
+        else
+        {
+            functor();//执行当前loop需要执行的回调操作
+        }
     }
     callPendingFunctor_ = false;
+    if (start.valid())
+    {
+        metrics_.recordFunctors(functors.size(), Timestamp::now().microSecondsSinceEpoch() - start.microSecondsSinceEpoch());
+    }
 }
 
+void EventLoop::setSlowCallbackThreshold(double seconds, SlowCallback cb)
+{
+    slowThresholdNs_ = seconds > 0 ? static_cast<int64_t>(seconds * 1e9) : 0;
+    slowCallback_ = std::move(cb);
+}
+
+void EventLoop::handleEventTimed(Channel* channel)
+{
+    const char* kind = eventKind(channel->revents());
+    int64_t wallStart = clockNs(CLOCK_MONOTONIC);
+    int64_t cpuStart = clockNs(CLOCK_THREAD_CPUTIME_ID);
+    callbackKind_.store(kind, std::memory_order_relaxed);
+    callbackFd_.store(channel->fd(), std::memory_order_relaxed);
+    callbackStartNs_.store(wallStart, std::memory_order_relaxed);
+    channel->handleEvent(pollReturnTime_);
+    //活跃channel在这一轮结束之前不会析构，connectionDestroyed之类的清理都是排队执行的
+    static const std::string kNoOwner;
+    callbackFinished(kind, channel->ownerName() ? *channel->ownerName() : kNoOwner, wallStart, cpuStart, channel);
+}
+
+void EventLoop::runFunctorTimed(const Functor& functor)
+{
+    static const std::string kFunctorOwner("pending functor");
+    int64_t wallStart = clockNs(CLOCK_MONOTONIC);
+    int64_t cpuStart = clockNs(CLOCK_THREAD_CPUTIME_ID);
+    callbackKind_.store("functor", std::memory_order_relaxed);
+    callbackFd_.store(-1, std::memory_order_relaxed);
+    callbackStartNs_.store(wallStart, std::memory_order_relaxed);
+    functor();
+    callbackFinished("functor", kFunctorOwner, wallStart, cpuStart, nullptr);
+}
+
+void EventLoop::callbackFinished(const char* kind, const std::string& owner, int64_t wallStartNs, int64_t cpuStartNs,
+    Channel* channel)
+{
+    int64_t cpuNs = clockNs(CLOCK_THREAD_CPUTIME_ID) - cpuStartNs;
+    int64_t wallNs = clockNs(CLOCK_MONOTONIC) - wallStartNs;
+    callbackStartNs_.store(0, std::memory_order_relaxed);
+    if (channel)
+    {
+        channel->addCallbackCpuNs(cpuNs);
+    }
+    else
+    {
+        functorCpuNs_.add(cpuNs);
+    }
+    if (slowThresholdNs_ > 0 && wallNs > slowThresholdNs_)
+    {
+        std::string name = owner.empty() && channel ? "fd " + std::to_string(channel->fd()) : owner;
+        if (slowCallback_)
+        {
+            slowCallback_(kind, name, wallNs / 1e9, cpuNs / 1e9);
+        }
+        else
+        {
+            LOG_ERROR("%s %s %d EventLoop %p slow %s callback of %s: %.1f ms wall, %.1f ms cpu\n", __FILENAME__, __FUNCTION__,
+                __LINE__, this, kind, name.c_str(), wallNs / 1e6, cpuNs / 1e6);
+        }
+    }
+}
@@ -9,9 +9,13 @@
 #include "noncopyable.h"
 #include "Timestamp.h"
 #include "CurrentThread.h"
+#include "Callbacks.h"
+#include "TimerId.h"
+#include "LoopMetrics.h"
 
 class Channel;
 class Poller;
+class TimerQueue;
 
 //事件循环类，其中包括两个主要大模块 Channel Poller(epoll的抽象)
 class EventLoop:noncopyable
@@ -29,6 +33,55 @@ public:
 
     Timestamp pollReturnTime() const { return pollReturnTime_; }
 
+    /**
+     * 忙轮询模式：每轮先用0超时poll自旋最多spinMicroseconds微秒，期间有事件或者有pending回调就立刻处理，
+     * 预算用完仍然空闲才阻塞在poll上，用CPU换掉调度器唤醒的延迟，适合独占核心的低延迟loop
+     * 0表示关闭(默认)，在loop开始之前或者loop线程中设置
+    */
+    void setBusyPoll(int spinMicroseconds) { busyPollUs_ = spinMicroseconds; }
+    int busyPoll() const { return busyPollUs_; }
+
+    /**
+     * 延迟更新模式：loop线程中channel的事件变化先记下来，每轮poll之前统一提交一次，
+     * 同一轮里先关后开(例如handleWrite关掉EPOLLOUT，writeComplete回调里又写满了)的变化互相抵消，不产生epoll_ctl
+     * 打开以后channel必须先remove再析构(本来也是这样要求的)，在loop开始之前设置
+    */
+    void setDeferredUpdates(bool on) { deferUpdates_ = on; }
+    //poller累计的epoll_ctl次数，只在loop线程中读取
+    uint64_t pollerCtlCalls() const;
+
+    /**
+     * 运行指标：poll等待时间、每轮活跃channel数、channel回调和pending回调各自的耗时、回调队列深度、唤醒次数
+     * 默认打开，每轮多两次取时间(有pending回调时四次)；关闭以后计数停止
+     * metrics()可以在任意线程调用
+    */
+    void setMetricsEnabled(bool on) { metricsEnabled_ = on; }
+    LoopMetrics::Snapshot metrics() const { return metrics_.snapshot(); }
+    //记录一个请求的延迟，TcpConnection::markResponse的请求完成时调用，在loop线程中调用
+    void recordRequestLatency(int64_t us)
+    {
+        if (metricsEnabled_)
+        {
+            metrics_.recordRequest(us);
+        }
+    }
+
+    /**
+     * 回调计时：每个channel回调和每个pending回调单独计时，墙钟时间超过seconds秒的通过cb报告，默认写ERROR日志
+     * 报告里有事件类型和channel的ownerName(TcpConnection是连接名)；
+     * 同时用CLOCK_THREAD_CPUTIME_ID的差值把CPU时间记到对应的channel上，pending回调的记在loop上，用来找出最耗CPU的连接
+     * 每个回调多两次取线程CPU时间的系统调用，默认关闭，seconds<=0关闭，在loop线程中设置
+    */
+    using SlowCallback = std::function<void(const char* kind, const std::string& owner, double wallSeconds, double cpuSeconds)>;
+    void setSlowCallbackThreshold(double seconds, SlowCallback cb = SlowCallback());
+    bool callbackTiming() const { return slowThresholdNs_ > 0; }
+    //回调计时期间pending回调累计占用的CPU纳秒数，任意线程读取
+    uint64_t functorCpuNs() const { return functorCpuNs_.get(); }
+    //回调计时期间正在执行的回调从什么时候开始(CLOCK_MONOTONIC纳秒)，没有回调在执行时为0，给LoopWatchdog在其他线程读取
+    int64_t callbackStartNs() const { return callbackStartNs_.load(std::memory_order_relaxed); }
+    const char* callbackKind() const { return callbackKind_.load(std::memory_order_relaxed); }
+    int callbackFd() const { return callbackFd_.load(std::memory_order_relaxed); }
+
     //在当前loop中执行cb
     void runInLoop(Functor cb);
     //把cb放入队列中，唤醒loop所在的线程执行cb
@@ -37,16 +90,34 @@ public:
     //唤醒loop所在的线程
     void wakeup();
 
+    //定时器，可以跨线程调用，回调在loop线程中执行
+    //在time时刻执行cb
+    TimerId runAt(Timestamp time, TimerCallback cb);
+    //delay秒以后执行cb
+    TimerId runAfter(double delay, TimerCallback cb);
+    //每隔interval秒执行一次cb
+    TimerId runEvery(double interval, TimerCallback cb);
+    void cancel(TimerId timerId);
+
     //EventLoop的方法->Poller的方法
     void updateChannel(Channel* channel);
     void removeChannel(Channel* channel);
-    void hasChannel(Channel* channel);
+    bool hasChannel(Channel* channel);
 
     //判断EventLoop对象是否在自己线程里面
     bool isInLoopThread()const { return threadId_ == CurrentThread::tid(); }
 private:
     void handleRead();//wake up
     void doPendingFunctor();//执行回调
+    //忙轮询模式下的poll，自旋预算内返回有事件或者有回调需要处理
+    void spinPoll();
+    bool hasPendingFunctors();
+    //提交延迟的channel更新
+    void flushChannelUpdates();
+    //打开回调计时时的分发
+    void handleEventTimed(Channel* channel);
+    void runFunctorTimed(const Functor& functor);
+    void callbackFinished(const char* kind, const std::string& owner, int64_t wallStartNs, int64_t cpuStartNs, Channel* channel);
 
     using ChannelList = std::vector<Channel*>;
 
@@ -55,12 +126,28 @@ private:
     const pid_t threadId_;//当前loop所在线程的id
     Timestamp pollReturnTime_;//记录poll返回发生事件的channels的时间点
     std::unique_ptr<Poller> poller_;
+    std::unique_ptr<TimerQueue> timerQueue_;
 
     int wakeupFd_;//当mainLoop获取一个新用户的channel，通过轮训算法选择一个subloop，通过该成员唤醒subloop处理channel
     std::unique_ptr<Channel> wakeupChannel_;//封装wakeupfd_的channel
 
     ChannelList activeChannels_;
 
+    int busyPollUs_;
+    bool deferUpdates_;
+    ChannelList pendingUpdates_;//延迟模式下待提交的channel
+    std::atomic_bool spinning_;//loop正在自旋，queueInLoop不需要写eventfd唤醒
+
+    bool metricsEnabled_;
+    LoopMetrics metrics_;//只在loop线程中更新
+
+    int64_t slowThresholdNs_;//0表示不计时
+    SlowCallback slowCallback_;
+    LoopCounter functorCpuNs_;
+    std::atomic<int64_t> callbackStartNs_;
+    std::atomic<const char*> callbackKind_;
+    std::atomic<int> callbackFd_;
+
     std::atomic_bool callPendingFunctor_;//当前loop是否需要执行的回调操作
     std::vector<Functor> pendingFunctors_;//存储loop需要执行的所有的回调操作
     std::mutex mutex_;//互斥锁用来保护上面vector容器的线程安全操作
@@ -0,0 +1,150 @@
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <strings.h>
+#include <vector>
+
+#include "Handoff.h"
+#include "Socket.h"
+#include "Logger.h"
+
+namespace
+{
+
+const uint32_t kHandoffMagic = 0x4b4d484f;//"KMHO"
+
+struct Header
+{
+    uint32_t magic;
+    uint32_t type;
+};
+
+bool fillAddress(const std::string& path, sockaddr_un* addr)
+{
+    bzero(addr, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr->sun_path))
+    {
+        LOG_ERROR("%s %s %d handoff path too long: %s\n", __FILENAME__, __FUNCTION__, __LINE__, path.c_str());
+        return false;
+    }
+    memcpy(addr->sun_path, path.data(), path.size());
+    return true;
+}
+
+}
+
+int Handoff::listen(const std::string& path)
+{
+    sockaddr_un addr;
+    if (!fillAddress(path, &addr))
+    {
+        return -1;
+    }
+    int fd = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    ::unlink(path.c_str());
+    if (fd < 0 || ::bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0 || ::listen(fd, 4) < 0)
+    {
+        LOG_ERROR("%s %s %d listen on %s error:%d\n", __FILENAME__, __FUNCTION__, __LINE__, path.c_str(), errno);
+        if (fd >= 0)
+        {
+            ::close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+bool Handoff::send(int controlFd, Type type, int fd, const char* input, size_t len)
+{
+    if (len > kMaxInput)
+    {
+        return false;
+    }
+    Header header;
+    header.magic = kHandoffMagic;
+    header.type = type;
+    std::string message(reinterpret_cast<const char*>(&header), sizeof(header));
+    message.append(input, len);
+    return Socket::sendFds(controlFd, message.data(), message.size(), &fd, 1);
+}
+
+int Handoff::connect(const std::string& path)
+{
+    sockaddr_un addr;
+    if (!fillAddress(path, &addr))
+    {
+        return -1;
+    }
+    int fd = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd < 0 || ::connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0)
+    {
+        if (fd >= 0)
+        {
+            ::close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+int Handoff::receive(int controlFd, Message* msg)
+{
+    std::vector<char> buf(sizeof(Header) + kMaxInput);
+    int fds[4];
+    int nfds = 4;
+    ssize_t n = Socket::recvFds(controlFd, buf.data(), buf.size(), fds, &nfds);
+    if (n <= 0)
+    {
+        return n == 0 ? 0 : -1;
+    }
+    Header header;
+    if (static_cast<size_t>(n) < sizeof(header) || nfds != 1)
+    {
+        LOG_ERROR("%s %s %d bad handoff message, %ld bytes %d fds\n", __FILENAME__, __FUNCTION__, __LINE__, n, nfds);
+        for (int i = 0; i < nfds; ++i)
+        {
+            ::close(fds[i]);
+        }
+        errno = EPROTO;
+        return -1;
+    }
+    memcpy(&header, buf.data(), sizeof(header));
+    if (header.magic != kHandoffMagic)
+    {
+        LOG_ERROR("%s %s %d bad handoff magic %x\n", __FILENAME__, __FUNCTION__, __LINE__, header.magic);
+        ::close(fds[0]);
+        errno = EPROTO;
+        return -1;
+    }
+    msg->type = static_cast<Type>(header.type);
+    msg->fd = fds[0];
+    msg->input.assign(buf.data() + sizeof(header), n - sizeof(header));
+    return 1;
+}
+
+int Handoff::takeOver(const std::string& path, int* listenFd)
+{
+    *listenFd = -1;
+    int controlFd = connect(path);
+    if (controlFd < 0)
+    {
+        return -1;
+    }
+    Message msg;
+    msg.fd = -1;
+    if (receive(controlFd, &msg) <= 0 || msg.type != kListener)
+    {
+        LOG_ERROR("%s %s %d %s did not hand over a listener\n", __FILENAME__, __FUNCTION__, __LINE__, path.c_str());
+        if (msg.fd >= 0)
+        {
+            ::close(msg.fd);
+        }
+        ::close(controlFd);
+        return -1;
+    }
+    *listenFd = msg.fd;
+    return controlFd;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+
+#include "noncopyable.h"
+
+/**
+ * 热重启时新旧进程之间的控制通道，SOCK_SEQPACKET类型的Unix域socket，每条消息带一个fd
+ * 旧进程在path上监听，新进程连上以后，旧进程先发送监听socket，再逐个发送空闲连接和它们已经读到的数据，
+ * 最后关闭通道表示交接结束
+*/
+class Handoff : noncopyable
+{
+public:
+    enum Type
+    {
+        kListener = 1,
+        kConnection = 2,
+    };
+
+    //一个连接随身带过去的未处理数据上限，超过的连接在旧进程里排空
+    static const size_t kMaxInput = 64 * 1024;
+
+    struct Message
+    {
+        Type type;
+        int fd;
+        std::string input;
+    };
+
+    //旧进程：在path上监听，返回非阻塞的监听fd，失败返回-1
+    static int listen(const std::string& path);
+    //旧进程：发送一个fd，input是连接已经读到还没有处理的数据
+    static bool send(int controlFd, Type type, int fd, const char* input, size_t len);
+
+    //新进程：连接旧进程，没有旧进程时返回-1
+    static int connect(const std::string& path);
+    //新进程：接收一条消息，返回1；通道已经关闭返回0；出错返回-1并设置errno，消息格式不对时errno为EPROTO
+    static int receive(int controlFd, Message* msg);
+    //新进程：连接旧进程并取得监听socket，返回控制通道，之后旧进程还会从控制通道送来连接
+    static int takeOver(const std::string& path, int* listenFd);
+};
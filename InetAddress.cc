@@ -1,17 +1,80 @@
 #include <string.h>
+#include <stddef.h>
 
 #include "InetAddress.h"
+#include "Logger.h"
 
 InetAddress::InetAddress(uint16_t port, std::string ip )
 {
-    bzero(&addr_, sizeof(addr_));
+    bzero(&unixAddr_, sizeof(unixAddr_));
     addr_.sin_family = AF_INET;
     addr_.sin_port = htons(port);
     addr_.sin_addr.s_addr = inet_addr(ip.c_str());
+    len_ = sizeof(addr_);
+    valid_ = true;
+}
+
+InetAddress InetAddress::fromUnixPath(const std::string& path, bool abstract)
+{
+    sockaddr_un addr;
+    bzero(&addr, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    //抽象地址以'\0'开头，长度由socklen决定，不以'\0'结尾
+    size_t offset = abstract ? 1 : 0;
+    size_t n = path.size();
+    if (n + offset >= sizeof(addr.sun_path))
+    {
+        LOG_ERROR("%s %s %d unix path too long (%zu bytes, at most %zu): %s\n", __FILENAME__, __FUNCTION__, __LINE__,
+            n, sizeof(addr.sun_path) - offset - 1, path.c_str());
+        InetAddress invalid;
+        invalid.valid_ = false;
+        return invalid;
+    }
+    memcpy(addr.sun_path + offset, path.data(), n);
+
+    InetAddress result;
+    socklen_t len = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + offset + n + (abstract ? 0 : 1));
+    result.setSockAddr(reinterpret_cast<const sockaddr*>(&addr), len);
+    return result;
+}
+
+void InetAddress::setSockAddr(const sockaddr* addr, socklen_t len)
+{
+    bzero(&unixAddr_, sizeof(unixAddr_));
+    if (len > sizeof(unixAddr_))
+    {
+        len = sizeof(unixAddr_);
+    }
+    memcpy(&unixAddr_, addr, len);
+    len_ = len;
+    valid_ = true;
+}
+
+bool InetAddress::isAbstract() const
+{
+    return isUnix() && len_ > offsetof(sockaddr_un, sun_path) && unixAddr_.sun_path[0] == '\0';
+}
+
+std::string InetAddress::unixPath() const
+{
+    if (!isUnix() || len_ <= offsetof(sockaddr_un, sun_path))
+    {
+        return std::string();//未命名的地址，例如客户端的Unix域socket
+    }
+    size_t n = len_ - offsetof(sockaddr_un, sun_path);
+    if (unixAddr_.sun_path[0] == '\0')
+    {
+        return std::string(unixAddr_.sun_path + 1, n - 1);
+    }
+    return std::string(unixAddr_.sun_path, strnlen(unixAddr_.sun_path, n));
 }
 
 std::string InetAddress::toIp() const
 {
+    if (isUnix())
+    {
+        return unixPath();
+    }
     char buf[64] = {0};
     ::inet_ntop(AF_INET, &addr_.sin_addr, buf, sizeof(buf));
 
@@ -20,6 +83,11 @@ std::string InetAddress::toIp() const
 
 std::string InetAddress::toIpPort() const
 {
+    //Unix域地址 unix:path 抽象地址 unix:@name
+    if (isUnix())
+    {
+        return (isAbstract() ? "unix:@" : "unix:") + unixPath();
+    }
     //ip:port
     char buf[64] = {0};
     ::inet_ntop(AF_INET, &addr_.sin_addr, buf, sizeof(buf));
@@ -32,7 +100,7 @@ std::string InetAddress::toIpPort() const
 
 uint16_t InetAddress::toPort() const
 {
-    return ntohs(addr_.sin_port);
+    return isUnix() ? 0 : ntohs(addr_.sin_port);
 }
 
 // #include <iostream>
@@ -44,4 +112,4 @@ uint16_t InetAddress::toPort() const
 //     std::cout << addr.toPort() << std::endl;
 
 //     return 0;
-// }
\ No newline at end of file
+// }
@@ -2,21 +2,52 @@
 
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include <sys/un.h>
+#include <strings.h>
 #include <string>
-//封装socket地址类型
+//封装socket地址类型 支持IPv4和Unix域(包括Linux的抽象命名空间)
 class InetAddress
 {
 public:
     explicit InetAddress(uint16_t port=8000, std::string ip = "127.0.0.1");
     explicit InetAddress(const sockaddr_in &addr)
-        :addr_(addr)
-    {}
-    
+        :len_(sizeof(addr)),
+        valid_(true)
+    {
+        bzero(&unixAddr_, sizeof(unixAddr_));
+        addr_ = addr;
+    }
+
+    /**
+     * Unix域地址，abstract为true时地址位于抽象命名空间，不会在文件系统中创建文件
+     * 路径放不进sun_path时写ERROR日志并返回无效地址(valid()为false)，不截断成另一个路径
+    */
+    static InetAddress fromUnixPath(const std::string& path, bool abstract = false);
+
+    sa_family_t family() const { return addr_.sin_family; }
+    //fromUnixPath构造失败的地址无效，Acceptor和Connector拒绝使用
+    bool valid() const { return valid_; }
+    bool isUnix() const { return family() == AF_UNIX; }
+    //Unix域地址的路径，抽象地址不包含开头的'\0'
+    std::string unixPath() const;
+    bool isAbstract() const;
+
     std::string toIp() const;
     std::string toIpPort() const;
     uint16_t toPort() const;
     const sockaddr_in* getSocketAddr() const{ return &addr_; }
-    void setSocketAddr(const sockaddr_in& addr) { addr_ = addr; }
+    void setSocketAddr(const sockaddr_in& addr) { addr_ = addr; len_ = sizeof(addr); valid_ = true; }
+
+    //通用的地址接口，bind/connect/accept使用
+    const sockaddr* getSockAddr() const { return reinterpret_cast<const sockaddr*>(&addr_); }
+    socklen_t getSockAddrLen() const { return len_; }
+    void setSockAddr(const sockaddr* addr, socklen_t len);
 private:
-    sockaddr_in addr_;
+    union
+    {
+        sockaddr_in addr_;
+        sockaddr_un unixAddr_;
+    };
+    socklen_t len_;
+    bool valid_;
 };
@@ -50,7 +50,7 @@
         snprintf(buf, 1024, LogmsgFormat, ##__VA_ARGS__); \
         logger.log(buf); \
     }while(0)
-else
+#else
     #define LOG_DEBUG(LogmsgFormat, ...) 
 #endif
 //定义日志的级别 INFO ERROR FATAL DEBUG
@@ -0,0 +1,115 @@
+#include "LoopMetrics.h"
+
+uint64_t Log2Histogram::Snapshot::percentile(double p) const
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(p * count);
+    uint64_t seen = 0;
+    for (int i = 0; i < kBuckets; ++i)
+    {
+        seen += counts[i];
+        if (seen > rank)
+        {
+            uint64_t upper = i == 0 ? 0 : (i == kBuckets - 1 ? max : (uint64_t(1) << i) - 1);
+            return std::min(upper, max);
+        }
+    }
+    return max;
+}
+
+void Log2Histogram::snapshot(Snapshot* out) const
+{
+    uint64_t total = 0;
+    for (int i = 0; i < kBuckets; ++i)
+    {
+        out->counts[i] = counts_[i].get();
+        total += out->counts[i];
+    }
+    //count和各个桶不是同时读的，用桶的和保持一致
+    out->count = total;
+    out->sum = sum_.get();
+    out->max = max_.get();
+}
+
+uint64_t LatencyHistogram::Snapshot::percentile(double p) const
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(p * count);
+    uint64_t seen = 0;
+    for (int i = 0; i < kBuckets; ++i)
+    {
+        seen += counts[i];
+        if (seen > rank)
+        {
+            return std::min(i == kBuckets - 1 ? max : upperBoundOf(i), max);
+        }
+    }
+    return max;
+}
+
+void LatencyHistogram::Snapshot::merge(const Snapshot& other)
+{
+    for (int i = 0; i < kBuckets; ++i)
+    {
+        counts[i] += other.counts[i];
+    }
+    count += other.count;
+    sum += other.sum;
+    max = std::max(max, other.max);
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::Snapshot::since(const Snapshot& prev) const
+{
+    Snapshot diff;
+    int top = -1;
+    for (int i = 0; i < kBuckets; ++i)
+    {
+        diff.counts[i] = counts[i] - prev.counts[i];
+        if (diff.counts[i] > 0)
+        {
+            top = i;
+        }
+    }
+    diff.count = count - prev.count;
+    diff.sum = sum - prev.sum;
+    diff.max = top < 0 ? 0 : std::min(top == kBuckets - 1 ? max : upperBoundOf(top), max);
+    return diff;
+}
+
+void LatencyHistogram::snapshot(Snapshot* out) const
+{
+    uint64_t total = 0;
+    for (int i = 0; i < kBuckets; ++i)
+    {
+        out->counts[i] = counts_[i].get();
+        total += out->counts[i];
+    }
+    out->count = total;
+    out->sum = sum_.get();
+    out->max = max_.get();
+}
+
+LoopMetrics::Snapshot LoopMetrics::snapshot() const
+{
+    Snapshot snap;
+    snap.iterations = iterations_.get();
+    snap.wakeups = wakeups_.get();
+    snap.events = events_.get();
+    snap.functors = functors_.get();
+    snap.pollWaitUs = pollWaitUs_.get();
+    snap.callbackUs = callbackUs_.get();
+    snap.functorUs = functorUs_.get();
+    pollWait_.snapshot(&snap.pollWait);
+    activeChannels_.snapshot(&snap.activeChannels);
+    callbackTime_.snapshot(&snap.callbackTime);
+    functorTime_.snapshot(&snap.functorTime);
+    queueDepth_.snapshot(&snap.queueDepth);
+    requestLatency_.snapshot(&snap.requestLatency);
+    return snap;
+}
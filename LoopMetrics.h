@@ -0,0 +1,213 @@
+#pragma once
+
+#include <atomic>
+#include <algorithm>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "noncopyable.h"
+
+/**
+ * 只有一个线程写、任意线程读的计数器
+ * 写入是relaxed的load加store，不是原子的读改写，没有lock前缀，和普通变量一样便宜
+*/
+class LoopCounter
+{
+public:
+    LoopCounter() : value_(0) {}
+
+    void add(uint64_t n) { value_.store(value_.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+    void raiseTo(uint64_t n)
+    {
+        if (n > value_.load(std::memory_order_relaxed))
+        {
+            value_.store(n, std::memory_order_relaxed);
+        }
+    }
+    uint64_t get() const { return value_.load(std::memory_order_relaxed); }
+private:
+    std::atomic<uint64_t> value_;
+};
+
+/**
+ * 按2的幂分桶的直方图，桶0统计0，桶i(i>0)统计[2^(i-1), 2^i)，最后一个桶收纳所有更大的值
+ * 写入方只有loop线程，快照可以在任意线程读取，各个桶之间不保证是同一时刻的值
+*/
+class Log2Histogram : noncopyable
+{
+public:
+    static const int kBuckets = 32;
+
+    struct Snapshot
+    {
+        uint64_t counts[kBuckets];
+        uint64_t count;
+        uint64_t sum;
+        uint64_t max;
+
+        double mean() const { return count > 0 ? static_cast<double>(sum) / count : 0; }
+        //返回p(0~1)分位所在桶的上界，不超过max
+        uint64_t percentile(double p) const;
+    };
+
+    void record(uint64_t value)
+    {
+        counts_[bucketOf(value)].add(1);
+        sum_.add(value);
+        max_.raiseTo(value);
+    }
+    void snapshot(Snapshot* out) const;
+private:
+    static int bucketOf(uint64_t value)
+    {
+        return value == 0 ? 0 : std::min(kBuckets - 1, 64 - __builtin_clzll(value));
+    }
+
+    LoopCounter counts_[kBuckets];
+    LoopCounter sum_;
+    LoopCounter max_;
+};
+
+/**
+ * HDR风格的对数线性直方图，用来统计延迟(微秒)的分位数
+ * 小于32的值每个值一个桶，之后每个2的幂区间再等分成32个桶，相对误差不超过1/32；不小于2^40的值都记在最后一个桶
+ * 和Log2Histogram一样只有loop线程写入，快照可以在任意线程读取；各个loop的快照直接按桶相加合并，不需要加锁
+*/
+class LatencyHistogram : noncopyable
+{
+public:
+    static const int kSubBucketBits = 5;
+    static const int kSubBuckets = 1 << kSubBucketBits;
+    static const int kMaxExponent = 40;
+    static const int kBuckets = (kMaxExponent - kSubBucketBits + 1) * kSubBuckets;
+
+    struct Snapshot
+    {
+        Snapshot() : counts(), count(0), sum(0), max(0) {}
+
+        uint64_t counts[kBuckets];
+        uint64_t count;
+        uint64_t sum;
+        uint64_t max;
+
+        double mean() const { return count > 0 ? static_cast<double>(sum) / count : 0; }
+        //返回p(0~1)分位所在桶的上界，不超过max
+        uint64_t percentile(double p) const;
+        //合并另一个loop的快照
+        void merge(const Snapshot& other);
+        //本快照相对更早的快照prev新增的部分，max取新增部分最高的桶的上界(不超过累计的max)
+        Snapshot since(const Snapshot& prev) const;
+    };
+
+    void record(uint64_t value)
+    {
+        counts_[bucketOf(value)].add(1);
+        sum_.add(value);
+        max_.raiseTo(value);
+    }
+    void snapshot(Snapshot* out) const;
+
+    static int bucketOf(uint64_t value)
+    {
+        if (value < static_cast<uint64_t>(kSubBuckets))
+        {
+            return static_cast<int>(value);
+        }
+        int exponent = 63 - __builtin_clzll(value);
+        if (exponent >= kMaxExponent)
+        {
+            return kBuckets - 1;
+        }
+        int shift = exponent - kSubBucketBits;
+        return (shift + 1) * kSubBuckets + static_cast<int>((value >> shift) & (kSubBuckets - 1));
+    }
+    //桶里最大的值
+    static uint64_t upperBoundOf(int bucket)
+    {
+        if (bucket < kSubBuckets)
+        {
+            return bucket;
+        }
+        int shift = bucket / kSubBuckets - 1;
+        uint64_t lower = static_cast<uint64_t>(kSubBuckets + bucket % kSubBuckets) << shift;
+        return lower + (uint64_t(1) << shift) - 1;
+    }
+private:
+    LoopCounter counts_[kBuckets];
+    LoopCounter sum_;
+    LoopCounter max_;
+};
+
+/**
+ * EventLoop每一轮的运行情况，由loop线程更新，通过EventLoop::metrics()在任意线程取快照
+ * 一轮分为三段：阻塞在poll里等待、处理活跃channel的回调、执行pendingFunctors_，时间单位都是微秒
+ * 忙的时间占比接近1说明这个loop已经饱和
+*/
+class LoopMetrics : noncopyable
+{
+public:
+    struct Snapshot
+    {
+        uint64_t iterations;
+        uint64_t wakeups;//被eventfd唤醒的次数
+        uint64_t events;//活跃channel的总数
+        uint64_t functors;//执行过的pending回调总数
+        uint64_t pollWaitUs;
+        uint64_t callbackUs;
+        uint64_t functorUs;
+
+        Log2Histogram::Snapshot pollWait;//每轮poll等待的微秒数
+        Log2Histogram::Snapshot activeChannels;//每轮poll返回的活跃channel数
+        Log2Histogram::Snapshot callbackTime;//每轮处理channel回调的微秒数
+        Log2Histogram::Snapshot functorTime;//每次执行pending回调的微秒数，队列为空时不统计
+        Log2Histogram::Snapshot queueDepth;//交换出来的pending回调个数，队列为空时不统计
+        LatencyHistogram::Snapshot requestLatency;//请求从poll返回到响应全部写进内核的微秒数，见TcpConnection::markResponse
+
+        //处理回调的时间占总时间的比例
+        double busyRatio() const
+        {
+            uint64_t busy = callbackUs + functorUs;
+            uint64_t total = busy + pollWaitUs;
+            return total > 0 ? static_cast<double>(busy) / total : 0;
+        }
+    };
+
+    void recordPoll(int64_t waitUs, size_t activeChannels, int64_t callbackUs)
+    {
+        iterations_.add(1);
+        events_.add(activeChannels);
+        pollWaitUs_.add(clamp(waitUs));
+        callbackUs_.add(clamp(callbackUs));
+        pollWait_.record(clamp(waitUs));
+        activeChannels_.record(activeChannels);
+        callbackTime_.record(clamp(callbackUs));
+    }
+    void recordFunctors(size_t depth, int64_t us)
+    {
+        functors_.add(depth);
+        functorUs_.add(clamp(us));
+        queueDepth_.record(depth);
+        functorTime_.record(clamp(us));
+    }
+    void recordWakeup() { wakeups_.add(1); }
+    void recordRequest(int64_t us) { requestLatency_.record(clamp(us)); }
+
+    Snapshot snapshot() const;
+private:
+    //系统时间被往回调时差值可能为负
+    static uint64_t clamp(int64_t us) { return us > 0 ? static_cast<uint64_t>(us) : 0; }
+
+    LoopCounter iterations_;
+    LoopCounter wakeups_;
+    LoopCounter events_;
+    LoopCounter functors_;
+    LoopCounter pollWaitUs_;
+    LoopCounter callbackUs_;
+    LoopCounter functorUs_;
+    Log2Histogram pollWait_;
+    Log2Histogram activeChannels_;
+    Log2Histogram callbackTime_;
+    Log2Histogram functorTime_;
+    Log2Histogram queueDepth_;
+    LatencyHistogram requestLatency_;
+};
@@ -0,0 +1,121 @@
+#include <time.h>
+#include <algorithm>
+#include <chrono>
+
+#include "LoopWatchdog.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+LoopWatchdog::LoopWatchdog(double stuckSeconds, const std::string& name)
+    :stuckNs_(static_cast<int64_t>(stuckSeconds * 1e9)),
+    thread_(std::bind(&LoopWatchdog::threadFunc, this), name),
+    running_(false)
+{
+}
+
+LoopWatchdog::~LoopWatchdog()
+{
+    stop();
+}
+
+void LoopWatchdog::watch(EventLoop* loop)
+{
+    double seconds = stuckNs_ / 1e9;
+    loop->runInLoop([loop, seconds]() {
+        if (!loop->callbackTiming())
+        {
+            loop->setSlowCallbackThreshold(seconds);
+        }
+    });
+    std::lock_guard<std::mutex> lock(mutex_);
+    loops_.push_back(Watched{loop, 0});
+}
+
+void LoopWatchdog::unwatch(EventLoop* loop)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    loops_.erase(std::remove_if(loops_.begin(), loops_.end(), [loop](const Watched& w) { return w.loop == loop; }),
+        loops_.end());
+}
+
+void LoopWatchdog::start()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = true;
+    }
+    thread_.start();
+}
+
+void LoopWatchdog::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_)
+        {
+            return;
+        }
+        running_ = false;
+    }
+    cond_.notify_all();
+    thread_.join();
+}
+
+void LoopWatchdog::threadFunc()
+{
+    //检查间隔是阈值的四分之一，发现卡住的时间最多晚四分之一个阈值
+    std::chrono::nanoseconds interval(std::max<int64_t>(stuckNs_ / 4, 1000000));
+    std::vector<Stuck> stuck;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (running_)
+    {
+        cond_.wait_for(lock, interval);
+        if (!running_)
+        {
+            break;
+        }
+        check(&stuck);
+        if (!stuck.empty())
+        {
+            //回调里可能调用watch、unwatch，持锁调用会死锁
+            lock.unlock();
+            for (const Stuck& s : stuck)
+            {
+                report(s);
+            }
+            stuck.clear();
+            lock.lock();
+        }
+    }
+}
+
+//持有mutex_
+void LoopWatchdog::check(std::vector<Stuck>* stuck)
+{
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    int64_t now = static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    for (Watched& w : loops_)
+    {
+        int64_t start = w.loop->callbackStartNs();
+        if (start == 0 || start == w.reportedStartNs || now - start < stuckNs_)
+        {
+            continue;
+        }
+        w.reportedStartNs = start;
+        stuck->push_back(Stuck{w.loop, w.loop->callbackKind(), w.loop->callbackFd(), (now - start) / 1e9});
+    }
+}
+
+void LoopWatchdog::report(const Stuck& stuck)
+{
+    if (stuckCallback_)
+    {
+        stuckCallback_(stuck.loop, stuck.kind, stuck.fd, stuck.seconds);
+    }
+    else
+    {
+        LOG_ERROR("%s %s %d EventLoop %p stuck in %s callback of fd %d for %.0f ms\n", __FILENAME__, __FUNCTION__,
+            __LINE__, stuck.loop, stuck.kind, stuck.fd, stuck.seconds * 1e3);
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+
+#include "noncopyable.h"
+#include "Thread.h"
+
+class EventLoop;
+
+/**
+ * 看门狗线程，发现卡在一个回调里超过stuckSeconds秒的loop
+ * loop自己的慢回调报告要等回调返回以后才有，这里在卡住期间就能报告，每个卡住的回调只报告一次
+ * 依赖loop的回调计时，watch时如果loop没有打开回调计时，用stuckSeconds作为阈值打开
+ * 被监视的loop析构之前要unwatch
+*/
+class LoopWatchdog : noncopyable
+{
+public:
+    //kind是回调类型，fd是channel的fd，pending回调为-1
+    using StuckCallback = std::function<void(EventLoop* loop, const char* kind, int fd, double stuckSeconds)>;
+
+    explicit LoopWatchdog(double stuckSeconds, const std::string& name = std::string("LoopWatchdog"));
+    ~LoopWatchdog();
+
+    //默认写ERROR日志，在start之前设置，在看门狗线程中不持锁调用，里面可以watch和unwatch
+    //调用时loop可能已经被unwatch，只能用来区分是哪个loop，不要再访问它
+    void setStuckCallback(const StuckCallback& cb) { stuckCallback_ = cb; }
+    void watch(EventLoop* loop);
+    void unwatch(EventLoop* loop);
+
+    void start();
+    void stop();
+private:
+    struct Watched
+    {
+        EventLoop* loop;
+        int64_t reportedStartNs;//已经报告过的回调的开始时间
+    };
+
+    //check在持锁时找出卡住的回调，threadFunc放开锁以后再逐个报告
+    struct Stuck
+    {
+        EventLoop* loop;
+        const char* kind;
+        int fd;
+        double seconds;
+    };
+
+    void threadFunc();
+    void check(std::vector<Stuck>* stuck);
+    void report(const Stuck& stuck);
+
+    const int64_t stuckNs_;
+    StuckCallback stuckCallback_;
+    Thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    bool running_;
+    std::vector<Watched> loops_;
+};
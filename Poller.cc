@@ -1,6 +1,9 @@
+#include <algorithm>
+
 #include "Poller.h"
+#include "Channel.h"
 
-Poller::Poller(EventLoop* loop):ownerLoop_(loop)
+Poller::Poller(EventLoop* loop):numChannels_(0), numCtlCalls_(0), ownerLoop_(loop)
 {
 }
 
@@ -9,6 +12,33 @@ Poller::~Poller() = default;
 //判断阐述Channel是否在当前Poller中
 bool Poller::hasChannel(Channel* channel) const
 {
-    auto it = channels_.find(channel->fd());
-    return it != channels_.end() && it->second == channel;
+    int fd = channel->fd();
+    return fd >= 0 && static_cast<size_t>(fd) < channels_.size() && channels_[fd].channel == channel;
+}
+
+uint32_t Poller::addToTable(Channel* channel)
+{
+    size_t fd = static_cast<size_t>(channel->fd());
+    if (fd >= channels_.size())
+    {
+        //按倍数扩容，扩容只在fd号第一次变大时发生
+        channels_.resize(std::max(fd + 1, channels_.size() * 2));
+    }
+    ChannelSlot& slot = channels_[fd];
+    if (slot.channel == nullptr)
+    {
+        ++numChannels_;
+    }
+    slot.channel = channel;
+    return ++slot.generation;
+}
+
+void Poller::removeFromTable(Channel* channel)
+{
+    int fd = channel->fd();
+    if (hasChannel(channel))
+    {
+        channels_[fd].channel = nullptr;
+        --numChannels_;
+    }
 }
\ No newline at end of file
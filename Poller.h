@@ -1,7 +1,7 @@
 #pragma once
 
 #include <vector>
-#include <unordered_map>
+#include <stdint.h>
 
 #include "EventLoop.h"
 #include "noncopyable.h"
@@ -25,13 +25,44 @@ public:
     //判断阐述Channel是否在当前Poller中
     virtual bool hasChannel(Channel* channel) const;
 
+    //累计调用epoll_ctl等修改内核注册表的系统调用次数
+    uint64_t numCtlCalls() const { return numCtlCalls_; }
+
     //EventLoop可以通过该结果获取默认的IO复用的具体实现
     static Poller* newDefaultPoller(EventLoop* loop);
 
 protected:
-    using ChannelMap = std::unordered_map<int, Channel*>;
-    //map的key是sockfd,value是sockfd所属的channel的通道类型
-    ChannelMap channels_;
+    /**
+     * 以fd为下标的channel表，fd是小而稠密的整数，增删都是O(1)而且不分配内存
+     * 每次有channel加入某个fd，这个位置的generation加1，和fd一起写进epoll_event，
+     * fd被关闭又复用以后，旧注册上报的事件generation对不上，不会再被当成新的channel
+    */
+    struct ChannelSlot
+    {
+        Channel* channel = nullptr;
+        uint32_t generation = 0;
+    };
+    using ChannelTable = std::vector<ChannelSlot>;
+
+    //把channel放进表中，返回它的generation
+    uint32_t addToTable(Channel* channel);
+    void removeFromTable(Channel* channel);
+    //fd和generation都匹配时返回channel，否则返回nullptr
+    Channel* findChannel(int fd, uint32_t generation) const
+    {
+        if (fd < 0 || static_cast<size_t>(fd) >= channels_.size())
+        {
+            return nullptr;
+        }
+        const ChannelSlot& slot = channels_[fd];
+        return slot.generation == generation ? slot.channel : nullptr;
+    }
+    uint32_t generationOf(int fd) const { return channels_[fd].generation; }
+    size_t numChannels() const { return numChannels_; }
+
+    ChannelTable channels_;
+    size_t numChannels_;
+    uint64_t numCtlCalls_;
 
 private:
     EventLoop* ownerLoop_; //定义Poller所属的事件循环EventLoop
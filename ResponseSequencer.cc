@@ -0,0 +1,113 @@
+#include "ResponseSequencer.h"
+#include "TcpConnection.h"
+#include "EventLoop.h"
+#include "Timestamp.h"
+#include "Logger.h"
+
+ResponseSequencer::ResponseSequencer(const TcpConnectionPtr& conn, size_t maxInFlight, const MessageCallback& resumeCallback)
+    :conn_(conn),
+    loop_(conn->getLoop()),
+    slots_(maxInFlight > 0 ? maxInFlight : 1),
+    headSeq_(0),
+    nextSeq_(0),
+    paused_(false),
+    pauses_(0),
+    resumeCallback_(resumeCallback)
+{
+}
+
+uint64_t ResponseSequencer::begin(Timestamp receiveTime)
+{
+    if (full())
+    {
+        //继续分配会覆盖队首还没发送的响应
+        LOG_ERROR("%s %s %d %zu requests in flight, request rejected\n", __FILENAME__, __FUNCTION__, __LINE__, inFlight());
+        return kRejected;
+    }
+    uint64_t seq = nextSeq_++;
+    slots_[seq % slots_.size()].receiveTime = receiveTime;
+    if (full() && !paused_)
+    {
+        TcpConnectionPtr conn = conn_.lock();
+        if (conn)
+        {
+            conn->stopRead();
+            paused_ = true;
+            ++pauses_;
+        }
+    }
+    return seq;
+}
+
+void ResponseSequencer::complete(uint64_t seq, std::string response)
+{
+    if (seq == kRejected)
+    {
+        return;
+    }
+    if (loop_->isInLoopThread())
+    {
+        completeInLoop(seq, response);
+    }
+    else
+    {
+        std::shared_ptr<ResponseSequencer> self(shared_from_this());
+        loop_->queueInLoop([self, seq, response]() mutable { self->completeInLoop(seq, response); });
+    }
+}
+
+void ResponseSequencer::completeInLoop(uint64_t seq, std::string& response)
+{
+    if (seq < headSeq_ || seq >= nextSeq_)
+    {
+        LOG_ERROR("%s %s %d unknown sequence %llu, expecting [%llu, %llu)\n", __FILENAME__, __FUNCTION__, __LINE__,
+            (unsigned long long)seq, (unsigned long long)headSeq_, (unsigned long long)nextSeq_);
+        return;
+    }
+    Slot& slot = slots_[seq % slots_.size()];
+    slot.ready = true;
+    slot.response.swap(response);
+    if (seq != headSeq_)
+    {
+        return;//前面还有没完成的请求，先缓存
+    }
+
+    //从队首开始把连续完成的响应拼起来一次发送
+    while (headSeq_ < nextSeq_ && slots_[headSeq_ % slots_.size()].ready)
+    {
+        Slot& head = slots_[headSeq_ % slots_.size()];
+        pending_.append(head.response);
+        if (head.receiveTime.valid())
+        {
+            pendingTimes_.push_back(head.receiveTime);
+        }
+        head.ready = false;
+        head.response.clear();
+        ++headSeq_;
+    }
+    TcpConnectionPtr conn = conn_.lock();
+    if (!conn)
+    {
+        pending_.clear();
+        pendingTimes_.clear();
+        return;
+    }
+    conn->send(pending_);
+    pending_.clear();
+    for (Timestamp receiveTime : pendingTimes_)
+    {
+        conn->markResponse(receiveTime);
+    }
+    pendingTimes_.clear();
+
+    if (paused_ && !full())
+    {
+        paused_ = false;
+        conn->startRead();
+        //暂停期间留在inputBuffer里的请求不会再有可读事件触发
+        if (resumeCallback_ && conn->inputBuffer()->readableBytes() > 0)
+        {
+            resumeCallback_(conn, conn->inputBuffer(), Timestamp::now());
+        }
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "noncopyable.h"
+#include "Callbacks.h"
+#include "Timestamp.h"
+
+class EventLoop;
+
+/**
+ * 流水线请求并行处理以后按到达顺序回复
+ * 在MessageCallback里用begin()给每个请求分配序号，交给其他线程处理，处理完调用complete(序号, 响应)；
+ * 队首的响应到达时，连续完成的响应合并成一次send，严格按请求顺序进入outputBuffer_
+ * 在途请求达到maxInFlight时停止读socket，队首完成腾出位置以后恢复读，
+ * 已经在inputBuffer里的请求通过resumeCallback重新交给用户解析(一般就是同一个MessageCallback)
+ * begin传入MessageCallback的receiveTime时，响应写进内核以后把请求延迟记进loop的直方图(TcpConnection::markResponse)
+ * 使用make_shared创建，通常保存在连接的context里
+*/
+class ResponseSequencer : noncopyable, public std::enable_shared_from_this<ResponseSequencer>
+{
+public:
+    ResponseSequencer(const TcpConnectionPtr& conn, size_t maxInFlight, const MessageCallback& resumeCallback);
+
+    //full()时begin返回的序号，请求没有登记，不能再交给complete以外的处理
+    static const uint64_t kRejected = ~0ULL;
+
+    /**
+     * 在连接的loop线程中调用，返回请求的序号，之后full()为true时应该停止解析
+     * 已经full()时不会覆盖在途请求的位置，返回kRejected，请求留在inputBuffer里等恢复读取以后再解析
+    */
+    uint64_t begin(Timestamp receiveTime = Timestamp());
+    //可以在任意线程调用，不在loop线程时转到loop线程执行，seq为kRejected时什么也不做
+    void complete(uint64_t seq, std::string response);
+
+    size_t inFlight() const { return static_cast<size_t>(nextSeq_ - headSeq_); }
+    bool full() const { return inFlight() >= slots_.size(); }
+    //因为在途请求太多暂停读取的次数
+    uint64_t pauses() const { return pauses_; }
+private:
+    struct Slot
+    {
+        Slot() :ready(false) {}
+
+        bool ready;
+        std::string response;
+        Timestamp receiveTime;
+    };
+
+    void completeInLoop(uint64_t seq, std::string& response);
+
+    std::weak_ptr<TcpConnection> conn_;//连接的context持有本对象，这里不能再持有连接
+    EventLoop* loop_;
+    std::vector<Slot> slots_;//按seq % maxInFlight存放，队首之后最多maxInFlight个
+    uint64_t headSeq_;//最早一个还没有发送的请求
+    uint64_t nextSeq_;//下一个分配的序号
+    bool paused_;
+    uint64_t pauses_;
+    MessageCallback resumeCallback_;
+    std::string pending_;//一次合并发送的响应，复用内存
+    std::vector<Timestamp> pendingTimes_;//pending_里各个请求的receiveTime
+};
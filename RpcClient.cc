@@ -0,0 +1,225 @@
+#include <sys/socket.h>
+#include <unistd.h>
+#include <strings.h>
+
+#include "RpcClient.h"
+#include "Connector.h"
+#include "EventLoop.h"
+#include "TcpConnection.h"
+#include "Logger.h"
+
+RpcClient::RpcClient(EventLoop* loop, const InetAddress& serverAddr, const std::string& name)
+    :loop_(loop),
+    serverAddr_(serverAddr),
+    name_(name),
+    connector_(new Connector(loop, serverAddr)),
+    nextId_(1),
+    flushQueued_(false),
+    guard_(std::make_shared<RpcClient*>(this))
+{
+    std::weak_ptr<RpcClient*> guard(guard_);
+    connector_->setNewConnectionCallback([guard](int sockfd) {
+        std::shared_ptr<RpcClient*> client(guard.lock());
+        if (!client)
+        {
+            //RpcClient已经析构，fd还没有交给任何对象，直接关掉
+            ::close(sockfd);
+            return;
+        }
+        (*client)->newConnection(sockfd);
+    });
+}
+
+RpcClient::~RpcClient()
+{
+    guard_.reset();
+    connector_->stop();
+    if (connection_)
+    {
+        //连接可能比RpcClient活得更久，回调里不能再访问this
+        connection_->setConnectionCallback([](const TcpConnectionPtr&) {});
+        connection_->setMessageCallback([](const TcpConnectionPtr&, Buffer* buf, Timestamp) { buf->retrieveAll(); });
+        connection_->setCloseCallback([](const TcpConnectionPtr& conn) {
+            conn->getLoop()->queueInLoop(std::bind(&TcpConnection::connectionDestroyed, conn));
+        });
+        loop_->queueInLoop(std::bind(&TcpConnection::connectionDestroyed, connection_));
+        connection_.reset();
+    }
+    //先断开连接，回调里再发起的调用会立即以kRpcConnectionClosed结束，不会留在pending_里
+    failAll(kRpcConnectionClosed);
+}
+
+void RpcClient::connect()
+{
+    connector_->start();
+}
+
+//在loop线程中执行，Connector交过来的fd已经是非阻塞的
+void RpcClient::newConnection(int sockfd)
+{
+    sockaddr_storage local;
+    bzero(&local, sizeof(local));
+    socklen_t addrlen = sizeof(local);
+    ::getsockname(sockfd, (sockaddr*)&local, &addrlen);
+    InetAddress localAddr;
+    localAddr.setSockAddr((sockaddr*)&local, addrlen);
+
+    TcpConnectionPtr conn(new TcpConnection(loop_, name_, sockfd, localAddr, serverAddr_));
+    conn->setConnectionCallback(std::bind(&RpcClient::onConnection, this, std::placeholders::_1));
+    conn->setMessageCallback(std::bind(&RpcClient::onMessage, this,
+        std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+    conn->setCloseCallback(std::bind(&RpcClient::onClose, this, std::placeholders::_1));
+    conn->setTcpNoDelay(true);
+    connection_ = conn;
+    conn->connectEstablished();
+}
+
+void RpcClient::disconnect()
+{
+    connector_->stop();
+    std::weak_ptr<RpcClient*> guard(guard_);
+    loop_->runInLoop([guard]() {
+        std::shared_ptr<RpcClient*> client(guard.lock());
+        if (client && (*client)->connection_)
+        {
+            (*client)->connection_->shutdown();
+        }
+    });
+}
+
+bool RpcClient::connected() const
+{
+    return connection_ && connection_->connected();
+}
+
+void RpcClient::call(const std::string& method, const std::string& request, RpcCallback cb, double timeoutSeconds)
+{
+    if (loop_->isInLoopThread())
+    {
+        callInLoop(method, request, cb, timeoutSeconds);
+    }
+    else
+    {
+        std::weak_ptr<RpcClient*> guard(guard_);
+        loop_->queueInLoop([guard, method, request, cb, timeoutSeconds]() {
+            std::shared_ptr<RpcClient*> client(guard.lock());
+            if (!client)
+            {
+                cb(kRpcConnectionClosed, std::string());
+                return;
+            }
+            (*client)->callInLoop(method, request, cb, timeoutSeconds);
+        });
+    }
+}
+
+void RpcClient::callInLoop(const std::string& method, const std::string& request, const RpcCallback& cb, double timeoutSeconds)
+{
+    if (!connected())
+    {
+        cb(kRpcConnectionClosed, std::string());
+        return;
+    }
+
+    uint64_t id = nextId_++;
+    PendingCall& entry = pending_[id];
+    entry.callback = cb;
+    if (timeoutSeconds > 0.0)
+    {
+        entry.timer = loop_->runAfter(timeoutSeconds, std::bind(&RpcClient::onTimeout, this, id));
+    }
+
+    RpcCodec::encode(kRpcRequest, kRpcOk, id, method, request, &outgoing_);
+    if (!flushQueued_)
+    {
+        flushQueued_ = true;
+        std::weak_ptr<RpcClient*> guard(guard_);
+        loop_->queueInLoop([guard]() {
+            std::shared_ptr<RpcClient*> client(guard.lock());
+            if (client)
+            {
+                (*client)->flushInLoop();
+            }
+        });
+    }
+}
+
+void RpcClient::flushInLoop()
+{
+    flushQueued_ = false;
+    if (connection_ && !outgoing_.empty())
+    {
+        connection_->send(outgoing_);
+    }
+    outgoing_.clear();
+}
+
+void RpcClient::onConnection(const TcpConnectionPtr& conn)
+{
+    LOG_INFO("%s %s %d %s %s\n", __FILENAME__, __FUNCTION__, __LINE__, name_.c_str(), conn->connected() ? "up" : "down");
+    if (connectionCallback_)
+    {
+        connectionCallback_(conn);
+    }
+}
+
+void RpcClient::onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+{
+    RpcMessage msg;
+    int ret;
+    while ((ret = RpcCodec::decode(buf, &msg)) > 0)
+    {
+        auto it = pending_.find(msg.id);
+        if (msg.type != kRpcResponse || it == pending_.end())
+        {
+            //已经超时的调用，响应直接丢弃
+            continue;
+        }
+        RpcCallback cb;
+        cb.swap(it->second.callback);
+        if (it->second.timer.valid())
+        {
+            loop_->cancel(it->second.timer);
+        }
+        pending_.erase(it);
+        cb(msg.status, msg.payload);
+    }
+    if (ret < 0)
+    {
+        LOG_ERROR("%s %s %d bad rpc message from %s\n", __FILENAME__, __FUNCTION__, __LINE__, conn->name().c_str());
+        conn->shutdown();
+    }
+}
+
+void RpcClient::onClose(const TcpConnectionPtr& conn)
+{
+    failAll(kRpcConnectionClosed);
+    connection_.reset();
+    loop_->queueInLoop(std::bind(&TcpConnection::connectionDestroyed, conn));
+}
+
+void RpcClient::onTimeout(uint64_t id)
+{
+    auto it = pending_.find(id);
+    if (it != pending_.end())
+    {
+        RpcCallback cb;
+        cb.swap(it->second.callback);
+        pending_.erase(it);
+        cb(kRpcTimeout, std::string());
+    }
+}
+
+void RpcClient::failAll(int status)
+{
+    std::unordered_map<uint64_t, PendingCall> pending;
+    pending.swap(pending_);
+    for (auto& item : pending)
+    {
+        if (item.second.timer.valid())
+        {
+            loop_->cancel(item.second.timer);
+        }
+        item.second.callback(status, std::string());
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "noncopyable.h"
+#include "InetAddress.h"
+#include "Callbacks.h"
+#include "TimerId.h"
+#include "RpcCodec.h"
+
+class EventLoop;
+class Connector;
+
+/**
+ * RPC客户端，一个连接上可以同时有任意多个未完成的调用，响应按id匹配，可以乱序到达
+ * 通过Connector非阻塞地连接服务端，连上之前发起的调用以kRpcConnectionClosed结束，连上以后回调ConnectionCallback
+ * 每个调用可以设置超时时间，由loop的定时器驱动，超时、连接断开时回调以相应的状态结束
+ * call可以跨线程调用，回调总是在loop线程中执行；RpcClient必须在loop线程中析构，
+ * 析构时未完成的调用以kRpcConnectionClosed结束，还在队列里的跨线程调用也一样
+*/
+class RpcClient:noncopyable
+{
+public:
+    RpcClient(EventLoop* loop, const InetAddress& serverAddr, const std::string& name);
+    ~RpcClient();
+
+    //连接建立和断开时回调，在connect之前设置
+    void setConnectionCallback(const ConnectionCallback& cb) { connectionCallback_ = cb; }
+    //开始连接服务端，不阻塞，失败时按Connector的退避间隔重试
+    void connect();
+    void disconnect();
+
+    //发起一次调用，timeoutSeconds<=0表示不超时
+    void call(const std::string& method, const std::string& request, RpcCallback cb, double timeoutSeconds = 0.0);
+
+    //只能在loop线程中调用
+    bool connected() const;
+    size_t pendingCalls() const { return pending_.size(); }
+private:
+    struct PendingCall
+    {
+        RpcCallback callback;
+        TimerId timer;
+    };
+
+    void newConnection(int sockfd);
+    void callInLoop(const std::string& method, const std::string& request, const RpcCallback& cb, double timeoutSeconds);
+    //把本轮攒下的请求一次性写出去
+    void flushInLoop();
+    void onConnection(const TcpConnectionPtr& conn);
+    void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp);
+    void onClose(const TcpConnectionPtr& conn);
+    void onTimeout(uint64_t id);
+    //以status结束所有未完成的调用
+    void failAll(int status);
+
+    EventLoop* loop_;
+    const InetAddress serverAddr_;
+    const std::string name_;
+    std::shared_ptr<Connector> connector_;
+    TcpConnectionPtr connection_;
+    ConnectionCallback connectionCallback_;
+
+    std::atomic<uint64_t> nextId_;
+    std::unordered_map<uint64_t, PendingCall> pending_;
+    std::string outgoing_;
+    bool flushQueued_;
+    //投递到loop的任务持有它的弱引用，RpcClient析构以后任务什么都不做
+    std::shared_ptr<RpcClient*> guard_;
+};
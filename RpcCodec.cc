@@ -0,0 +1,64 @@
+#include <string.h>
+#include <endian.h>
+#include <arpa/inet.h>
+
+#include "RpcCodec.h"
+
+void RpcCodec::encode(const RpcMessage& msg, std::string* out)
+{
+    encode(msg.type, msg.status, msg.id, msg.method, msg.payload, out);
+}
+
+void RpcCodec::encode(int type, int status, uint64_t id, const std::string& method,
+    const std::string& payload, std::string* out)
+{
+    char header[kHeaderLen];
+    uint32_t length = htonl(static_cast<uint32_t>(kHeaderLen - 4 + method.size() + payload.size()));
+    uint16_t methodLen = htons(static_cast<uint16_t>(method.size()));
+    uint64_t netId = htobe64(id);
+    memcpy(header, &length, 4);
+    header[4] = static_cast<char>(type);
+    header[5] = static_cast<char>(status);
+    memcpy(header + 6, &methodLen, 2);
+    memcpy(header + 8, &netId, 8);
+
+    out->reserve(out->size() + kHeaderLen + method.size() + payload.size());
+    out->append(header, kHeaderLen);
+    out->append(method);
+    out->append(payload);
+}
+
+int RpcCodec::decode(Buffer* buf, RpcMessage* msg)
+{
+    if (buf->readableBytes() < kHeaderLen)
+    {
+        return 0;
+    }
+
+    const char* data = buf->peek();
+    uint32_t length;
+    uint16_t methodLen;
+    uint64_t id;
+    memcpy(&length, data, 4);
+    memcpy(&methodLen, data + 6, 2);
+    memcpy(&id, data + 8, 8);
+    length = ntohl(length);
+    methodLen = ntohs(methodLen);
+
+    if (length < kHeaderLen - 4 || length > kMaxMessageLen || methodLen > length - (kHeaderLen - 4))
+    {
+        return -1;
+    }
+    if (buf->readableBytes() < length + 4)
+    {
+        return 0;
+    }
+
+    msg->type = static_cast<unsigned char>(data[4]);
+    msg->status = static_cast<unsigned char>(data[5]);
+    msg->id = be64toh(id);
+    msg->method.assign(data + kHeaderLen, methodLen);
+    msg->payload.assign(data + kHeaderLen + methodLen, length - (kHeaderLen - 4) - methodLen);
+    buf->retrieve(length + 4);
+    return 1;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <functional>
+
+#include "Buffer.h"
+
+/**
+ * RPC消息帧格式，整数都是网络字节序
+ * | length 4 | type 1 | status 1 | methodLen 2 | id 8 | method | payload |
+ * length是length字段之后的字节数，一个连接上可以同时有多个id不同的请求，响应可以乱序返回
+*/
+enum RpcMessageType
+{
+    kRpcRequest = 1,
+    kRpcResponse = 2,
+};
+
+enum RpcStatus
+{
+    kRpcOk = 0,
+    kRpcNoSuchMethod,//服务端没有注册该方法
+    kRpcHandlerError,//服务端处理失败
+    kRpcTimeout,//客户端等待超时
+    kRpcConnectionClosed,//连接断开，请求不会再有响应
+};
+
+struct RpcMessage
+{
+    RpcMessage():type(kRpcRequest), status(kRpcOk), id(0) {}
+
+    int type;
+    int status;
+    uint64_t id;
+    std::string method;
+    std::string payload;
+};
+
+//响应回调，可以在任意线程调用，只能调用一次
+using RpcDoneCallback = std::function<void(int status, const std::string& response)>;
+//客户端收到响应或者失败时的回调，在客户端loop线程中执行
+using RpcCallback = std::function<void(int status, const std::string& response)>;
+
+class RpcCodec
+{
+public:
+    static const size_t kHeaderLen = 16;
+    static const size_t kMaxMessageLen = 64 * 1024 * 1024;
+
+    //把消息编码后追加到out的末尾
+    static void encode(const RpcMessage& msg, std::string* out);
+    static void encode(int type, int status, uint64_t id, const std::string& method,
+        const std::string& payload, std::string* out);
+    //从buf中解析一条消息，返回1表示成功，0表示数据不完整，-1表示格式错误
+    static int decode(Buffer* buf, RpcMessage* msg);
+};
@@ -0,0 +1,114 @@
+#include "RpcServer.h"
+#include "Logger.h"
+
+//每个连接的状态，dispatching期间在loop线程内同步完成的响应先攒起来，解析完再一起发送
+struct RpcSession
+{
+    RpcSession():dispatching(false), pendingRequests(0) {}
+
+    bool dispatching;
+    std::string pending;
+    int pendingRequests;//pending里的响应个数，发送以后逐个markResponse
+};
+
+RpcServer::RpcServer(EventLoop* loop, const InetAddress& listenAddr, const std::string& name)
+    :server_(loop, listenAddr, name)
+{
+    server_.setConnectionCallback(std::bind(&RpcServer::onConnection, this, std::placeholders::_1));
+    server_.setMessageCallback(std::bind(&RpcServer::onMessage, this,
+        std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+}
+
+void RpcServer::registerMethod(const std::string& name, RpcMethod method)
+{
+    methods_[name] = std::move(method);
+}
+
+void RpcServer::start()
+{
+    server_.start();
+}
+
+void RpcServer::onConnection(const TcpConnectionPtr& conn)
+{
+    if (conn->connected())
+    {
+        conn->setTcpNoDelay(true);
+        conn->setContext(std::make_shared<RpcSession>());
+    }
+}
+
+void RpcServer::onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp receiveTime)
+{
+    RpcSession* session = static_cast<RpcSession*>(conn->getContext().get());
+    std::weak_ptr<TcpConnection> weakConn(conn);
+    RpcMessage msg;
+    int ret;
+
+    session->dispatching = true;
+    while ((ret = RpcCodec::decode(buf, &msg)) > 0)
+    {
+        if (msg.type != kRpcRequest)
+        {
+            ret = -1;
+            break;
+        }
+
+        auto it = methods_.find(msg.method);
+        if (it == methods_.end())
+        {
+            RpcCodec::encode(kRpcResponse, kRpcNoSuchMethod, msg.id, std::string(), std::string(), &session->pending);
+            ++session->pendingRequests;
+            continue;
+        }
+
+        uint64_t id = msg.id;
+        it->second(conn, msg.payload, [weakConn, id, receiveTime](int status, const std::string& response) {
+            sendResponse(weakConn, id, status, response, receiveTime);
+        });
+    }
+    session->dispatching = false;
+
+    if (!session->pending.empty())
+    {
+        std::string out;
+        out.swap(session->pending);
+        conn->send(out);
+        for (; session->pendingRequests > 0; --session->pendingRequests)
+        {
+            conn->markResponse(receiveTime);
+        }
+    }
+    if (ret < 0)
+    {
+        LOG_ERROR("%s %s %d bad rpc message from %s\n", __FILENAME__, __FUNCTION__, __LINE__, conn->name().c_str());
+        conn->shutdown();
+    }
+}
+
+void RpcServer::sendResponse(const std::weak_ptr<TcpConnection>& weakConn, uint64_t id,
+    int status, const std::string& response, Timestamp receiveTime)
+{
+    TcpConnectionPtr conn(weakConn.lock());
+    if (!conn)
+    {
+        return;
+    }
+
+    //在onMessage里同步完成的响应合并到一次发送中
+    if (conn->getLoop()->isInLoopThread())
+    {
+        RpcSession* session = static_cast<RpcSession*>(conn->getContext().get());
+        if (session != nullptr && session->dispatching)
+        {
+            RpcCodec::encode(kRpcResponse, status, id, std::string(), response, &session->pending);
+            ++session->pendingRequests;
+            return;
+        }
+    }
+
+    std::string out;
+    RpcCodec::encode(kRpcResponse, status, id, std::string(), response, &out);
+    conn->send(out);
+    conn->markResponse(receiveTime);
+}
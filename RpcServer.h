@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <functional>
+
+#include "noncopyable.h"
+#include "TcpServer.h"
+#include "RpcCodec.h"
+
+/**
+ * RPC服务端，请求按id区分，一个连接上可以同时处理多个请求
+ * 方法的处理函数拿到done回调后可以立即完成，也可以把done交给其他线程稍后完成，响应按完成顺序返回
+*/
+class RpcServer:noncopyable
+{
+public:
+    using RpcMethod = std::function<void(const TcpConnectionPtr&, const std::string& request, const RpcDoneCallback& done)>;
+
+    RpcServer(EventLoop* loop, const InetAddress& listenAddr, const std::string& name);
+
+    void setThreadNum(int numThreads) { server_.setThreadNum(numThreads); }
+    //必须在start之前注册
+    void registerMethod(const std::string& name, RpcMethod method);
+    void start();
+    //请求从收到到响应写完的延迟，见TcpServer::requestLatency
+    TcpServer* server() { return &server_; }
+private:
+    void onConnection(const TcpConnectionPtr& conn);
+    void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp receiveTime);
+    //done被调用时回到这里，把响应写回请求所在的连接，并标记请求的延迟
+    static void sendResponse(const std::weak_ptr<TcpConnection>& weakConn, uint64_t id,
+        int status, const std::string& response, Timestamp receiveTime);
+
+    TcpServer server_;
+    std::unordered_map<std::string, RpcMethod> methods_;
+};
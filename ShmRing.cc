@@ -0,0 +1,149 @@
+#include <string.h>
+#include <new>
+
+#include "ShmRing.h"
+#include "Buffer.h"
+
+//跨进程使用的原子变量必须是无锁的，否则锁在各自的进程里
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2, "shared memory atomics must be lock free");
+
+//head和tail分别独占一个cache line，避免生产者和消费者互相伪共享
+struct ShmRing::Header
+{
+    alignas(64) std::atomic<uint64_t> head;//生产者写入的总字节数
+    alignas(64) std::atomic<uint64_t> tail;//消费者读取的总字节数
+    alignas(64) std::atomic<uint32_t> readerWaiting;
+    std::atomic<uint32_t> writerWaiting;
+    uint64_t capacity;//只用于调试，attach时不信任这个值
+};
+
+size_t ShmRing::mappedSize(size_t capacity)
+{
+    return sizeof(Header) + capacity;
+}
+
+void ShmRing::initialize(void* base, size_t capacity)
+{
+    Header* header = new (base) Header;
+    header->head.store(0, std::memory_order_relaxed);
+    header->tail.store(0, std::memory_order_relaxed);
+    //初始时消费者还没开始读，认为它在等待，第一次写入一定会通知
+    header->readerWaiting.store(1, std::memory_order_relaxed);
+    header->writerWaiting.store(0, std::memory_order_relaxed);
+    header->capacity = capacity;
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+ShmRing::ShmRing(void* base, size_t capacity)
+    :header_(static_cast<Header*>(base)),
+    data_(static_cast<char*>(base) + sizeof(Header)),
+    capacity_(capacity)
+{
+}
+
+size_t ShmRing::readableBytes() const
+{
+    size_t n;
+    if (!used(header_->head.load(std::memory_order_acquire), header_->tail.load(std::memory_order_relaxed), &n))
+    {
+        return capacity_;
+    }
+    return n;
+}
+
+size_t ShmRing::writableBytes() const
+{
+    size_t n;
+    if (!used(header_->head.load(std::memory_order_relaxed), header_->tail.load(std::memory_order_acquire), &n))
+    {
+        return capacity_;
+    }
+    return capacity_ - n;
+}
+
+ssize_t ShmRing::write(const void* data, size_t len)
+{
+    uint64_t head = header_->head.load(std::memory_order_relaxed);
+    uint64_t tail = header_->tail.load(std::memory_order_acquire);
+    size_t usedBytes;
+    if (!used(head, tail, &usedBytes))
+    {
+        return -1;
+    }
+    size_t n = std::min(len, capacity_ - usedBytes);
+    if (n == 0)
+    {
+        return 0;
+    }
+
+    size_t offset = head & (capacity_ - 1);
+    size_t first = std::min(n, capacity_ - offset);
+    memcpy(data_ + offset, data, first);
+    memcpy(data_, static_cast<const char*>(data) + first, n - first);
+    header_->head.store(head + n, std::memory_order_release);
+    return static_cast<ssize_t>(n);
+}
+
+/**
+ * 和waitReadable配对的Dekker式检查：一边先写head再读readerWaiting，另一边先写readerWaiting再读head
+ * 两边中间都有seq_cst栅栏，所以至少有一方能看到对方的写入，通知不会丢
+*/
+bool ShmRing::takeReaderWaiting()
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return header_->readerWaiting.load(std::memory_order_relaxed) != 0
+        && header_->readerWaiting.exchange(0, std::memory_order_acq_rel) != 0;
+}
+
+size_t ShmRing::waitWritable()
+{
+    header_->writerWaiting.store(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    size_t writable = writableBytes();
+    if (writable > 0)
+    {
+        header_->writerWaiting.store(0, std::memory_order_relaxed);
+    }
+    return writable;
+}
+
+ssize_t ShmRing::read(Buffer* buf)
+{
+    uint64_t tail = header_->tail.load(std::memory_order_relaxed);
+    uint64_t head = header_->head.load(std::memory_order_acquire);
+    size_t n;
+    if (!used(head, tail, &n))
+    {
+        return -1;
+    }
+    if (n == 0)
+    {
+        return 0;
+    }
+
+    size_t offset = tail & (capacity_ - 1);
+    size_t first = std::min(n, capacity_ - offset);
+    buf->append(data_ + offset, first);
+    buf->append(data_, n - first);
+    header_->tail.store(head, std::memory_order_release);
+    return static_cast<ssize_t>(n);
+}
+
+bool ShmRing::takeWriterWaiting()
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return header_->writerWaiting.load(std::memory_order_relaxed) != 0
+        && header_->writerWaiting.exchange(0, std::memory_order_acq_rel) != 0;
+}
+
+size_t ShmRing::waitReadable()
+{
+    header_->readerWaiting.store(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    size_t readable = readableBytes();
+    if (readable > 0)
+    {
+        header_->readerWaiting.store(0, std::memory_order_relaxed);
+    }
+    return readable;
+}
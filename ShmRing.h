@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <atomic>
+
+#include "noncopyable.h"
+
+class Buffer;
+
+/**
+ * 放在共享内存里的单生产者单消费者字节环，两个进程各自mmap同一块内存后通过它传递字节流
+ * head/tail只增不减，分别只由生产者/消费者写，彼此通过acquire/release同步，收发数据本身不需要系统调用
+ * 通知由调用方负责：消费者读空以后登记readerWaiting，生产者写入后发现有人在等才去写eventfd；
+ * 生产者写满以后登记writerWaiting，消费者腾出空间后发现有人在等才去通知，两边忙的时候都不会产生系统调用
+ * 共享内存里的所有字段对端都能改写，容量由attach的一方自己给出，head/tail不一致(已用字节数超过容量)时按协议错误处理
+*/
+class ShmRing:noncopyable
+{
+public:
+    //capacity必须是2的幂
+    static size_t mappedSize(size_t capacity);
+    //在base处初始化一个空环，只由创建共享内存的一方调用一次
+    static void initialize(void* base, size_t capacity);
+
+    //attach到已经初始化好的环，capacity是本方校验过的大小，不读共享内存里的值
+    ShmRing(void* base, size_t capacity);
+
+    size_t capacity() const { return capacity_; }
+    //环被对端破坏时两者都返回capacity，让调用方接着read/write时发现错误
+    size_t readableBytes() const;
+    size_t writableBytes() const;
+
+    //生产者：写入尽可能多的数据，返回实际写入的字节数，环被对端破坏时返回-1
+    ssize_t write(const void* data, size_t len);
+    //生产者：写入以后调用，返回true表示消费者在等待，需要通知它
+    bool takeReaderWaiting();
+    //生产者：环满时登记等待，返回登记之后的可写字节数，不为0说明不用等了
+    size_t waitWritable();
+
+    //消费者：把环中的数据全部追加到buf，返回读取的字节数，环被对端破坏时返回-1
+    ssize_t read(Buffer* buf);
+    //消费者：读取以后调用，返回true表示生产者在等空间，需要通知它
+    bool takeWriterWaiting();
+    //消费者：读空时登记等待，返回登记之后的可读字节数，不为0说明不用等了
+    size_t waitReadable();
+private:
+    struct Header;
+
+    //已用字节数，head/tail不一致时返回false
+    bool used(uint64_t head, uint64_t tail, size_t* n) const
+    {
+        *n = static_cast<size_t>(head - tail);
+        return head - tail <= capacity_;
+    }
+
+    Header* header_;
+    char* data_;
+    size_t capacity_;
+};
@@ -0,0 +1,231 @@
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <strings.h>
+
+#include "ShmTransport.h"
+#include "TcpConnection.h"
+#include "InetAddress.h"
+#include "Socket.h"
+#include "Buffer.h"
+#include "Logger.h"
+
+namespace
+{
+
+const uint32_t kHandshakeMagic = 0x4b4d5348;//"KMSH"
+const uint32_t kHandshakeVersion = 1;
+const char kHandshakeAck = 'A';
+
+//握手消息，后面跟着memfd、客户端eventfd、服务端eventfd三个fd
+struct Handshake
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t ringSize;
+};
+static_assert(sizeof(Handshake) == ShmTransport::kHandshakeSize, "handshake size mismatch");
+
+bool isPowerOfTwo(size_t n)
+{
+    return n != 0 && (n & (n - 1)) == 0;
+}
+
+const int kRequiredSeals = F_SEAL_SHRINK | F_SEAL_GROW;
+
+}
+
+ShmTransport::ShmTransport(EventLoop* loop, int memfd, void* base, size_t mapped, size_t ringSize,
+    bool client, int selfFd, int peerFd)
+    :memfd_(memfd),
+    base_(base),
+    mapped_(mapped),
+    selfFd_(selfFd),
+    peerFd_(peerFd),
+    //第一个环是客户端到服务端方向，第二个环是服务端到客户端方向
+    out_(static_cast<char*>(base) + (client ? 0 : ShmRing::mappedSize(ringSize)), ringSize),
+    in_(static_cast<char*>(base) + (client ? ShmRing::mappedSize(ringSize) : 0), ringSize),
+    channel_(loop, selfFd)
+{
+}
+
+ShmTransport::~ShmTransport()
+{
+    ::munmap(base_, mapped_);
+    ::close(memfd_);
+    ::close(selfFd_);
+    ::close(peerFd_);
+}
+
+TcpConnectionPtr ShmTransport::connect(EventLoop* loop, const InetAddress& serverAddr,
+    const std::string& name, size_t ringSize)
+{
+    if (!serverAddr.isUnix() || !isPowerOfTwo(ringSize) || ringSize > kMaxRingSize)
+    {
+        LOG_ERROR("%s %s %d %s needs a unix address and a power of two ring size\n", __FILENAME__, __FUNCTION__, __LINE__, name.c_str());
+        return TcpConnectionPtr();
+    }
+
+    int sockfd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (sockfd < 0 || ::connect(sockfd, serverAddr.getSockAddr(), serverAddr.getSockAddrLen()) < 0)
+    {
+        LOG_ERROR("%s %s %d connect %s error:%d\n", __FILENAME__, __FUNCTION__, __LINE__, serverAddr.toIpPort().c_str(), errno);
+        if (sockfd >= 0)
+        {
+            ::close(sockfd);
+        }
+        return TcpConnectionPtr();
+    }
+    size_t mapped = 2 * ShmRing::mappedSize(ringSize);
+    int memfd = ::memfd_create("kenmuduo-shm", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (memfd < 0 || ::ftruncate(memfd, mapped) < 0 || ::fcntl(memfd, F_ADD_SEALS, kRequiredSeals | F_SEAL_SEAL) < 0)
+    {
+        LOG_ERROR("%s %s %d memfd error:%d\n", __FILENAME__, __FUNCTION__, __LINE__, errno);
+        if (memfd >= 0)
+        {
+            ::close(memfd);
+        }
+        ::close(sockfd);
+        return TcpConnectionPtr();
+    }
+    void* base = ::mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+    if (base == MAP_FAILED)
+    {
+        LOG_ERROR("%s %s %d mmap error:%d\n", __FILENAME__, __FUNCTION__, __LINE__, errno);
+        ::close(memfd);
+        ::close(sockfd);
+        return TcpConnectionPtr();
+    }
+    ShmRing::initialize(base, ringSize);
+    ShmRing::initialize(static_cast<char*>(base) + ShmRing::mappedSize(ringSize), ringSize);
+
+    int clientFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    int serverFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    std::unique_ptr<ShmTransport> transport(new ShmTransport(loop, memfd, base, mapped, ringSize, true, clientFd, serverFd));
+    if (clientFd < 0 || serverFd < 0)
+    {
+        LOG_ERROR("%s %s %d eventfd error:%d\n", __FILENAME__, __FUNCTION__, __LINE__, errno);
+        ::close(sockfd);
+        return TcpConnectionPtr();
+    }
+
+    Handshake hs;
+    hs.magic = kHandshakeMagic;
+    hs.version = kHandshakeVersion;
+    hs.ringSize = ringSize;
+    int fds[3] = {memfd, clientFd, serverFd};
+    char ack = 0;
+    //握手是阻塞的，收到服务端的确认说明它已经接管了共享内存，服务端一直不确认时超时失败
+    struct pollfd pfd;
+    pfd.fd = sockfd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    if (!Socket::sendFds(sockfd, &hs, sizeof(hs), fds, 3) || ::poll(&pfd, 1, kHandshakeTimeoutMs) != 1
+        || ::read(sockfd, &ack, 1) != 1 || ack != kHandshakeAck)
+    {
+        LOG_ERROR("%s %s %d %s shared memory handshake failed\n", __FILENAME__, __FUNCTION__, __LINE__, serverAddr.toIpPort().c_str());
+        ::close(sockfd);
+        return TcpConnectionPtr();
+    }
+    ::fcntl(sockfd, F_SETFL, ::fcntl(sockfd, F_GETFL) | O_NONBLOCK);
+
+    sockaddr_storage local;
+    bzero(&local, sizeof(local));
+    socklen_t addrlen = sizeof(local);
+    ::getsockname(sockfd, (sockaddr*)&local, &addrlen);
+    InetAddress localAddr;
+    localAddr.setSockAddr((sockaddr*)&local, addrlen);
+
+    TcpConnectionPtr conn(new TcpConnection(loop, name, sockfd, localAddr, serverAddr));
+    conn->setShmTransport(std::move(transport));
+    return conn;
+}
+
+std::unique_ptr<ShmTransport> ShmTransport::accept(EventLoop* loop, int sockfd, const char* handshake, size_t len,
+    const int* fds, int nfds)
+{
+    Handshake hs;
+    bool valid = len == sizeof(hs) && nfds == 3;
+    if (valid)
+    {
+        memcpy(&hs, handshake, sizeof(hs));
+        valid = hs.magic == kHandshakeMagic && hs.version == kHandshakeVersion && isPowerOfTwo(hs.ringSize)
+            && hs.ringSize <= kMaxRingSize;
+    }
+    //没有封住大小的memfd可以被对端截断，访问被截掉的页会收到SIGBUS
+    int seals = valid ? ::fcntl(fds[0], F_GET_SEALS) : 0;
+    if (valid && (seals < 0 || (seals & kRequiredSeals) != kRequiredSeals))
+    {
+        LOG_ERROR("%s %s %d shared memory is not sealed against resizing\n", __FILENAME__, __FUNCTION__, __LINE__);
+        valid = false;
+    }
+
+    size_t mapped = valid ? 2 * ShmRing::mappedSize(hs.ringSize) : 0;
+    struct stat st;
+    void* base = MAP_FAILED;
+    if (valid && ::fstat(fds[0], &st) == 0 && static_cast<size_t>(st.st_size) >= mapped)
+    {
+        base = ::mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0);
+    }
+    if (base == MAP_FAILED || ::write(sockfd, &kHandshakeAck, 1) != 1)
+    {
+        if (base != MAP_FAILED)
+        {
+            ::munmap(base, mapped);
+        }
+        for (int i = 0; i < nfds; ++i)
+        {
+            ::close(fds[i]);
+        }
+        return std::unique_ptr<ShmTransport>();
+    }
+    return std::unique_ptr<ShmTransport>(new ShmTransport(loop, fds[0], base, mapped, hs.ringSize, false, fds[2], fds[1]));
+}
+
+ssize_t ShmTransport::send(const void* data, size_t len)
+{
+    ssize_t n = out_.write(data, len);
+    if (n > 0 && out_.takeReaderWaiting())
+    {
+        notifyPeer();
+    }
+    return n;
+}
+
+ssize_t ShmTransport::receive(Buffer* buf)
+{
+    ssize_t n = in_.read(buf);
+    if (n > 0 && in_.takeWriterWaiting())
+    {
+        notifyPeer();
+    }
+    return n;
+}
+
+void ShmTransport::clearNotification()
+{
+    uint64_t count = 0;
+    ::read(selfFd_, &count, sizeof(count));
+}
+
+void ShmTransport::notifySelf()
+{
+    uint64_t one = 1;
+    ::write(selfFd_, &one, sizeof(one));
+}
+
+void ShmTransport::notifyPeer()
+{
+    uint64_t one = 1;
+    ssize_t n = ::write(peerFd_, &one, sizeof(one));
+    if (n != sizeof(one))
+    {
+        LOG_ERROR("%s %s %d writes %ld bytes instead of 8\n", __FILENAME__, __FUNCTION__, __LINE__, n);
+    }
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <memory>
+#include <string>
+
+#include "noncopyable.h"
+#include "ShmRing.h"
+#include "Channel.h"
+#include "Callbacks.h"
+
+class EventLoop;
+class InetAddress;
+class Buffer;
+
+/**
+ * 同一台机器上两个进程之间的共享内存传输，挂在一条Unix域TcpConnection上使用
+ * 客户端创建memfd(里面是两个方向的ShmRing)和双方的eventfd，连接建立后通过SCM_RIGHTS把它们交给服务端
+ * 之后数据只走共享内存，Unix域socket只用来发现对端关闭；对用户来说仍然是同一个TcpConnection，
+ * MessageCallback、send、shutdown的用法都不变
+ * 只有对端空闲(登记了等待)时才写eventfd唤醒它，对端正忙时收发都不需要系统调用
+ * memfd由客户端创建并封住大小(F_SEAL_SHRINK|F_SEAL_GROW)，服务端检查封印，对端不能再截断共享内存让我们收到SIGBUS
+*/
+class ShmTransport:noncopyable
+{
+public:
+    static const size_t kDefaultRingSize = 1024 * 1024;
+    //握手消息的长度，服务端第一次读取时用它判断对方是不是共享内存客户端
+    static const size_t kHandshakeSize = 16;
+    static const size_t kMaxRingSize = 1024 * 1024 * 1024;
+    //客户端等待服务端确认握手的毫秒数
+    static const int kHandshakeTimeoutMs = 3000;
+
+    ~ShmTransport();
+
+    /**
+     * 客户端：连接serverAddr(必须是Unix域地址)并完成握手，失败返回nullptr
+     * 返回的连接还没有建立，调用方设置好回调以后在loop线程中调用connectEstablished，
+     * closeCallback里需要在loop中调用connectionDestroyed
+    */
+    static TcpConnectionPtr connect(EventLoop* loop, const InetAddress& serverAddr,
+        const std::string& name, size_t ringSize = kDefaultRingSize);
+
+    //服务端：用在sockfd上收到的握手消息和fd建立传输并回复确认，不是合法的握手返回nullptr，fd的所有权总是被转移
+    static std::unique_ptr<ShmTransport> accept(EventLoop* loop, int sockfd, const char* handshake, size_t len,
+        const int* fds, int nfds);
+
+    //监听自己的eventfd，对端写入数据或者腾出空间时可读
+    Channel* channel() { return &channel_; }
+
+    //写入发送方向的环，返回写入的字节数，对端在等待时通知它；环被对端破坏时返回-1，调用方应该关闭连接
+    ssize_t send(const void* data, size_t len);
+    //环满时登记等待，对端读走数据后会通知channel，返回登记后的可写字节数
+    size_t waitWritable() { return out_.waitWritable(); }
+
+    //把接收方向的数据读到buf，对端在等空间时通知它；环被对端破坏时返回-1，调用方应该关闭连接
+    ssize_t receive(Buffer* buf);
+    //读空时登记等待，返回登记后的可读字节数
+    size_t waitReadable() { return in_.waitReadable(); }
+
+    //清除自己eventfd上的计数
+    void clearNotification();
+    //让channel再触发一次，本轮处理不完的数据留给下一轮
+    void notifySelf();
+private:
+    ShmTransport(EventLoop* loop, int memfd, void* base, size_t mapped, size_t ringSize,
+        bool client, int selfFd, int peerFd);
+
+    void notifyPeer();
+
+    int memfd_;
+    void* base_;
+    size_t mapped_;
+    int selfFd_;//自己读的eventfd
+    int peerFd_;//对端读的eventfd
+    ShmRing out_;
+    ShmRing in_;
+    Channel channel_;
+};
@@ -3,6 +3,8 @@
 #include <sys/socket.h>
 #include <strings.h>
 #include <netinet/tcp.h>
+#include <string.h>
+#include <errno.h>
 
 #include "Socket.h"
 #include "Logger.h"
@@ -15,7 +17,7 @@ Socket::~Socket()
 
 void Socket::bindAddress(const InetAddress& localaddr)
 {
-    if (0 != ::bind(sockfd_, (sockaddr*)localaddr.getSocketAddr(), sizeof(sockaddr_in)))
+    if (0 != ::bind(sockfd_, localaddr.getSockAddr(), localaddr.getSockAddrLen()))
     {
         LOG_FATAL("%s %s %d bind socket fd %d failed.\n", __FILENAME__, __FUNCTION__, __LINE__, sockfd_);
     }
@@ -37,13 +39,14 @@ int Socket::accept(InetAddress* peerAddr)
      * 服务器为Reator模型 one loop one thread
      * 每个loop里面 poller + non-blocking IO
     */
-    struct sockaddr_in addr;
+    //sockaddr_storage能同时容纳IPv4和Unix域地址
+    struct sockaddr_storage addr;
     socklen_t len = sizeof(addr);
     bzero(&addr, sizeof(addr));
     int connfd = ::accept4(sockfd_, (sockaddr*)&addr, &len, SOCK_NONBLOCK|SOCK_CLOEXEC);
     if (connfd >= 0)
     {
-        peerAddr->setSocketAddr(addr);
+        peerAddr->setSockAddr((sockaddr*)&addr, len);
     }
     return connfd;
 }
@@ -78,4 +81,94 @@ void Socket::setKeepAlive(bool on)
 {
     int optval = on ? 1 : 0;
     ::setsockopt(sockfd_, SOL_SOCKET, SO_KEEPALIVE, &optval, sizeof(optval));
+}
+
+bool Socket::setBusyPoll(int usec)
+{
+    if (::setsockopt(sockfd_, SOL_SOCKET, SO_BUSY_POLL, &usec, sizeof(usec)) < 0)
+    {
+        LOG_ERROR("%s %s %d SO_BUSY_POLL fd %d error:%d\n", __FILENAME__, __FUNCTION__, __LINE__, sockfd_, errno);
+        return false;
+    }
+    return true;
+}
+
+//一次最多传递的fd个数
+static const int kMaxPassFds = 16;
+
+bool Socket::sendFds(int sockfd, const void* data, size_t len, const int* fds, int nfds)
+{
+    if (nfds <= 0 || nfds > kMaxPassFds || len == 0)
+    {
+        return false;
+    }
+    char control[CMSG_SPACE(sizeof(int) * kMaxPassFds)];
+    bzero(control, sizeof(control));
+    iovec iov;
+    iov.iov_base = const_cast<void*>(data);
+    iov.iov_len = len;
+    msghdr msg;
+    bzero(&msg, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * nfds);
+
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * nfds);
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * nfds);
+
+    ssize_t n = ::sendmsg(sockfd, &msg, MSG_NOSIGNAL);
+    if (n != static_cast<ssize_t>(len))
+    {
+        LOG_ERROR("%s %s %d sendmsg fd %d error:%d\n", __FILENAME__, __FUNCTION__, __LINE__, sockfd, errno);
+        return false;
+    }
+    return true;
+}
+
+ssize_t Socket::recvFds(int sockfd, void* data, size_t len, int* fds, int* nfds)
+{
+    char control[CMSG_SPACE(sizeof(int) * kMaxPassFds)];
+    iovec iov;
+    iov.iov_base = data;
+    iov.iov_len = len;
+    msghdr msg;
+    bzero(&msg, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    int capacity = *nfds;
+    *nfds = 0;
+    ssize_t n = ::recvmsg(sockfd, &msg, MSG_CMSG_CLOEXEC);
+    if (n < 0)
+    {
+        return n;
+    }
+    for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+        {
+            continue;
+        }
+        int count = static_cast<int>((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+        const int* received = reinterpret_cast<const int*>(CMSG_DATA(cmsg));
+        for (int i = 0; i < count; ++i)
+        {
+            //放不下的fd直接关掉，避免泄漏
+            if (*nfds < capacity)
+            {
+                fds[(*nfds)++] = received[i];
+            }
+            else
+            {
+                ::close(received[i]);
+            }
+        }
+    }
+    return n;
 }
\ No newline at end of file
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <sys/types.h>
+
 #include "noncopyable.h"
 
 class InetAddress;
@@ -22,6 +24,13 @@ public:
     void setReuseAddr(bool on);
     void setReusePort(bool on);
     void setKeepAlive(bool on);
+    //SO_BUSY_POLL，阻塞读或者poll时在驱动队列上忙等usec微秒，调大需要CAP_NET_ADMIN
+    bool setBusyPoll(int usec);
+
+    //通过Unix域socket用SCM_RIGHTS传递文件描述符，data至少1个字节
+    //发送成功返回true；接收返回读到的字节数，*nfds带入数组容量、带出收到的fd个数
+    static bool sendFds(int sockfd, const void* data, size_t len, const int* fds, int nfds);
+    static ssize_t recvFds(int sockfd, void* data, size_t len, int* fds, int* nfds);
 private:
     const int sockfd_;
 };
\ No newline at end of file
@@ -0,0 +1,115 @@
+#include <sys/socket.h>
+#include <strings.h>
+#include <stdio.h>
+
+#include "TcpClient.h"
+#include "Connector.h"
+#include "EventLoop.h"
+#include "TcpConnection.h"
+#include "Logger.h"
+
+static InetAddress localAddressOf(int sockfd)
+{
+    sockaddr_storage local;
+    bzero(&local, sizeof(local));
+    socklen_t addrlen = sizeof(local);
+    ::getsockname(sockfd, (sockaddr*)&local, &addrlen);
+    InetAddress addr;
+    addr.setSockAddr((sockaddr*)&local, addrlen);
+    return addr;
+}
+
+TcpClient::TcpClient(EventLoop* loop, const InetAddress& serverAddr, const std::string& nameArg)
+    :loop_(loop),
+    connector_(new Connector(loop, serverAddr)),
+    name_(nameArg),
+    retry_(false),
+    connect_(false),
+    nextConnId_(1)
+{
+    connector_->setNewConnectionCallback(std::bind(&TcpClient::newConnection, this, std::placeholders::_1));
+    LOG_INFO("%s %s %d TcpClient %s created for %s\n", __FILENAME__, __FUNCTION__, __LINE__, name_.c_str(),
+        serverAddr.toIpPort().c_str());
+}
+
+TcpClient::~TcpClient()
+{
+    TcpConnectionPtr conn;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        conn = connection_;
+    }
+    if (conn)
+    {
+        //连接可能比TcpClient活得更久，关闭回调里不能再访问this
+        loop_->runInLoop([conn]() {
+            conn->setCloseCallback([](const TcpConnectionPtr& c) {
+                c->getLoop()->queueInLoop(std::bind(&TcpConnection::connectionDestroyed, c));
+            });
+        });
+        conn->forceClose();
+    }
+    connector_->stop();
+}
+
+void TcpClient::connect()
+{
+    connect_ = true;
+    connector_->start();
+}
+
+void TcpClient::disconnect()
+{
+    connect_ = false;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (connection_)
+    {
+        connection_->shutdown();
+    }
+}
+
+void TcpClient::stop()
+{
+    connect_ = false;
+    connector_->stop();
+}
+
+void TcpClient::setRetryDelay(double initRetryDelay, double maxRetryDelay)
+{
+    connector_->setRetryDelay(initRetryDelay, maxRetryDelay);
+}
+
+void TcpClient::newConnection(int sockfd)
+{
+    InetAddress peerAddr = connector_->serverAddress();
+    char buf[64] = {0};
+    snprintf(buf, sizeof(buf), ":%s#%d", peerAddr.toIpPort().c_str(), nextConnId_);
+    ++nextConnId_;
+    std::string connName = name_ + buf;
+
+    TcpConnectionPtr conn(new TcpConnection(loop_, connName, sockfd, localAddressOf(sockfd), peerAddr));
+    conn->setConnectionCallback(connectionCallback_);
+    conn->setMessageCallback(messageCallback_);
+    conn->setWriteCompleteCallback(writeCompleteCallback_);
+    conn->setCloseCallback(std::bind(&TcpClient::removeConnection, this, std::placeholders::_1));
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        connection_ = conn;
+    }
+    conn->connectEstablished();
+}
+
+void TcpClient::removeConnection(const TcpConnectionPtr& conn)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        connection_.reset();
+    }
+    loop_->queueInLoop(std::bind(&TcpConnection::connectionDestroyed, conn));
+    if (retry_ && connect_)
+    {
+        LOG_INFO("%s %s %d %s reconnecting to %s\n", __FILENAME__, __FUNCTION__, __LINE__, name_.c_str(),
+            connector_->serverAddress().toIpPort().c_str());
+        connector_->restart();
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <memory>
+#include <atomic>
+
+#include "noncopyable.h"
+#include "InetAddress.h"
+#include "Callbacks.h"
+
+class EventLoop;
+class Connector;
+
+/**
+ * 对外的客户端编程使用的类，通过Connector非阻塞地连接服务端，连上以后和服务端一样用TcpConnection收发数据
+ * enableRetry以后连接断开会自动重连；connect/disconnect/stop可以跨线程调用，TcpClient在loop线程中析构
+*/
+class TcpClient : noncopyable
+{
+public:
+    TcpClient(EventLoop* loop, const InetAddress& serverAddr, const std::string& nameArg);
+    ~TcpClient();
+
+    void connect();
+    //关闭写端，数据发完以后断开
+    void disconnect();
+    //停止还没完成的连接尝试
+    void stop();
+
+    //可能为空，也可能已经断开
+    TcpConnectionPtr connection() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return connection_;
+    }
+
+    EventLoop* getLoop() const { return loop_; }
+    bool retry() const { return retry_; }
+    void enableRetry() { retry_ = true; }
+    //连接失败以后的重试间隔，见Connector::setRetryDelay
+    void setRetryDelay(double initRetryDelay, double maxRetryDelay);
+    const std::string& name() const { return name_; }
+
+    void setConnectionCallback(const ConnectionCallback& cb) { connectionCallback_ = cb; }
+    void setMessageCallback(const MessageCallback& cb) { messageCallback_ = cb; }
+    void setWriteCompleteCallback(const WriteCompleteCallback& cb) { writeCompleteCallback_ = cb; }
+private:
+    //在loop线程中执行
+    void newConnection(int sockfd);
+    void removeConnection(const TcpConnectionPtr& conn);
+
+    EventLoop* loop_;
+    std::shared_ptr<Connector> connector_;
+    const std::string name_;
+    ConnectionCallback connectionCallback_;
+    MessageCallback messageCallback_;
+    WriteCompleteCallback writeCompleteCallback_;
+    std::atomic_bool retry_;
+    std::atomic_bool connect_;
+    int nextConnId_;//只在loop线程中访问
+    mutable std::mutex mutex_;
+    TcpConnectionPtr connection_;
+};
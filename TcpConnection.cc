@@ -4,13 +4,22 @@
 #include <sys/socket.h>
 #include <strings.h>
 #include <netinet/tcp.h>
+#include <sys/uio.h>
 #include <sys/socket.h>
+#include <limits>
 
 #include "TcpConnection.h"
 #include "Logger.h"
 #include "Socket.h"
 #include "Channel.h"
 #include "EventLoop.h"
+#include "ShmTransport.h"
+#include "TrafficShaper.h"
+#include "ZeroCopy.h"
+#include "TcpRelay.h"
+
+//共享内存上连续处理的轮数，超过以后让出loop，剩下的数据下一轮再处理
+static const int kMaxShmRounds = 16;
 
 static EventLoop* CheckLoopNotNull(EventLoop* loop)
 {
@@ -31,15 +40,27 @@ TcpConnection::TcpConnection(EventLoop* loop, const std::string& name, int sockf
     channel_(new Channel(loop, sockfd)),
     localAddr_(localAddr),
     peerAddr_(peerAdder),
-    highWaterMark_(64*1024*1024)
+    handler_(nullptr),
+    highWaterMark_(64*1024*1024),
+    shmHandshakePending_(false),
+    shmFailed_(false),
+    readThrottled_(false),
+    writeThrottled_(false),
+    zeroCopyThreshold_(0),
+    segmentPayloadBytes_(0)
 {
+    //默认转调std::function回调
+    setConnectionCallback(ConnectionCallback());
+    setMessageCallback(MessageCallback());
     //下面给Channel设置相应的回调函数，poller给channel通知感兴趣的事件，channel会回调相应的操作函数
-    channel_->setReadCallback(std::bind(&TcpConnection::handleRead, this, std::placeholders::_1));
-    channel_->setWriteCallback(std::bind(&TcpConnection::handleWrite, this));
-    channel_->setCloseCallback(std::bind(&TcpConnection::handleClose, this));
-    channel_->setErrorCallback(std::bind(&TcpConnection::handleError, this));
+    channel_->setHandler(this);
+    channel_->setOwnerName(&name_);
     LOG_INFO("%s %s %d TcpConnection::ctor[%s] at fd %d\n", __FILENAME__, __FUNCTION__, __LINE__, name.c_str(), sockfd);
-    socket_->setKeepAlive(true);
+    //Unix域socket没有keepalive
+    if (!localAddr.isUnix())
+    {
+        socket_->setKeepAlive(true);
+    }
 }
 
 TcpConnection::~TcpConnection()
@@ -49,15 +70,49 @@ TcpConnection::~TcpConnection()
 
 void TcpConnection::handleRead(Timestamp receiveTime)
 {
+    if (relay_)
+    {
+        //relay可能在处理过程中结束，先持有一份引用
+        std::shared_ptr<TcpRelay> relay(relay_);
+        relay->handleRead(this);
+        return;
+    }
+    //同一轮poll返回的事件里，前面的回调已经stopRead，这时读出来的数据不会再被处理
+    if (!reading_ || readThrottled_)
+    {
+        return;
+    }
+    if (shmHandshakePending_)
+    {
+        handleShmHandshake(receiveTime);
+        return;
+    }
+
     int saveErrno = 0;
     ssize_t n = inputBuffer_.readFd(channel_->fd(), &saveErrno);
+    ++stats_.readCalls;
     if (n > 0)
     {
+        stats_.bytesIn += n;
+        ++stats_.messagesIn;
+        if (shaper_ && shaper_->readLimited())
+        {
+            double wait = shaper_->consumeRead(n, receiveTime);
+            if (wait > 0)
+            {
+                throttleRead(wait);
+            }
+        }
         //已建立连接的用户，有可读事件发生，调用用户传入的回调操作
-        messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+        messageFn_(this, self_, &inputBuffer_, receiveTime);
     }
     else if (n == 0)
     {
+        //对端关闭socket之前写进共享内存的数据要先交给用户
+        if (shm_)
+        {
+            handleShmEvent(receiveTime);
+        }
         handleClose();
     }
     else
@@ -68,22 +123,210 @@ void TcpConnection::handleRead(Timestamp receiveTime)
     }
 }
 
+/**
+ * 服务端收到的第一段数据：带着3个fd的握手消息说明对方是共享内存客户端，否则按普通连接处理，
+ * 读到的数据放进inputBuffer_交给用户，所以同一个监听地址可以同时服务两种客户端
+*/
+void TcpConnection::handleShmHandshake(Timestamp receiveTime)
+{
+    char handshake[ShmTransport::kHandshakeSize];
+    int fds[4];
+    int nfds = 4;
+    ssize_t n = Socket::recvFds(channel_->fd(), handshake, sizeof(handshake), fds, &nfds);
+    if (n < 0)
+    {
+        if (errno != EAGAIN)
+        {
+            handleError();
+        }
+        return;
+    }
+
+    shmHandshakePending_ = false;
+    if (n == 0)
+    {
+        handleClose();
+        return;
+    }
+    shm_ = ShmTransport::accept(loop_, channel_->fd(), handshake, n, fds, nfds);
+    if (!shm_ && nfds > 0)
+    {
+        LOG_ERROR("%s %s %d %s bad shared memory handshake\n", __FILENAME__, __FUNCTION__, __LINE__, name_.c_str());
+        handleClose();
+        return;
+    }
+    if (!shm_)
+    {
+        inputBuffer_.append(handshake, n);
+    }
+
+    setState(kConnected);
+    if (shm_)
+    {
+        startShm();
+    }
+    connectionFn_(this, self_);
+    if (inputBuffer_.readableBytes() > 0)
+    {
+        messageFn_(this, self_, &inputBuffer_, receiveTime);
+    }
+}
+
+bool TcpConnection::shmActive() const
+{
+    return state_ != kDisconnected && shm_->channel()->isReading();
+}
+
+void TcpConnection::handleShmEvent(Timestamp receiveTime)
+{
+    //handleClose以后连接关闭回调已经执行过，同一轮里排在后面的通知不能再交给messageCallback
+    if (!shmActive())
+    {
+        return;
+    }
+    shm_->clearNotification();
+    if (outputBuffer_.readableBytes() > 0)
+    {
+        flushShmOutput();
+    }
+
+    for (int round = 0; round < kMaxShmRounds; ++round)
+    {
+        if (!shmActive())
+        {
+            return;//messageCallback里关闭了连接
+        }
+        ssize_t n = shm_->receive(&inputBuffer_);
+        if (n < 0)
+        {
+            shmProtocolError();
+            return;
+        }
+        if (n == 0)
+        {
+            //登记等待以后再检查一次，这期间写入的数据不会收到通知
+            if (shm_->waitReadable() == 0)
+            {
+                return;
+            }
+            continue;
+        }
+        stats_.bytesIn += n;
+        ++stats_.messagesIn;
+        messageFn_(this, self_, &inputBuffer_, receiveTime);
+    }
+    //对端一直在写，剩下的留到下一轮，不饿死同一个loop上的其他连接
+    shm_->notifySelf();
+}
+
+void TcpConnection::flushShmOutput()
+{
+    while (outputBuffer_.readableBytes() > 0)
+    {
+        ssize_t n = shm_->send(outputBuffer_.peek(), outputBuffer_.readableBytes());
+        if (n < 0)
+        {
+            shmProtocolError();
+            return;
+        }
+        outputBuffer_.retrieve(n);
+        stats_.bytesOut += n;
+        completeResponses();
+        if (n == 0 && shm_->waitWritable() == 0)
+        {
+            return;//对端读走数据以后会通知eventfd
+        }
+    }
+    outputDrained();
+
+    if (writeCompleteCallback_)
+    {
+        loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+    }
+    if (state_ == kDisconnecting)
+    {
+        shutdownInLoop();
+    }
+}
+
+//对端破坏了共享内存环的状态，不再收发，按对端关闭处理
+void TcpConnection::shmProtocolError()
+{
+    if (shmFailed_)
+    {
+        return;
+    }
+    shmFailed_ = true;
+    LOG_ERROR("%s %s %d %s shared memory ring corrupted by peer, closing\n", __FILENAME__, __FUNCTION__, __LINE__, name_.c_str());
+    forceClose();
+}
+
+void TcpConnection::setShmTransport(std::unique_ptr<ShmTransport> transport)
+{
+    shm_ = std::move(transport);
+}
+
+void TcpConnection::startShm()
+{
+    shm_->channel()->setReadHandler<TcpConnection, &TcpConnection::handleShmEvent>(this);
+    shm_->channel()->enableReading();
+}
+
 void TcpConnection::handleWrite()
+{
+    if (relay_)
+    {
+        std::shared_ptr<TcpRelay> relay(relay_);
+        relay->handleWrite(this);
+        return;
+    }
+    writeOutput();
+}
+
+void TcpConnection::writeOutput()
 {
     if (channel_->isWriting())
     {
+        if (!segments_.empty())
+        {
+            handleSegmentedWrite();
+            return;
+        }
+        size_t maxBytes = outputBuffer_.readableBytes();
+        bool limited = shaper_ && shaper_->writeLimited();
+        Timestamp now;
+        if (limited)
+        {
+            //组里的其他连接可能已经用完了额度
+            now = Timestamp::now();
+            maxBytes = std::min(maxBytes, shaper_->writeAllowance(now));
+            if (maxBytes == 0)
+            {
+                throttleWrite(shaper_->writeWait(now));
+                return;
+            }
+        }
         int saveErrno = 0;
-        ssize_t n = outputBuffer_.writeFd(channel_->fd(), &saveErrno);
+        ssize_t n = outputBuffer_.writeFd(channel_->fd(), &saveErrno, maxBytes);
+        ++stats_.writeCalls;
         if (n > 0)
         {
             outputBuffer_.retrieve(n);
-            if (outputBuffer_.readableBytes() == 0)
+            stats_.bytesOut += n;
+            completeResponses();
+            double wait = limited ? shaper_->consumeWrite(n, now) : 0;
+            if (outputBuffer_.readableBytes() > 0 && wait > 0)
+            {
+                throttleWrite(wait);
+            }
+            else if (outputBuffer_.readableBytes() == 0)
             {
                 channel_->disableWriting();
+                outputDrained();
                 if (writeCompleteCallback_)
                 {
                     //loop对应的thread线程，执行回调
-                    loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+                    loop_->queueInLoop(std::bind(writeCompleteCallback_, self_));
                 }
                 if (state_ == kDisconnecting)
                 {
@@ -106,16 +349,39 @@ void TcpConnection::handleWrite()
 void TcpConnection::handleClose()
 {
     LOG_INFO("%s %s %d fd %d state %d\n", __FILENAME__, __FUNCTION__, __LINE__, channel_->fd(), (int)state_);
+    //还在握手的连接没有通知过用户，关闭时也不通知
+    bool announced = state_ != kConnecting;
     setState(kDisconnecting);
-    channel_->disableWriting();
+    //还没到期的限速定时器到期后什么都不做
+    readThrottled_ = false;
+    writeThrottled_ = false;
+    //没发完的数据不会再发了，待发送时间算到这里为止
+    outputDrained();
+    responseMarks_.clear();
+    //不再关注任何事件，否则对端关闭以后在connectionDestroyed之前每次poll都会重复报告可读
+    channel_->disableAll();
+    if (shm_)
+    {
+        shm_->channel()->disableAll();
+    }
+    if (relay_)
+    {
+        std::shared_ptr<TcpRelay> relay;
+        relay.swap(relay_);
+        relay->handleClose(this);
+    }
 
     TcpConnectionPtr connPtr(shared_from_this());
-    connectionCallback_(connPtr);//执行连接关闭的回调
+    if (announced)
+    {
+        connectionFn_(this, connPtr);//执行连接关闭的回调
+    }
     closeCallback_(connPtr);//关闭连接的回调,这里执行的TcpServer::removeConncection回调方法
 }
 
 void TcpConnection::handleError()
 {
+    //SO_ERROR读一次就被清零，只能取一次
     int optval;
     socklen_t optlen = sizeof(optval);
     int err = 0;
@@ -127,6 +393,11 @@ void TcpConnection::handleError()
     {
         err = optval;
     }
+    //zerocopy的完成通知也以EPOLLERR的形式到达，这时socket上没有真正的错误
+    if (zeroCopy_ && zeroCopy_->drainCompletions(channel_->fd()) && err == 0)
+    {
+        return;
+    }
     LOG_ERROR("%s %s %d TcpConnection handle Error, name %s SO_ERROR %d\n", __FILENAME__, __FUNCTION__, __LINE__, name_.c_str(), err);
 }
 
@@ -140,11 +411,49 @@ void TcpConnection::send(const std::string& buf)
         }
         else
         {
-            loop_->runInLoop(std::bind(&TcpConnection::sendInLoop, this, buf.c_str(), buf.size()));
+            //跨线程发送时必须拷贝一份数据，调用方的buf在回调执行时可能已经释放
+            void (TcpConnection::*fp)(const std::string&) = &TcpConnection::sendInLoop;
+            loop_->runInLoop(std::bind(fp, shared_from_this(), buf));
+        }
+    }
+}
+
+void TcpConnection::send(const void* data, size_t len)
+{
+    if (state_ == kConnected)
+    {
+        if (loop_->isInLoopThread())
+        {
+            sendInLoop(data, len);
+        }
+        else
+        {
+            void (TcpConnection::*fp)(const std::string&) = &TcpConnection::sendInLoop;
+            loop_->runInLoop(std::bind(fp, shared_from_this(), std::string(static_cast<const char*>(data), len)));
         }
     }
 }
 
+void TcpConnection::send(const SharedPayload& payload)
+{
+    if (state_ == kConnected)
+    {
+        if (loop_->isInLoopThread())
+        {
+            sendPayloadInLoop(payload);
+        }
+        else
+        {
+            loop_->runInLoop(std::bind(&TcpConnection::sendPayloadInLoop, shared_from_this(), payload));
+        }
+    }
+}
+
+void TcpConnection::sendInLoop(const std::string& message)
+{
+    sendInLoop(message.data(), message.size());
+}
+
 /**
  * 发送数据，应用写的快，而内核发送数据慢，需要把待发送数据写入缓冲区，而且设置的水位回调
 */
@@ -161,13 +470,40 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
         return ;
     }
     
+    ++stats_.messagesOut;
+    bool limited = shaper_ && !shm_ && shaper_->writeLimited();
     //表示channel第一次开始写数据，而且缓冲区没有待发送的数据
-    if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0)
+    if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0 && segments_.empty())
     {
-        nwrote = ::write(channel_->fd(), data, len);
+        size_t allowed = len;
+        Timestamp now;
+        if (limited)
+        {
+            now = Timestamp::now();
+            allowed = std::min(len, shaper_->writeAllowance(now));
+        }
+        if (shm_)
+        {
+            nwrote = shm_->send(data, len);
+            if (nwrote < 0)
+            {
+                shmProtocolError();
+                return;
+            }
+        }
+        else if (allowed > 0)
+        {
+            nwrote = ::write(channel_->fd(), data, allowed);
+            ++stats_.writeCalls;
+        }
         if (nwrote >= 0)
         {
-            remaining = len = nwrote;
+            stats_.bytesOut += nwrote;
+            if (limited && nwrote > 0)
+            {
+                shaper_->consumeWrite(nwrote, now);
+            }
+            remaining = len - nwrote;
             if (remaining == 0 && writeCompleteCallback_)
             {
                 //既然数据发送完成，就不用再给channel设置epollout事件了
@@ -202,22 +538,257 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
             loop_->queueInLoop(std::bind(highWaterMarkCallback_, shared_from_this(), oldLen + remaining));
         }
         outputBuffer_.append((char*)data + nwrote, remaining);
-        if (!channel_->isWriting())
+        outputQueued();
+        if (!segments_.empty())
+        {
+            //排在前面的zerocopy payload发完以后才轮到这段数据
+            if (segments_.back().payload)
+            {
+                segments_.push_back(OutputSegment{SharedPayload(), 0, remaining});
+            }
+            else
+            {
+                segments_.back().copyBytes += remaining;
+            }
+        }
+        if (shm_)
+        {
+            //共享内存环满了，登记等待，对端读走数据后通过eventfd通知
+            if (shm_->waitWritable() > 0)
+            {
+                flushShmOutput();
+            }
+        }
+        else if (!channel_->isWriting() && !writeThrottled_)
+        {
+            double wait = limited ? shaper_->writeWait(Timestamp::now()) : 0;
+            if (wait > 0)
+            {
+                throttleWrite(wait);
+            }
+            else
+            {
+                channel_->enableWriting();//这里一定要注册channel的写事件，否则poller不会给channel通知epollout
+            }
+        }
+    }
+}
+
+void TcpConnection::sendPayloadInLoop(const SharedPayload& payload)
+{
+    size_t len = payload->size();
+    //共享内存和限速的写路径只处理outputBuffer_，这时按普通数据拷贝
+    if (shm_ || (shaper_ && shaper_->writeLimited()) || state_ == kDisconnected)
+    {
+        sendInLoop(payload->data(), len);
+        return;
+    }
+    if (len == 0)
+    {
+        return;
+    }
+
+    ++stats_.messagesOut;
+    size_t offset = 0;
+    if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0 && segments_.empty())
+    {
+        ssize_t n = useZeroCopy(*payload) ? zeroCopy_->send(channel_->fd(), payload, 0)
+            : ::write(channel_->fd(), payload->data(), len);
+        ++stats_.writeCalls;
+        if (n < 0)
+        {
+            if (errno != EWOULDBLOCK)
+            {
+                LOG_ERROR("%s %s %d %s send error:%d\n", __FILENAME__, __FUNCTION__, __LINE__, name_.c_str(), errno);
+                return;
+            }
+            n = 0;
+        }
+        offset = n;
+        stats_.bytesOut += n;
+        if (offset == len)
+        {
+            if (writeCompleteCallback_)
+            {
+                loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+            }
+            return;
+        }
+    }
+
+    //没发完的部分只保存payload的引用，广播给很多连接时每个连接不再各拷贝一份
+    size_t oldLen = outputBytes();
+    if (oldLen + len - offset >= highWaterMark_ && oldLen < highWaterMark_ && highWaterMarkCallback_)
+    {
+        loop_->queueInLoop(std::bind(highWaterMarkCallback_, shared_from_this(), oldLen + len - offset));
+    }
+    //outputBuffer_里已有的数据要先发
+    if (segments_.empty() && outputBuffer_.readableBytes() > 0)
+    {
+        segments_.push_back(OutputSegment{SharedPayload(), 0, outputBuffer_.readableBytes()});
+    }
+    segments_.push_back(OutputSegment{payload, offset, 0});
+    segmentPayloadBytes_ += len - offset;
+    outputQueued();
+    if (!channel_->isWriting() && !writeThrottled_)
+    {
+        channel_->enableWriting();
+    }
+}
+
+void TcpConnection::handleSegmentedWrite()
+{
+    //payload排队以后才设置的限速也要生效，和outputBuffer_的写路径一样按额度发送
+    bool limited = shaper_ && shaper_->writeLimited();
+    while (!segments_.empty())
+    {
+        size_t allowance = std::numeric_limits<size_t>::max();
+        Timestamp now;
+        if (limited)
+        {
+            now = Timestamp::now();
+            allowance = shaper_->writeAllowance(now);
+            if (allowance == 0)
+            {
+                throttleWrite(shaper_->writeWait(now));
+                return;
+            }
+        }
+        OutputSegment& seg = segments_.front();
+        //zerocopy一次提交整个payload，限速时按普通段发送
+        if (!limited && seg.payload && useZeroCopy(*seg.payload))
+        {
+            size_t want = seg.payload->size() - seg.offset;
+            ssize_t n = zeroCopy_->send(channel_->fd(), seg.payload, seg.offset);
+            ++stats_.writeCalls;
+            if (n <= 0)
+            {
+                if (n < 0 && errno != EWOULDBLOCK)
+                {
+                    LOG_ERROR("%s %s %d %s write error:%d\n", __FILENAME__, __FUNCTION__, __LINE__, name_.c_str(), errno);
+                }
+                return;
+            }
+            seg.offset += n;
+            segmentPayloadBytes_ -= n;
+            stats_.bytesOut += n;
+            completeResponses();
+            if (static_cast<size_t>(n) < want)
+            {
+                return;//内核发送缓冲区满了，等下一次EPOLLOUT
+            }
+            segments_.pop_front();
+            continue;
+        }
+
+        //连续的普通段(共享payload和outputBuffer_里的数据)用一次writev发出
+        struct iovec vec[kMaxWriteIov];
+        int count = 0;
+        size_t want = 0;
+        size_t bufferOffset = 0;
+        for (auto it = segments_.begin(); it != segments_.end() && count < kMaxWriteIov && want < allowance; ++it)
+        {
+            size_t len;
+            if (it->payload)
+            {
+                if (!limited && useZeroCopy(*it->payload))
+                {
+                    break;
+                }
+                len = it->payload->size() - it->offset;
+                vec[count].iov_base = const_cast<char*>(it->payload->data()) + it->offset;
+            }
+            else
+            {
+                len = it->copyBytes;
+                vec[count].iov_base = const_cast<char*>(outputBuffer_.peek()) + bufferOffset;
+                bufferOffset += len;
+            }
+            len = std::min(len, allowance - want);
+            vec[count].iov_len = len;
+            want += len;
+            ++count;
+        }
+        ssize_t n = ::writev(channel_->fd(), vec, count);
+        ++stats_.writeCalls;
+        if (n <= 0)
+        {
+            if (n < 0 && errno != EWOULDBLOCK)
+            {
+                LOG_ERROR("%s %s %d %s write error:%d\n", __FILENAME__, __FUNCTION__, __LINE__, name_.c_str(), errno);
+            }
+            return;
+        }
+        stats_.bytesOut += n;
+        size_t left = n;
+        while (left > 0)
+        {
+            OutputSegment& front = segments_.front();
+            size_t segLen = front.payload ? front.payload->size() - front.offset : front.copyBytes;
+            size_t used = std::min(left, segLen);
+            if (front.payload)
+            {
+                front.offset += used;
+                segmentPayloadBytes_ -= used;
+            }
+            else
+            {
+                outputBuffer_.retrieve(used);
+                front.copyBytes -= used;
+            }
+            left -= used;
+            if (used == segLen)
+            {
+                segments_.pop_front();
+            }
+        }
+        completeResponses();
+        double wait = limited ? shaper_->consumeWrite(n, now) : 0;
+        if (static_cast<size_t>(n) < want)
+        {
+            return;
+        }
+        if (wait > 0 && !segments_.empty())
         {
-            channel_->enableReading();//这里一定要注册channel的写事件，否则poller不会给channel通知epollout
+            throttleWrite(wait);
+            return;
         }
     }
+
+    channel_->disableWriting();
+    outputDrained();
+    if (writeCompleteCallback_)
+    {
+        loop_->queueInLoop(std::bind(writeCompleteCallback_, self_));
+    }
+    if (state_ == kDisconnecting)
+    {
+        shutdownInLoop();
+    }
 }
 
 //连接建立
 void TcpConnection::connectEstablished()
 {
-    setState(kConnected);
-    channel_->tie(shared_from_this());
+    self_ = shared_from_this();
     channel_->enableReading();//向poller注册channel的epollin事件
+    if (shmHandshakePending_)
+    {
+        return;//握手完成以后再执行回调
+    }
 
+    setState(kConnected);
+    if (shm_)
+    {
+        startShm();
+    }
     //新连接建立，执行回调
-    connectionCallback_(shared_from_this());
+    connectionFn_(this, self_);
+    //建立之前已经放进inputBuffer的数据(热重启时从旧进程带过来的)不会再有可读事件，直接交给用户
+    if (inputBuffer_.readableBytes() > 0)
+    {
+        messageFn_(this, self_, &inputBuffer_, Timestamp::now());
+    }
 }
 
 //连接销毁
@@ -228,9 +799,15 @@ void TcpConnection::connectionDestroyed()
         setState(kDisconnected);
         channel_->disableAll();//把channel的所有感兴趣的事件从poller中del掉
 
-        connectionCallback_(shared_from_this());
+        connectionFn_(this, self_);
     }
     channel_->remove();//把channel从poller中删除掉
+    if (shm_)
+    {
+        shm_->channel()->remove();
+    }
+    //channel已经从poller删除，不会再有事件借用self_，这里可以放掉自己的引用
+    self_.reset();
 }
 
 //关闭连接
@@ -243,10 +820,282 @@ void TcpConnection::shutdown()
     }
 }
 
+void TcpConnection::forceClose()
+{
+    if (state_ == kConnected || state_ == kDisconnecting)
+    {
+        setState(kDisconnecting);
+        loop_->queueInLoop(std::bind(&TcpConnection::forceCloseInLoop, shared_from_this()));
+    }
+}
+
+void TcpConnection::forceCloseInLoop()
+{
+    if (state_ == kConnected || state_ == kDisconnecting)
+    {
+        handleClose();
+    }
+}
+
+int TcpConnection::fd() const
+{
+    return socket_->fd();
+}
+
+void TcpConnection::startRead()
+{
+    loop_->runInLoop(std::bind(&TcpConnection::startReadInLoop, this));
+}
+
+void TcpConnection::startReadInLoop()
+{
+    if (!reading_ || !channel_->isReading())
+    {
+        //限速暂停中，定时器到期时会按reading_恢复
+        if (!readThrottled_)
+        {
+            channel_->enableReading();
+        }
+        if (shm_ && !shmHandshakePending_)
+        {
+            shm_->channel()->enableReading();
+            shm_->notifySelf();//暂停期间写进环里的数据没有通知
+        }
+        reading_ = true;
+    }
+}
+
+void TcpConnection::stopRead()
+{
+    loop_->runInLoop(std::bind(&TcpConnection::stopReadInLoop, this));
+}
+
+void TcpConnection::stopReadInLoop()
+{
+    if (reading_ || channel_->isReading())
+    {
+        channel_->disableReading();
+        if (shm_)
+        {
+            shm_->channel()->disableReading();
+        }
+        reading_ = false;
+    }
+}
+
+void TcpConnection::setTcpNoDelay(bool on)
+{
+    if (!localAddr_.isUnix())
+    {
+        socket_->setTcpNoDelay(on);
+    }
+}
+
+bool TcpConnection::setBusyPoll(int usec)
+{
+    return socket_->setBusyPoll(usec);
+}
+
 void TcpConnection::shutdownInLoop()
 {
-    if (!channel_->isWriting())//当前outputBuffer缓冲区数据已经全部发送完成
+    if (!channel_->isWriting() && outputBytes() == 0)//当前outputBuffer缓冲区数据已经全部发送完成
     {
         socket_->shutdownWrite();//关闭写端
     }
-}
\ No newline at end of file
+}
+
+double TcpConnection::callbackCpuSeconds() const
+{
+    return channel_->callbackCpuNs() / 1e9;
+}
+
+bool TcpConnection::tcpInfo(TcpInfoSample* sample) const
+{
+    if (localAddr_.isUnix())
+    {
+        return false;
+    }
+    struct tcp_info info;
+    socklen_t len = sizeof(info);
+    ::bzero(&info, sizeof(info));
+    if (::getsockopt(channel_->fd(), IPPROTO_TCP, TCP_INFO, &info, &len) < 0)
+    {
+        LOG_ERROR("%s %s %d %s getsockopt TCP_INFO error:%d\n", __FILENAME__, __FUNCTION__, __LINE__, name_.c_str(), errno);
+        return false;
+    }
+    sample->rttUs = info.tcpi_rtt;
+    sample->rttVarUs = info.tcpi_rttvar;
+    sample->sndCwnd = info.tcpi_snd_cwnd;
+    sample->sndMss = info.tcpi_snd_mss;
+    sample->unacked = info.tcpi_unacked;
+    sample->lost = info.tcpi_lost;
+    sample->retransmits = info.tcpi_retransmits;
+    sample->totalRetrans = info.tcpi_total_retrans;
+    return true;
+}
+
+void TcpConnection::markResponse(Timestamp receiveTime)
+{
+    if (loop_->isInLoopThread())
+    {
+        markResponseInLoop(receiveTime);
+    }
+    else
+    {
+        loop_->runInLoop(std::bind(&TcpConnection::markResponseInLoop, shared_from_this(), receiveTime));
+    }
+}
+
+void TcpConnection::markResponseInLoop(Timestamp receiveTime)
+{
+    if (!receiveTime.valid() || state_ == kDisconnected)
+    {
+        return;
+    }
+    size_t pending = outputBytes();
+    if (pending == 0)
+    {
+        //send时已经直接写完
+        loop_->recordRequestLatency(Timestamp::now().microSecondsSinceEpoch() - receiveTime.microSecondsSinceEpoch());
+        return;
+    }
+    responseMarks_.push_back(ResponseMark{receiveTime, stats_.bytesOut + pending});
+}
+
+void TcpConnection::completeResponsesSlow()
+{
+    int64_t now = Timestamp::now().microSecondsSinceEpoch();
+    while (!responseMarks_.empty() && responseMarks_.front().endBytes <= stats_.bytesOut)
+    {
+        loop_->recordRequestLatency(now - responseMarks_.front().receiveTime.microSecondsSinceEpoch());
+        responseMarks_.pop_front();
+    }
+}
+
+//输出队列里加了数据
+void TcpConnection::outputQueued()
+{
+    size_t pending = outputBytes();
+    stats_.peakOutputBytes = std::max(stats_.peakOutputBytes, pending);
+    if (!stats_.pendingSince.valid())
+    {
+        stats_.pendingSince = Timestamp::now();
+    }
+}
+
+//输出队列发空了
+void TcpConnection::outputDrained()
+{
+    if (stats_.pendingSince.valid())
+    {
+        stats_.pendingOutputUs += Timestamp::now().microSecondsSinceEpoch() - stats_.pendingSince.microSecondsSinceEpoch();
+        stats_.pendingSince = Timestamp();
+    }
+}
+
+TrafficShaper* TcpConnection::shaper()
+{
+    if (!shaper_)
+    {
+        shaper_.reset(new TrafficShaper());
+    }
+    return shaper_.get();
+}
+
+void TcpConnection::setReadRateLimit(double bytesPerSecond, double burst)
+{
+    shaper()->setReadLimit(bytesPerSecond, burst);
+}
+
+void TcpConnection::setWriteRateLimit(double bytesPerSecond, double burst)
+{
+    shaper()->setWriteLimit(bytesPerSecond, burst);
+}
+
+void TcpConnection::setTrafficGroup(const std::shared_ptr<TrafficGroup>& group)
+{
+    shaper()->setGroup(group);
+}
+
+void TcpConnection::throttleRead(double wait)
+{
+    if (readThrottled_)
+    {
+        return;
+    }
+    readThrottled_ = true;
+    channel_->disableReading();
+    shaper_->countReadPause();
+    //定时器不持有连接，连接先销毁的话到期时什么都不做
+    std::weak_ptr<TcpConnection> weakConn(self_);
+    loop_->runAfter(wait, [weakConn]() {
+        TcpConnectionPtr conn(weakConn.lock());
+        if (conn)
+        {
+            conn->resumeThrottledRead();
+        }
+    });
+}
+
+void TcpConnection::throttleWrite(double wait)
+{
+    if (writeThrottled_)
+    {
+        return;
+    }
+    writeThrottled_ = true;
+    if (channel_->isWriting())
+    {
+        channel_->disableWriting();
+    }
+    shaper_->countWritePause();
+    std::weak_ptr<TcpConnection> weakConn(self_);
+    loop_->runAfter(wait, [weakConn]() {
+        TcpConnectionPtr conn(weakConn.lock());
+        if (conn)
+        {
+            conn->resumeThrottledWrite();
+        }
+    });
+}
+
+void TcpConnection::resumeThrottledRead()
+{
+    if (!readThrottled_)
+    {
+        return;
+    }
+    readThrottled_ = false;
+    //暂停期间用户stopRead过的话保持暂停
+    if (reading_)
+    {
+        channel_->enableReading();
+    }
+}
+
+void TcpConnection::resumeThrottledWrite()
+{
+    if (!writeThrottled_)
+    {
+        return;
+    }
+    writeThrottled_ = false;
+    if (outputBytes() > 0)
+    {
+        channel_->enableWriting();
+    }
+}
+
+bool TcpConnection::enableZeroCopy(size_t threshold)
+{
+    if (!zeroCopy_)
+    {
+        if (!ZeroCopySender::enable(channel_->fd()))
+        {
+            return false;
+        }
+        zeroCopy_.reset(new ZeroCopySender());
+    }
+    zeroCopyThreshold_ = threshold;
+    return true;
+}
@@ -3,6 +3,7 @@
 #include <memory>
 #include <string>
 #include <atomic>
+#include <deque>
 
 #include "TcpConnection.h"
 #include "noncopyable.h"
@@ -10,10 +11,16 @@
 #include "Callbacks.h"
 #include "Buffer.h"
 #include "Timestamp.h"
+#include "ConnectionStats.h"
 
 class Channel;
 class EventLoop;
 class Socket;
+class ShmTransport;
+class TrafficShaper;
+class TrafficGroup;
+class ZeroCopySender;
+class TcpRelay;
 
 /**
  * TcpServer通过Acceptor有一个新用户连接，通过Acceptor函数拿到connfd打包到TCPConnection，设置相应回调，然后
@@ -31,38 +38,171 @@ public:
     const InetAddress& localAddress() const{ return localAddr_; }
     const InetAddress peerAddress() const { return peerAddr_; }
 
+    int fd() const;
     bool connected() const { return state_ == kConnected; }
     bool disConnected() const { return state_ == kDisconnected; }
 
     //发送数据
     void send(const std::string& buf);
+    //在loop线程中直接发送不需要构造string，其他线程调用时会拷贝一份
+    void send(const void* data, size_t len);
+    /**
+     * 发送共享的payload，跨线程也不拷贝，没发完的部分在输出队列里只保存引用，见BroadcastGroup
+     * 打开了zerocopy并且不小于阈值时内核直接引用payload；限速中的连接和共享内存传输按普通数据拷贝
+    */
+    void send(const SharedPayload& payload);
+    /**
+     * 打开MSG_ZEROCOPY，之后send(SharedPayload)发送不小于threshold字节的payload时不再拷贝进内核，
+     * payload一直被持有到错误队列里的完成通知到达；限速中的连接和共享内存传输仍然走拷贝
+     * 内核不支持时返回false，在连接所属的loop线程中调用
+    */
+    bool enableZeroCopy(size_t threshold);
+    //没有打开zerocopy时为nullptr
+    const ZeroCopySender* zeroCopySender() const { return zeroCopy_.get(); }
     //关闭连接
     void shutdown();
+    //不等待输出缓冲区发完，直接按对端关闭处理
+    void forceClose();
+    //暂停/恢复从socket读取，用于背压；暂停期间也不会发现对端关闭
+    void startRead();
+    void stopRead();
+    bool isReading() const { return reading_; }
+    //关闭Nagle算法，小包请求响应类的协议需要
+    void setTcpNoDelay(bool on);
+    //给socket设置SO_BUSY_POLL，配合EventLoop::setBusyPoll使用
+    bool setBusyPoll(int usec);
 
-    void setConnectionCallback(const ConnectionCallback& cb){ connectionCallback_ = cb; }
-    void setMessageCallback(const MessageCallback& cb){ messageCallback_ = cb; }
+    /**
+     * 按字节每秒限制接收/发送速率，0表示不限制，burst是允许的突发字节数
+     * 额度用完时不再关注EPOLLIN/EPOLLOUT，loop的定时器在额度恢复以后重新打开；共享内存传输不受限制
+     * 在连接所属的loop线程中调用
+    */
+    void setReadRateLimit(double bytesPerSecond, double burst);
+    void setWriteRateLimit(double bytesPerSecond, double burst);
+    //加入一个租户组，组内所有连接还要共享组的额度
+    void setTrafficGroup(const std::shared_ptr<TrafficGroup>& group);
+    //没有设置过限速时为nullptr
+    const TrafficShaper* trafficShaper() const { return shaper_.get(); }
+
+    void setConnectionCallback(const ConnectionCallback& cb)
+    {
+        connectionCallback_ = cb;
+        connectionFn_ = [](TcpConnection* c, const TcpConnectionPtr& conn) { c->connectionCallback_(conn); };
+    }
+    void setMessageCallback(const MessageCallback& cb)
+    {
+        messageCallback_ = cb;
+        messageFn_ = [](TcpConnection* c, const TcpConnectionPtr& conn, Buffer* buf, Timestamp t) { c->messageCallback_(conn, buf, t); };
+    }
+    /**
+     * 编译期绑定的用户处理对象，代替上面两个std::function回调
+     * H需要有onConnection(const TcpConnectionPtr&)和onMessage(const TcpConnectionPtr&, Buffer*, Timestamp)
+     * 分发只经过一次普通函数指针调用，H的方法在跳板里静态解析可以内联；handler必须比连接活得久
+    */
+    template <typename H>
+    void setHandler(H* handler)
+    {
+        handler_ = handler;
+        connectionFn_ = [](TcpConnection* c, const TcpConnectionPtr& conn) { static_cast<H*>(c->handler_)->onConnection(conn); };
+        messageFn_ = [](TcpConnection* c, const TcpConnectionPtr& conn, Buffer* buf, Timestamp t) {
+            static_cast<H*>(c->handler_)->onMessage(conn, buf, t);
+        };
+    }
     void setWriteCompleteCallback(const WriteCompleteCallback& cb){ writeCompleteCallback_ = cb; }
+    const WriteCompleteCallback& writeCompleteCallback() const { return writeCompleteCallback_; }
     void setCloseCallback(const CloseCallback& cb){ closeCallback_ = cb; }
     void setHighWaterMarkCallback(const HighWaterMarkCallback& cb, size_t hightWaterMark)
     { 
         highWaterMarkCallback_ = cb; 
         highWaterMark_ = hightWaterMark;
     }
-    //连接建立
+    Buffer* inputBuffer() { return &inputBuffer_; }
+    //还没有写进内核(或共享内存)的字节数
+    size_t outputBytes() const { return outputBuffer_.readableBytes() + segmentPayloadBytes_; }
+    //loop打开回调计时(EventLoop::setSlowCallbackThreshold)期间，这个连接的事件回调累计占用的CPU秒数，在loop线程中读取
+    double callbackCpuSeconds() const;
+    //收发字节数、系统调用次数、输出队列峰值和有数据待发送的累计时间，在loop线程中读取
+    const ConnectionStats& stats() const { return stats_; }
+    //从内核取一次TCP_INFO，Unix域socket或者取不到时返回false，在loop线程中调用
+    bool tcpInfo(TcpInfoSample* sample) const;
+    /**
+     * 标记一个请求的响应已经全部send：当前输出队列里的数据全部写进内核(或共享内存)时，
+     * 把从receiveTime(MessageCallback收到的poll返回时间)到这时的微秒数记进loop的请求延迟直方图
+     * 可以在任意线程调用，和同一线程之前的send保持顺序；连接关闭时还没写完的请求不统计
+    */
+    void markResponse(Timestamp receiveTime);
+
+    //给连接绑定任意的上下文(协议解析状态等)，只在连接所属的loop线程中访问
+    void setContext(const std::shared_ptr<void>& context){ context_ = context; }
+    const std::shared_ptr<void>& getContext() const { return context_; }
+
+    //数据改走共享内存传输，必须在connectEstablished之前调用
+    void setShmTransport(std::unique_ptr<ShmTransport> transport);
+    //服务端：第一次读取时先尝试共享内存握手，握手结束以后才回调connectionCallback
+    void expectShmHandshake() { shmHandshakePending_ = true; }
+    bool usingShm() const { return shm_ != nullptr; }
+
+    /**
+     * 连接建立，从这里到connectionDestroyed连接自己持有自己的shared_ptr，
+     * 期间的事件回调直接借用这个引用，不需要每个事件都提升channel的弱引用、调用shared_from_this
+    */
     void connectEstablished();
-    //连接销毁
+    //连接销毁，释放自己持有的引用，调用方要持有连接的shared_ptr（通常是bind进任务里的那一份）
     void connectionDestroyed();
 private:
+    //Channel通过setHandler直接调用下面的handleRead等私有方法
+    friend class Channel;
+    //relay期间直接操作channel_和socket_
+    friend class TcpRelay;
+
     enum StateE{kDisconnected, kConnecting, kConnected, kDisconnecting};
     void setState(StateE s) { state_ = s; }
 
     void handleRead(Timestamp receiveTime);
     void handleWrite();
+    //按普通写路径发送outputBuffer_和segments_，TcpRelay开始之前排队的数据也走这里
+    void writeOutput();
     void handleClose();
     void handleError();
 
+    void handleShmHandshake(Timestamp receiveTime);
+    //共享内存的eventfd可读：对端写入了数据或者腾出了空间
+    void handleShmEvent(Timestamp receiveTime);
+    void flushShmOutput();
+    void shmProtocolError();
+    //共享内存通道还在收数据，handleClose以后为false
+    bool shmActive() const;
+    void startShm();
+
     void sendInLoop(const void* data, size_t len);
+    void sendInLoop(const std::string& message);
+    void sendPayloadInLoop(const SharedPayload& payload);
+    //有payload排队时按segments_的顺序发送，连续的非zerocopy段合并成一次writev
+    void handleSegmentedWrite();
+    bool useZeroCopy(const std::string& payload) const { return zeroCopy_ && payload.size() >= zeroCopyThreshold_; }
+    void outputQueued();
+    void outputDrained();
+    void markResponseInLoop(Timestamp receiveTime);
+    //写出数据以后，完成结束位置已经写出的请求
+    void completeResponses()
+    {
+        if (!responseMarks_.empty())
+        {
+            completeResponsesSlow();
+        }
+    }
+    void completeResponsesSlow();
     void shutdownInLoop();
+    void forceCloseInLoop();
+    void startReadInLoop();
+    void stopReadInLoop();
+
+    TrafficShaper* shaper();
+    //额度用完，wait秒以后恢复
+    void throttleRead(double wait);
+    void throttleWrite(double wait);
+    void resumeThrottledRead();
+    void resumeThrottledWrite();
 
     EventLoop* loop_;//这里绝对不是baseloop,因为TCPConnection都是在subloop里面管理的
     const std::string name_;
@@ -76,6 +216,10 @@ private:
     const InetAddress localAddr_;
     const InetAddress peerAddr_;
 
+    //连接和消息回调统一通过函数指针分发，指向setHandler生成的跳板或者转调下面std::function的适配函数
+    void* handler_;
+    void (*connectionFn_)(TcpConnection*, const TcpConnectionPtr&);
+    void (*messageFn_)(TcpConnection*, const TcpConnectionPtr&, Buffer*, Timestamp);
     ConnectionCallback connectionCallback_;//有新连接的时候的回调
     MessageCallback messageCallback_;//有读写消息时候的回调
     WriteCompleteCallback writeCompleteCallback_;//消息写完以后的回调
@@ -85,4 +229,42 @@ private:
     size_t highWaterMark_;
     Buffer inputBuffer_;//接收数据
     Buffer outputBuffer_;//发送数据
+    std::shared_ptr<void> context_;//用户上下文
+
+    std::unique_ptr<ShmTransport> shm_;//不为空时数据走共享内存，socket只用来发现关闭
+    bool shmHandshakePending_;
+    bool shmFailed_;//环被对端破坏，已经在关闭
+
+    std::unique_ptr<TrafficShaper> shaper_;//设置了限速才创建，快路径上只比较一次指针
+    bool readThrottled_;
+    bool writeThrottled_;
+
+    /**
+     * 排队中的共享payload和普通数据按send的顺序交替发送，payload为空的段表示outputBuffer_里接下来的copyBytes字节
+     * segments_为空时所有待发送数据都在outputBuffer_里
+    */
+    static const int kMaxWriteIov = 64;
+    struct OutputSegment
+    {
+        SharedPayload payload;
+        size_t offset;
+        size_t copyBytes;
+    };
+    std::unique_ptr<ZeroCopySender> zeroCopy_;
+    size_t zeroCopyThreshold_;
+    std::deque<OutputSegment> segments_;
+    size_t segmentPayloadBytes_;//segments_里还没发出去的payload字节数
+
+    ConnectionStats stats_;
+    //等待写完的响应，endBytes是响应最后一个字节对应的累计bytesOut
+    struct ResponseMark
+    {
+        Timestamp receiveTime;
+        uint64_t endBytes;
+    };
+    std::deque<ResponseMark> responseMarks_;
+
+    std::shared_ptr<TcpRelay> relay_;//不为空时读写事件交给TcpRelay，和relay之间的循环引用在relay结束时断开
+
+    TcpConnectionPtr self_;//连接建立期间指向自己，回调里借用，只在loop线程里访问
 };
\ No newline at end of file
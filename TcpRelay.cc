@@ -0,0 +1,250 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include "TcpRelay.h"
+#include "TcpConnection.h"
+#include "Channel.h"
+#include "Socket.h"
+#include "Logger.h"
+
+std::shared_ptr<TcpRelay> TcpRelay::start(const TcpConnectionPtr& a, const TcpConnectionPtr& b, int pipeSize)
+{
+    if (!a || !b || a == b || a->getLoop() != b->getLoop() || a->usingShm() || b->usingShm()
+        || !a->connected() || !b->connected() || a->relay_ || b->relay_)
+    {
+        return nullptr;
+    }
+    std::shared_ptr<TcpRelay> relay(new TcpRelay(a, b));
+    if (!relay->openPipes(pipeSize))
+    {
+        return nullptr;
+    }
+    a->relay_ = relay;
+    b->relay_ = relay;
+    for (Direction* d : {&relay->forward_, &relay->backward_})
+    {
+        //已经读进inputBuffer_的数据按普通数据发给对面，对面的outputBuffer_排空以后才开始splice
+        Buffer* input = d->from->inputBuffer();
+        if (input->readableBytes() > 0)
+        {
+            d->to->sendInLoop(input->peek(), input->readableBytes());
+            input->retrieveAll();
+        }
+        if (!d->from->channel_->isReading())
+        {
+            d->from->channel_->enableReading();
+        }
+    }
+    return relay;
+}
+
+TcpRelay::TcpRelay(const TcpConnectionPtr& a, const TcpConnectionPtr& b)
+    :a_(a),
+    b_(b)
+{
+    forward_ = Direction{a.get(), b.get(), -1, -1, 0, false, false, 0, 0};
+    backward_ = Direction{b.get(), a.get(), -1, -1, 0, false, false, 0, 0};
+}
+
+TcpRelay::~TcpRelay()
+{
+    for (Direction* d : {&forward_, &backward_})
+    {
+        if (d->pipeRead >= 0)
+        {
+            ::close(d->pipeRead);
+            ::close(d->pipeWrite);
+        }
+    }
+}
+
+bool TcpRelay::openPipes(int pipeSize)
+{
+    for (Direction* d : {&forward_, &backward_})
+    {
+        int fds[2];
+        if (::pipe2(fds, O_NONBLOCK | O_CLOEXEC) < 0)
+        {
+            LOG_ERROR("%s %s %d create pipe error:%d\n", __FILENAME__, __FUNCTION__, __LINE__, errno);
+            return false;
+        }
+        d->pipeRead = fds[0];
+        d->pipeWrite = fds[1];
+        //超过/proc/sys/fs/pipe-max-size时保持默认的64KB
+        ::fcntl(d->pipeWrite, F_SETPIPE_SZ, pipeSize);
+    }
+    return true;
+}
+
+void TcpRelay::handleRead(TcpConnection* conn)
+{
+    Direction* d = conn == forward_.from ? &forward_ : &backward_;
+    if (d->eof || d->pipeBytes > 0)
+    {
+        conn->channel_->disableReading();
+        return;
+    }
+    ssize_t n = ::splice(conn->fd(), nullptr, d->pipeWrite, nullptr, 1024 * 1024, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    ++conn->stats_.readCalls;
+    if (n > 0)
+    {
+        d->pipeBytes += n;
+        d->bytes += n;
+        conn->stats_.bytesIn += n;
+        if (!flush(d))
+        {
+            teardown(nullptr);
+            return;
+        }
+        if (d->pipeBytes > 0)
+        {
+            //对面写不进去了，先不读这一边，数据留在内核的接收缓冲区里，对端的发送窗口随之缩小
+            conn->channel_->disableReading();
+            ++d->pauses;
+        }
+    }
+    else if (n == 0)
+    {
+        d->eof = true;
+        conn->channel_->disableReading();
+        if (d->pipeBytes == 0)
+        {
+            drained(d);
+        }
+    }
+    else if (errno != EAGAIN && errno != EINTR)
+    {
+        LOG_ERROR("%s %s %d splice from %s error:%d\n", __FILENAME__, __FUNCTION__, __LINE__, conn->name().c_str(), errno);
+        teardown(nullptr);
+    }
+}
+
+void TcpRelay::handleWrite(TcpConnection* conn)
+{
+    //relay开始之前send进来的数据(outputBuffer_和共享payload)先按普通写路径发，统计、写完成回调照常
+    if (conn->outputBytes() > 0)
+    {
+        conn->writeOutput();
+        if (conn->outputBytes() > 0)
+        {
+            return;
+        }
+        //普通写路径排空以后关掉了EPOLLOUT，pipe里还有数据时flush会重新打开
+    }
+    Direction* d = conn == forward_.to ? &forward_ : &backward_;
+    if (!flush(d))
+    {
+        teardown(nullptr);
+        return;
+    }
+    if (d->pipeBytes == 0)
+    {
+        conn->channel_->disableWriting();
+        drained(d);
+    }
+}
+
+void TcpRelay::handleClose(TcpConnection* conn)
+{
+    teardown(conn);
+}
+
+bool TcpRelay::flush(Direction* d)
+{
+    TcpConnection* to = d->to;
+    if (to->outputBytes() > 0)
+    {
+        if (!to->channel_->isWriting())
+        {
+            to->channel_->enableWriting();
+        }
+        return true;
+    }
+    while (d->pipeBytes > 0)
+    {
+        ssize_t n = ::splice(d->pipeRead, nullptr, to->fd(), nullptr, d->pipeBytes, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        ++to->stats_.writeCalls;
+        if (n > 0)
+        {
+            d->pipeBytes -= n;
+            to->stats_.bytesOut += n;
+        }
+        else if (n < 0 && errno == EAGAIN)
+        {
+            if (!to->channel_->isWriting())
+            {
+                to->channel_->enableWriting();
+            }
+            return true;
+        }
+        else if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        else
+        {
+            LOG_ERROR("%s %s %d splice to %s error:%d\n", __FILENAME__, __FUNCTION__, __LINE__, to->name().c_str(), errno);
+            return false;
+        }
+    }
+    return true;
+}
+
+void TcpRelay::drained(Direction* d)
+{
+    if (d->to->outputBytes() > 0)
+    {
+        //pipe空了但对面还有relay之前send进来的数据没发完，EOF不能越过它们，等handleWrite发完以后再来
+        if (!d->to->channel_->isWriting())
+        {
+            d->to->channel_->enableWriting();
+        }
+        return;
+    }
+    if (!d->eof)
+    {
+        if (!d->from->channel_->isReading())
+        {
+            d->from->channel_->enableReading();
+        }
+        return;
+    }
+    if (!d->done)
+    {
+        //这个方向的数据都写进对面了，把EOF也传过去
+        d->done = true;
+        d->to->socket_->shutdownWrite();
+        finishIfDone();
+    }
+}
+
+void TcpRelay::finishIfDone()
+{
+    if (forward_.done && backward_.done)
+    {
+        teardown(nullptr);
+    }
+}
+
+void TcpRelay::teardown(TcpConnection* closing)
+{
+    TcpConnectionPtr a;
+    TcpConnectionPtr b;
+    a.swap(a_);
+    b.swap(b_);
+    if (!a)
+    {
+        return;
+    }
+    //断开连接和relay之间的循环引用，调用方持有relay直到返回
+    a->relay_.reset();
+    b->relay_.reset();
+    for (TcpConnection* conn : {a.get(), b.get()})
+    {
+        if (conn != closing)
+        {
+            conn->forceClose();
+        }
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdint.h>
+#include <memory>
+
+#include "noncopyable.h"
+#include "Callbacks.h"
+
+/**
+ * 把两个TcpConnection首尾相接做TCP转发，每个方向一个pipe，数据用splice在内核里从一个socket搬到另一个socket，
+ * 不经过inputBuffer_/outputBuffer_，也不分配用户态内存
+ * 背压：pipe里还有数据没写进对面的socket时停止读这一边，对面可写以后再恢复
+ * 半关闭：一边读到EOF，等这个方向的pipe排空以后关闭对面的写端；两个方向都结束以后关闭两个连接
+ * 任何一边出错或者被关闭，另一边也随之关闭
+ * 两个连接必须属于同一个loop，relay期间不再回调messageCallback，连接的建立/断开回调照常
+*/
+class TcpRelay : noncopyable, public std::enable_shared_from_this<TcpRelay>
+{
+public:
+    /**
+     * 开始转发，在两个连接所属的loop线程中调用，连接必须已经建立
+     * 两边inputBuffer_里已经读到的数据先转给对面，pipeSize是每个方向pipe的容量
+     * 共享内存连接、不在同一个loop或者创建pipe失败时返回nullptr
+    */
+    static std::shared_ptr<TcpRelay> start(const TcpConnectionPtr& a, const TcpConnectionPtr& b, int pipeSize = 1024 * 1024);
+    ~TcpRelay();
+
+    //a到b、b到a方向已经转发的字节数
+    uint64_t forwardedBytes() const { return forward_.bytes; }
+    uint64_t backwardBytes() const { return backward_.bytes; }
+    //因为对面写不进去而暂停读取的次数
+    uint64_t pauses() const { return forward_.pauses + backward_.pauses; }
+private:
+    friend class TcpConnection;
+
+    struct Direction
+    {
+        TcpConnection* from;
+        TcpConnection* to;
+        int pipeRead;
+        int pipeWrite;
+        size_t pipeBytes;//pipe里还没写进to的字节数
+        bool eof;//from读到EOF
+        bool done;//EOF已经传递给to
+        uint64_t bytes;
+        uint64_t pauses;
+    };
+
+    TcpRelay(const TcpConnectionPtr& a, const TcpConnectionPtr& b);
+    bool openPipes(int pipeSize);
+
+    //TcpConnection的事件在relay期间转到这里
+    void handleRead(TcpConnection* conn);
+    void handleWrite(TcpConnection* conn);
+    void handleClose(TcpConnection* conn);
+
+    //把pipe里的数据写进to，写不完时打开to的EPOLLOUT，返回false表示出错
+    bool flush(Direction* d);
+    //pipe和to的输出队列都排空以后恢复读取或者传递EOF
+    void drained(Direction* d);
+    void finishIfDone();
+    void teardown(TcpConnection* closing);
+
+    TcpConnectionPtr a_;
+    TcpConnectionPtr b_;
+    Direction forward_;
+    Direction backward_;
+};
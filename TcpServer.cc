@@ -1,9 +1,14 @@
 #include <functional>
 #include <strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
 
 #include "TcpServer.h"
 #include "Logger.h"
 #include "TcpConnection.h"
+#include "Handoff.h"
 
 static EventLoop* CheckLoopNotNull(EventLoop* loop)
 {
@@ -20,17 +25,80 @@ TcpServer::TcpServer(EventLoop* loop, const InetAddress &listenAddr, const std::
     threadPool_(new EventLoopThreadPool(loop, name_)),
     connectionCallback_(),
     messageCallback_(),
+    handler_(nullptr),
+    applyHandler_(nullptr),
+    started_(0),
+    shmTransport_(false),
     nextConnId_(1),
-    started_(0)
+    acceptPaused_(false),
+    acceptPauses_(0),
+    drainSeconds_(0),
+    handingOff_(false),
+    handoffFinished_(false),
+    handoffControlFd_(-1)
 {
     LOG_INFO("%s %s %d TcpServer created, acceptor fd %d\n", __FILENAME__, __FUNCTION__, __LINE__, acceptor_->acceptFd());
     //当有新用户连接时，会执行TcpServer::newConnection回调
     acceptor_->setNewConnectionCallback(std::bind(&TcpServer::newConnection, this, 
-        std::placeholders::_1, std::placeholders::_2));
+        std::placeholders::_1, std::placeholders::_2, static_cast<const std::string*>(nullptr)));
+}
+
+static InetAddress localAddressOf(int sockfd)
+{
+    sockaddr_storage local;
+    bzero(&local, sizeof(local));
+    socklen_t addrlen = sizeof(local);
+    ::getsockname(sockfd, (sockaddr*)&local, &addrlen);
+    InetAddress addr;
+    addr.setSockAddr((sockaddr*)&local, addrlen);
+    return addr;
+}
+
+TcpServer::TcpServer(EventLoop* loop, int listenFd, const std::string& nameArg)
+    :loop_(CheckLoopNotNull(loop)), ipPort_(localAddressOf(listenFd).toIpPort()), name_(nameArg),
+    acceptor_(new Acceptor(loop, listenFd)),
+    threadPool_(new EventLoopThreadPool(loop, name_)),
+    connectionCallback_(),
+    messageCallback_(),
+    handler_(nullptr),
+    applyHandler_(nullptr),
+    started_(0),
+    shmTransport_(false),
+    nextConnId_(1),
+    acceptPaused_(false),
+    acceptPauses_(0),
+    drainSeconds_(0),
+    handingOff_(false),
+    handoffFinished_(false),
+    handoffControlFd_(-1)
+{
+    LOG_INFO("%s %s %d TcpServer took over listen fd %d\n", __FILENAME__, __FUNCTION__, __LINE__, listenFd);
+    acceptor_->setNewConnectionCallback(std::bind(&TcpServer::newConnection, this,
+        std::placeholders::_1, std::placeholders::_2, static_cast<const std::string*>(nullptr)));
 }
 
 TcpServer::~TcpServer()
 {
+    if (acceptRetryTimer_.valid())
+    {
+        loop_->cancel(acceptRetryTimer_);
+    }
+    if (statsTimer_.valid())
+    {
+        loop_->cancel(statsTimer_);
+    }
+    if (latencyTimer_.valid())
+    {
+        loop_->cancel(latencyTimer_);
+    }
+    if (handoffTimer_.valid())
+    {
+        loop_->cancel(handoffTimer_);
+    }
+    if (!handoffPath_.empty())
+    {
+        ::unlink(handoffPath_.c_str());
+    }
     for (auto& item : connections_)
     {
         //这个局部的shared_ptr智能指针对象，出右括号可以自动释放new出来的TcpConnection对象资源
@@ -40,7 +108,19 @@ TcpServer::~TcpServer()
         //销毁连接
         conn->getLoop()->runInLoop(std::bind(&TcpConnection::connectionDestroyed, conn));
     }
-    
+    for (Channel* channel : {handoffChannel_.get(), predecessorChannel_.get()})
+    {
+        if (channel != nullptr)
+        {
+            channel->disableAll();
+            channel->remove();
+            ::close(channel->fd());
+        }
+    }
+    if (handoffControlFd_ >= 0)
+    {
+        ::close(handoffControlFd_);
+    }
 }
 
 //开启服务器监听 loop.loop()
@@ -60,10 +140,21 @@ void TcpServer::setThreadNum(int numThreads)
 }
 
 //有一个新的客户端的连接会执行这个回调操作
-void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr)
+void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr, const std::string* input)
 {
-    //轮训算法选择一个subloop,来管理channel
-    EventLoop* ioLoop = threadPool_->getNextLoop();
+    //轮训算法选择一个subloop,来管理channel，设置了每个loop的连接上限时跳过已满的loop
+    EventLoop* ioLoop = admission_.chooseLoop(threadPool_.get());
+    //热重启交接过来的连接已经被旧进程接受过，不再检查
+    if (input == nullptr && !admission_.admit(ioLoop, peerAddr, Timestamp::now()))
+    {
+        ::close(sockfd);
+        updateAccepting();
+        return;
+    }
+    if (ioLoop == nullptr)
+    {
+        ioLoop = threadPool_->getNextLoop();
+    }
     char buf[64] = {0};
     snprintf(buf, sizeof(buf), "-%s#%d", ipPort_.c_str(), nextConnId_);//连接名称
     ++nextConnId_;
@@ -72,42 +163,405 @@ void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr)
     LOG_INFO("%s %s %d %s new connection %s from %s \n", __FILENAME__, __FUNCTION__, __LINE__, 
         name_.c_str(), connName.c_str(), peerAddr.toIpPort().c_str());
 
-    //通过sockfd获取其绑定的本机的IP地址和端口信息
-    sockaddr_in local;
+    //通过sockfd获取其绑定的本机的地址信息
+    sockaddr_storage local;
     bzero(&local, sizeof(local));
     socklen_t addrlen = sizeof(local);
     if (::getsockname(sockfd, (sockaddr*)&local, &addrlen) < 0)
     {
         LOG_ERROR("%s %s %d getsockname error\n", __FILENAME__, __FUNCTION__, __LINE__);
     }
-    InetAddress localAddr(local);
+    InetAddress localAddr;
+    localAddr.setSockAddr((sockaddr*)&local, addrlen);
     
     //根据连接成功的sockfd，创建TcpConnection连接对象
     TcpConnectionPtr conn(new TcpConnection(ioLoop, connName, sockfd, localAddr, peerAddr));
     connections_[connName] = conn;
     //下面的回调是用户设置给TcpServer，然后->TcpConnection->Channel->Poller->notify channel调用回调
-    conn->setConnectionCallback(connectionCallback_);
-    conn->setMessageCallback(messageCallback_);
+    if (applyHandler_)
+    {
+        applyHandler_(handler_, conn.get());
+    }
+    else
+    {
+        conn->setConnectionCallback(connectionCallback_);
+        conn->setMessageCallback(messageCallback_);
+    }
     conn->setWriteCompleteCallback(writeCompleteCallback_);
+    if (input != nullptr && !input->empty())
+    {
+        conn->inputBuffer()->append(input->data(), input->size());
+    }
+    else if (shmTransport_ && localAddr.isUnix())
+    {
+        conn->expectShmHandshake();
+    }
 
     //设置了如果关闭连接的回调
     conn->setCloseCallback(std::bind(&TcpServer::removeConnection, this, std::placeholders::_1));
 
+    admission_.added(ioLoop, peerAddr);
+
     //直接调用TcpConnection::connectEstablished
     ioLoop->runInLoop(std::bind(&TcpConnection::connectEstablished, conn));
+    updateAccepting();
+}
+
+void TcpServer::updateAccepting()
+{
+    if (admission_.overloadAction() != AdmissionControl::kStopAccept || !acceptor_->listenning())
+    {
+        return;
+    }
+    double retryAfter = 0;
+    bool saturated = admission_.saturated(threadPool_.get(), Timestamp::now(), &retryAfter);
+    if (saturated && !acceptPaused_)
+    {
+        acceptor_->pauseAccepting();
+        acceptPaused_ = true;
+        ++acceptPauses_;
+    }
+    else if (!saturated && acceptPaused_)
+    {
+        acceptor_->resumeAccepting();
+        acceptPaused_ = false;
+    }
+    //连接数到上限时等removeConnectionInLoop唤醒，速率到上限时等令牌补充
+    if (saturated && retryAfter > 0 && !acceptRetryTimer_.valid())
+    {
+        acceptRetryTimer_ = loop_->runAfter(retryAfter, [this]() {
+            acceptRetryTimer_ = TimerId();
+            updateAccepting();
+        });
+    }
 }
 
+//在连接所属的subloop中调用，统计只能在这个线程里读
 void TcpServer::removeConnection(const TcpConnectionPtr& conn)
 {
-    loop_->runInLoop(std::bind(&TcpServer::removeConnectionInLoop, this, conn));
+    loop_->runInLoop(std::bind(&TcpServer::removeConnectionInLoop, this, conn, conn->stats()));
 }
 
-void TcpServer::removeConnectionInLoop(const TcpConnectionPtr& conn)
+void TcpServer::removeConnectionInLoop(const TcpConnectionPtr& conn, const ConnectionStats& stats)
 {
     LOG_INFO("%s %d %s connection %s\n", __FUNCTION__, __LINE__, name_.c_str(), conn->name().c_str());
 
     size_t n = connections_.erase(conn->name());
     EventLoop* ioLoop = conn->getLoop();
+    if (n > 0)
+    {
+        admission_.removed(ioLoop, conn->peerAddress());
+        closedTraffic_.add(stats, Timestamp::now());
+    }
     ioLoop->queueInLoop(std::bind(&TcpConnection::connectionDestroyed, conn));
+    updateAccepting();
+    if (handingOff_ && connections_.empty())
+    {
+        finishHandoff();
+    }
+}
+
+void TcpServer::collectStats(const StatsCallback& cb, bool perConnection)
+{
+    loop_->runInLoop(std::bind(&TcpServer::collectStatsInLoop, this, cb, perConnection));
+}
+
+void TcpServer::setStatsInterval(double seconds, const StatsCallback& cb, bool perConnection)
+{
+    if (statsTimer_.valid())
+    {
+        loop_->cancel(statsTimer_);
+        statsTimer_ = TimerId();
+    }
+    if (seconds > 0)
+    {
+        statsTimer_ = loop_->runEvery(seconds, std::bind(&TcpServer::collectStatsInLoop, this, cb, perConnection));
+    }
+}
+
+namespace
+{
+//一次collectStats的中间结果，各个subloop汇总到这里，最后一个完成的把结果交回baseloop
+struct StatsCollection
+{
+    std::mutex mutex;
+    ServerStats stats;
+    size_t remaining;
+};
+}
+
+void TcpServer::collectStatsInLoop(const StatsCallback& cb, bool perConnection)
+{
+    std::shared_ptr<StatsCollection> collection(new StatsCollection());
+    collection->stats.when = Timestamp::now();
+    collection->stats.closed = closedTraffic_;
+
+    //没有连接的loop也要出现在结果里
+    std::unordered_map<EventLoop*, std::vector<TcpConnectionPtr>> byLoop;
+    for (EventLoop* ioLoop : threadPool_->getAllLoops())
+    {
+        byLoop[ioLoop];
+    }
+    for (auto& item : connections_)
+    {
+        byLoop[item.second->getLoop()].push_back(item.second);
+    }
+    collection->remaining = byLoop.size();
+
+    EventLoop* baseLoop = loop_;
+    for (auto& item : byLoop)
+    {
+        EventLoop* ioLoop = item.first;
+        std::vector<TcpConnectionPtr> conns;
+        conns.swap(item.second);
+        ioLoop->runInLoop([collection, ioLoop, conns, perConnection, baseLoop, cb]() {
+            LoopStats loopStats;
+            loopStats.loop = ioLoop;
+            std::vector<ConnectionSample> samples;
+            Timestamp now = Timestamp::now();
+            for (const TcpConnectionPtr& conn : conns)
+            {
+                ConnectionSample sample;
+                sample.stats = conn->stats();
+                sample.hasTcpInfo = conn->connected() && conn->tcpInfo(&sample.tcpInfo);
+                loopStats.traffic.add(sample.stats, now);
+                if (sample.hasTcpInfo)
+                {
+                    loopStats.tcp.add(sample.tcpInfo);
+                }
+                if (perConnection)
+                {
+                    sample.name = conn->name();
+                    sample.loop = ioLoop;
+                    samples.push_back(std::move(sample));
+                }
+            }
+
+            std::lock_guard<std::mutex> lock(collection->mutex);
+            ServerStats& stats = collection->stats;
+            stats.total.traffic.add(loopStats.traffic);
+            stats.total.tcp.add(loopStats.tcp);
+            stats.loops.push_back(loopStats);
+            stats.connections.insert(stats.connections.end(), samples.begin(), samples.end());
+            if (--collection->remaining == 0)
+            {
+                baseLoop->queueInLoop([collection, cb]() { cb(collection->stats); });
+            }
+        });
+    }
+}
+
+LatencyHistogram::Snapshot TcpServer::requestLatency()
+{
+    LatencyHistogram::Snapshot total;
+    for (EventLoop* ioLoop : threadPool_->getAllLoops())
+    {
+        total.merge(ioLoop->metrics().requestLatency);
+    }
+    return total;
+}
+
+void TcpServer::setLatencyReportInterval(double seconds, const LatencyReportCallback& cb)
+{
+    if (latencyTimer_.valid())
+    {
+        loop_->cancel(latencyTimer_);
+        latencyTimer_ = TimerId();
+    }
+    if (seconds > 0)
+    {
+        lastLatency_.reset(new LatencyHistogram::Snapshot(requestLatency()));
+        latencyTimer_ = loop_->runEvery(seconds, std::bind(&TcpServer::reportLatency, this, cb));
+    }
+}
+
+void TcpServer::reportLatency(const LatencyReportCallback& cb)
+{
+    LatencyHistogram::Snapshot total = requestLatency();
+    LatencyHistogram::Snapshot interval = total.since(*lastLatency_);
+    *lastLatency_ = total;
+    if (cb)
+    {
+        cb(interval);
+    }
+    else
+    {
+        LOG_INFO("%s %s %d %s %llu requests, latency us p50 %llu p90 %llu p99 %llu p999 %llu max %llu\n", __FILENAME__,
+            __FUNCTION__, __LINE__, name_.c_str(), (unsigned long long)interval.count,
+            (unsigned long long)interval.percentile(0.5), (unsigned long long)interval.percentile(0.9),
+            (unsigned long long)interval.percentile(0.99), (unsigned long long)interval.percentile(0.999),
+            (unsigned long long)interval.max);
+    }
+}
+
+void TcpServer::enableHandoff(const std::string& path, double drainSeconds, const std::function<void()>& doneCallback)
+{
+    int fd = Handoff::listen(path);
+    if (fd < 0)
+    {
+        return;
+    }
+    handoffPath_ = path;
+    drainSeconds_ = drainSeconds;
+    handoffDoneCallback_ = doneCallback;
+    handoffChannel_.reset(new Channel(loop_, fd));
+    handoffChannel_->setReadCallback(std::bind(&TcpServer::handleHandoffAccept, this));
+    handoffChannel_->enableReading();
+}
+
+void TcpServer::handleHandoffAccept()
+{
+    int controlFd = ::accept4(handoffChannel_->fd(), nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (controlFd < 0)
+    {
+        return;
+    }
+    if (handingOff_)
+    {
+        ::close(controlFd);
+        return;
+    }
+    //下一个进程拿到监听fd以后会在同一个路径上重新enableHandoff，所以要在发送之前删除，之后这个路径就不归这里管了
+    ::unlink(handoffPath_.c_str());
+    handoffPath_.clear();
+    if (!Handoff::send(controlFd, Handoff::kListener, acceptor_->acceptFd(), "", 0))
+    {
+        ::close(controlFd);
+        return;
+    }
+    LOG_INFO("%s %s %d %s handed listen fd to successor, draining %zu connections\n", __FILENAME__, __FUNCTION__, __LINE__,
+        name_.c_str(), connections_.size());
+    //从这里开始新连接都由新进程accept，监听队列里还没accept的连接也一起交过去了
+    acceptor_->stopListening();
+    handoffChannel_->disableAll();
+    handingOff_ = true;
+    handoffControlFd_ = controlFd;
+    for (auto& item : connections_)
+    {
+        TcpConnectionPtr conn(item.second);
+        conn->getLoop()->runInLoop(std::bind(&TcpServer::handOffConnection, this, conn));
+    }
+    handoffTimer_ = loop_->runAfter(drainSeconds_, std::bind(&TcpServer::finishHandoff, this));
+    if (connections_.empty())
+    {
+        loop_->queueInLoop(std::bind(&TcpServer::finishHandoff, this));
+    }
+}
+
+//在连接所属的subloop中执行
+void TcpServer::handOffConnection(const TcpConnectionPtr& conn)
+{
+    Buffer* input = conn->inputBuffer();
+    if (conn->connected() && conn->outputBytes() == 0 && !conn->usingShm() && input->readableBytes() <= Handoff::kMaxInput)
+    {
+        //停止读以后新到的数据留在内核缓冲区里，由新进程读取
+        //控制通道只在baseloop中写，subloop不会因为通道拥塞或者等锁而停下来
+        conn->stopRead();
+        loop_->queueInLoop(std::bind(&TcpServer::sendHandoffConnection, this, conn,
+            std::string(input->peek(), input->readableBytes())));
+        return;
+    }
+    conn->shutdown();
+}
+
+//在连接所属的subloop中执行，交出去的连接直接关闭，没交出去的在本进程排空
+static void handoffSent(const TcpConnectionPtr& conn, bool sent)
+{
+    if (!conn->connected())
+    {
+        return;//已经被finishHandoff强制关闭或者对端关闭了
+    }
+    if (sent)
+    {
+        //新进程持有socket的另一个引用，这里关闭fd不会影响对端
+        conn->inputBuffer()->retrieveAll();
+        conn->forceClose();
+        return;
+    }
+    conn->startRead();
+    conn->shutdown();
+}
+
+//在baseloop中执行，控制通道满(EAGAIN)时这个连接留在本进程排空
+void TcpServer::sendHandoffConnection(const TcpConnectionPtr& conn, const std::string& input)
+{
+    bool sent = handoffControlFd_ >= 0
+        && Handoff::send(handoffControlFd_, Handoff::kConnection, conn->fd(), input.data(), input.size());
+    conn->getLoop()->runInLoop(std::bind(&handoffSent, conn, sent));
+}
+
+void TcpServer::finishHandoff()
+{
+    if (handoffFinished_)
+    {
+        return;
+    }
+    handoffFinished_ = true;
+    if (handoffTimer_.valid())
+    {
+        loop_->cancel(handoffTimer_);
+        handoffTimer_ = TimerId();
+    }
+    for (auto& item : connections_)
+    {
+        item.second->forceClose();
+    }
+    ::close(handoffControlFd_);
+    handoffControlFd_ = -1;
+    LOG_INFO("%s %s %d %s handoff finished, %zu connections force closed\n", __FILENAME__, __FUNCTION__, __LINE__,
+        name_.c_str(), connections_.size());
+    if (handoffDoneCallback_)
+    {
+        handoffDoneCallback_();
+    }
+}
+
+void TcpServer::takeOverConnections(int controlFd)
+{
+    ::fcntl(controlFd, F_SETFL, ::fcntl(controlFd, F_GETFL) | O_NONBLOCK);
+    predecessorChannel_.reset(new Channel(loop_, controlFd));
+    predecessorChannel_->setReadCallback(std::bind(&TcpServer::handleHandoffMessage, this));
+    predecessorChannel_->enableReading();
+}
+
+void TcpServer::handleHandoffMessage()
+{
+    for (;;)
+    {
+        Handoff::Message msg;
+        int ret = Handoff::receive(predecessorChannel_->fd(), &msg);
+        if (ret == 0)
+        {
+            //旧进程交接完成关闭了通道
+            LOG_INFO("%s %s %d %s predecessor finished handoff\n", __FILENAME__, __FUNCTION__, __LINE__, name_.c_str());
+            predecessorChannel_->disableAll();
+            return;
+        }
+        if (ret < 0)
+        {
+            if (errno == EAGAIN || errno == EINTR)
+            {
+                return;
+            }
+            //格式错误的消息(EPROTO)或者通道出错，之后的消息也不可信，停止接收
+            LOG_ERROR("%s %s %d %s handoff channel error:%d, stop taking over connections\n", __FILENAME__, __FUNCTION__,
+                __LINE__, name_.c_str(), errno);
+            predecessorChannel_->disableAll();
+            return;
+        }
+        if (msg.type != Handoff::kConnection)
+        {
+            ::close(msg.fd);
+            continue;
+        }
+        ::fcntl(msg.fd, F_SETFL, ::fcntl(msg.fd, F_GETFL) | O_NONBLOCK);
+        sockaddr_storage peer;
+        bzero(&peer, sizeof(peer));
+        socklen_t addrlen = sizeof(peer);
+        ::getpeername(msg.fd, (sockaddr*)&peer, &addrlen);
+        InetAddress peerAddr;
+        peerAddr.setSockAddr((sockaddr*)&peer, addrlen);
+        newConnection(msg.fd, peerAddr, &msg.input);
+    }
 }
 
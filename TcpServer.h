@@ -2,6 +2,7 @@
 
 #include <unordered_map>
 #include <atomic>
+#include <mutex>
 
 #include "EventLoop.h"
 #include "Acceptor.h"
@@ -11,12 +12,16 @@
 #include "Callbacks.h"
 #include "TcpConnection.h"
 #include "Buffer.h"
+#include "AdmissionControl.h"
+#include "ConnectionStats.h"
 
 //对外的服务器编程使用的类
 class TcpServer:noncopyable
 {
 public:
     using ThreadInitCallback = std::function<void(EventLoop*)>;
+    using StatsCallback = std::function<void(const ServerStats&)>;
+    using LatencyReportCallback = std::function<void(const LatencyHistogram::Snapshot& interval)>;
     enum Option
     {
         kNoReusePort,
@@ -24,6 +29,8 @@ public:
     };
 
     TcpServer(EventLoop* loop, const InetAddress &listenAddr, const std::string& nameArg, Option option = kNoReusePort);
+    //热重启的新进程：使用Handoff::takeOver从旧进程拿到的监听socket
+    TcpServer(EventLoop* loop, int listenFd, const std::string& nameArg);
     ~TcpServer();
 
     //设置底层subloop个数
@@ -33,15 +40,68 @@ public:
     void setConnectionCallback(const ConnectionCallback& cb){ connectionCallback_ = std::move(cb); }
     void setMessageCallback(const MessageCallback& cb){ messageCallback_ = std::move(cb); }
     void setWriteCompleteCallback(const WriteCompleteCallback& cb){ writeCompleteCallback_ = std::move(cb); }
+    //新连接使用编译期绑定的handler代替连接和消息回调，见TcpConnection::setHandler
+    template <typename H>
+    void setHandler(H* handler)
+    {
+        handler_ = handler;
+        applyHandler_ = [](void* h, TcpConnection* conn) { conn->setHandler(static_cast<H*>(h)); };
+    }
+    //监听Unix域地址时，允许客户端通过ShmTransport握手改走共享内存，普通客户端不受影响
+    void setShmTransport(bool on){ shmTransport_ = on; }
+
+    //连接数和accept速率的限制，在start之前配置，默认不限制
+    AdmissionControl* admissionControl() { return &admission_; }
+    //kStopAccept时暂停accept的次数
+    uint64_t acceptPauses() const { return acceptPauses_; }
 
     //开启服务器监听
     void start();
+
+    /**
+     * 汇总所有连接的流量统计并采样TCP_INFO，每个subloop在自己的线程里读自己的连接，全部完成以后在baseloop中回调cb
+     * perConnection为true时同时带上每个连接的明细；可以在任意线程调用，回调之前TcpServer不能析构
+    */
+    void collectStats(const StatsCallback& cb, bool perConnection = false);
+    //每seconds秒collectStats一次，0表示停止，在baseloop线程中调用
+    void setStatsInterval(double seconds, const StatsCallback& cb, bool perConnection = false);
+
+    /**
+     * 合并所有subloop的请求延迟直方图，请求需要用TcpConnection::markResponse标记(RpcServer和ResponseSequencer已经标记)
+     * 直方图按loop统计，loop被多个服务器共用时包括其他服务器的请求；可以在任意线程调用
+    */
+    LatencyHistogram::Snapshot requestLatency();
+    //每seconds秒报告一次这段时间内的请求延迟，默认写INFO日志(p50/p90/p99/p999/max)，0表示停止，在baseloop线程中调用
+    void setLatencyReportInterval(double seconds, const LatencyReportCallback& cb = LatencyReportCallback());
+
+    /**
+     * 热重启的旧进程：在path上等待新进程，新进程连上以后把监听socket交给它并停止accept，
+     * 空闲的连接(输出缓冲区为空)连同已经读到的数据一起交过去，其余连接发完数据后关闭写端，
+     * drainSeconds秒后还没有结束的连接强制关闭，全部处理完以后在baseloop中调用doneCallback
+    */
+    void enableHandoff(const std::string& path, double drainSeconds, const std::function<void()>& doneCallback);
+    //热重启的新进程：继续从控制通道接收旧进程交过来的连接，在start之前调用
+    void takeOverConnections(int controlFd);
+
+    EventLoop* getLoop() const { return loop_; }
+    const std::string& name() const { return name_; }
+    std::shared_ptr<EventLoopThreadPool> threadPool() { return threadPool_; }
 private:
     using ConnectionMap = std::unordered_map<std::string, TcpConnectionPtr>;
 
-    void newConnection(int sockfd, const InetAddress& peerAddr);
+    //input不为空时是热重启带过来的连接已经读到的数据
+    void newConnection(int sockfd, const InetAddress& peerAddr, const std::string* input);
+    void handleHandoffAccept();
+    void handleHandoffMessage();
+    void handOffConnection(const TcpConnectionPtr& conn);
+    void sendHandoffConnection(const TcpConnectionPtr& conn, const std::string& input);
+    void finishHandoff();
     void removeConnection(const TcpConnectionPtr& conn);
-    void removeConnectionInLoop(const TcpConnectionPtr& conn);
+    void removeConnectionInLoop(const TcpConnectionPtr& conn, const ConnectionStats& stats);
+    void collectStatsInLoop(const StatsCallback& cb, bool perConnection);
+    void reportLatency(const LatencyReportCallback& cb);
+    //根据准入控制的状态暂停或者恢复accept
+    void updateAccepting();
 
     EventLoop* loop_;//baseloop 用户定义的loop
     const std::string ipPort_;
@@ -54,10 +114,34 @@ private:
     ConnectionCallback connectionCallback_;//有新连接的时候的回调
     MessageCallback messageCallback_;//有读写消息时候的回调
     WriteCompleteCallback writeCompleteCallback_;//消息写完以后的回调
+    void* handler_;
+    void (*applyHandler_)(void*, TcpConnection*);
 
     ThreadInitCallback threadInitCallback_;//线程初始化回调
     std::atomic_int started_;
+    bool shmTransport_;
 
     int nextConnId_;
     ConnectionMap connections_;//保存所有的连接
+
+    AdmissionControl admission_;
+    bool acceptPaused_;
+    TimerId acceptRetryTimer_;//因为accept速率暂停时，令牌补充以后重新检查
+    uint64_t acceptPauses_;
+
+    TrafficTotals closedTraffic_;//已经关闭的连接的流量合计，只在baseloop中访问
+    TimerId statsTimer_;
+    TimerId latencyTimer_;
+    std::unique_ptr<LatencyHistogram::Snapshot> lastLatency_;//上一次报告时的累计值
+
+    //热重启，handoffChannel_等待下一个进程连上来，predecessorChannel_接收上一个进程交过来的连接
+    std::unique_ptr<Channel> handoffChannel_;
+    std::string handoffPath_;//handoffChannel_监听的路径，交给下一个进程之前一直由这个进程负责删除
+    std::unique_ptr<Channel> predecessorChannel_;
+    double drainSeconds_;
+    std::function<void()> handoffDoneCallback_;
+    bool handingOff_;
+    bool handoffFinished_;
+    TimerId handoffTimer_;//drainSeconds_到期强制结束交接
+    int handoffControlFd_;//非阻塞，只在baseloop中使用，subloop要交出的连接转到baseloop发送
 };
\ No newline at end of file
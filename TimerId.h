@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdint.h>
+
+class Timer;
+
+//对用户暴露的定时器标识，只用于EventLoop::cancel
+class TimerId
+{
+public:
+    TimerId():timer_(nullptr), sequence_(0) {}
+    TimerId(Timer* timer, int64_t seq):timer_(timer), sequence_(seq) {}
+
+    bool valid() const { return timer_ != nullptr; }
+
+    friend class TimerQueue;
+private:
+    Timer* timer_;
+    int64_t sequence_;
+};
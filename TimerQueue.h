@@ -0,0 +1,53 @@
+#pragma once
+
+#include <set>
+#include <vector>
+#include <utility>
+
+#include "noncopyable.h"
+#include "Timestamp.h"
+#include "Callbacks.h"
+#include "Channel.h"
+#include "TimerId.h"
+
+class EventLoop;
+class Timer;
+
+/**
+ * 基于timerfd的定时器队列，timerfd作为一个普通的Channel注册到所属loop的poller上
+ * 定时器按到期时间排序，timerfd总是设置为最早到期的那个时间点
+ * 所有成员函数只在所属loop线程中执行，addTimer/cancel可以跨线程调用
+*/
+class TimerQueue:noncopyable
+{
+public:
+    explicit TimerQueue(EventLoop* loop);
+    ~TimerQueue();
+
+    TimerId addTimer(TimerCallback cb, Timestamp when, double interval);
+    void cancel(TimerId timerId);
+private:
+    using Entry = std::pair<Timestamp, Timer*>;
+    using TimerList = std::set<Entry>;
+    using ActiveTimer = std::pair<Timer*, int64_t>;
+    using ActiveTimerSet = std::set<ActiveTimer>;
+
+    void addTimerInLoop(Timer* timer);
+    void cancelInLoop(TimerId timerId);
+    //timerfd可读，处理所有到期的定时器
+    void handleRead();
+    //取出所有到期的定时器
+    std::vector<Entry> getExpired(Timestamp now);
+    //重复定时器重新加入队列，重新设置timerfd
+    void reset(const std::vector<Entry>& expired, Timestamp now);
+    bool insert(Timer* timer);
+
+    EventLoop* loop_;
+    const int timerfd_;
+    Channel timerfdChannel_;
+    TimerList timers_;//按到期时间排序
+
+    ActiveTimerSet activeTimers_;//和timers_保存相同的定时器，按地址排序，用于cancel
+    bool callingExpiredTimers_;
+    ActiveTimerSet cancelingTimers_;//回调执行期间被取消的定时器
+};
@@ -1,4 +1,5 @@
 #include <time.h>
+#include <sys/time.h>
 
 #include "Timestamp.h"
 
@@ -10,13 +11,16 @@ Timestamp::Timestamp(int64_t microSecondsSinceEpoch)
 
 Timestamp Timestamp::now()
 {
-    return Timestamp(time(NULL));
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return Timestamp(static_cast<int64_t>(tv.tv_sec) * kMicroSecondsPerSecond + tv.tv_usec);
 }
 
 std::string Timestamp::toString() const
 {
     char buf[128] = {0};
-    tm* tm_time = localtime(&microSecondsSinceEpoch_);
+    time_t seconds = static_cast<time_t>(microSecondsSinceEpoch_ / kMicroSecondsPerSecond);
+    tm* tm_time = localtime(&seconds);
     snprintf(buf, 128, "%4d-%02d-%02d %02d:%02d:%02d", 
         tm_time->tm_year + 1900, tm_time->tm_mon + 1, 
         tm_time->tm_mday, tm_time->tm_hour, 
@@ -30,4 +34,4 @@ std::string Timestamp::toString() const
 // {
 //     std::cout << Timestamp::now().toString() << std::endl;
 //     return 0;
-// }
\ No newline at end of file
+// }
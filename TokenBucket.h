@@ -0,0 +1,89 @@
+#pragma once
+
+#include <algorithm>
+
+#include "Timestamp.h"
+
+/**
+ * 令牌桶，每秒补充rate个令牌，最多攒burst个，rate<=0表示不限速
+ * 不是线程安全的，只在所属的loop线程中使用，时间由调用者传入，一次poll返回后的多次检查可以共用同一个now
+*/
+class TokenBucket
+{
+public:
+    TokenBucket(double rate = 0, double burst = 0)
+    {
+        reset(rate, burst);
+    }
+
+    void reset(double rate, double burst)
+    {
+        rate_ = rate;
+        burst_ = std::max(burst, 1.0);
+        tokens_ = burst_;
+        last_ = 0;
+    }
+
+    bool enabled() const { return rate_ > 0; }
+    double rate() const { return rate_; }
+
+    //令牌够n个就取走并返回true，否则什么都不做
+    bool tryConsume(double n, Timestamp now)
+    {
+        if (!enabled())
+        {
+            return true;
+        }
+        refill(now);
+        if (tokens_ < n)
+        {
+            return false;
+        }
+        tokens_ -= n;
+        return true;
+    }
+
+    //无条件取走n个，令牌可以变成负数，之后要等补回来才能继续，用于事后才知道大小的字节数
+    void consume(double n, Timestamp now)
+    {
+        if (enabled())
+        {
+            refill(now);
+            tokens_ -= n;
+        }
+    }
+
+    //当前可用的令牌数，欠账时是负数
+    double available(Timestamp now)
+    {
+        refill(now);
+        return tokens_;
+    }
+
+    //还要多少秒才能攒够n个令牌，已经够了返回0
+    double secondsUntil(double n, Timestamp now)
+    {
+        if (!enabled())
+        {
+            return 0;
+        }
+        refill(now);
+        return tokens_ >= n ? 0 : (n - tokens_) / rate_;
+    }
+
+private:
+    void refill(Timestamp now)
+    {
+        int64_t us = now.microSecondsSinceEpoch();
+        if (last_ != 0 && us > last_)
+        {
+            tokens_ = std::min(burst_, tokens_ + (us - last_) * rate_ / 1000000);
+        }
+        last_ = std::max(last_, us);
+    }
+
+    double rate_;
+    double burst_;
+    double tokens_;
+    int64_t last_;//上次补充的时间，微秒
+};
@@ -0,0 +1,76 @@
+#include <algorithm>
+#include <limits>
+
+#include "TrafficShaper.h"
+
+TrafficGroup::TrafficGroup(double readRate, double readBurst, double writeRate, double writeBurst)
+    :read_(readRate, readBurst),
+    write_(writeRate, writeBurst)
+{
+}
+
+double TrafficGroup::available(bool read, Timestamp now)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    TokenBucket& bucket = read ? read_ : write_;
+    return bucket.available(now);
+}
+
+double TrafficGroup::consume(bool read, double n, Timestamp now)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    TokenBucket& bucket = read ? read_ : write_;
+    bucket.consume(n, now);
+    return bucket.secondsUntil(1, now);
+}
+
+TrafficShaper::TrafficShaper()
+    :readPauses_(0),
+    writePauses_(0)
+{
+}
+
+size_t TrafficShaper::writeAllowance(Timestamp now)
+{
+    double allowed = std::numeric_limits<double>::max();
+    if (write_.enabled())
+    {
+        allowed = write_.available(now);
+    }
+    if (group_ && group_->writeLimited())
+    {
+        allowed = std::min(allowed, group_->available(false, now));
+    }
+    if (allowed < 1)
+    {
+        return 0;
+    }
+    return allowed >= static_cast<double>(std::numeric_limits<size_t>::max()) ? std::numeric_limits<size_t>::max() : static_cast<size_t>(allowed);
+}
+
+double TrafficShaper::consumeRead(size_t n, Timestamp now)
+{
+    read_.consume(static_cast<double>(n), now);
+    double wait = read_.secondsUntil(1, now);
+    if (group_ && group_->readLimited())
+    {
+        wait = std::max(wait, group_->consume(true, static_cast<double>(n), now));
+    }
+    return wait;
+}
+
+double TrafficShaper::consumeWrite(size_t n, Timestamp now)
+{
+    write_.consume(static_cast<double>(n), now);
+    double wait = write_.secondsUntil(1, now);
+    if (group_ && group_->writeLimited())
+    {
+        wait = std::max(wait, group_->consume(false, static_cast<double>(n), now));
+    }
+    return wait;
+}
+
+double TrafficShaper::writeWait(Timestamp now)
+{
+    return consumeWrite(0, now);
+}
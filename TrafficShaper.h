@@ -0,0 +1,66 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+
+#include "noncopyable.h"
+#include "TokenBucket.h"
+
+/**
+ * 一组连接(同一个租户)共享的收发带宽限额，组内连接可以分布在不同的subloop上，所以用锁保护
+ * 每次read/write系统调用结算一次，不是每个字节
+*/
+class TrafficGroup : noncopyable
+{
+public:
+    //字节每秒，0表示这个方向不限制；burst是允许的突发字节数
+    TrafficGroup(double readRate, double readBurst, double writeRate, double writeBurst);
+
+    bool readLimited() const { return read_.enabled(); }
+    bool writeLimited() const { return write_.enabled(); }
+
+    double available(bool read, Timestamp now);
+    //记账并返回还要等多少秒才有可用的额度，0表示不用等
+    double consume(bool read, double n, Timestamp now);
+private:
+    std::mutex mutex_;
+    TokenBucket read_;
+    TokenBucket write_;
+};
+
+/**
+ * 一个连接的收发限速，连接自己的令牌桶加上所属组的令牌桶，两者都要有额度才能收发
+ * 只在连接所属的loop线程中使用
+*/
+class TrafficShaper : noncopyable
+{
+public:
+    TrafficShaper();
+
+    void setReadLimit(double rate, double burst) { read_.reset(rate, burst); }
+    void setWriteLimit(double rate, double burst) { write_.reset(rate, burst); }
+    void setGroup(const std::shared_ptr<TrafficGroup>& group) { group_ = group; }
+
+    bool readLimited() const { return read_.enabled() || (group_ && group_->readLimited()); }
+    bool writeLimited() const { return write_.enabled() || (group_ && group_->writeLimited()); }
+
+    //这次最多可以发送多少字节
+    size_t writeAllowance(Timestamp now);
+    //收发了n字节以后记账，返回需要暂停的秒数，0表示不用暂停
+    double consumeRead(size_t n, Timestamp now);
+    double consumeWrite(size_t n, Timestamp now);
+    //额度用完时还要等多少秒
+    double writeWait(Timestamp now);
+
+    //因为限速暂停收发的次数
+    uint64_t readPauses() const { return readPauses_; }
+    uint64_t writePauses() const { return writePauses_; }
+    void countReadPause() { ++readPauses_; }
+    void countWritePause() { ++writePauses_; }
+private:
+    TokenBucket read_;
+    TokenBucket write_;
+    std::shared_ptr<TrafficGroup> group_;
+    uint64_t readPauses_;
+    uint64_t writePauses_;
+};
@@ -0,0 +1,249 @@
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <string.h>
+#include <errno.h>
+#include <algorithm>
+
+#include "UdpChannel.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+static int createNonblockingUdp()
+{
+    int sockfd = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_UDP);
+    if (sockfd < 0)
+    {
+        LOG_FATAL("%s %s %d udp socket create failed errno:%d.\n", __FILENAME__, __FUNCTION__, __LINE__, errno);
+    }
+    return sockfd;
+}
+
+UdpChannel::UdpChannel(EventLoop* loop, const InetAddress& bindAddr, bool reusePort, int batchSize, size_t maxDatagram)
+    :loop_(loop),
+    socket_(createNonblockingUdp()),
+    channel_(loop, socket_.fd()),
+    started_(false),
+    batchSize_(batchSize > 0 ? batchSize : 1),
+    maxDatagram_(maxDatagram),
+    rxBuffers_(batchSize_ * maxDatagram),
+    rxIovecs_(batchSize_),
+    rxAddrs_(batchSize_),
+    rxMsgs_(batchSize_),
+    maxQueued_(64 * 1024),
+    flushQueued_(false),
+    txIovecs_(batchSize_),
+    txMsgs_(batchSize_),
+    packetsReceived_(0),
+    packetsSent_(0),
+    recvBatches_(0),
+    sendBatches_(0),
+    packetsDropped_(0),
+    guard_(std::make_shared<UdpChannel*>(this))
+{
+    socket_.setReuseAddr(true);
+    socket_.setReusePort(reusePort);
+    socket_.bindAddress(bindAddr);
+
+    //每个mmsghdr固定指向自己的接收缓冲区和地址
+    for (int i = 0; i < batchSize_; ++i)
+    {
+        rxIovecs_[i].iov_base = &rxBuffers_[i * maxDatagram_];
+        rxIovecs_[i].iov_len = maxDatagram_;
+        memset(&rxMsgs_[i], 0, sizeof(mmsghdr));
+        rxMsgs_[i].msg_hdr.msg_iov = &rxIovecs_[i];
+        rxMsgs_[i].msg_hdr.msg_iovlen = 1;
+        rxMsgs_[i].msg_hdr.msg_name = &rxAddrs_[i];
+        rxMsgs_[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+        memset(&txMsgs_[i], 0, sizeof(mmsghdr));
+    }
+
+    channel_.setReadCallback(std::bind(&UdpChannel::handleRead, this, std::placeholders::_1));
+    channel_.setWriteCallback(std::bind(&UdpChannel::handleWrite, this));
+}
+
+UdpChannel::~UdpChannel()
+{
+    guard_.reset();
+    if (started_)
+    {
+        stop();
+    }
+}
+
+void UdpChannel::start()
+{
+    std::weak_ptr<UdpChannel*> guard(guard_);
+    loop_->runInLoop([guard]() {
+        std::shared_ptr<UdpChannel*> self(guard.lock());
+        if (self && !(*self)->started_)
+        {
+            (*self)->started_ = true;
+            (*self)->channel_.enableReading();
+        }
+    });
+}
+
+void UdpChannel::stop()
+{
+    if (started_)
+    {
+        started_ = false;
+        channel_.disableAll();
+        channel_.remove();
+    }
+}
+
+void UdpChannel::handleRead(Timestamp receiveTime)
+{
+    for (int round = 0; round < kMaxBatchesPerWakeup; ++round)
+    {
+        int n = ::recvmmsg(socket_.fd(), rxMsgs_.data(), batchSize_, MSG_DONTWAIT, nullptr);
+        if (n < 0)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            {
+                LOG_ERROR("%s %s %d recvmmsg error:%d\n", __FILENAME__, __FUNCTION__, __LINE__, errno);
+            }
+            break;
+        }
+
+        uint64_t truncated = 0;
+        for (int i = 0; i < n; ++i)
+        {
+            msghdr& hdr = rxMsgs_[i].msg_hdr;
+            if (hdr.msg_flags & MSG_TRUNC)
+            {
+                ++truncated;
+            }
+            else if (messageCallback_)
+            {
+                messageCallback_(this, static_cast<const char*>(rxIovecs_[i].iov_base), rxMsgs_[i].msg_len,
+                    InetAddress(rxAddrs_[i]), receiveTime);
+            }
+            //recvmmsg会改写namelen和flags，下次使用前恢复
+            hdr.msg_namelen = sizeof(sockaddr_in);
+            hdr.msg_flags = 0;
+        }
+        add(&packetsReceived_, n);
+        add(&recvBatches_, 1);
+        if (truncated > 0)
+        {
+            add(&packetsDropped_, truncated);
+        }
+
+        if (n < batchSize_)
+        {
+            break;
+        }
+    }
+}
+
+void UdpChannel::handleWrite()
+{
+    flushSendQueue();
+}
+
+void UdpChannel::send(const InetAddress& peer, const std::string& data)
+{
+    if (loop_->isInLoopThread())
+    {
+        send(peer, data.data(), data.size());
+    }
+    else
+    {
+        std::weak_ptr<UdpChannel*> guard(guard_);
+        loop_->runInLoop([guard, peer, data]() {
+            std::shared_ptr<UdpChannel*> self(guard.lock());
+            if (self)
+            {
+                (*self)->sendInLoop(peer, data);
+            }
+        });
+    }
+}
+
+void UdpChannel::sendInLoop(const InetAddress& peer, const std::string& data)
+{
+    send(peer, data.data(), data.size());
+}
+
+void UdpChannel::send(const InetAddress& peer, const char* data, size_t len)
+{
+    if (sendQueue_.size() >= maxQueued_)
+    {
+        add(&packetsDropped_, 1);
+        return;
+    }
+
+    sendQueue_.push_back(Datagram());
+    sendQueue_.back().peer = *peer.getSocketAddr();
+    sendQueue_.back().data.assign(data, len);
+
+    //本轮产生的所有数据报在pending functor阶段一起发送；正在等EPOLLOUT时由handleWrite发送
+    if (!flushQueued_ && !channel_.isWriting())
+    {
+        flushQueued_ = true;
+        std::weak_ptr<UdpChannel*> guard(guard_);
+        loop_->queueInLoop([guard]() {
+            std::shared_ptr<UdpChannel*> self(guard.lock());
+            if (self)
+            {
+                (*self)->flushSendQueue();
+            }
+        });
+    }
+}
+
+void UdpChannel::flushSendQueue()
+{
+    flushQueued_ = false;
+    while (!sendQueue_.empty())
+    {
+        int n = static_cast<int>(std::min(sendQueue_.size(), static_cast<size_t>(batchSize_)));
+        for (int i = 0; i < n; ++i)
+        {
+            Datagram& d = sendQueue_[i];
+            txIovecs_[i].iov_base = &d.data[0];
+            txIovecs_[i].iov_len = d.data.size();
+            msghdr& hdr = txMsgs_[i].msg_hdr;
+            hdr.msg_iov = &txIovecs_[i];
+            hdr.msg_iovlen = 1;
+            hdr.msg_name = &d.peer;
+            hdr.msg_namelen = sizeof(sockaddr_in);
+        }
+
+        int sent = ::sendmmsg(socket_.fd(), txMsgs_.data(), n, MSG_DONTWAIT);
+        if (sent < 0)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)
+            {
+                break;
+            }
+            //第一个数据报出错(例如目的地址不可达)，丢掉它继续发送后面的
+            LOG_ERROR("%s %s %d sendmmsg error:%d\n", __FILENAME__, __FUNCTION__, __LINE__, errno);
+            sendQueue_.pop_front();
+            add(&packetsDropped_, 1);
+            continue;
+        }
+
+        sendQueue_.erase(sendQueue_.begin(), sendQueue_.begin() + sent);
+        add(&packetsSent_, sent);
+        add(&sendBatches_, 1);
+        if (sent < n)
+        {
+            break;
+        }
+    }
+
+    if (!sendQueue_.empty())
+    {
+        if (!channel_.isWriting())
+        {
+            channel_.enableWriting();
+        }
+    }
+    else if (channel_.isWriting())
+    {
+        channel_.disableWriting();
+    }
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <functional>
+#include <string>
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <memory>
+
+#include "noncopyable.h"
+#include "InetAddress.h"
+#include "Socket.h"
+#include "Channel.h"
+#include "Timestamp.h"
+
+class EventLoop;
+
+/**
+ * 绑定在一个loop上的UDP socket
+ * 每次可读时用recvmmsg一次收取一批数据报，接收缓冲区预先分配好，不会为每个数据报分配内存
+ * 发送的数据报先进入队列，本轮事件处理完以后用sendmmsg一次发出，socket发送缓冲区满时注册EPOLLOUT等待
+ * 在loop线程中析构，析构以后还没执行的start/send/flush任务什么都不做
+*/
+class UdpChannel:noncopyable
+{
+public:
+    //data只在回调期间有效
+    using UdpMessageCallback = std::function<void(UdpChannel*, const char* data, size_t len,
+        const InetAddress& peer, Timestamp receiveTime)>;
+
+    static const int kDefaultBatchSize = 64;
+    static const size_t kDefaultMaxDatagram = 2048;
+
+    UdpChannel(EventLoop* loop, const InetAddress& bindAddr, bool reusePort,
+        int batchSize = kDefaultBatchSize, size_t maxDatagram = kDefaultMaxDatagram);
+    ~UdpChannel();
+
+    void setMessageCallback(const UdpMessageCallback& cb) { messageCallback_ = cb; }
+    //发送队列的上限，超过后新的数据报被丢弃
+    void setMaxQueuedDatagrams(size_t n) { maxQueued_ = n; }
+
+    //开始接收数据，可以跨线程调用
+    void start();
+    //从poller中移除，必须在loop线程中调用
+    void stop();
+
+    //发送一个数据报，可以跨线程调用
+    void send(const InetAddress& peer, const std::string& data);
+    //只能在loop线程中调用
+    void send(const InetAddress& peer, const char* data, size_t len);
+
+    EventLoop* getLoop() const { return loop_; }
+    int fd() const { return socket_.fd(); }
+
+    //统计信息，只有loop线程写，任意线程都可以读
+    uint64_t packetsReceived() const { return packetsReceived_.load(std::memory_order_relaxed); }
+    uint64_t packetsSent() const { return packetsSent_.load(std::memory_order_relaxed); }
+    uint64_t recvBatches() const { return recvBatches_.load(std::memory_order_relaxed); }
+    uint64_t sendBatches() const { return sendBatches_.load(std::memory_order_relaxed); }
+    uint64_t packetsDropped() const { return packetsDropped_.load(std::memory_order_relaxed); }
+private:
+    struct Datagram
+    {
+        sockaddr_in peer;
+        std::string data;
+    };
+
+    static const int kMaxBatchesPerWakeup = 4;//一次唤醒最多收几批，避免饿死同一loop上的其他channel
+
+    void handleRead(Timestamp receiveTime);
+    void handleWrite();
+    void sendInLoop(const InetAddress& peer, const std::string& data);
+    void flushSendQueue();
+    //单写者计数器，不需要原子的读改写
+    static void add(std::atomic<uint64_t>* counter, uint64_t n)
+    {
+        counter->store(counter->load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    EventLoop* loop_;
+    Socket socket_;
+    Channel channel_;
+    bool started_;
+    const int batchSize_;
+    const size_t maxDatagram_;
+    UdpMessageCallback messageCallback_;
+
+    //接收批次，预先分配
+    std::vector<char> rxBuffers_;
+    std::vector<iovec> rxIovecs_;
+    std::vector<sockaddr_in> rxAddrs_;
+    std::vector<mmsghdr> rxMsgs_;
+
+    //发送队列以及发送批次
+    std::deque<Datagram> sendQueue_;
+    size_t maxQueued_;
+    bool flushQueued_;
+    std::vector<iovec> txIovecs_;
+    std::vector<mmsghdr> txMsgs_;
+
+    std::atomic<uint64_t> packetsReceived_;
+    std::atomic<uint64_t> packetsSent_;
+    std::atomic<uint64_t> recvBatches_;
+    std::atomic<uint64_t> sendBatches_;
+    std::atomic<uint64_t> packetsDropped_;//被截断的接收数据报以及发送队列溢出/出错丢弃的数据报
+
+    //投递到loop的任务持有它的弱引用
+    std::shared_ptr<UdpChannel*> guard_;
+};
@@ -0,0 +1,91 @@
+#include <future>
+
+#include "UdpServer.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+UdpServer::UdpServer(EventLoop* loop, const InetAddress& listenAddr, const std::string& nameArg)
+    :loop_(loop),
+    listenAddr_(listenAddr),
+    name_(nameArg),
+    threadPool_(new EventLoopThreadPool(loop, nameArg)),
+    batchSize_(UdpChannel::kDefaultBatchSize),
+    maxDatagram_(UdpChannel::kDefaultMaxDatagram),
+    started_(false)
+{
+}
+
+UdpServer::~UdpServer()
+{
+    //UdpChannel必须在所属的loop线程中移除和析构，等待每个loop执行完毕
+    for (auto& channel : channels_)
+    {
+        std::unique_ptr<UdpChannel>* ch = &channel;
+        EventLoop* ioLoop = channel->getLoop();
+        if (ioLoop->isInLoopThread())
+        {
+            ch->reset();
+        }
+        else
+        {
+            std::shared_ptr<std::promise<void>> done(new std::promise<void>);
+            ioLoop->runInLoop([ch, done]() {
+                ch->reset();
+                done->set_value();
+            });
+            done->get_future().wait();
+        }
+    }
+}
+
+void UdpServer::start()
+{
+    if (started_)
+    {
+        return;
+    }
+    started_ = true;
+    threadPool_->start(threadInitCallback_);
+
+    std::vector<EventLoop*> loops = threadPool_->getAllLoops();
+    bool reusePort = loops.size() > 1;
+    for (EventLoop* ioLoop : loops)
+    {
+        UdpChannel* channel = new UdpChannel(ioLoop, listenAddr_, reusePort, batchSize_, maxDatagram_);
+        channel->setMessageCallback(messageCallback_);
+        channels_.push_back(std::unique_ptr<UdpChannel>(channel));
+        channel->start();
+    }
+    LOG_INFO("%s %s %d UdpServer %s listening on %s with %d sockets\n", __FILENAME__, __FUNCTION__, __LINE__,
+        name_.c_str(), listenAddr_.toIpPort().c_str(), (int)channels_.size());
+}
+
+uint64_t UdpServer::packetsReceived() const
+{
+    uint64_t total = 0;
+    for (const auto& channel : channels_)
+    {
+        total += channel->packetsReceived();
+    }
+    return total;
+}
+
+uint64_t UdpServer::packetsSent() const
+{
+    uint64_t total = 0;
+    for (const auto& channel : channels_)
+    {
+        total += channel->packetsSent();
+    }
+    return total;
+}
+
+uint64_t UdpServer::recvBatches() const
+{
+    uint64_t total = 0;
+    for (const auto& channel : channels_)
+    {
+        total += channel->recvBatches();
+    }
+    return total;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "noncopyable.h"
+#include "InetAddress.h"
+#include "UdpChannel.h"
+#include "EventLoopThreadPool.h"
+
+class EventLoop;
+
+/**
+ * UDP服务器，复用EventLoopThreadPool
+ * 每个subloop上创建一个UdpChannel，都用SO_REUSEPORT绑定在同一个地址上，由内核按四元组hash把数据报分给各个loop
+ * 同一个对端的数据报总是落在同一个loop上，回调里的UdpChannel*就是应答应该使用的channel
+*/
+class UdpServer:noncopyable
+{
+public:
+    using ThreadInitCallback = std::function<void(EventLoop*)>;
+    using UdpMessageCallback = UdpChannel::UdpMessageCallback;
+
+    UdpServer(EventLoop* loop, const InetAddress& listenAddr, const std::string& nameArg);
+    ~UdpServer();
+
+    void setThreadNum(int numThreads) { threadPool_->setThreadNum(numThreads); }
+    //每次recvmmsg最多收取的数据报个数
+    void setBatchSize(int batchSize) { batchSize_ = batchSize; }
+    void setMaxDatagramSize(size_t maxDatagram) { maxDatagram_ = maxDatagram; }
+    void setThreadInitCallback(const ThreadInitCallback& cb) { threadInitCallback_ = cb; }
+    void setMessageCallback(const UdpMessageCallback& cb) { messageCallback_ = cb; }
+
+    void start();
+
+    const std::string& name() const { return name_; }
+    //所有loop上收发数据报的合计
+    uint64_t packetsReceived() const;
+    uint64_t packetsSent() const;
+    uint64_t recvBatches() const;
+private:
+    EventLoop* loop_;
+    const InetAddress listenAddr_;
+    const std::string name_;
+    std::shared_ptr<EventLoopThreadPool> threadPool_;
+    int batchSize_;
+    size_t maxDatagram_;
+    bool started_;
+
+    ThreadInitCallback threadInitCallback_;
+    UdpMessageCallback messageCallback_;
+    std::vector<std::unique_ptr<UdpChannel>> channels_;
+};
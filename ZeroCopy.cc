@@ -0,0 +1,93 @@
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <linux/errqueue.h>
+#include <errno.h>
+
+#include "ZeroCopy.h"
+#include "Logger.h"
+
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+
+ZeroCopySender::ZeroCopySender()
+    :nextSeq_(0),
+    sends_(0),
+    copied_(0)
+{
+}
+
+bool ZeroCopySender::enable(int fd)
+{
+    int one = 1;
+    if (::setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) < 0)
+    {
+        LOG_ERROR("%s %s %d SO_ZEROCOPY not supported on fd %d, errno:%d\n", __FILENAME__, __FUNCTION__, __LINE__, fd, errno);
+        return false;
+    }
+    return true;
+}
+
+ssize_t ZeroCopySender::send(int fd, const SharedPayload& payload, size_t offset)
+{
+    const char* data = payload->data() + offset;
+    size_t len = payload->size() - offset;
+    ssize_t n = ::send(fd, data, len, MSG_ZEROCOPY | MSG_NOSIGNAL);
+    if (n >= 0)
+    {
+        //部分发送也占用一个序号，内核引用的是已经发出去的那一段
+        pins_.push_back(Pin{nextSeq_++, payload});
+        ++sends_;
+    }
+    else if (errno == ENOBUFS)
+    {
+        n = ::send(fd, data, len, MSG_NOSIGNAL);
+    }
+    return n;
+}
+
+bool ZeroCopySender::drainCompletions(int fd)
+{
+    bool handled = false;
+    for (;;)
+    {
+        char control[128];
+        msghdr msg = {};
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (::recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+        {
+            break;
+        }
+        for (cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm))
+        {
+            bool recverr = (cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR)
+                || (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR);
+            if (!recverr)
+            {
+                continue;
+            }
+            const sock_extended_err* err = reinterpret_cast<const sock_extended_err*>(CMSG_DATA(cm));
+            if (err->ee_errno != 0 || err->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+            {
+                continue;
+            }
+            //[ee_info, ee_data]这一段序号的发送已经完成，TCP上的通知按顺序到达
+            uint32_t lo = err->ee_info;
+            uint32_t hi = err->ee_data;
+            if (err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+            {
+                copied_ += hi - lo + 1;
+            }
+            while (!pins_.empty() && static_cast<int32_t>(pins_.front().seq - hi) <= 0)
+            {
+                pins_.pop_front();
+            }
+            handled = true;
+        }
+    }
+    return handled;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <deque>
+
+#include "noncopyable.h"
+#include "Callbacks.h"
+
+/**
+ * 一个socket上的MSG_ZEROCOPY发送：内核直接引用用户内存里的数据，发送完成以后通过socket的错误队列通知
+ * 每次成功的zerocopy发送占用一个递增的序号，完成通知给出一段序号区间，区间内的payload在这之前必须保持不变，
+ * 这里持有payload的引用直到收到通知，通知到达时loop会收到EPOLLERR
+ * 只在连接所属的loop线程中使用
+*/
+class ZeroCopySender : noncopyable
+{
+public:
+    ZeroCopySender();
+
+    //给socket打开SO_ZEROCOPY，内核不支持时返回false
+    static bool enable(int fd);
+
+    //从payload的offset开始发送，返回发送的字节数，失败返回-1并设置errno
+    //optmem不够(ENOBUFS)时这一次退回普通的拷贝发送
+    ssize_t send(int fd, const SharedPayload& payload, size_t offset);
+    //读取错误队列里的完成通知，释放已经发送完成的payload，处理过通知返回true
+    bool drainCompletions(int fd);
+
+    size_t pinned() const { return pins_.size(); }
+    uint64_t zeroCopySends() const { return sends_; }
+    //内核没能避免拷贝的发送次数(比如loopback上的接收方、不支持SG的网卡)
+    uint64_t copiedSends() const { return copied_; }
+private:
+    struct Pin
+    {
+        uint32_t seq;
+        SharedPayload payload;
+    };
+
+    std::deque<Pin> pins_;
+    uint32_t nextSeq_;
+    uint64_t sends_;
+    uint64_t copied_;
+};
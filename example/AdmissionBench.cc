@@ -0,0 +1,235 @@
+#include <Kenmuduo/TcpServer.h>
+#include <Kenmuduo/TcpConnection.h>
+#include <Kenmuduo/Logger.h>
+#include "BenchUtil.h"
+
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+/**
+ * 过载时准入控制对正常客户端延迟的影响
+ * 服务器每个64字节的请求消耗workUs微秒CPU后原样返回
+ * 探测客户端在过载开始之前就连上，每毫秒发一个请求统计延迟；压测线程维持floodConns个连接，
+ * 每个连接始终有一个请求在途，连接被关闭后等10ms重连
+ * none：不限制；close：超限的新连接立即关闭；stop：超限时暂停accept
+ * AdmissionBench [port] [seconds] [floodConns] [maxConnections] [workUs]
+*/
+static const size_t kMessageSize = 64;
+
+static int connectNonblocking(uint16_t port)
+{
+    InetAddress addr(port);
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (::connect(fd, addr.getSockAddr(), addr.getSockAddrLen()) < 0 && errno != EINPROGRESS)
+    {
+        ::close(fd);
+        return -1;
+    }
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+//每个连接一个在途请求，连上(可写)以后发第一个，收到完整响应再发下一个
+static void flood(uint16_t port, int conns, std::atomic<bool>* stop, std::atomic<long>* served)
+{
+    struct Conn
+    {
+        int fd;
+        size_t got;
+        int64_t reconnectAt;
+    };
+    int epfd = ::epoll_create1(EPOLL_CLOEXEC);
+    std::vector<Conn> all(conns, Conn{-1, 0, 0});
+    char request[kMessageSize] = {'f'};
+    auto closeConn = [&](Conn& c) {
+        ::close(c.fd);
+        c.fd = -1;
+        c.reconnectAt = nowNs() + 10 * 1000 * 1000;
+    };
+    std::vector<epoll_event> events(conns);
+    while (!*stop)
+    {
+        int64_t now = nowNs();
+        for (int i = 0; i < conns; ++i)
+        {
+            Conn& c = all[i];
+            if (c.fd < 0 && now >= c.reconnectAt && (c.fd = connectNonblocking(port)) >= 0)
+            {
+                c.got = 0;
+                epoll_event ev;
+                ev.events = EPOLLIN | EPOLLOUT;
+                ev.data.u32 = i;
+                ::epoll_ctl(epfd, EPOLL_CTL_ADD, c.fd, &ev);
+            }
+        }
+        int n = ::epoll_wait(epfd, events.data(), conns, 1);
+        for (int k = 0; k < n; ++k)
+        {
+            Conn& c = all[events[k].data.u32];
+            if (c.fd < 0)
+            {
+                continue;
+            }
+            if (events[k].events & (EPOLLERR | EPOLLHUP))
+            {
+                closeConn(c);
+                continue;
+            }
+            if (events[k].events & EPOLLOUT)
+            {
+                //连接完成，发出第一个请求，之后只关心可读
+                epoll_event ev;
+                ev.events = EPOLLIN;
+                ev.data.u32 = events[k].data.u32;
+                ::epoll_ctl(epfd, EPOLL_CTL_MOD, c.fd, &ev);
+                if (::send(c.fd, request, sizeof(request), MSG_NOSIGNAL) != sizeof(request))
+                {
+                    closeConn(c);
+                    continue;
+                }
+            }
+            if (events[k].events & EPOLLIN)
+            {
+                char buf[kMessageSize];
+                ssize_t r = ::read(c.fd, buf, sizeof(buf) - c.got);
+                if (r <= 0)
+                {
+                    if (r == 0 || errno != EAGAIN)
+                    {
+                        closeConn(c);
+                    }
+                    continue;
+                }
+                c.got += r;
+                if (c.got == kMessageSize)
+                {
+                    c.got = 0;
+                    ++*served;
+                    if (::send(c.fd, request, sizeof(request), MSG_NOSIGNAL) != sizeof(request))
+                    {
+                        closeConn(c);
+                    }
+                }
+            }
+        }
+    }
+    for (Conn& c : all)
+    {
+        if (c.fd >= 0)
+        {
+            ::close(c.fd);
+        }
+    }
+    ::close(epfd);
+}
+
+static void run(const char* mode, uint16_t port, double seconds, int floodConns, size_t maxConnections, int workUs)
+{
+    EventLoop* serverLoop = nullptr;
+    TcpServer* serverPtr = nullptr;
+    std::atomic<bool> ready(false);
+    std::thread serverThread([&]() {
+        EventLoop loop;
+        TcpServer server(&loop, InetAddress(port), "admission");
+        if (mode[0] != 'n')
+        {
+            AdmissionControl* admission = server.admissionControl();
+            admission->setMaxConnections(maxConnections);
+            admission->setMaxConnectionsPerPeer(maxConnections);
+            admission->setAcceptRate(1000, 100);
+            admission->setOverloadAction(mode[0] == 's' ? AdmissionControl::kStopAccept : AdmissionControl::kCloseNew);
+        }
+        server.setThreadNum(2);
+        server.setConnectionCallback([](const TcpConnectionPtr& conn) {
+            if (conn->connected())
+            {
+                conn->setTcpNoDelay(true);
+            }
+        });
+        server.setMessageCallback([workUs](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+            while (buf->readableBytes() >= kMessageSize)
+            {
+                burnCpu(workUs * 1000);
+                conn->send(buf->peek(), kMessageSize);
+                buf->retrieve(kMessageSize);
+            }
+        });
+        server.start();
+        serverLoop = &loop;
+        serverPtr = &server;
+        ready = true;
+        loop.loop();
+    });
+    while (!ready)
+    {
+        usleep(1000);
+    }
+
+    int probe = connectTo(port);
+    usleep(50 * 1000);
+
+    std::atomic<bool> stop(false);
+    std::atomic<long> served(0);
+    std::thread floodThread(flood, port, floodConns, &stop, &served);
+
+    std::vector<int64_t> latencies;
+    int64_t end = nowNs() + static_cast<int64_t>(seconds * 1e9);
+    while (nowNs() < end)
+    {
+        char buf[kMessageSize] = {'p'};
+        int64_t start = nowNs();
+        if (::write(probe, buf, sizeof(buf)) != sizeof(buf))
+        {
+            break;
+        }
+        readExactly(probe, buf, sizeof(buf));
+        latencies.push_back(nowNs() - start);
+        usleep(1000);
+    }
+    stop = true;
+    floodThread.join();
+    ::close(probe);
+
+    usleep(100 * 1000);
+    AdmissionControl* admission = serverPtr->admissionControl();
+    unsigned long long rejected = 0;
+    for (int r = 0; r < AdmissionControl::kNumReasons; ++r)
+    {
+        rejected += admission->rejected(static_cast<AdmissionControl::Reason>(r));
+    }
+    unsigned long long pauses = serverPtr->acceptPauses();
+    serverLoop->quit();
+    serverThread.join();
+
+    std::sort(latencies.begin(), latencies.end());
+    size_t n = latencies.size();
+    printf("%-6s probe p50=%-8.1f p99=%-8.1f max=%-8.1f us  flood req/s=%-8.0f rejected=%-6llu accept pauses=%llu\n",
+        mode, latencies[n / 2] / 1e3, latencies[n * 99 / 100] / 1e3, latencies[n - 1] / 1e3, served / seconds, rejected, pauses);
+}
+
+int main(int argc, char* argv[])
+{
+    uint16_t port = static_cast<uint16_t>(argc > 1 ? atoi(argv[1]) : 9960);
+    double seconds = argc > 2 ? atof(argv[2]) : 3;
+    int floodConns = argc > 3 ? atoi(argv[3]) : 500;
+    size_t maxConnections = static_cast<size_t>(argc > 4 ? atoi(argv[4]) : 16);
+    int workUs = argc > 5 ? atoi(argv[5]) : 20;
+
+    run("none", port, seconds, floodConns, maxConnections, workUs);
+    run("close", static_cast<uint16_t>(port + 1), seconds, floodConns, maxConnections, workUs);
+    run("stop", static_cast<uint16_t>(port + 2), seconds, floodConns, maxConnections, workUs);
+    return 0;
+}
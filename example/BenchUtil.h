@@ -0,0 +1,81 @@
+#pragma once
+
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/**
+ * 压测程序共用的小工具，只依赖系统头文件，不链接Kenmuduo的压测程序也可以用
+ * 出错时直接打印并退出，压测程序不需要恢复
+*/
+
+inline int64_t nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+//忙等ns纳秒，模拟处理函数里的计算
+inline void burnCpu(int64_t ns)
+{
+    int64_t end = nowNs() + ns;
+    while (nowNs() < end)
+    {
+    }
+}
+
+//当前线程消耗的用户态加内核态CPU时间
+inline double threadCpuSeconds()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_THREAD, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+//阻塞连接127.0.0.1:port并打开TCP_NODELAY，rcvbuf大于0时在connect之前设置接收缓冲区，这样才能限制窗口
+inline int connectTo(uint16_t port, int rcvbuf = 0)
+{
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (rcvbuf > 0)
+    {
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    }
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+    {
+        perror("connect");
+        exit(1);
+    }
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+//阻塞读满len字节，对端关闭或者出错时退出
+inline void readExactly(int fd, char* data, size_t len)
+{
+    size_t got = 0;
+    while (got < len)
+    {
+        ssize_t n = ::read(fd, data + got, len - got);
+        if (n <= 0)
+        {
+            perror("read");
+            exit(1);
+        }
+        got += n;
+    }
+}
@@ -0,0 +1,126 @@
+#include <Kenmuduo/Buffer.h>
+#include <Kenmuduo/ByteSearch.h>
+#include "BenchUtil.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <functional>
+
+/**
+ * Buffer查找原语的微基准
+ * 1.单次查找：分隔符位于数据末尾，对比std::search、memchr和各个向量实现
+ * 2.分段到达：一行数据按chunk分多次readFd进来，对比每次从头std::search和scanCRLF续查
+*/
+static const char kCRLF[] = "\r\n";
+static volatile const char* g_sink;
+
+//返回每次调用的纳秒数
+static double timeIt(size_t iterations, const std::function<const char*()>& fn)
+{
+    int64_t start = nowNs();
+    for (size_t i = 0; i < iterations; ++i)
+    {
+        g_sink = fn();
+    }
+    return static_cast<double>(nowNs() - start) / iterations;
+}
+
+static void printRow(const char* what, size_t len, double ns)
+{
+    printf("  %-22s %8.1f ns  %8.2f GB/s\n", what, ns, ns > 0 ? len / ns : 0.0);
+}
+
+//crDense为true时每8个字节出现一个单独的'\r'，先memchr('\r')再检查的做法会频繁退出
+static void benchSingleSearch(size_t len, bool crDense)
+{
+    //填充不含分隔符的文本，最后放CRLF
+    std::string data(len, 'a');
+    for (size_t i = 0; i < len; ++i)
+    {
+        data[i] = (crDense && i % 8 == 7) ? '\r' : static_cast<char>('a' + i % 26);
+    }
+    data[len - 2] = '\r';
+    data[len - 1] = '\n';
+    const char* begin = data.data();
+    const char* end = begin + data.size();
+    size_t iterations = std::max<size_t>(1000, (64u << 20) / len);
+
+    printf("len=%zu%s iterations=%zu\n", len, crDense ? " cr-dense" : "", iterations);
+    printRow("std::search CRLF", len, timeIt(iterations, [=]() {
+        const char* p = std::search(begin, end, kCRLF, kCRLF + 2);
+        return p == end ? nullptr : p;
+    }));
+    printRow("memchr '\\n'", len, timeIt(iterations, [=]() {
+        return static_cast<const char*>(memchr(begin, '\n', end - begin));
+    }));
+
+    const ByteSearch::Impl* impls[] = {ByteSearch::scalarImpl(), ByteSearch::sse2Impl(), ByteSearch::avx2Impl()};
+    for (const ByteSearch::Impl* impl : impls)
+    {
+        if (impl == nullptr)
+        {
+            continue;
+        }
+        std::string name(impl->name);
+        printRow((name + " findCRLF").c_str(), len, timeIt(iterations, [=]() {
+            return impl->findCRLF(begin, end);
+        }));
+        printRow((name + " findByte").c_str(), len, timeIt(iterations, [=]() {
+            return impl->findByte(begin, end, '\n');
+        }));
+        printRow((name + " findAnyOf(4)").c_str(), len, timeIt(iterations, [=]() {
+            return impl->findAnyOf(begin, end, "\r\n ;", 4);
+        }));
+    }
+}
+
+//一行长为lineLen的数据按chunk大小分批到达，每到一批查找一次
+static void benchPartialReads(size_t lineLen, size_t chunk)
+{
+    std::string line(lineLen - 2, 'x');
+    line += "\r\n";
+    const int rounds = 20;
+
+    int64_t rescanNs = 0;
+    int64_t resumeNs = 0;
+    for (int r = 0; r < rounds; ++r)
+    {
+        Buffer rescan;
+        Buffer resume;
+        size_t scanned = 0;
+        for (size_t off = 0; off < line.size(); off += chunk)
+        {
+            size_t n = std::min(chunk, line.size() - off);
+            rescan.append(line.data() + off, n);
+            resume.append(line.data() + off, n);
+
+            int64_t t0 = nowNs();
+            const char* end = rescan.peek() + rescan.readableBytes();
+            g_sink = std::search(rescan.peek(), end, kCRLF, kCRLF + 2);
+            int64_t t1 = nowNs();
+            g_sink = resume.scanCRLF(&scanned);
+            int64_t t2 = nowNs();
+            rescanNs += t1 - t0;
+            resumeNs += t2 - t1;
+        }
+    }
+    printf("line=%zu chunk=%zu  rescan std::search %.1f us/line  scanCRLF %.1f us/line\n",
+        lineLen, chunk, rescanNs / 1000.0 / rounds, resumeNs / 1000.0 / rounds);
+}
+
+int main()
+{
+    printf("active implementation: %s\n", ByteSearch::active().name);
+    size_t lens[] = {64, 1024, 16 * 1024, 256 * 1024};
+    for (size_t len : lens)
+    {
+        benchSingleSearch(len, false);
+    }
+    benchSingleSearch(16 * 1024, true);
+    benchPartialReads(64 * 1024, 512);
+    benchPartialReads(1024 * 1024, 4096);
+    return 0;
+}
@@ -0,0 +1,145 @@
+#include <Kenmuduo/TcpServer.h>
+#include <Kenmuduo/TcpConnection.h>
+#include <Kenmuduo/Logger.h>
+#include "BenchUtil.h"
+
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <strings.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+/**
+ * EventLoop阻塞模式和忙轮询模式的ping-pong往返延迟对比
+ * 服务端在子进程中运行，客户端也是一个EventLoop，两边使用相同的模式，每次只有一个消息在途
+ * 忙轮询需要两边各有一个独占的核心，核心数不够时自旋会和对端抢CPU，结果反而更差
+ * BusyPollBench [port] [iterations] [spinUs] [soBusyPollUs]
+*/
+static void runServer(const InetAddress& addr, int spinUs, int soBusyPollUs)
+{
+    EventLoop loop;
+    loop.setBusyPoll(spinUs);
+    TcpServer server(&loop, addr, "echo");
+    server.setConnectionCallback([soBusyPollUs](const TcpConnectionPtr& conn) {
+        if (conn->connected())
+        {
+            conn->setTcpNoDelay(true);
+            if (soBusyPollUs > 0)
+            {
+                conn->setBusyPoll(soBusyPollUs);
+            }
+        }
+    });
+    server.setMessageCallback([](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+        conn->send(buf->retrieveAllAsString());
+    });
+    server.start();
+    loop.loop();
+}
+
+//普通的阻塞connect，建立以后交给TcpConnection
+static TcpConnectionPtr connectPlain(EventLoop* loop, const InetAddress& addr)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (::connect(fd, addr.getSockAddr(), addr.getSockAddrLen()) < 0)
+    {
+        perror("connect");
+        exit(1);
+    }
+    ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+    sockaddr_storage local;
+    bzero(&local, sizeof(local));
+    socklen_t len = sizeof(local);
+    ::getsockname(fd, (sockaddr*)&local, &len);
+    InetAddress localAddr;
+    localAddr.setSockAddr((sockaddr*)&local, len);
+    return TcpConnectionPtr(new TcpConnection(loop, "client", fd, localAddr, addr));
+}
+
+static void pingPong(const InetAddress& addr, int iterations, int spinUs, int soBusyPollUs)
+{
+    pid_t child = fork();
+    if (child == 0)
+    {
+        runServer(addr, spinUs, soBusyPollUs);
+        exit(0);
+    }
+    usleep(200 * 1000);
+
+    EventLoop loop;
+    loop.setBusyPoll(spinUs);
+    TcpConnectionPtr conn = connectPlain(&loop, addr);
+    const std::string message(64, 'p');
+    std::vector<int64_t> rtts;
+    rtts.reserve(iterations);
+    int64_t sendTime = 0;
+
+    conn->setConnectionCallback([&](const TcpConnectionPtr& c) {
+        if (c->connected())
+        {
+            c->setTcpNoDelay(true);
+            if (soBusyPollUs > 0)
+            {
+                c->setBusyPoll(soBusyPollUs);
+            }
+            sendTime = nowNs();
+            c->send(message);
+        }
+    });
+    conn->setMessageCallback([&](const TcpConnectionPtr& c, Buffer* buf, Timestamp) {
+        if (buf->readableBytes() < message.size())
+        {
+            return;
+        }
+        buf->retrieve(message.size());
+        int64_t now = nowNs();
+        rtts.push_back(now - sendTime);
+        if (static_cast<int>(rtts.size()) == iterations)
+        {
+            loop.quit();
+            return;
+        }
+        sendTime = now;
+        c->send(message);
+    });
+    conn->setCloseCallback([](const TcpConnectionPtr&) {
+        fprintf(stderr, "closed by server\n");
+        exit(1);
+    });
+    loop.runInLoop(std::bind(&TcpConnection::connectEstablished, conn));
+    loop.loop();
+    conn->setConnectionCallback([](const TcpConnectionPtr&) {});
+    conn->connectionDestroyed();
+
+    kill(child, SIGTERM);
+    waitpid(child, nullptr, 0);
+
+    std::sort(rtts.begin(), rtts.end());
+    auto pct = [&rtts](double p) { return rtts[static_cast<size_t>(p / 100 * (rtts.size() - 1))] / 1000.0; };
+    printf("%-8s spin=%-4dus so_busy_poll=%-3dus rtt p50=%6.1f p90=%6.1f p99=%6.1f p99.9=%7.1f max=%8.1f us\n",
+        spinUs > 0 ? "spinning" : "blocking", spinUs, soBusyPollUs, pct(50), pct(90), pct(99), pct(99.9), pct(100));
+}
+
+int main(int argc, char* argv[])
+{
+    uint16_t port = static_cast<uint16_t>(argc > 1 ? atoi(argv[1]) : 9300);
+    int iterations = argc > 2 ? atoi(argv[2]) : 50000;
+    int spinUs = argc > 3 ? atoi(argv[3]) : 200;
+    int soBusyPollUs = argc > 4 ? atoi(argv[4]) : 0;
+
+    InetAddress addr(port);
+    pingPong(addr, iterations, 0, 0);
+    pingPong(addr, iterations, spinUs, 0);
+    if (soBusyPollUs > 0)
+    {
+        pingPong(addr, iterations, spinUs, soBusyPollUs);
+    }
+    return 0;
+}
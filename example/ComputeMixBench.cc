@@ -0,0 +1,177 @@
+#include <Kenmuduo/TcpServer.h>
+#include <Kenmuduo/TcpConnection.h>
+#include <Kenmuduo/ComputeThreadPool.h>
+#include <Kenmuduo/Logger.h>
+#include "BenchUtil.h"
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <atomic>
+#include <thread>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+/**
+ * IO和计算混合时subloop的延迟隔离
+ * 服务端只有一个loop线程，同时服务两类连接：计算请求('H')每个要消耗work毫秒CPU，探测请求('L')立即回复
+ * inline模式在消息回调里直接计算，pool模式把计算交给ComputeThreadPool，结果回到loop线程再发送
+ * 客户端heavy个线程不停发计算请求，另一个线程发探测请求测往返延迟
+ * ComputeMixBench [port] [seconds] [workMs] [heavyClients] [computeThreads]
+*/
+static const size_t kMessageSize = 64;
+
+static int64_t threadCpuNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+//消耗ms毫秒的线程CPU时间，返回值避免被优化掉
+static uint64_t burn(double ms)
+{
+    uint64_t h = 1469598103934665603ull;
+    int64_t deadline = threadCpuNs() + static_cast<int64_t>(ms * 1e6);
+    while (threadCpuNs() < deadline)
+    {
+        for (int i = 0; i < 1000; ++i)
+        {
+            h = (h ^ i) * 1099511628211ull;
+        }
+    }
+    return h;
+}
+
+static bool roundTrip(int fd, char kind)
+{
+    char buf[kMessageSize];
+    buf[0] = kind;
+    if (::write(fd, buf, sizeof(buf)) != sizeof(buf))
+    {
+        return false;
+    }
+    size_t got = 0;
+    while (got < sizeof(buf))
+    {
+        ssize_t n = ::read(fd, buf + got, sizeof(buf) - got);
+        if (n <= 0)
+        {
+            return false;
+        }
+        got += n;
+    }
+    return true;
+}
+
+static void run(uint16_t port, double seconds, double workMs, int heavyClients, int computeThreads)
+{
+    const bool usePool = computeThreads > 0;
+    EventLoop* serverLoop = nullptr;
+    std::atomic<bool> ready(false);
+    ComputeThreadPool pool("compute");
+    pool.setThreadNum(computeThreads);
+    std::thread serverThread([&]() {
+        EventLoop loop;
+        TcpServer server(&loop, InetAddress(port), "mix");
+        server.setConnectionCallback([](const TcpConnectionPtr& conn) {
+            if (conn->connected())
+            {
+                conn->setTcpNoDelay(true);
+            }
+        });
+        server.setMessageCallback([&](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+            while (buf->readableBytes() >= kMessageSize)
+            {
+                std::string request = buf->retrieveAsString(kMessageSize);
+                if (request[0] != 'H')
+                {
+                    conn->send(request);
+                }
+                else if (!usePool)
+                {
+                    request[1] = static_cast<char>(burn(workMs));
+                    conn->send(request);
+                }
+                else
+                {
+                    std::shared_ptr<std::string> reply = std::make_shared<std::string>(std::move(request));
+                    pool.submit(&loop,
+                        [reply, workMs]() { (*reply)[1] = static_cast<char>(burn(workMs)); },
+                        [conn, reply]() { conn->send(*reply); });
+                }
+            }
+        });
+        server.start();
+        serverLoop = &loop;
+        ready = true;
+        loop.loop();
+    });
+    while (!ready)
+    {
+        usleep(1000);
+    }
+    if (usePool)
+    {
+        pool.start();
+    }
+
+    std::atomic<bool> stop(false);
+    std::atomic<long> heavyDone(0);
+    std::vector<std::thread> heavy;
+    for (int i = 0; i < heavyClients; ++i)
+    {
+        heavy.emplace_back([&]() {
+            int fd = connectTo(port);
+            while (!stop && roundTrip(fd, 'H'))
+            {
+                ++heavyDone;
+            }
+            ::close(fd);
+        });
+    }
+
+    int fd = connectTo(port);
+    std::vector<int64_t> rtts;
+    int64_t deadline = nowNs() + static_cast<int64_t>(seconds * 1e9);
+    while (nowNs() < deadline)
+    {
+        int64_t start = nowNs();
+        if (!roundTrip(fd, 'L'))
+        {
+            break;
+        }
+        rtts.push_back(nowNs() - start);
+        usleep(200);
+    }
+    stop = true;
+    ::close(fd);
+    for (auto& t : heavy)
+    {
+        t.join();
+    }
+    serverLoop->quit();
+    serverThread.join();
+    pool.stop();
+
+    std::sort(rtts.begin(), rtts.end());
+    auto pct = [&rtts](double p) { return rtts[static_cast<size_t>(p / 100 * (rtts.size() - 1))] / 1000.0; };
+    printf("%-6s threads=%d probe rtt p50=%8.1f p99=%8.1f max=%8.1f us  probes=%-6zu heavy/s=%-6.0f batches=%llu\n",
+        usePool ? "pool" : "inline", computeThreads, pct(50), pct(99), pct(100), rtts.size(), heavyDone / seconds,
+        static_cast<unsigned long long>(pool.completionBatches()));
+}
+
+int main(int argc, char* argv[])
+{
+    uint16_t port = static_cast<uint16_t>(argc > 1 ? atoi(argv[1]) : 9700);
+    double seconds = argc > 2 ? atof(argv[2]) : 3;
+    double workMs = argc > 3 ? atof(argv[3]) : 2;
+    int heavyClients = argc > 4 ? atoi(argv[4]) : 4;
+    int computeThreads = argc > 5 ? atoi(argv[5]) : 2;
+
+    run(port, seconds, workMs, heavyClients, 0);
+    run(static_cast<uint16_t>(port + 1), seconds, workMs, heavyClients, computeThreads);
+    return 0;
+}
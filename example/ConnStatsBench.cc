@@ -0,0 +1,205 @@
+#include <Kenmuduo/TcpServer.h>
+#include <Kenmuduo/TcpConnection.h>
+#include <Kenmuduo/EventLoop.h>
+#include <Kenmuduo/Logger.h>
+#include "BenchUtil.h"
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * 按连接的流量统计和TCP_INFO采样，服务器有2个subloop
+ * 三类客户端：普通echo连接；慢处理连接，服务器每条消息多消耗5ms CPU；慢网络连接，接收缓冲区很小而且读得慢，
+ * 服务器每条请求回4MB。统计里慢网络连接的待发送时间和输出峰值很大，慢处理连接的待发送时间接近0
+ * 另外有idle个空闲连接，测collectStats汇总一次的耗时
+ * ConnStatsBench [port] [echoConns] [messagesPerConn] [idle]
+*/
+//每次最多读chunk字节，读完一次停pauseUs微秒
+static void readSlowly(int fd, size_t len, size_t chunk, int pauseUs)
+{
+    std::vector<char> data(chunk);
+    size_t got = 0;
+    while (got < len)
+    {
+        ssize_t n = ::read(fd, data.data(), std::min(chunk, len - got));
+        if (n <= 0)
+        {
+            perror("read");
+            exit(1);
+        }
+        got += n;
+        if (pauseUs > 0)
+        {
+            usleep(pauseUs);
+        }
+    }
+}
+
+static void request(int fd, char kind, size_t replyBytes, size_t chunk, int pauseUs)
+{
+    char message[64] = {0};
+    message[0] = kind;
+    ::write(fd, message, sizeof(message));
+    readSlowly(fd, replyBytes, chunk, pauseUs);
+}
+
+int main(int argc, char* argv[])
+{
+    uint16_t port = static_cast<uint16_t>(argc > 1 ? atoi(argv[1]) : 10000);
+    int echoConns = argc > 2 ? atoi(argv[2]) : 4;
+    int messages = argc > 3 ? atoi(argv[3]) : 2000;
+    int idle = argc > 4 ? atoi(argv[4]) : 200;
+    const size_t kDownload = 4 * 1024 * 1024;
+
+    std::string download(kDownload, 'd');
+    TcpServer* server = nullptr;
+    EventLoop* baseLoop = nullptr;
+    std::atomic<bool> ready(false);
+    std::thread serverThread([&]() {
+        EventLoop loop;
+        TcpServer tcpServer(&loop, InetAddress(port), "stats");
+        tcpServer.setThreadNum(2);
+        tcpServer.setConnectionCallback([](const TcpConnectionPtr& conn) {
+            if (conn->connected())
+            {
+                conn->setTcpNoDelay(true);
+            }
+        });
+        tcpServer.setMessageCallback([&](const TcpConnectionPtr& conn, Buffer* buffer, Timestamp) {
+            while (buffer->readableBytes() >= 64)
+            {
+                char kind = *buffer->peek();
+                if (kind == 'S')
+                {
+                    burnCpu(5 * 1000 * 1000);
+                    conn->send(buffer->peek(), 64);
+                }
+                else if (kind == 'D')
+                {
+                    conn->send(download);
+                }
+                else
+                {
+                    conn->send(buffer->peek(), 64);
+                }
+                buffer->retrieve(64);
+            }
+        });
+        tcpServer.start();
+        server = &tcpServer;
+        baseLoop = &loop;
+        ready = true;
+        loop.loop();
+    });
+    while (!ready)
+    {
+        usleep(1000);
+    }
+
+    std::vector<int> echoFds;
+    for (int i = 0; i < echoConns; ++i)
+    {
+        echoFds.push_back(connectTo(port, 0));
+    }
+    int slowHandler = connectTo(port, 0);
+    int slowNetwork = connectTo(port, 4096);
+    std::vector<int> idleFds;
+    for (int i = 0; i < idle; ++i)
+    {
+        idleFds.push_back(connectTo(port, 0));
+    }
+    usleep(100 * 1000);
+
+    int64_t begin = nowNs();
+    for (int m = 0; m < messages; ++m)
+    {
+        for (int fd : echoFds)
+        {
+            request(fd, 'E', 64, 64, 0);
+        }
+    }
+    double echoRate = static_cast<double>(messages) * echoConns / ((nowNs() - begin) / 1e9);
+    for (int m = 0; m < 20; ++m)
+    {
+        request(slowHandler, 'S', 64, 64, 0);
+    }
+    for (int m = 0; m < 3; ++m)
+    {
+        request(slowNetwork, 'D', kDownload, 16 * 1024, 1000);
+    }
+
+    //collectStats是异步的，结果在baseloop中回调
+    auto collect = [&](bool perConnection) {
+        std::atomic<bool> done(false);
+        ServerStats result;
+        server->collectStats([&](const ServerStats& stats) {
+            result = stats;
+            done = true;
+        }, perConnection);
+        while (!done)
+        {
+            usleep(10);
+        }
+        return result;
+    };
+
+    ServerStats stats = collect(true);
+    printf("echo %.0f msg/s over %d connections (counters always on)\n", echoRate, echoConns);
+    printf("%-20s %10s %10s %7s %7s %7s %7s %9s %10s %7s %5s %6s\n", "connection", "bytesIn", "bytesOut", "msgIn",
+        "msgOut", "reads", "writes", "peakOut", "pendingMs", "rttUs", "cwnd", "retrans");
+    for (const ConnectionSample& sample : stats.connections)
+    {
+        const ConnectionStats& s = sample.stats;
+        if (s.bytesIn == 0)
+        {
+            continue;//空闲连接不列出来
+        }
+        printf("%-20s %10lu %10lu %7lu %7lu %7lu %7lu %9zu %10.1f %7u %5u %6u\n", sample.name.c_str(), s.bytesIn, s.bytesOut,
+            s.messagesIn, s.messagesOut, s.readCalls, s.writeCalls, s.peakOutputBytes, s.pendingOutputUs / 1e3,
+            sample.tcpInfo.rttUs, sample.tcpInfo.sndCwnd, sample.tcpInfo.totalRetrans);
+    }
+    for (const LoopStats& loopStats : stats.loops)
+    {
+        printf("loop %p: %lu conns, %lu bytes out, %.1f ms pending, mean rtt %.0f us\n", loopStats.loop,
+            loopStats.traffic.connections, loopStats.traffic.bytesOut, loopStats.traffic.pendingOutputUs / 1e3,
+            loopStats.tcp.meanRttUs());
+    }
+
+    const int kCollects = 200;
+    begin = nowNs();
+    for (int i = 0; i < kCollects; ++i)
+    {
+        collect(false);
+    }
+    printf("collectStats over %zu connections: %.1f us per call\n", echoFds.size() + 2 + idleFds.size(),
+        (nowNs() - begin) / 1e3 / kCollects);
+
+    for (int fd : idleFds)
+    {
+        ::close(fd);
+    }
+    usleep(200 * 1000);
+    stats = collect(false);
+    printf("after closing idle connections: %lu open, %lu closed\n", stats.total.traffic.connections,
+        stats.closed.connections);
+
+    for (int fd : echoFds)
+    {
+        ::close(fd);
+    }
+    ::close(slowHandler);
+    ::close(slowNetwork);
+    usleep(100 * 1000);
+    baseLoop->quit();
+    serverThread.join();
+    return 0;
+}
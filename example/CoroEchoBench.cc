@@ -0,0 +1,129 @@
+#include <Kenmuduo/Coroutine.h>
+#include <Kenmuduo/TcpServer.h>
+#include <Kenmuduo/Logger.h>
+#include "BenchUtil.h"
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <thread>
+#include <string>
+#include <new>
+
+/**
+ * 回调版本和协程版本的echo服务器对比
+ * 两个服务器在同一个EventLoop线程里，客户端是阻塞socket，每轮写window条消息再全部读回来
+ * 统计服务端每条消息的堆内存分配次数(客户端不分配)，协程版本的co_await不应该带来额外的分配
+ * CoroEchoBench [port] [messages] [messageSize] [window]
+*/
+static std::atomic<uint64_t> g_allocations(0);
+
+void* operator new(size_t size)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    void* p = malloc(size);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+static CoTask coEcho(CoConnection c)
+{
+    for (;;)
+    {
+        std::string_view data = co_await c.readSome();
+        if (data.empty() || !co_await c.write(data))
+        {
+            co_return;
+        }
+    }
+}
+
+static void callbackEcho(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+{
+    conn->send(buf->peek(), buf->readableBytes());
+    buf->retrieveAll();
+}
+
+static void drive(const char* name, uint16_t port, int messages, size_t messageSize, int window)
+{
+    int fd = connectTo(port);
+    const std::string batch(messageSize * window, 'e');
+    std::string back(batch.size(), '\0');
+
+    //先跑一轮预热，建立连接、扩容缓冲区的分配不计入
+    int rounds = messages / window;
+    uint64_t allocsBefore = 0;
+    int64_t start = 0;
+    for (int r = 0; r <= rounds; ++r)
+    {
+        if (r == 1)
+        {
+            allocsBefore = g_allocations.load();
+            start = nowNs();
+        }
+        ::write(fd, batch.data(), batch.size());
+        readExactly(fd, &back[0], back.size());
+    }
+    double elapsed = (nowNs() - start) / 1e9;
+    uint64_t allocs = g_allocations.load() - allocsBefore;
+    ::close(fd);
+    printf("%-9s size=%-5zu window=%-4d msgs/s=%-9.0f allocations/msg=%.3f\n",
+        name, messageSize, window, rounds * window / elapsed, static_cast<double>(allocs) / (rounds * window));
+}
+
+int main(int argc, char* argv[])
+{
+    uint16_t port = static_cast<uint16_t>(argc > 1 ? atoi(argv[1]) : 9500);
+    int messages = argc > 2 ? atoi(argv[2]) : 200000;
+    size_t messageSize = argc > 3 ? atoi(argv[3]) : 64;
+    int window = argc > 4 ? atoi(argv[4]) : 1;
+
+    EventLoop* serverLoop = nullptr;
+    std::atomic<bool> ready(false);
+    std::thread serverThread([&]() {
+        EventLoop loop;
+        TcpServer callbackServer(&loop, InetAddress(port), "callback");
+        callbackServer.setConnectionCallback([](const TcpConnectionPtr& conn) {
+            if (conn->connected())
+            {
+                conn->setTcpNoDelay(true);
+            }
+        });
+        callbackServer.setMessageCallback(callbackEcho);
+        TcpServer coroutineServer(&loop, InetAddress(static_cast<uint16_t>(port + 1)), "coroutine");
+        CoConnection::serve(&coroutineServer, [](CoConnection c) {
+            c.connection()->setTcpNoDelay(true);
+            return coEcho(c);
+        });
+        callbackServer.start();
+        coroutineServer.start();
+        serverLoop = &loop;
+        ready = true;
+        loop.loop();
+    });
+    while (!ready)
+    {
+        usleep(1000);
+    }
+
+    drive("callback", port, messages, messageSize, window);
+    drive("coroutine", static_cast<uint16_t>(port + 1), messages, messageSize, window);
+
+    serverLoop->quit();
+    serverThread.join();
+    return 0;
+}
@@ -0,0 +1,145 @@
+#include <Kenmuduo/TcpServer.h>
+#include <Kenmuduo/TcpConnection.h>
+#include <Kenmuduo/Logger.h>
+#include "BenchUtil.h"
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <thread>
+#include <string>
+#include <algorithm>
+
+/**
+ * 发送密集场景下每条消息的epoll_ctl次数
+ * 服务端像chargen一样在writeComplete回调里不断send下一批消息，客户端读一段就停一下，
+ * socket发送缓冲区反复写满又清空，EPOLLOUT在handleWrite里关掉、又在同一轮的writeComplete回调里重新打开
+ * 可执行文件里定义的epoll_ctl会覆盖libc的版本，所以库里的每次调用都会被计数
+ * 同样覆盖accept4，把服务端连接的发送缓冲区设小，模拟大量连接时每个连接的缓冲区很快写满的情况
+ * EpollCtlBench [port] [messages] [messageSize] [sndbuf]
+*/
+static std::atomic<uint64_t> g_epollCtlCalls(0);
+static int g_sndbuf = 32 * 1024;
+
+extern "C" int epoll_ctl(int epfd, int op, int fd, struct epoll_event* event)
+{
+    g_epollCtlCalls.fetch_add(1, std::memory_order_relaxed);
+    return static_cast<int>(::syscall(SYS_epoll_ctl, epfd, op, fd, event));
+}
+
+extern "C" int accept4(int sockfd, struct sockaddr* addr, socklen_t* addrlen, int flags)
+{
+    int fd = static_cast<int>(::syscall(SYS_accept4, sockfd, addr, addrlen, flags));
+    if (fd >= 0)
+    {
+        ::setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &g_sndbuf, sizeof(g_sndbuf));
+    }
+    return fd;
+}
+
+//每次writeComplete时发送一批消息，一共发送total条后关闭连接
+//一批消息合成一次send，每次send完整写出都会触发一次writeComplete，分开send会让回调成倍增加
+class Chargen
+{
+public:
+    Chargen(EventLoop* loop, const InetAddress& addr, int total, size_t messageSize)
+        :server_(loop, addr, "chargen"), messageSize_(messageSize), total_(total), sent_(0)
+    {
+        server_.setConnectionCallback([this](const TcpConnectionPtr& conn) {
+            if (conn->connected())
+            {
+                sendBatch(conn);
+            }
+        });
+        server_.setMessageCallback([](const TcpConnectionPtr&, Buffer* buf, Timestamp) { buf->retrieveAll(); });
+        server_.setWriteCompleteCallback([this](const TcpConnectionPtr& conn) { sendBatch(conn); });
+    }
+
+    void start() { server_.start(); }
+private:
+    void sendBatch(const TcpConnectionPtr& conn)
+    {
+        if (sent_ == total_)
+        {
+            return;
+        }
+        int n = std::min(kBatch, total_ - sent_);
+        sent_ += n;
+        conn->send(std::string(n * messageSize_, 'c'));
+        if (sent_ == total_)
+        {
+            conn->shutdown();
+        }
+    }
+
+    static const int kBatch = 128;
+    TcpServer server_;
+    const size_t messageSize_;
+    const int total_;
+    int sent_;
+};
+
+static void run(uint16_t port, int total, size_t messageSize, bool deferred)
+{
+    EventLoop* serverLoop = nullptr;
+    std::atomic<bool> ready(false);
+    std::thread serverThread([&]() {
+        EventLoop loop;
+        loop.setDeferredUpdates(deferred);
+        Chargen chargen(&loop, InetAddress(port), total, messageSize);
+        chargen.start();
+        serverLoop = &loop;
+        ready = true;
+        loop.loop();
+    });
+    while (!ready)
+    {
+        usleep(1000);
+    }
+
+    int fd = connectTo(port, 16 * 1024);
+
+    uint64_t callsBefore = g_epollCtlCalls.load();
+    int64_t start = nowNs();
+    char buf[4096];
+    size_t received = 0;
+    ssize_t n;
+    int reads = 0;
+    while ((n = ::read(fd, buf, sizeof(buf))) > 0)
+    {
+        received += n;
+        //读得比服务端写得慢，让发送缓冲区反复写满
+        if (++reads % 4 == 0)
+        {
+            usleep(50);
+        }
+    }
+    double elapsed = (nowNs() - start) / 1e9;
+    uint64_t calls = g_epollCtlCalls.load() - callsBefore;
+    ::close(fd);
+
+    serverLoop->quit();
+    serverThread.join();
+
+    size_t messages = received / messageSize;
+    printf("%-9s messages=%-8zu epoll_ctl=%-7llu per message=%.4f  %.1f MB/s\n",
+        deferred ? "deferred" : "immediate", messages, static_cast<unsigned long long>(calls),
+        messages > 0 ? static_cast<double>(calls) / messages : 0.0, received / elapsed / 1e6);
+}
+
+int main(int argc, char* argv[])
+{
+    uint16_t port = static_cast<uint16_t>(argc > 1 ? atoi(argv[1]) : 9400);
+    int total = argc > 2 ? atoi(argv[2]) : 500000;
+    size_t messageSize = argc > 3 ? atoi(argv[3]) : 512;
+    g_sndbuf = argc > 4 ? atoi(argv[4]) : g_sndbuf;
+
+    run(port, total, messageSize, false);
+    run(static_cast<uint16_t>(port + 1), total, messageSize, true);
+    return 0;
+}
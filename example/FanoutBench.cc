@@ -0,0 +1,206 @@
+#include <Kenmuduo/TcpServer.h>
+#include <Kenmuduo/TcpConnection.h>
+#include <Kenmuduo/BroadcastGroup.h>
+#include <Kenmuduo/Logger.h>
+#include "BenchUtil.h"
+
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <malloc.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * 发布者线程把同一条消息推送给subscribers个连接，服务端2个subloop
+ * copy：对每个连接调用send(std::string)，每个连接拷贝一份消息，每个连接投递一个任务
+ * broadcast：BroadcastGroup::broadcast(SharedPayload)，每个loop投递一个任务，所有连接引用同一份消息
+ * 吞吐：订阅者一直在读，发布者最多领先8条消息，统计每秒送达的消息数(条数 x 订阅者数)
+ * 内存：订阅者停止读取，再发布64条16KB的消息，内核缓冲区满了以后剩下的留在用户态，统计每个订阅者占用的堆内存
+ * FanoutBench [port] [subscribers] [messages]
+*/
+static size_t heapInUse()
+{
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+
+static void run(uint16_t port, int subscribers, int messages, bool shared)
+{
+    const size_t kMessageSize = 1024;
+    const int kWindow = 8;
+    const int kStalledMessages = 64;
+    const size_t kStalledSize = 16 * 1024;
+
+    std::mutex mutex;
+    std::vector<TcpConnectionPtr> conns;
+    BroadcastGroup group;
+    EventLoop* serverLoop = nullptr;
+    std::atomic<bool> ready(false);
+    std::thread serverThread([&]() {
+        EventLoop loop;
+        TcpServer server(&loop, InetAddress(port), "fanout");
+        server.setThreadNum(2);
+        server.setConnectionCallback([&](const TcpConnectionPtr& conn) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (conn->connected())
+            {
+                conns.push_back(conn);
+                group.add(conn);
+            }
+            else
+            {
+                group.remove(conn);
+            }
+        });
+        server.start();
+        serverLoop = &loop;
+        ready = true;
+        loop.loop();
+    });
+    while (!ready)
+    {
+        usleep(1000);
+    }
+
+    //订阅者：一个线程用epoll读所有连接，只计字节数
+    std::vector<int> fds;
+    for (int i = 0; i < subscribers; ++i)
+    {
+        int fd = connectTo(port);
+        ::fcntl(fd, F_SETFL, O_NONBLOCK);
+        fds.push_back(fd);
+    }
+    std::atomic<int64_t> received(0);
+    std::atomic<bool> reading(true);
+    std::atomic<bool> quit(false);
+    std::thread reader([&]() {
+        int epfd = ::epoll_create1(0);
+        for (int fd : fds)
+        {
+            struct epoll_event ev;
+            ev.events = EPOLLIN;
+            ev.data.fd = fd;
+            ::epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+        }
+        std::vector<struct epoll_event> events(1024);
+        char buf[64 * 1024];
+        while (!quit)
+        {
+            if (!reading)
+            {
+                usleep(1000);
+                continue;
+            }
+            int n = ::epoll_wait(epfd, events.data(), static_cast<int>(events.size()), 10);
+            for (int i = 0; i < n; ++i)
+            {
+                ssize_t r;
+                while ((r = ::read(events[i].data.fd, buf, sizeof(buf))) > 0)
+                {
+                    received += r;
+                }
+            }
+        }
+        ::close(epfd);
+    });
+    for (;;)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (conns.size() == static_cast<size_t>(subscribers) && group.size() == static_cast<size_t>(subscribers))
+        {
+            break;
+        }
+        usleep(1000);
+    }
+    std::vector<TcpConnectionPtr> targets;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        targets = conns;
+    }
+
+    auto publish = [&](size_t size, char c) {
+        if (shared)
+        {
+            group.broadcast(std::make_shared<const std::string>(size, c));
+        }
+        else
+        {
+            std::string message(size, c);
+            for (const TcpConnectionPtr& conn : targets)
+            {
+                conn->send(message);
+            }
+        }
+    };
+
+    int64_t perMessage = static_cast<int64_t>(kMessageSize) * subscribers;
+    int64_t start = nowNs();
+    for (int i = 0; i < messages; ++i)
+    {
+        while (received < (i - kWindow) * perMessage)
+        {
+            usleep(50);
+        }
+        publish(kMessageSize, 'm');
+    }
+    while (received < messages * perMessage)
+    {
+        usleep(100);
+    }
+    double elapsed = (nowNs() - start) / 1e9;
+
+    //订阅者停止读取以后的内存占用
+    reading = false;
+    usleep(50 * 1000);
+    size_t heapBefore = heapInUse();
+    for (int i = 0; i < kStalledMessages; ++i)
+    {
+        publish(kStalledSize, 's');
+    }
+    usleep(500 * 1000);
+    size_t heapAfter = heapInUse();
+    size_t queued = 0;
+    for (const TcpConnectionPtr& conn : targets)
+    {
+        queued += conn->outputBytes();
+    }
+
+    printf("%-9s %9.0f msg/s  %6.1f MB/s  stalled: %7.1f KB queued, %7.1f KB heap per subscriber\n",
+        shared ? "broadcast" : "copy", static_cast<double>(messages) * subscribers / elapsed,
+        static_cast<double>(messages) * perMessage / elapsed / 1e6, queued / 1024.0 / subscribers,
+        (heapAfter > heapBefore ? heapAfter - heapBefore : 0) / 1024.0 / subscribers);
+
+    quit = true;
+    reader.join();
+    for (int fd : fds)
+    {
+        ::close(fd);
+    }
+    targets.clear();
+    usleep(500 * 1000);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        conns.clear();
+    }
+    serverLoop->quit();
+    serverThread.join();
+}
+
+int main(int argc, char* argv[])
+{
+    uint16_t port = static_cast<uint16_t>(argc > 1 ? atoi(argv[1]) : 10000);
+    int subscribers = argc > 2 ? atoi(argv[2]) : 2000;
+    int messages = argc > 3 ? atoi(argv[3]) : 200;
+
+    run(port, subscribers, messages, false);
+    run(static_cast<uint16_t>(port + 1), subscribers, messages, true);
+    return 0;
+}
@@ -0,0 +1,71 @@
+#include <Kenmuduo/EventLoop.h>
+#include <Kenmuduo/Channel.h>
+#include "BenchUtil.h"
+
+#include <sys/epoll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <functional>
+#include <algorithm>
+
+/**
+ * Channel::handleEvent的分发开销，setHandler的函数指针跳板和std::function回调对比
+ * channel不注册到poller，只在循环里设置revents再调用handleEvent，处理函数只做一次计数
+ * 每项取多轮中的最小值
+ * HandlerDispatchBench [iterations]
+*/
+class Counter
+{
+public:
+    Counter() :reads_(0), writes_(0) {}
+
+    void handleRead(Timestamp) { ++reads_; }
+    void handleWrite() { ++writes_; }
+    void handleClose() {}
+    void handleError() {}
+
+    long reads_;
+    long writes_;
+};
+
+static double measure(Channel* channel, int iterations)
+{
+    double best = 1e18;
+    for (int r = 0; r < 5; ++r)
+    {
+        Timestamp now = Timestamp::now();
+        int64_t start = nowNs();
+        for (int i = 0; i < iterations; ++i)
+        {
+            channel->set_revents((i & 1) ? EPOLLIN : (EPOLLIN | EPOLLOUT));
+            channel->handleEvent(now);
+        }
+        best = std::min(best, static_cast<double>(nowNs() - start) / iterations);
+    }
+    return best;
+}
+
+int main(int argc, char* argv[])
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : 20000000;
+
+    EventLoop loop;
+    Counter viaHandler;
+    Channel handlerChannel(&loop, -1);
+    handlerChannel.setHandler(&viaHandler);
+
+    Counter viaFunction;
+    Channel functionChannel(&loop, -1);
+    functionChannel.setReadCallback(std::bind(&Counter::handleRead, &viaFunction, std::placeholders::_1));
+    functionChannel.setWriteCallback(std::bind(&Counter::handleWrite, &viaFunction));
+    functionChannel.setCloseCallback(std::bind(&Counter::handleClose, &viaFunction));
+    functionChannel.setErrorCallback(std::bind(&Counter::handleError, &viaFunction));
+
+    double handlerNs = measure(&handlerChannel, iterations);
+    double functionNs = measure(&functionChannel, iterations);
+
+    printf("sizeof(Channel)=%zu iterations=%d (min of 5)\n", sizeof(Channel), iterations);
+    printf("  setHandler      %6.2f ns/event  reads=%ld\n", handlerNs, viaHandler.reads_);
+    printf("  std::function   %6.2f ns/event  reads=%ld\n", functionNs, viaFunction.reads_);
+    return 0;
+}
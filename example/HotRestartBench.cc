@@ -0,0 +1,211 @@
+#include <Kenmuduo/TcpServer.h>
+#include <Kenmuduo/TcpConnection.h>
+#include <Kenmuduo/Handoff.h>
+#include <Kenmuduo/Logger.h>
+#include "BenchUtil.h"
+
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+/**
+ * 压力下重启服务器时失败的请求数
+ * cold：杀掉旧进程再启动新进程，重新bind端口；handoff：新进程通过Handoff从旧进程接过监听socket和空闲连接
+ * 客户端一部分线程反复短连接(连接、请求、关闭)，一部分线程在长连接上连续请求，连接断了就重连
+ * 请求没有收到完整响应(连接被拒绝、被重置、读到EOF、超时)都算失败
+ * 新进程启动后先花startupMs初始化(加载配置、预热缓存)才开始监听或者接管，cold模式下这段时间端口没有人监听
+ * HotRestartBench [port] [seconds] [shortClients] [persistentClients] [startupMs]
+*/
+static const size_t kMessageSize = 64;
+static int g_startupMs = 200;
+static const char* kHandoffPath = "/tmp/kenmuduo-hotrestart.sock";
+
+static void echo(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+{
+    size_t n = buf->readableBytes() / kMessageSize * kMessageSize;
+    conn->send(buf->peek(), n);
+    buf->retrieve(n);
+}
+
+//successor表示是重启后的新进程，先尝试从旧进程接管，接管不到就自己bind
+static void runServer(uint16_t port, bool successor)
+{
+    if (successor)
+    {
+        usleep(g_startupMs * 1000);
+    }
+    EventLoop loop;
+    std::unique_ptr<TcpServer> server;
+    int listenFd = -1;
+    int controlFd = successor ? Handoff::takeOver(kHandoffPath, &listenFd) : -1;
+    if (controlFd >= 0)
+    {
+        server.reset(new TcpServer(&loop, listenFd, "hot"));
+        server->takeOverConnections(controlFd);
+    }
+    else
+    {
+        server.reset(new TcpServer(&loop, InetAddress(port), "hot"));
+    }
+    server->setConnectionCallback([](const TcpConnectionPtr&) {});
+    server->setMessageCallback(echo);
+    server->enableHandoff(kHandoffPath, 2.0, [&loop]() { loop.quit(); });
+    server->start();
+    loop.loop();
+}
+
+static pid_t spawnServer(uint16_t port, bool successor)
+{
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        runServer(port, successor);
+        _exit(0);
+    }
+    return pid;
+}
+
+//重启期间connect会失败，失败时返回-1由调用者计数重试，不像BenchUtil.h的connectTo那样退出
+static int tryConnect(uint16_t port)
+{
+    InetAddress addr(port);
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (::connect(fd, addr.getSockAddr(), addr.getSockAddrLen()) < 0)
+    {
+        ::close(fd);
+        return -1;
+    }
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    struct timeval tv = {2, 0};
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    return fd;
+}
+
+static bool request(int fd)
+{
+    char buf[kMessageSize] = {'r'};
+    if (::send(fd, buf, sizeof(buf), MSG_NOSIGNAL) != sizeof(buf))
+    {
+        return false;
+    }
+    size_t got = 0;
+    while (got < sizeof(buf))
+    {
+        ssize_t n = ::read(fd, buf + got, sizeof(buf) - got);
+        if (n <= 0)
+        {
+            return false;
+        }
+        got += n;
+    }
+    return true;
+}
+
+static void run(const char* mode, uint16_t port, double seconds, int shortClients, int persistentClients)
+{
+    bool handoff = mode[0] == 'h';
+    pid_t oldServer = spawnServer(port, false);
+    usleep(300 * 1000);
+
+    std::atomic<bool> stop(false);
+    std::atomic<long> ok(0);
+    std::atomic<long> failed(0);
+    std::vector<std::thread> clients;
+    for (int i = 0; i < shortClients; ++i)
+    {
+        clients.emplace_back([&]() {
+            while (!stop)
+            {
+                int fd = tryConnect(port);
+                bool success = fd >= 0 && request(fd);
+                ++(success ? ok : failed);
+                if (fd >= 0)
+                {
+                    ::close(fd);
+                }
+                if (!success)
+                {
+                    usleep(1000);
+                }
+            }
+        });
+    }
+    for (int i = 0; i < persistentClients; ++i)
+    {
+        clients.emplace_back([&]() {
+            int fd = -1;
+            while (!stop)
+            {
+                if (fd < 0 && (fd = tryConnect(port)) < 0)
+                {
+                    ++failed;
+                    usleep(1000);
+                    continue;
+                }
+                if (request(fd))
+                {
+                    ++ok;
+                }
+                else
+                {
+                    ++failed;
+                    ::close(fd);
+                    fd = -1;
+                }
+            }
+            if (fd >= 0)
+            {
+                ::close(fd);
+            }
+        });
+    }
+
+    usleep(static_cast<useconds_t>(seconds / 3 * 1e6));
+    int64_t restartStart = nowNs();
+    pid_t newServer;
+    if (handoff)
+    {
+        //新进程接管以后旧进程排空连接自己退出
+        newServer = spawnServer(port, true);
+        waitpid(oldServer, nullptr, 0);
+    }
+    else
+    {
+        kill(oldServer, SIGKILL);
+        waitpid(oldServer, nullptr, 0);
+        newServer = spawnServer(port, true);
+    }
+    double restartMs = (nowNs() - restartStart) / 1e6;//handoff模式包含新进程的初始化时间
+    usleep(static_cast<useconds_t>(seconds * 2 / 3 * 1e6));
+    stop = true;
+    for (auto& t : clients)
+    {
+        t.join();
+    }
+    kill(newServer, SIGKILL);
+    waitpid(newServer, nullptr, 0);
+    printf("%-8s requests ok=%-8ld failed=%-6ld old process gone after %.1f ms\n", mode, ok.load(), failed.load(), restartMs);
+}
+
+int main(int argc, char* argv[])
+{
+    uint16_t port = static_cast<uint16_t>(argc > 1 ? atoi(argv[1]) : 9900);
+    double seconds = argc > 2 ? atof(argv[2]) : 3;
+    int shortClients = argc > 3 ? atoi(argv[3]) : 2;
+    int persistentClients = argc > 4 ? atoi(argv[4]) : 4;
+    g_startupMs = argc > 5 ? atoi(argv[5]) : g_startupMs;
+
+    run("cold", port, seconds, shortClients, persistentClients);
+    run("handoff", static_cast<uint16_t>(port + 1), seconds, shortClients, persistentClients);
+    return 0;
+}
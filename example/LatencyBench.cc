@@ -0,0 +1,201 @@
+#include <Kenmuduo/TcpServer.h>
+#include <Kenmuduo/TcpConnection.h>
+#include <Kenmuduo/EventLoop.h>
+#include <Kenmuduo/Logger.h>
+#include "BenchUtil.h"
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * 请求延迟直方图，服务器有2个subloop，每条64字节的消息是一个请求
+ * 开销：echo，markResponse关闭和打开交替跑rounds轮，各取最好的一轮，另外单独测一次记录的耗时
+ * 分布：每100个请求里有1个在处理函数里多消耗2ms CPU，对比服务端直方图的分位数和客户端测到的往返时间，
+ * 同时每0.2秒通过setLatencyReportInterval报告一次这段时间的分位数
+ * LatencyBench [port] [conns] [messagesPerConn] [rounds]
+*/
+static void printPercentiles(const char* label, const LatencyHistogram::Snapshot& snap)
+{
+    printf("%-22s %7lu requests  p50 %6lu  p90 %6lu  p99 %6lu  p999 %6lu  max %6lu us\n", label, snap.count,
+        snap.percentile(0.5), snap.percentile(0.9), snap.percentile(0.99), snap.percentile(0.999), snap.max);
+}
+
+int main(int argc, char* argv[])
+{
+    uint16_t port = static_cast<uint16_t>(argc > 1 ? atoi(argv[1]) : 10000);
+    int conns = argc > 2 ? atoi(argv[2]) : 8;
+    int messages = argc > 3 ? atoi(argv[3]) : 2000;
+    int rounds = argc > 4 ? atoi(argv[4]) : 5;
+
+    //直方图自检：1..100000均匀分布，返回的是桶的上界，相对误差不超过1/32
+    {
+        LatencyHistogram histogram;
+        for (uint64_t v = 1; v <= 100000; ++v)
+        {
+            histogram.record(v);
+        }
+        LatencyHistogram::Snapshot snap;
+        histogram.snapshot(&snap);
+        printf("histogram check: p50 %lu (50000)  p99 %lu (99000)  p999 %lu (99900)  max %lu\n", snap.percentile(0.5),
+            snap.percentile(0.99), snap.percentile(0.999), snap.max);
+        const int kRecords = 10000000;
+        int64_t begin = nowNs();
+        for (int i = 0; i < kRecords; ++i)
+        {
+            histogram.record(Timestamp::now().microSecondsSinceEpoch() & 0xffff);
+        }
+        printf("record with a clock read: %.1f ns\n", static_cast<double>(nowNs() - begin) / kRecords);
+    }
+
+    std::atomic<bool> mark(false);
+    std::atomic<bool> slowTail(false);
+    std::atomic<uint64_t> requests(0);
+    TcpServer* server = nullptr;
+    EventLoop* baseLoop = nullptr;
+    std::atomic<bool> ready(false);
+    std::vector<LatencyHistogram::Snapshot> reports;
+    std::thread serverThread([&]() {
+        EventLoop loop;
+        TcpServer tcpServer(&loop, InetAddress(port), "latency");
+        tcpServer.setThreadNum(2);
+        tcpServer.setConnectionCallback([](const TcpConnectionPtr& conn) {
+            if (conn->connected())
+            {
+                conn->setTcpNoDelay(true);
+            }
+        });
+        tcpServer.setMessageCallback([&](const TcpConnectionPtr& conn, Buffer* buffer, Timestamp receiveTime) {
+            while (buffer->readableBytes() >= 64)
+            {
+                if (slowTail && requests.fetch_add(1, std::memory_order_relaxed) % 100 == 99)
+                {
+                    burnCpu(2 * 1000 * 1000);
+                }
+                conn->send(buffer->peek(), 64);
+                buffer->retrieve(64);
+                if (mark)
+                {
+                    conn->markResponse(receiveTime);
+                }
+            }
+        });
+        tcpServer.start();
+        server = &tcpServer;
+        baseLoop = &loop;
+        ready = true;
+        loop.loop();
+    });
+    while (!ready)
+    {
+        usleep(1000);
+    }
+
+    std::vector<int> fds;
+    for (int i = 0; i < conns; ++i)
+    {
+        fds.push_back(connectTo(port));
+    }
+    usleep(100 * 1000);
+
+    //每个连接各发一条再全部读回，rtts不为空时记录每个连接的往返时间
+    char message[64] = {0};
+    char reply[64];
+    auto pingAll = [&](std::vector<int64_t>* rtts) {
+        int64_t sent = nowNs();
+        for (int fd : fds)
+        {
+            ::write(fd, message, sizeof(message));
+        }
+        for (int fd : fds)
+        {
+            readExactly(fd, reply, sizeof(reply));
+            if (rtts != nullptr)
+            {
+                rtts->push_back((nowNs() - sent) / 1000);
+            }
+        }
+    };
+
+    double best[2] = {0, 0};
+    for (int r = 0; r < rounds * 2; ++r)
+    {
+        bool on = r % 2 == 1;
+        mark = on;
+        int64_t begin = nowNs();
+        for (int m = 0; m < messages; ++m)
+        {
+            pingAll(nullptr);
+        }
+        best[on] = std::max(best[on], static_cast<double>(messages) * conns / ((nowNs() - begin) / 1e9));
+    }
+    mark = false;
+    printf("markResponse off %9.0f req/s\n", best[0]);
+    printf("markResponse on  %9.0f req/s  (%+.2f%%)\n", best[1], (best[1] / best[0] - 1) * 100);
+
+    //setLatencyReportInterval要在baseloop线程中调用
+    auto runInBase = [&](const std::function<void()>& task) {
+        std::atomic<bool> done(false);
+        baseLoop->runInLoop([&]() {
+            task();
+            done = true;
+        });
+        while (!done)
+        {
+            usleep(100);
+        }
+    };
+    //等最后一个请求的记录落进直方图
+    usleep(100 * 1000);
+    LatencyHistogram::Snapshot before = server->requestLatency();
+    runInBase([&]() {
+        server->setLatencyReportInterval(0.2, [&](const LatencyHistogram::Snapshot& interval) {
+            if (interval.count > 0)
+            {
+                reports.push_back(interval);
+            }
+        });
+    });
+    mark = true;
+    slowTail = true;
+    std::vector<int64_t> rtts;
+    for (int m = 0; m < messages; ++m)
+    {
+        pingAll(&rtts);
+    }
+    usleep(300 * 1000);
+    runInBase([&]() { server->setLatencyReportInterval(0); });
+    LatencyHistogram::Snapshot tail = server->requestLatency().since(before);
+
+    std::sort(rtts.begin(), rtts.end());
+    auto rttAt = [&](double p) { return rtts[std::min(rtts.size() - 1, static_cast<size_t>(p * rtts.size()))]; };
+    printf("1%% of requests +2ms in the handler:\n");
+    printPercentiles("  server histogram", tail);
+    printf("%-22s %7zu requests  p50 %6ld  p90 %6ld  p99 %6ld  p999 %6ld  max %6ld us\n", "  client round trip",
+        rtts.size(), rttAt(0.5), rttAt(0.9), rttAt(0.99), rttAt(0.999), rtts.back());
+    LatencyHistogram::Snapshot merged;
+    for (const LatencyHistogram::Snapshot& interval : reports)
+    {
+        merged.merge(interval);
+        printPercentiles("  0.2s report", interval);
+    }
+    printPercentiles("  reports merged", merged);
+
+    for (int fd : fds)
+    {
+        ::close(fd);
+    }
+    usleep(100 * 1000);
+    baseLoop->quit();
+    serverThread.join();
+    return 0;
+}
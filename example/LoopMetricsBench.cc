@@ -0,0 +1,169 @@
+#include <Kenmuduo/TcpServer.h>
+#include <Kenmuduo/TcpConnection.h>
+#include <Kenmuduo/EventLoop.h>
+#include <Kenmuduo/Logger.h>
+#include "BenchUtil.h"
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+/**
+ * EventLoop运行指标的开销，echo服务器只有一个loop线程
+ * 客户端每轮往conns个连接各写一条64字节的消息，再把回显全部读回来，服务端每次poll有多个活跃channel
+ * 指标关闭和打开交替跑rounds轮，各取最好的一轮；最后打印打开指标时的快照
+ * 单核上客户端和服务端抢CPU，两种模式的差别在噪声以内，所以另外单独测一轮记录(两次取时间加一次recordPoll)的耗时
+ * LoopMetricsBench [port] [conns] [messagesPerConn] [rounds]
+*/
+static void printHistogram(const char* name, const Log2Histogram::Snapshot& h)
+{
+    printf("  %-16s count=%-9llu mean=%-8.1f p50=%-6llu p99=%-6llu max=%llu\n", name, (unsigned long long)h.count,
+        h.mean(), (unsigned long long)h.percentile(0.5), (unsigned long long)h.percentile(0.99),
+        (unsigned long long)h.max);
+}
+
+//loop每轮打开指标以后多做的事情：两次取时间和一次recordPoll
+static double recordCostNs()
+{
+    LoopMetrics metrics;
+    const int kIterations = 2000000;
+    int64_t begin = nowNs();
+    for (int i = 0; i < kIterations; ++i)
+    {
+        Timestamp pollStart = Timestamp::now();
+        Timestamp polled = Timestamp::now();
+        metrics.recordPoll(polled.microSecondsSinceEpoch() - pollStart.microSecondsSinceEpoch(), i & 31, i & 255);
+    }
+    return static_cast<double>(nowNs() - begin) / kIterations;
+}
+
+int main(int argc, char* argv[])
+{
+    uint16_t port = static_cast<uint16_t>(argc > 1 ? atoi(argv[1]) : 10000);
+    int conns = argc > 2 ? atoi(argv[2]) : 32;
+    int messages = argc > 3 ? atoi(argv[3]) : 5000;
+    int rounds = argc > 4 ? atoi(argv[4]) : 5;
+
+    EventLoop* serverLoop = nullptr;
+    std::atomic<bool> ready(false);
+    std::thread serverThread([&]() {
+        EventLoop loop;
+        TcpServer server(&loop, InetAddress(port), "echo");
+        server.setConnectionCallback([](const TcpConnectionPtr& conn) {
+            if (conn->connected())
+            {
+                conn->setTcpNoDelay(true);
+            }
+        });
+        server.setMessageCallback([](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+            conn->send(buf->peek(), buf->readableBytes());
+            buf->retrieveAll();
+        });
+        server.start();
+        serverLoop = &loop;
+        ready = true;
+        loop.loop();
+    });
+    while (!ready)
+    {
+        usleep(1000);
+    }
+
+    std::vector<int> fds;
+    for (int i = 0; i < conns; ++i)
+    {
+        fds.push_back(connectTo(port));
+    }
+    usleep(100 * 1000);
+
+    char message[64] = {0};
+    char reply[64];
+    double best[2] = {0, 0};
+    LoopMetrics::Snapshot before = serverLoop->metrics();
+    LoopMetrics::Snapshot after = before;
+    for (int r = 0; r < rounds * 2; ++r)
+    {
+        bool on = r % 2 == 1;
+        std::atomic<bool> set(false);
+        serverLoop->runInLoop([&]() {
+            serverLoop->setMetricsEnabled(on);
+            set = true;
+        });
+        while (!set)
+        {
+            usleep(100);
+        }
+        LoopMetrics::Snapshot start = serverLoop->metrics();
+        int64_t begin = nowNs();
+        for (int m = 0; m < messages; ++m)
+        {
+            for (int fd : fds)
+            {
+                ::write(fd, message, sizeof(message));
+            }
+            for (int fd : fds)
+            {
+                readExactly(fd, reply, sizeof(reply));
+            }
+        }
+        double rate = static_cast<double>(messages) * conns / ((nowNs() - begin) / 1e9);
+        if (rate > best[on])
+        {
+            best[on] = rate;
+            if (on)
+            {
+                before = start;
+                after = serverLoop->metrics();
+            }
+        }
+    }
+
+    printf("metrics off %9.0f msg/s\n", best[0]);
+    printf("metrics on  %9.0f msg/s  (%+.2f%%)\n", best[1], (best[1] / best[0] - 1) * 100);
+    printf("best round with metrics on: iterations=%llu events=%llu wakeups=%llu functors=%llu busy=%.1f%%\n",
+        (unsigned long long)(after.iterations - before.iterations), (unsigned long long)(after.events - before.events),
+        (unsigned long long)(after.wakeups - before.wakeups), (unsigned long long)(after.functors - before.functors),
+        100.0 * (after.callbackUs + after.functorUs - before.callbackUs - before.functorUs)
+            / (after.callbackUs + after.functorUs + after.pollWaitUs - before.callbackUs - before.functorUs - before.pollWaitUs));
+    //其他线程每次queueInLoop都要写eventfd唤醒loop，等上一个任务执行完再投递下一个，每次正好一次唤醒
+    const int kCrossThreadTasks = 1000;
+    LoopMetrics::Snapshot wakeBefore = serverLoop->metrics();
+    for (int i = 0; i < kCrossThreadTasks; ++i)
+    {
+        std::atomic<bool> done(false);
+        serverLoop->queueInLoop([&done]() { done = true; });
+        while (!done)
+        {
+            usleep(10);
+        }
+    }
+    LoopMetrics::Snapshot wakeAfter = serverLoop->metrics();
+    printf("%d cross-thread queueInLoop: wakeups +%llu\n", kCrossThreadTasks,
+        (unsigned long long)(wakeAfter.wakeups - wakeBefore.wakeups));
+    double iterationUs = 1e6 / (best[1] / conns);
+    double costNs = recordCostNs();
+    printf("recording cost %.0f ns per iteration, %.3f%% of a %.0f us iteration\n", costNs,
+        costNs / 10 / iterationUs, iterationUs);
+    printf("whole run:\n");
+    printHistogram("pollWait us", after.pollWait);
+    printHistogram("activeChannels", after.activeChannels);
+    printHistogram("callbacks us", after.callbackTime);
+    printHistogram("functors us", after.functorTime);
+    printHistogram("queueDepth", after.queueDepth);
+
+    for (int fd : fds)
+    {
+        ::close(fd);
+    }
+    usleep(100 * 1000);
+    serverLoop->quit();
+    serverThread.join();
+    return 0;
+}
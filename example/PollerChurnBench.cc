@@ -0,0 +1,147 @@
+#include <Kenmuduo/EventLoop.h>
+#include <Kenmuduo/Channel.h>
+#include "BenchUtil.h"
+
+#include <sys/eventfd.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <memory>
+#include <new>
+#include <algorithm>
+
+/**
+ * Poller注册表的增删开销，模拟短连接服务器上channel的频繁创建和销毁
+ * 1.固定fd反复add/remove：表里常驻background个channel，测一次enableReading+disableAll+remove的时间
+ * 2.fd复用：每次新建eventfd、注册、注销、关闭，内核会把刚关掉的fd号再分配出去
+ * 耗时都包含epoll_ctl系统调用，噪声较大，每项取多轮中的最小值；另外统计每次增删的堆内存分配次数
+ * PollerChurnBench [background] [cycles]
+*/
+static size_t g_allocations = 0;
+
+void* operator new(size_t size)
+{
+    ++g_allocations;
+    void* p = malloc(size);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+//替换全局分配函数时，sized和数组版本也要一起替换，否则编译器会报new/delete不配对
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+    free(p);
+}
+
+int main(int argc, char* argv[])
+{
+    int background = argc > 1 ? atoi(argv[1]) : 10000;
+    int cycles = argc > 2 ? atoi(argv[2]) : 200000;
+
+    EventLoop loop;
+    //常驻的channel，让表里有足够多的元素
+    std::vector<int> fds;
+    std::vector<std::unique_ptr<Channel>> channels;
+    for (int i = 0; i < background; ++i)
+    {
+        int fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (fd < 0)
+        {
+            perror("eventfd (raise ulimit -n)");
+            return 1;
+        }
+        fds.push_back(fd);
+        channels.emplace_back(new Channel(&loop, fd));
+        channels.back()->enableReading();
+    }
+
+    const int rounds = 5;
+    double sameFd = 1e18;
+    double reuseFd = 1e18;
+    double rawEpoll = 1e18;
+    double allocsPerCycle = 0;
+    int churnFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    int epfd = ::epoll_create1(EPOLL_CLOEXEC);
+    for (int r = 0; r < rounds; ++r)
+    {
+        size_t allocsBefore = g_allocations;
+        int64_t start = nowNs();
+        for (int i = 0; i < cycles; ++i)
+        {
+            Channel channel(&loop, churnFd);
+            channel.enableReading();
+            channel.disableAll();
+            channel.remove();
+        }
+        sameFd = std::min(sameFd, static_cast<double>(nowNs() - start) / cycles);
+        allocsPerCycle = static_cast<double>(g_allocations - allocsBefore) / cycles;
+
+        start = nowNs();
+        for (int i = 0; i < cycles; ++i)
+        {
+            int fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            Channel channel(&loop, fd);
+            channel.enableReading();
+            channel.disableAll();
+            channel.remove();
+            ::close(fd);
+        }
+        reuseFd = std::min(reuseFd, static_cast<double>(nowNs() - start) / cycles);
+
+        //只有epoll_ctl本身的开销，作为基准
+        start = nowNs();
+        for (int i = 0; i < cycles; ++i)
+        {
+            epoll_event ev;
+            ev.events = EPOLLIN;
+            ev.data.u64 = 0;
+            ::epoll_ctl(epfd, EPOLL_CTL_ADD, churnFd, &ev);
+            ::epoll_ctl(epfd, EPOLL_CTL_DEL, churnFd, &ev);
+        }
+        rawEpoll = std::min(rawEpoll, static_cast<double>(nowNs() - start) / cycles);
+    }
+    ::close(churnFd);
+    ::close(epfd);
+
+    printf("background=%d cycles=%d rounds=%d (min)\n", background, cycles, rounds);
+    printf("  same fd add/remove     %7.1f ns/cycle  poller overhead %6.1f ns  allocations %.2f/cycle\n",
+        sameFd, sameFd - rawEpoll, allocsPerCycle);
+    printf("  reused fd add/remove   %7.1f ns/cycle  (incl. eventfd+close)\n", reuseFd);
+    printf("  raw epoll_ctl add+del  %7.1f ns/cycle\n", rawEpoll);
+
+    for (auto& channel : channels)
+    {
+        channel->disableAll();
+        channel->remove();
+    }
+    for (int fd : fds)
+    {
+        ::close(fd);
+    }
+    return 0;
+}
@@ -0,0 +1,181 @@
+#include <Kenmuduo/TcpServer.h>
+#include <Kenmuduo/TcpClient.h>
+#include <Kenmuduo/TcpConnection.h>
+#include <Kenmuduo/ConnectionPool.h>
+#include <Kenmuduo/EventLoop.h>
+#include <Kenmuduo/Logger.h>
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+
+/**
+ * 上游请求：客户端loop上保持concurrency个请求在途，每个请求发64字节，收到服务端的回显算完成
+ * pool：从ConnectionPool借连接，收到回显以后归还，连接一直复用
+ * connect：每个请求新建一个TcpClient，服务端回显以后关闭连接，客户端不留TIME_WAIT
+ * PoolBench [port] [seconds] [concurrency]
+*/
+static const std::string kRequest(64, 'q');
+
+class Bench
+{
+public:
+    Bench(EventLoop* loop, const InetAddress& serverAddr, bool pooled, int concurrency)
+        :loop_(loop),
+        serverAddr_(serverAddr),
+        pooled_(pooled),
+        concurrency_(concurrency),
+        pool_(loop, "pool"),
+        stopped_(false),
+        completed_(0),
+        failed_(0),
+        nextId_(0)
+    {
+        pool_.setMaxPerEndpoint(concurrency);
+    }
+
+    void start()
+    {
+        for (int i = 0; i < concurrency_; ++i)
+        {
+            issue();
+        }
+    }
+    void stop() { stopped_ = true; }
+    int64_t completed() const { return completed_; }
+    int64_t failed() const { return failed_; }
+    uint64_t connects() const { return pooled_ ? pool_.connectsStarted() : nextId_; }
+private:
+    void issue()
+    {
+        if (stopped_)
+        {
+            return;
+        }
+        if (pooled_)
+        {
+            pool_.acquire(serverAddr_, [this](const TcpConnectionPtr& conn) {
+                if (!conn)
+                {
+                    ++failed_;
+                    issue();
+                    return;
+                }
+                conn->setMessageCallback([this](const TcpConnectionPtr& c, Buffer* buf, Timestamp) {
+                    if (buf->readableBytes() < kRequest.size())
+                    {
+                        return;
+                    }
+                    buf->retrieveAll();
+                    ++completed_;
+                    pool_.release(c);
+                    issue();
+                });
+                conn->send(kRequest);
+            }, [this](const TcpConnectionPtr&) {
+                //借出期间被服务端关闭，这个请求失败，换一个连接重发
+                ++failed_;
+                issue();
+            });
+            return;
+        }
+
+        int id = ++nextId_;
+        TcpClient* client = new TcpClient(loop_, serverAddr_, "short");
+        clients_[id].reset(client);
+        client->setConnectionCallback([this, id](const TcpConnectionPtr& conn) {
+            if (conn->connected())
+            {
+                conn->setTcpNoDelay(true);
+                conn->send(kRequest);
+                return;
+            }
+            //TcpClient::removeConnection在同一次handleClose里，之后再析构TcpClient
+            loop_->queueInLoop([this, id]() {
+                clients_.erase(id);
+                issue();
+            });
+        });
+        client->setMessageCallback([this](const TcpConnectionPtr&, Buffer* buf, Timestamp) {
+            if (buf->readableBytes() >= kRequest.size())
+            {
+                buf->retrieveAll();
+                ++completed_;
+            }
+        });
+        client->connect();
+    }
+
+    EventLoop* loop_;
+    InetAddress serverAddr_;
+    bool pooled_;
+    int concurrency_;
+    ConnectionPool pool_;
+    bool stopped_;
+    int64_t completed_;
+    int64_t failed_;
+    int nextId_;
+    std::unordered_map<int, std::unique_ptr<TcpClient>> clients_;
+};
+
+static void run(uint16_t port, double seconds, int concurrency, bool pooled)
+{
+    EventLoop* serverLoop = nullptr;
+    std::atomic<bool> ready(false);
+    std::thread serverThread([&]() {
+        EventLoop loop;
+        TcpServer server(&loop, InetAddress(port), "upstream");
+        server.setConnectionCallback([](const TcpConnectionPtr& conn) {
+            if (conn->connected())
+            {
+                conn->setTcpNoDelay(true);
+            }
+        });
+        server.setMessageCallback([pooled](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+            conn->send(buf->retrieveAllAsString());
+            if (!pooled)
+            {
+                conn->shutdown();//短连接：回复以后服务端先关闭
+            }
+        });
+        server.start();
+        serverLoop = &loop;
+        ready = true;
+        loop.loop();
+    });
+    while (!ready)
+    {
+        usleep(1000);
+    }
+
+    EventLoop loop;
+    {
+        Bench bench(&loop, InetAddress(port), pooled, concurrency);
+        loop.runAfter(0.2, [&]() { bench.start(); });
+        loop.runAfter(0.2 + seconds, [&]() {
+            bench.stop();
+            loop.runAfter(0.5, [&]() { loop.quit(); });
+        });
+        loop.loop();
+        printf("%-8s %8.0f req/s  completed=%-8lld failed=%-4lld connects=%llu\n", pooled ? "pool" : "connect",
+            bench.completed() / seconds, (long long)bench.completed(), (long long)bench.failed(),
+            (unsigned long long)bench.connects());
+    }
+    serverLoop->quit();
+    serverThread.join();
+}
+
+int main(int argc, char* argv[])
+{
+    uint16_t port = static_cast<uint16_t>(argc > 1 ? atoi(argv[1]) : 10000);
+    double seconds = argc > 2 ? atof(argv[2]) : 3.0;
+    int concurrency = argc > 3 ? atoi(argv[3]) : 8;
+
+    run(port, seconds, concurrency, false);
+    run(static_cast<uint16_t>(port + 1), seconds, concurrency, true);
+    return 0;
+}
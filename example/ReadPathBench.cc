@@ -0,0 +1,62 @@
+#include <Kenmuduo/TcpConnection.h>
+#include <Kenmuduo/EventLoop.h>
+#include <Kenmuduo/Logger.h>
+#include "BenchUtil.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+
+/**
+ * 读路径上每个事件的开销
+ * socketpair的一端交给TcpConnection，消息回调里往另一端写1个字节，下一轮epoll_wait马上又可读，
+ * 每个事件是一次epoll_wait、一次readv、一次write和一次消息回调，全部在同一个线程里
+ * 以前每个读事件在Channel里提升一次tie_弱引用、在handleRead里调用一次shared_from_this，
+ * 各是一次原子加和一次原子减，连接自己持有引用以后读路径上没有引用计数操作
+ * ReadPathBench [events]
+*/
+static double run(int events)
+{
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, fds) < 0)
+    {
+        perror("socketpair");
+        exit(1);
+    }
+    EventLoop loop;
+    const InetAddress addr = InetAddress::fromUnixPath("/tmp/kenmuduo-readpath.sock");
+    TcpConnectionPtr conn(new TcpConnection(&loop, "readpath", fds[0], addr, addr));
+    int count = 0;
+    conn->setConnectionCallback([](const TcpConnectionPtr&) {});
+    conn->setMessageCallback([&](const TcpConnectionPtr&, Buffer* buf, Timestamp) {
+        buf->retrieveAll();
+        if (++count == events)
+        {
+            loop.quit();
+            return;
+        }
+        ::write(fds[1], "x", 1);
+    });
+    conn->connectEstablished();
+    ::write(fds[1], "x", 1);
+    int64_t start = nowNs();
+    loop.loop();
+    double ns = static_cast<double>(nowNs() - start) / events;
+    conn->connectionDestroyed();
+    ::close(fds[1]);
+    return ns;
+}
+
+int main(int argc, char* argv[])
+{
+    int events = argc > 1 ? atoi(argv[1]) : 500000;
+    double best = 1e18;
+    for (int r = 0; r < 5; ++r)
+    {
+        best = std::min(best, run(events));
+    }
+    printf("events=%d (min of 5)  %.1f ns/event  %.0f events/s\n", events, best, 1e9 / best);
+    return 0;
+}
@@ -0,0 +1,324 @@
+#include "BenchUtil.h"
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <algorithm>
+#include <random>
+
+/**
+ * RedisServer的多连接压测工具，也可以用来压真正的redis
+ * 每个连接一次发出pipeline个命令，全部回复收到后再发下一批，统计ops/s和每个命令的延迟分布
+ * RedisBench [-h host] [-p port] [-c connections] [-t threads] [-P pipeline] [-d seconds] [-r keyspace] [-g getPercent]
+*/
+struct Options
+{
+    std::string host = "127.0.0.1";
+    int port = 6380;
+    int connections = 50;
+    int threads = 1;
+    int pipeline = 16;
+    int seconds = 10;
+    int keyspace = 100000;
+    int getPercent = 80;
+};
+
+struct Conn
+{
+    int fd = -1;
+    std::string out;
+    size_t outOffset = 0;
+    std::string in;
+    std::deque<int64_t> sendTimes;
+};
+
+//返回一个完整回复结束的位置，数据不完整返回nullptr
+static const char* parseReply(const char* p, const char* end)
+{
+    if (p >= end)
+    {
+        return nullptr;
+    }
+    const char* crlf = static_cast<const char*>(memmem(p, end - p, "\r\n", 2));
+    if (crlf == nullptr)
+    {
+        return nullptr;
+    }
+    long n = atol(p + 1);
+    switch (*p)
+    {
+    case '+':
+    case '-':
+    case ':':
+        return crlf + 2;
+    case '$':
+        if (n < 0)
+        {
+            return crlf + 2;
+        }
+        return (end - (crlf + 2) >= n + 2) ? crlf + 2 + n + 2 : nullptr;
+    case '*':
+    {
+        const char* q = crlf + 2;
+        for (long i = 0; i < n && q != nullptr; ++i)
+        {
+            q = parseReply(q, end);
+        }
+        return q;
+    }
+    default:
+        fprintf(stderr, "bad reply byte %d\n", *p);
+        exit(1);
+    }
+}
+
+static void appendCommand(std::string* out, const std::vector<std::string>& args)
+{
+    *out += "*" + std::to_string(args.size()) + "\r\n";
+    for (const std::string& a : args)
+    {
+        *out += "$" + std::to_string(a.size()) + "\r\n" + a + "\r\n";
+    }
+}
+
+class Worker
+{
+public:
+    Worker(const Options& opt, int numConns, unsigned seed)
+        :opt_(opt), conns_(numConns), rng_(seed), completed_(0), epollfd_(::epoll_create1(EPOLL_CLOEXEC))
+    {
+        latencies_.reserve(1 << 20);
+    }
+
+    ~Worker()
+    {
+        for (Conn& c : conns_)
+        {
+            ::close(c.fd);
+        }
+        ::close(epollfd_);
+    }
+
+    void run(int64_t deadline)
+    {
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(opt_.port));
+        addr.sin_addr.s_addr = inet_addr(opt_.host.c_str());
+        for (size_t i = 0; i < conns_.size(); ++i)
+        {
+            Conn& c = conns_[i];
+            c.fd = ::socket(AF_INET, SOCK_STREAM, 0);
+            if (::connect(c.fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+            {
+                perror("connect");
+                exit(1);
+            }
+            int one = 1;
+            ::setsockopt(c.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            ::fcntl(c.fd, F_SETFL, O_NONBLOCK);
+            epoll_event ev;
+            ev.events = EPOLLIN;
+            ev.data.u32 = static_cast<uint32_t>(i);
+            ::epoll_ctl(epollfd_, EPOLL_CTL_ADD, c.fd, &ev);
+            sendBatch(&c);
+        }
+
+        std::vector<epoll_event> events(conns_.size());
+        char buf[64 * 1024];
+        while (nowNs() < deadline)
+        {
+            int n = ::epoll_wait(epollfd_, events.data(), static_cast<int>(events.size()), 100);
+            for (int i = 0; i < n; ++i)
+            {
+                Conn& c = conns_[events[i].data.u32];
+                if (events[i].events & EPOLLOUT)
+                {
+                    writeSome(&c);
+                }
+                if (events[i].events & EPOLLIN)
+                {
+                    ssize_t r = ::read(c.fd, buf, sizeof(buf));
+                    if (r <= 0)
+                    {
+                        if (r < 0 && errno == EAGAIN)
+                        {
+                            continue;
+                        }
+                        fprintf(stderr, "server closed connection\n");
+                        exit(1);
+                    }
+                    c.in.append(buf, r);
+                    onReplies(&c);
+                }
+            }
+        }
+    }
+
+    uint64_t completed() const { return completed_; }
+    const std::vector<int64_t>& latencies() const { return latencies_; }
+private:
+    void sendBatch(Conn* c)
+    {
+        std::uniform_int_distribution<int> keyDist(0, opt_.keyspace - 1);
+        std::uniform_int_distribution<int> pctDist(0, 99);
+        int64_t now = nowNs();
+        for (int i = 0; i < opt_.pipeline; ++i)
+        {
+            std::string key = "key:" + std::to_string(keyDist(rng_));
+            if (pctDist(rng_) < opt_.getPercent)
+            {
+                appendCommand(&c->out, {"GET", key});
+            }
+            else
+            {
+                appendCommand(&c->out, {"SET", key, "value-of-" + key});
+            }
+            c->sendTimes.push_back(now);
+        }
+        writeSome(c);
+    }
+
+    void writeSome(Conn* c)
+    {
+        while (c->outOffset < c->out.size())
+        {
+            ssize_t n = ::write(c->fd, c->out.data() + c->outOffset, c->out.size() - c->outOffset);
+            if (n < 0)
+            {
+                if (errno == EAGAIN)
+                {
+                    break;
+                }
+                perror("write");
+                exit(1);
+            }
+            c->outOffset += n;
+        }
+
+        epoll_event ev;
+        ev.data.u32 = static_cast<uint32_t>(c - conns_.data());
+        ev.events = EPOLLIN;
+        if (c->outOffset == c->out.size())
+        {
+            c->out.clear();
+            c->outOffset = 0;
+        }
+        else
+        {
+            ev.events |= EPOLLOUT;
+        }
+        ::epoll_ctl(epollfd_, EPOLL_CTL_MOD, c->fd, &ev);
+    }
+
+    void onReplies(Conn* c)
+    {
+        const char* p = c->in.data();
+        const char* end = p + c->in.size();
+        const char* next;
+        int64_t now = nowNs();
+        while ((next = parseReply(p, end)) != nullptr)
+        {
+            latencies_.push_back(now - c->sendTimes.front());
+            c->sendTimes.pop_front();
+            ++completed_;
+            p = next;
+        }
+        c->in.erase(0, p - c->in.data());
+        if (c->sendTimes.empty())
+        {
+            sendBatch(c);
+        }
+    }
+
+    const Options& opt_;
+    std::vector<Conn> conns_;
+    std::mt19937 rng_;
+    uint64_t completed_;
+    std::vector<int64_t> latencies_;
+    int epollfd_;
+};
+
+static double percentile(const std::vector<int64_t>& sorted, double p)
+{
+    if (sorted.empty())
+    {
+        return 0;
+    }
+    size_t idx = static_cast<size_t>(p / 100.0 * (sorted.size() - 1));
+    return sorted[idx] / 1000.0;
+}
+
+int main(int argc, char* argv[])
+{
+    Options opt;
+    int ch;
+    while ((ch = getopt(argc, argv, "h:p:c:t:P:d:r:g:")) != -1)
+    {
+        switch (ch)
+        {
+        case 'h': opt.host = optarg; break;
+        case 'p': opt.port = atoi(optarg); break;
+        case 'c': opt.connections = atoi(optarg); break;
+        case 't': opt.threads = atoi(optarg); break;
+        case 'P': opt.pipeline = atoi(optarg); break;
+        case 'd': opt.seconds = atoi(optarg); break;
+        case 'r': opt.keyspace = atoi(optarg); break;
+        case 'g': opt.getPercent = atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-h host] [-p port] [-c conns] [-t threads] [-P pipeline] [-d seconds] [-r keyspace] [-g get%%]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    for (int i = 0; i < opt.threads; ++i)
+    {
+        int n = opt.connections / opt.threads + (i < opt.connections % opt.threads ? 1 : 0);
+        workers.emplace_back(new Worker(opt, n, 12345u + i));
+    }
+
+    int64_t start = nowNs();
+    int64_t deadline = start + static_cast<int64_t>(opt.seconds) * 1000000000;
+    std::vector<std::thread> threads;
+    for (auto& w : workers)
+    {
+        Worker* worker = w.get();
+        threads.emplace_back([worker, deadline]() { worker->run(deadline); });
+    }
+    for (std::thread& t : threads)
+    {
+        t.join();
+    }
+    double elapsed = (nowNs() - start) / 1e9;
+
+    uint64_t total = 0;
+    std::vector<int64_t> all;
+    for (auto& w : workers)
+    {
+        total += w->completed();
+        all.insert(all.end(), w->latencies().begin(), w->latencies().end());
+    }
+    std::sort(all.begin(), all.end());
+
+    printf("connections=%d pipeline=%d threads=%d get=%d%% duration=%.1fs\n",
+        opt.connections, opt.pipeline, opt.threads, opt.getPercent, elapsed);
+    printf("ops=%llu ops/s=%.0f\n", static_cast<unsigned long long>(total), total / elapsed);
+    printf("latency us: p50=%.1f p90=%.1f p99=%.1f p99.9=%.1f max=%.1f\n",
+        percentile(all, 50), percentile(all, 90), percentile(all, 99), percentile(all, 99.9), percentile(all, 100));
+    return 0;
+}
@@ -0,0 +1,474 @@
+#include <Kenmuduo/TcpServer.h>
+#include <Kenmuduo/Logger.h>
+
+#include <stdlib.h>
+#include <ctype.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+/**
+ * 兼容RESP2协议的内存KV服务器，支持GET/SET/DEL/INCR/MGET/PING以及pipeline
+ * 每个subloop持有一个分片(shared-nothing)，key按hash归属到某个loop
+ * 本地分片的命令直接执行，其他分片的命令在一次onMessage中按分片攒成一批，通过runInLoop转发给所属loop
+ * 执行结果再runInLoop回到连接所在的loop，按请求到达的顺序写回
+*/
+
+//每个loop一个分片，分片内的数据只在所属loop线程访问，不需要加锁
+struct Shard
+{
+    Shard():loop(nullptr) {}
+
+    EventLoop* loop;
+    std::unordered_map<std::string, std::string> kv;
+};
+
+//当前loop线程持有的分片
+static __thread Shard* t_shard = nullptr;
+
+enum CommandType { kGet, kSet, kDel, kIncr };
+
+//需要在key所属分片上执行的一个操作
+struct Op
+{
+    CommandType type;
+    uint64_t seq;//所属请求的序号
+    size_t part;//请求中的第几个结果，MGET/DEL可以有多个key
+    std::string key;
+    std::string value;
+};
+
+//一个请求的回复槽位，所有part都到齐后才算完成，完成的请求只能按序号顺序写回
+struct Slot
+{
+    enum Kind { kSingle, kArray, kSum };
+
+    Slot():kind(kSingle), remaining(0), ready(false) {}
+
+    Kind kind;
+    size_t remaining;
+    std::vector<std::string> parts;
+    bool ready;
+    std::string reply;
+};
+
+//每个连接的pipeline状态，作为TcpConnection的context保存
+struct Session
+{
+    Session():headSeq(0) {}
+
+    uint64_t headSeq;//slots.front()的序号
+    std::deque<Slot> slots;
+};
+
+using OpBatch = std::vector<Op>;
+using OpBatchPtr = std::shared_ptr<OpBatch>;
+using ResultsPtr = std::shared_ptr<std::vector<std::string>>;
+
+static bool parseInteger(const char* begin, const char* end, long long* out)
+{
+    if (begin == end)
+    {
+        return false;
+    }
+    bool negative = (*begin == '-');
+    if (negative && ++begin == end)
+    {
+        return false;
+    }
+    long long v = 0;
+    for (const char* p = begin; p < end; ++p)
+    {
+        if (*p < '0' || *p > '9' || v > (9223372036854775807LL - 9) / 10)
+        {
+            return false;
+        }
+        v = v * 10 + (*p - '0');
+    }
+    *out = negative ? -v : v;
+    return true;
+}
+
+static std::string bulkString(const std::string& s)
+{
+    return "$" + std::to_string(s.size()) + "\r\n" + s + "\r\n";
+}
+
+class RedisServer
+{
+public:
+    RedisServer(EventLoop* loop, const InetAddress& addr, int numThreads)
+        :server_(loop, addr, "RedisServer"),
+        shards_(numThreads > 0 ? numThreads : 1),
+        nextShard_(0)
+    {
+        server_.setConnectionCallback(std::bind(&RedisServer::onConnection, this, std::placeholders::_1));
+        server_.setMessageCallback(std::bind(&RedisServer::onMessage, this,
+                    std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+        //每个loop线程启动时认领一个分片
+        server_.setThreadInitCallback(std::bind(&RedisServer::onThreadInit, this, std::placeholders::_1));
+        server_.setThreadNum(numThreads);
+    }
+
+    void start()
+    {
+        server_.start();
+    }
+private:
+    static const size_t kMaxArgs = 1024 * 1024;
+    static const long long kMaxBulkLen = 512LL * 1024 * 1024;
+
+    void onThreadInit(EventLoop* loop)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        shards_[nextShard_].loop = loop;
+        t_shard = &shards_[nextShard_];
+        ++nextShard_;
+    }
+
+    void onConnection(const TcpConnectionPtr& conn)
+    {
+        if (conn->connected())
+        {
+            conn->setTcpNoDelay(true);
+            conn->setContext(std::make_shared<Session>());
+        }
+    }
+
+    void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp time)
+    {
+        Session* session = static_cast<Session*>(conn->getContext().get());
+        std::vector<OpBatch> remote(shards_.size());
+        std::vector<std::string> args;
+
+        int ret;
+        while ((ret = parseCommand(buf, &args)) > 0)
+        {
+            if (!args.empty())
+            {
+                dispatch(session, args, &remote);
+            }
+        }
+        if (ret < 0)
+        {
+            Slot& slot = newSlot(session);
+            slot.ready = true;
+            slot.reply = "-ERR Protocol error\r\n";
+            buf->retrieveAll();
+        }
+
+        //本次读到的所有命令解析完以后，每个分片只转发一次
+        for (size_t i = 0; i < remote.size(); ++i)
+        {
+            if (!remote[i].empty())
+            {
+                OpBatchPtr batch(new OpBatch);
+                batch->swap(remote[i]);
+                forward(conn, &shards_[i], batch);
+            }
+        }
+        flush(conn, session);
+        if (ret < 0)
+        {
+            conn->shutdown();
+        }
+    }
+
+    /**
+     * 从buf中解析一条命令，返回1表示解析出一条完整命令，0表示数据不完整，-1表示协议错误
+     * 支持RESP数组格式(*N\r\n$len\r\n...)和telnet使用的内联格式
+    */
+    int parseCommand(Buffer* buf, std::vector<std::string>* args)
+    {
+        args->clear();
+        const char* begin = buf->peek();
+        const char* end = begin + buf->readableBytes();
+        if (begin == end)
+        {
+            return 0;
+        }
+
+        if (*begin != '*')
+        {
+            const char* eol = buf->findEOL();
+            if (eol == nullptr)
+            {
+                return buf->readableBytes() > 64 * 1024 ? -1 : 0;
+            }
+            const char* lineEnd = (eol > begin && eol[-1] == '\r') ? eol - 1 : eol;
+            const char* p = begin;
+            while (p < lineEnd)
+            {
+                while (p < lineEnd && *p == ' ')
+                {
+                    ++p;
+                }
+                const char* word = p;
+                while (p < lineEnd && *p != ' ')
+                {
+                    ++p;
+                }
+                if (p > word)
+                {
+                    args->emplace_back(word, p - word);
+                }
+            }
+            buf->retrieve(eol + 1 - begin);
+            return 1;
+        }
+
+        const char* crlf = buf->findCRLF();
+        if (crlf == nullptr)
+        {
+            return 0;
+        }
+        long long count = 0;
+        if (!parseInteger(begin + 1, crlf, &count) || count < 0 || count > static_cast<long long>(kMaxArgs))
+        {
+            return -1;
+        }
+
+        const char* p = crlf + 2;
+        for (long long i = 0; i < count; ++i)
+        {
+            if (p >= end)
+            {
+                return 0;
+            }
+            if (*p != '$')
+            {
+                return -1;
+            }
+            crlf = buf->findCRLF(p);
+            if (crlf == nullptr)
+            {
+                return 0;
+            }
+            long long len = 0;
+            if (!parseInteger(p + 1, crlf, &len) || len < 0 || len > kMaxBulkLen)
+            {
+                return -1;
+            }
+            p = crlf + 2;
+            if (end - p < len + 2)
+            {
+                return 0;
+            }
+            if (p[len] != '\r' || p[len + 1] != '\n')
+            {
+                return -1;
+            }
+            args->emplace_back(p, len);
+            p += len + 2;
+        }
+        buf->retrieve(p - begin);
+        return 1;
+    }
+
+    Slot& newSlot(Session* session)
+    {
+        session->slots.push_back(Slot());
+        return session->slots.back();
+    }
+
+    //把一条命令拆成若干个Op，本地分片直接执行，远端分片的Op放进remote批量转发
+    void dispatch(Session* session, const std::vector<std::string>& args, std::vector<OpBatch>* remote)
+    {
+        std::string cmd(args[0]);
+        for (char& c : cmd)
+        {
+            c = static_cast<char>(::toupper(c));
+        }
+
+        uint64_t seq = session->headSeq + session->slots.size();
+        Slot& slot = newSlot(session);
+        std::vector<Op> ops;
+        Op op;
+        op.seq = seq;
+        op.part = 0;
+
+        if (cmd == "PING")
+        {
+            slot.ready = true;
+            slot.reply = "+PONG\r\n";
+            return;
+        }
+        else if ((cmd == "GET" || cmd == "INCR") && args.size() == 2)
+        {
+            op.type = (cmd == "GET") ? kGet : kIncr;
+            op.key = args[1];
+            ops.push_back(op);
+        }
+        else if (cmd == "SET" && args.size() == 3)
+        {
+            op.type = kSet;
+            op.key = args[1];
+            op.value = args[2];
+            ops.push_back(op);
+        }
+        else if ((cmd == "MGET" || cmd == "DEL") && args.size() >= 2)
+        {
+            slot.kind = (cmd == "MGET") ? Slot::kArray : Slot::kSum;
+            op.type = (cmd == "MGET") ? kGet : kDel;
+            for (size_t i = 1; i < args.size(); ++i)
+            {
+                op.part = i - 1;
+                op.key = args[i];
+                ops.push_back(op);
+            }
+        }
+        else
+        {
+            slot.ready = true;
+            if (cmd == "GET" || cmd == "SET" || cmd == "INCR" || cmd == "MGET" || cmd == "DEL")
+            {
+                slot.reply = "-ERR wrong number of arguments for '" + args[0] + "' command\r\n";
+            }
+            else
+            {
+                slot.reply = "-ERR unknown command '" + args[0] + "'\r\n";
+            }
+            return;
+        }
+
+        slot.remaining = ops.size();
+        slot.parts.resize(ops.size());
+        for (Op& o : ops)
+        {
+            size_t idx = std::hash<std::string>()(o.key) % shards_.size();
+            if (&shards_[idx] == t_shard)
+            {
+                completePart(session, o.seq, o.part, execute(t_shard, o));
+            }
+            else
+            {
+                (*remote)[idx].push_back(std::move(o));
+            }
+        }
+    }
+
+    //把一批Op交给分片所属的loop执行，结果整批送回连接所在的loop
+    void forward(const TcpConnectionPtr& conn, Shard* owner, const OpBatchPtr& batch)
+    {
+        owner->loop->runInLoop([this, conn, owner, batch]() {
+            ResultsPtr results(new std::vector<std::string>);
+            results->reserve(batch->size());
+            for (const Op& op : *batch)
+            {
+                results->push_back(execute(owner, op));
+            }
+            conn->getLoop()->runInLoop([this, conn, batch, results]() {
+                Session* session = static_cast<Session*>(conn->getContext().get());
+                for (size_t i = 0; i < batch->size(); ++i)
+                {
+                    completePart(session, (*batch)[i].seq, (*batch)[i].part, (*results)[i]);
+                }
+                flush(conn, session);
+            });
+        });
+    }
+
+    //只会在shard->loop线程中调用
+    std::string execute(Shard* shard, const Op& op)
+    {
+        switch (op.type)
+        {
+        case kGet:
+        {
+            auto it = shard->kv.find(op.key);
+            return it == shard->kv.end() ? std::string("$-1\r\n") : bulkString(it->second);
+        }
+        case kSet:
+            shard->kv[op.key] = op.value;
+            return "+OK\r\n";
+        case kDel:
+            return shard->kv.erase(op.key) ? ":1\r\n" : ":0\r\n";
+        case kIncr:
+        {
+            std::string& value = shard->kv[op.key];
+            long long v = 0;
+            if (!value.empty() && (!parseInteger(value.data(), value.data() + value.size(), &v)
+                || v == 9223372036854775807LL))
+            {
+                return "-ERR value is not an integer or out of range\r\n";
+            }
+            value = std::to_string(++v);
+            return ":" + value + "\r\n";
+        }
+        }
+        return "-ERR internal error\r\n";
+    }
+
+    void completePart(Session* session, uint64_t seq, size_t part, const std::string& result)
+    {
+        Slot& slot = session->slots[seq - session->headSeq];
+        slot.parts[part] = result;
+        if (--slot.remaining > 0)
+        {
+            return;
+        }
+
+        slot.ready = true;
+        if (slot.kind == Slot::kSingle)
+        {
+            slot.reply.swap(slot.parts[0]);
+        }
+        else if (slot.kind == Slot::kArray)
+        {
+            slot.reply = "*" + std::to_string(slot.parts.size()) + "\r\n";
+            for (const std::string& s : slot.parts)
+            {
+                slot.reply += s;
+            }
+        }
+        else
+        {
+            long long sum = 0;
+            for (const std::string& s : slot.parts)
+            {
+                sum += ::atoll(s.c_str() + 1);
+            }
+            slot.reply = ":" + std::to_string(sum) + "\r\n";
+        }
+        slot.parts.clear();
+    }
+
+    //队头连续完成的请求一次性写回，保证pipeline的回复顺序和请求顺序一致
+    void flush(const TcpConnectionPtr& conn, Session* session)
+    {
+        std::string out;
+        while (!session->slots.empty() && session->slots.front().ready)
+        {
+            out += session->slots.front().reply;
+            session->slots.pop_front();
+            ++session->headSeq;
+        }
+        if (!out.empty())
+        {
+            conn->send(out);
+        }
+    }
+
+    TcpServer server_;
+    std::vector<Shard> shards_;
+    size_t nextShard_;
+    std::mutex mutex_;
+};
+
+//RedisServer [port] [threads]
+int main(int argc, char* argv[])
+{
+    uint16_t port = static_cast<uint16_t>(argc > 1 ? atoi(argv[1]) : 6380);
+    int threads = argc > 2 ? atoi(argv[2]) : 4;
+
+    EventLoop loop;
+    InetAddress addr(port, "0.0.0.0");
+    RedisServer server(&loop, addr, threads);
+    server.start();
+    loop.loop();
+    return 0;
+}
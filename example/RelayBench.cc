@@ -0,0 +1,145 @@
+#include <Kenmuduo/TcpServer.h>
+#include <Kenmuduo/TcpConnection.h>
+#include <Kenmuduo/TcpRelay.h>
+#include <Kenmuduo/Logger.h>
+#include "BenchUtil.h"
+
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+/**
+ * TCP转发：source -> 代理 -> sink，比较TcpRelay的splice转发和读进inputBuffer再send的拷贝转发
+ * 代理把先后连上来的两个连接配成一对，source写完totalMB以后关闭写端，EOF经过代理传给sink
+ * sink检查收到的字节数和内容，统计吞吐和代理线程每GB消耗的CPU时间
+ * RelayBench [port] [totalMB]
+*/
+static void run(uint16_t port, size_t totalBytes, bool splice)
+{
+    std::atomic<double> cpuSeconds(0);
+    EventLoop* proxyLoop = nullptr;
+    std::atomic<bool> ready(false);
+    std::thread proxyThread([&]() {
+        EventLoop loop;
+        TcpServer server(&loop, InetAddress(port), "relay");
+        TcpConnectionPtr pending;
+        double cpuStart = 0;
+        int closed = 0;
+        server.setConnectionCallback([&](const TcpConnectionPtr& conn) {
+            if (!conn->connected())
+            {
+                if (++closed == 2)
+                {
+                    cpuSeconds = threadCpuSeconds() - cpuStart;
+                }
+                return;
+            }
+            if (!pending)
+            {
+                pending = conn;
+                return;
+            }
+            cpuStart = threadCpuSeconds();
+            if (splice)
+            {
+                TcpRelay::start(pending, conn);
+            }
+            else
+            {
+                pending->setContext(std::shared_ptr<TcpConnection>(conn));
+                conn->setContext(std::shared_ptr<TcpConnection>(pending));
+            }
+            pending.reset();
+        });
+        //拷贝转发：数据读进inputBuffer_，取出成string再send给对面，读到EOF时关闭对面的写端
+        server.setMessageCallback([](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+            std::shared_ptr<TcpConnection> peer = std::static_pointer_cast<TcpConnection>(conn->getContext());
+            if (peer)
+            {
+                peer->send(buf->retrieveAllAsString());
+            }
+        });
+        server.start();
+        proxyLoop = &loop;
+        ready = true;
+        loop.loop();
+    });
+    while (!ready)
+    {
+        usleep(1000);
+    }
+
+    int source = connectTo(port);
+    usleep(20 * 1000);
+    int sink = connectTo(port);
+
+    std::thread writer([&]() {
+        std::vector<char> chunk(256 * 1024);
+        size_t written = 0;
+        while (written < totalBytes)
+        {
+            size_t len = std::min(chunk.size(), totalBytes - written);
+            for (size_t i = 0; i < len; ++i)
+            {
+                chunk[i] = static_cast<char>((written + i) % 251);
+            }
+            ssize_t n = ::write(source, chunk.data(), len);
+            if (n <= 0)
+            {
+                break;
+            }
+            written += n;
+        }
+        ::shutdown(source, SHUT_WR);
+    });
+
+    std::vector<char> buf(256 * 1024);
+    size_t got = 0;
+    bool intact = true;
+    int64_t start = nowNs();
+    for (;;)
+    {
+        ssize_t n = ::read(sink, buf.data(), buf.size());
+        if (n <= 0)
+        {
+            break;
+        }
+        for (ssize_t i = 0; i < n; i += 4093)
+        {
+            intact = intact && buf[i] == static_cast<char>((got + i) % 251);
+        }
+        got += n;
+        if (!splice && got == totalBytes)
+        {
+            break;//拷贝转发这里没有传递半关闭
+        }
+    }
+    double elapsed = (nowNs() - start) / 1e9;
+    writer.join();
+    ::close(source);
+    ::close(sink);
+    usleep(100 * 1000);
+    proxyLoop->quit();
+    proxyThread.join();
+
+    double gb = got / 1e9;
+    printf("%-6s bytes=%-11zu intact=%-3s %.2f GB/s  proxy cpu %.3f s/GB\n", splice ? "splice" : "copy", got,
+        intact && got == totalBytes ? "yes" : "NO", gb / elapsed, cpuSeconds / gb);
+}
+
+int main(int argc, char* argv[])
+{
+    uint16_t port = static_cast<uint16_t>(argc > 1 ? atoi(argv[1]) : 10000);
+    size_t totalBytes = static_cast<size_t>(argc > 2 ? atoi(argv[2]) : 2048) * 1024 * 1024;
+
+    run(port, totalBytes, false);
+    run(static_cast<uint16_t>(port + 1), totalBytes, true);
+    return 0;
+}
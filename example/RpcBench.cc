@@ -0,0 +1,255 @@
+#include <Kenmuduo/RpcServer.h>
+#include <Kenmuduo/RpcClient.h>
+#include <Kenmuduo/EventLoop.h>
+#include <Kenmuduo/Logger.h>
+
+#include <unistd.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <algorithm>
+#include <random>
+
+/**
+ * RPC吞吐和延迟基准，服务端在子进程中运行
+ * echo方法在loop线程内同步完成；delay方法交给工作线程，随机延迟后从工作线程完成，响应乱序返回
+ * 客户端在一个连接上分别保持1/8/64/256个调用同时在途，统计calls/s和延迟分布，同时验证超时
+ * RpcBench [port] [seconds]
+*/
+
+//模拟异步后端的工作线程，done在这里被调用
+class DelayWorker
+{
+public:
+    DelayWorker():thread_(&DelayWorker::run, this) {}
+
+    void submit(int delayUs, const RpcDoneCallback& done, const std::string& payload)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        int64_t due = Timestamp::now().microSecondsSinceEpoch() + delayUs;
+        tasks_.push_back(Task{due, done, payload});
+        cond_.notify_one();
+    }
+private:
+    struct Task
+    {
+        int64_t due;
+        RpcDoneCallback done;
+        std::string payload;
+    };
+
+    void run()
+    {
+        while (true)
+        {
+            std::vector<Task> ready;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                while (tasks_.empty())
+                {
+                    cond_.wait(lock);
+                }
+                int64_t now = Timestamp::now().microSecondsSinceEpoch();
+                for (auto it = tasks_.begin(); it != tasks_.end();)
+                {
+                    if (it->due <= now)
+                    {
+                        ready.push_back(*it);
+                        it = tasks_.erase(it);
+                    }
+                    else
+                    {
+                        ++it;
+                    }
+                }
+            }
+            for (Task& t : ready)
+            {
+                t.done(kRpcOk, t.payload);
+            }
+            if (ready.empty())
+            {
+                usleep(50);
+            }
+        }
+    }
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::deque<Task> tasks_;
+    std::thread thread_;
+};
+
+static void runServer(uint16_t port)
+{
+    EventLoop loop;
+    RpcServer server(&loop, InetAddress(port), "RpcBenchServer");
+    DelayWorker worker;
+    std::mt19937 rng(1);
+
+    server.registerMethod("echo", [](const TcpConnectionPtr&, const std::string& request, const RpcDoneCallback& done) {
+        done(kRpcOk, request);
+    });
+    server.registerMethod("delay", [&worker, &rng](const TcpConnectionPtr&, const std::string& request, const RpcDoneCallback& done) {
+        worker.submit(static_cast<int>(rng() % 1000), done, request);
+    });
+    server.registerMethod("never", [](const TcpConnectionPtr&, const std::string&, const RpcDoneCallback&) {
+        //永远不响应，用来验证客户端超时
+    });
+    server.setThreadNum(1);
+    server.start();
+    loop.loop();
+}
+
+//在客户端loop中保持concurrency个调用在途
+class Driver
+{
+public:
+    Driver(EventLoop* loop, RpcClient* client, const std::string& method, int concurrency, double seconds, double timeout)
+        :loop_(loop), client_(client), method_(method), concurrency_(concurrency),
+        timeout_(timeout), payload_(64, 'x'), inflight_(0), completed_(0), failed_(0), timeouts_(0)
+    {
+        deadline_ = addTime(Timestamp::now(), seconds);
+    }
+
+    void start(const std::function<void()>& finished)
+    {
+        finished_ = finished;
+        start_ = Timestamp::now();
+        for (int i = 0; i < concurrency_; ++i)
+        {
+            issue();
+        }
+    }
+
+    void report()
+    {
+        double elapsed = timeDifference(end_, start_);
+        std::sort(latencies_.begin(), latencies_.end());
+        auto pct = [this](double p) {
+            return latencies_.empty() ? 0.0 : latencies_[static_cast<size_t>(p / 100 * (latencies_.size() - 1))] / 1.0;
+        };
+        printf("%-6s inflight=%-4d calls/s=%-9.0f p50=%7.0fus p99=%7.0fus p99.9=%7.0fus failed=%d timeouts=%d\n",
+            method_.c_str(), concurrency_, completed_ / elapsed, pct(50), pct(99), pct(99.9), failed_, timeouts_);
+    }
+private:
+    void issue()
+    {
+        ++inflight_;
+        Timestamp sent = Timestamp::now();
+        client_->call(method_, payload_, [this, sent](int status, const std::string&) {
+            --inflight_;
+            Timestamp now = Timestamp::now();
+            if (status == kRpcOk)
+            {
+                ++completed_;
+                latencies_.push_back(now.microSecondsSinceEpoch() - sent.microSecondsSinceEpoch());
+            }
+            else if (status == kRpcTimeout)
+            {
+                ++timeouts_;
+            }
+            else
+            {
+                ++failed_;
+            }
+
+            if (now < deadline_)
+            {
+                issue();
+            }
+            else if (inflight_ == 0)
+            {
+                end_ = now;
+                loop_->queueInLoop(finished_);
+            }
+        }, timeout_);
+    }
+
+    EventLoop* loop_;
+    RpcClient* client_;
+    std::string method_;
+    int concurrency_;
+    double timeout_;
+    std::string payload_;
+    Timestamp deadline_;
+    Timestamp start_;
+    Timestamp end_;
+    int inflight_;
+    int completed_;
+    int failed_;
+    int timeouts_;
+    std::vector<int64_t> latencies_;
+    std::function<void()> finished_;
+};
+
+int main(int argc, char* argv[])
+{
+    uint16_t port = static_cast<uint16_t>(argc > 1 ? atoi(argv[1]) : 9090);
+    double seconds = argc > 2 ? atof(argv[2]) : 2.0;
+
+    pid_t child = fork();
+    if (child == 0)
+    {
+        runServer(port);
+        return 0;
+    }
+    usleep(200 * 1000);
+
+    EventLoop loop;
+    RpcClient client(&loop, InetAddress(port), "RpcBenchClient");
+
+    //依次跑完每一组配置
+    struct Case { const char* method; int concurrency; double timeout; };
+    std::vector<Case> cases = {
+        {"echo", 1, 1.0}, {"echo", 8, 1.0}, {"echo", 64, 1.0}, {"echo", 256, 1.0},
+        {"delay", 1, 1.0}, {"delay", 8, 1.0}, {"delay", 64, 1.0}, {"delay", 256, 1.0},
+        {"never", 4, 0.05},
+    };
+    std::vector<std::unique_ptr<Driver>> drivers;
+    size_t next = 0;
+    std::function<void()> runNext = [&]() {
+        if (!drivers.empty())
+        {
+            drivers.back()->report();
+        }
+        if (next == cases.size())
+        {
+            loop.quit();
+            return;
+        }
+        const Case& c = cases[next++];
+        double duration = (c.timeout < 0.1) ? 0.2 : seconds;
+        drivers.emplace_back(new Driver(&loop, &client, c.method, c.concurrency, duration, c.timeout));
+        drivers.back()->start(runNext);
+    };
+    //连上以后开始第一组，3秒还没连上就放弃
+    bool connected = false;
+    client.setConnectionCallback([&](const TcpConnectionPtr& conn) {
+        if (conn->connected() && !connected)
+        {
+            connected = true;
+            runNext();
+        }
+    });
+    client.connect();
+    loop.runAfter(3.0, [&]() {
+        if (!connected)
+        {
+            fprintf(stderr, "connect to port %d failed\n", port);
+            loop.quit();
+        }
+    });
+    loop.loop();
+
+    kill(child, SIGKILL);
+    waitpid(child, nullptr, 0);
+    return connected ? 0 : 1;
+}
@@ -0,0 +1,161 @@
+#include <Kenmuduo/TcpServer.h>
+#include <Kenmuduo/TcpConnection.h>
+#include <Kenmuduo/ComputeThreadPool.h>
+#include <Kenmuduo/ResponseSequencer.h>
+#include <Kenmuduo/Logger.h>
+#include "BenchUtil.h"
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <thread>
+#include <string>
+
+/**
+ * 流水线请求交给线程池并行处理，再由ResponseSequencer按顺序回复
+ * 每个请求16字节：8字节序号和4字节处理时间(微秒)，处理线程用usleep模拟访问后端的等待，响应原样返回
+ * depth=1相当于每个连接串行处理；客户端一次把所有请求写出去，另一个线程检查响应序号是否连续
+ * SequencerBench [port] [requests] [maxWorkUs] [computeThreads]
+*/
+static const size_t kRequestSize = 16;
+
+static void setupServer(TcpServer* server, size_t depth, ComputeThreadPool* pool)
+{
+    EventLoop* loop = server->getLoop();
+    MessageCallback onMessage = [loop, pool](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+        std::shared_ptr<ResponseSequencer> sequencer = std::static_pointer_cast<ResponseSequencer>(conn->getContext());
+        while (buf->readableBytes() >= kRequestSize && !sequencer->full())
+        {
+            std::shared_ptr<std::string> request = std::make_shared<std::string>(buf->retrieveAsString(kRequestSize));
+            uint64_t seq = sequencer->begin();
+            pool->submit(loop,
+                [request]() {
+                    uint32_t workUs;
+                    memcpy(&workUs, request->data() + 8, sizeof(workUs));
+                    usleep(workUs);
+                },
+                [sequencer, seq, request]() { sequencer->complete(seq, std::move(*request)); });
+        }
+    };
+    server->setConnectionCallback([depth, onMessage](const TcpConnectionPtr& conn) {
+        if (conn->connected())
+        {
+            conn->setTcpNoDelay(true);
+            conn->setContext(std::make_shared<ResponseSequencer>(conn, depth, onMessage));
+        }
+        else
+        {
+            std::shared_ptr<ResponseSequencer> sequencer = std::static_pointer_cast<ResponseSequencer>(conn->getContext());
+            printf("  stopped reading %llu times\n", static_cast<unsigned long long>(sequencer->pauses()));
+        }
+    });
+    server->setMessageCallback(onMessage);
+}
+
+static void run(uint16_t port, int requests, int maxWorkUs, int computeThreads, size_t depth)
+{
+    ComputeThreadPool pool("worker");
+    pool.setThreadNum(computeThreads);
+    pool.start();
+    EventLoop* serverLoop = nullptr;
+    std::atomic<bool> ready(false);
+    std::thread serverThread([&]() {
+        EventLoop loop;
+        TcpServer server(&loop, InetAddress(port), "sequencer");
+        setupServer(&server, depth, &pool);
+        server.start();
+        serverLoop = &loop;
+        ready = true;
+        loop.loop();
+    });
+    while (!ready)
+    {
+        usleep(1000);
+    }
+
+    InetAddress addr(port);
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (::connect(fd, addr.getSockAddr(), addr.getSockAddrLen()) < 0)
+    {
+        perror("connect");
+        exit(1);
+    }
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    int64_t start = nowNs();
+    std::thread writer([&]() {
+        unsigned seed = 12345;
+        std::string all;
+        for (uint64_t seq = 0; seq < static_cast<uint64_t>(requests); ++seq)
+        {
+            char request[kRequestSize] = {0};
+            uint32_t workUs = static_cast<uint32_t>(rand_r(&seed) % (maxWorkUs + 1));
+            memcpy(request, &seq, sizeof(seq));
+            memcpy(request + 8, &workUs, sizeof(workUs));
+            all.append(request, sizeof(request));
+        }
+        size_t written = 0;
+        while (written < all.size())
+        {
+            ssize_t n = ::write(fd, all.data() + written, all.size() - written);
+            if (n <= 0)
+            {
+                break;
+            }
+            written += n;
+        }
+    });
+
+    char response[kRequestSize];
+    uint64_t expected = 0;
+    bool ordered = true;
+    size_t got = 0;
+    while (expected < static_cast<uint64_t>(requests))
+    {
+        ssize_t n = ::read(fd, response + got, sizeof(response) - got);
+        if (n <= 0)
+        {
+            fprintf(stderr, "closed\n");
+            exit(1);
+        }
+        got += n;
+        if (got == sizeof(response))
+        {
+            uint64_t seq;
+            memcpy(&seq, response, sizeof(seq));
+            ordered = ordered && seq == expected;
+            ++expected;
+            got = 0;
+        }
+    }
+    double elapsed = (nowNs() - start) / 1e9;
+    writer.join();
+    ::close(fd);
+    usleep(100 * 1000);
+    serverLoop->quit();
+    serverThread.join();
+    pool.stop();
+    printf("depth=%-4zu requests=%-6d req/s=%-8.0f in order=%s batches=%llu\n", depth, requests, requests / elapsed,
+        ordered ? "yes" : "NO", static_cast<unsigned long long>(pool.completionBatches()));
+}
+
+int main(int argc, char* argv[])
+{
+    uint16_t port = static_cast<uint16_t>(argc > 1 ? atoi(argv[1]) : 9800);
+    int requests = argc > 2 ? atoi(argv[2]) : 20000;
+    int maxWorkUs = argc > 3 ? atoi(argv[3]) : 500;
+    int computeThreads = argc > 4 ? atoi(argv[4]) : 16;
+
+    const size_t depths[] = {1, 16, 64};
+    for (size_t i = 0; i < sizeof(depths) / sizeof(depths[0]); ++i)
+    {
+        run(static_cast<uint16_t>(port + i), depths[i] == 1 ? requests / 10 : requests, maxWorkUs, computeThreads, depths[i]);
+    }
+    return 0;
+}
@@ -0,0 +1,204 @@
+#include <Kenmuduo/TcpServer.h>
+#include <Kenmuduo/TcpConnection.h>
+#include <Kenmuduo/ShmTransport.h>
+#include <Kenmuduo/Logger.h>
+#include "BenchUtil.h"
+
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <strings.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <algorithm>
+
+/**
+ * 共享内存传输和TCP回环、Unix域socket的对比
+ * 服务端在子进程中运行，同一个echo处理函数同时服务TCP监听和开启了共享内存的Unix域监听
+ * 客户端的收发代码对三种传输完全一样，只有建立连接的方式不同
+ * window=1测往返延迟，window较大时测每秒消息数
+ * ShmBench [port] [messages]
+*/
+static const char* kUdsPath = "/tmp/kenmuduo-shmbench.sock";
+
+static void runServer(uint16_t port)
+{
+    EventLoop loop;
+    auto onMessage = [](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+        conn->send(buf->retrieveAllAsString());
+    };
+    TcpServer tcpServer(&loop, InetAddress(port), "tcp");
+    tcpServer.setMessageCallback(onMessage);
+    tcpServer.setConnectionCallback([](const TcpConnectionPtr& conn) {
+        if (conn->connected())
+        {
+            conn->setTcpNoDelay(true);
+        }
+    });
+    TcpServer udsServer(&loop, InetAddress::fromUnixPath(kUdsPath), "uds");
+    udsServer.setMessageCallback(onMessage);
+    udsServer.setConnectionCallback([](const TcpConnectionPtr&) {});
+    udsServer.setShmTransport(true);
+    tcpServer.start();
+    udsServer.start();
+    loop.loop();
+}
+
+//普通的阻塞connect，建立以后交给TcpConnection
+static TcpConnectionPtr connectPlain(EventLoop* loop, const InetAddress& addr, const std::string& name)
+{
+    int fd = ::socket(addr.family(), SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (::connect(fd, addr.getSockAddr(), addr.getSockAddrLen()) < 0)
+    {
+        perror("connect");
+        exit(1);
+    }
+    ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+    sockaddr_storage local;
+    bzero(&local, sizeof(local));
+    socklen_t len = sizeof(local);
+    ::getsockname(fd, (sockaddr*)&local, &len);
+    InetAddress localAddr;
+    localAddr.setSockAddr((sockaddr*)&local, len);
+    TcpConnectionPtr conn(new TcpConnection(loop, name, fd, localAddr, addr));
+    conn->setTcpNoDelay(true);
+    return conn;
+}
+
+//保持window个消息在途，收到一个回复就补发一个，直到收齐total个
+class Driver
+{
+public:
+    Driver(EventLoop* loop, const TcpConnectionPtr& conn, size_t msgSize, int window, int total)
+        :loop_(loop), conn_(conn), message_(msgSize, 'm'), window_(window), total_(total), sent_(0), received_(0)
+    {
+        latencies_.reserve(total);
+    }
+
+    void run()
+    {
+        conn_->setConnectionCallback([this](const TcpConnectionPtr& conn) {
+            if (conn->connected())
+            {
+                start_ = nowNs();
+                for (int i = 0; i < window_ && sent_ < total_; ++i)
+                {
+                    sendOne();
+                }
+            }
+        });
+        conn_->setMessageCallback([this](const TcpConnectionPtr&, Buffer* buf, Timestamp) { onMessage(buf); });
+        conn_->setCloseCallback([](const TcpConnectionPtr& conn) {
+            fprintf(stderr, "%s closed by server\n", conn->name().c_str());
+            exit(1);
+        });
+        loop_->runInLoop(std::bind(&TcpConnection::connectEstablished, conn_));
+        loop_->loop();
+        elapsed_ = (nowNs() - start_) / 1e9;
+        conn_->setConnectionCallback([](const TcpConnectionPtr&) {});
+        conn_->connectionDestroyed();
+    }
+
+    void report(const char* transport) const
+    {
+        std::vector<int64_t> sorted(latencies_);
+        std::sort(sorted.begin(), sorted.end());
+        auto pct = [&sorted](double p) { return sorted[static_cast<size_t>(p / 100 * (sorted.size() - 1))] / 1000.0; };
+        printf("%-4s size=%-5zu window=%-4d msgs/s=%-9.0f p50=%7.1fus p99=%7.1fus\n",
+            transport, message_.size(), window_, received_ / elapsed_, pct(50), pct(99));
+    }
+private:
+    void sendOne()
+    {
+        sendTimes_.push_back(nowNs());
+        ++sent_;
+        conn_->send(message_);
+    }
+
+    void onMessage(Buffer* buf)
+    {
+        int64_t now = nowNs();
+        while (buf->readableBytes() >= message_.size())
+        {
+            buf->retrieve(message_.size());
+            latencies_.push_back(now - sendTimes_.front());
+            sendTimes_.pop_front();
+            if (++received_ == total_)
+            {
+                loop_->quit();
+                return;
+            }
+            if (sent_ < total_)
+            {
+                sendOne();
+            }
+        }
+    }
+
+    EventLoop* loop_;
+    TcpConnectionPtr conn_;
+    const std::string message_;
+    const int window_;
+    const int total_;
+    int sent_;
+    int received_;
+    int64_t start_;
+    double elapsed_;
+    std::deque<int64_t> sendTimes_;
+    std::vector<int64_t> latencies_;
+};
+
+int main(int argc, char* argv[])
+{
+    uint16_t port = static_cast<uint16_t>(argc > 1 ? atoi(argv[1]) : 9200);
+    int total = argc > 2 ? atoi(argv[2]) : 200000;
+
+    pid_t child = fork();
+    if (child == 0)
+    {
+        runServer(port);
+        return 0;
+    }
+    usleep(200 * 1000);
+
+    EventLoop loop;
+    const InetAddress tcpAddr(port);
+    const InetAddress udsAddr = InetAddress::fromUnixPath(kUdsPath);
+    struct Case { size_t size; int window; };
+    const Case cases[] = {{64, 1}, {64, 64}, {1024, 64}};
+    for (const Case& c : cases)
+    {
+        int messages = c.window == 1 ? total / 10 : total;
+        {
+            Driver d(&loop, connectPlain(&loop, tcpAddr, "tcp"), c.size, c.window, messages);
+            d.run();
+            d.report("tcp");
+        }
+        {
+            Driver d(&loop, connectPlain(&loop, udsAddr, "uds"), c.size, c.window, messages);
+            d.run();
+            d.report("uds");
+        }
+        {
+            TcpConnectionPtr conn = ShmTransport::connect(&loop, udsAddr, "shm");
+            if (!conn)
+            {
+                fprintf(stderr, "shm connect failed\n");
+                break;
+            }
+            Driver d(&loop, conn, c.size, c.window, messages);
+            d.run();
+            d.report("shm");
+        }
+    }
+
+    kill(child, SIGTERM);
+    waitpid(child, nullptr, 0);
+    return 0;
+}
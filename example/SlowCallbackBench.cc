@@ -0,0 +1,222 @@
+#include <Kenmuduo/TcpServer.h>
+#include <Kenmuduo/TcpConnection.h>
+#include <Kenmuduo/EventLoop.h>
+#include <Kenmuduo/LoopWatchdog.h>
+#include <Kenmuduo/Logger.h>
+#include "BenchUtil.h"
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * 慢回调报告、看门狗和按连接统计的CPU时间，echo服务器只有一个loop线程
+ * 开销：conns个连接每轮各发一条64字节的消息再全部读回，回调计时关闭和打开交替跑rounds轮，各取最好的一轮
+ * 诊断：第0个连接是热点租户，每条消息多消耗2ms CPU；第1个连接收到'B'时阻塞300ms；其他连接正常
+ * 慢回调阈值20ms，看门狗阈值100ms，最后列出CPU时间最多的3个连接
+ * SlowCallbackBench [port] [conns] [messagesPerConn] [rounds]
+*/
+static std::vector<int> connectAll(uint16_t port, int conns)
+{
+    std::vector<int> fds;
+    for (int i = 0; i < conns; ++i)
+    {
+        fds.push_back(connectTo(port));
+    }
+    usleep(100 * 1000);
+    return fds;
+}
+
+//所有连接各发一条消息再读回，返回这一轮的墙钟时间
+static int64_t pingAll(const std::vector<int>& fds, char first)
+{
+    char message[64] = {0};
+    char reply[64];
+    int64_t begin = nowNs();
+    for (size_t i = 0; i < fds.size(); ++i)
+    {
+        message[0] = i == 1 ? first : 0;
+        ::write(fds[i], message, sizeof(message));
+    }
+    for (int fd : fds)
+    {
+        readExactly(fd, reply, sizeof(reply));
+    }
+    return nowNs() - begin;
+}
+
+int main(int argc, char* argv[])
+{
+    uint16_t port = static_cast<uint16_t>(argc > 1 ? atoi(argv[1]) : 10000);
+    int conns = argc > 2 ? atoi(argv[2]) : 32;
+    int messages = argc > 3 ? atoi(argv[3]) : 3000;
+    int rounds = argc > 4 ? atoi(argv[4]) : 5;
+
+    std::atomic<bool> diagnose(false);
+    std::mutex mutex;
+    std::vector<std::string> slowReports;
+    std::vector<std::string> stuckReports;
+    std::vector<TcpConnectionPtr> serverConns;
+    EventLoop* serverLoop = nullptr;
+    std::atomic<bool> ready(false);
+    std::thread serverThread([&]() {
+        EventLoop loop;
+        TcpServer server(&loop, InetAddress(port), "echo");
+        server.setConnectionCallback([&](const TcpConnectionPtr& conn) {
+            if (conn->connected())
+            {
+                conn->setTcpNoDelay(true);
+                serverConns.push_back(conn);
+            }
+        });
+        //连接按建立的顺序编号，名字以#1结尾的是第0个连接
+        server.setMessageCallback([&](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+            if (diagnose)
+            {
+                if (conn == serverConns[0])
+                {
+                    burnCpu(2 * 1000 * 1000);
+                }
+                else if (conn == serverConns[1] && *buf->peek() == 'B')
+                {
+                    usleep(300 * 1000);
+                }
+            }
+            conn->send(buf->peek(), buf->readableBytes());
+            buf->retrieveAll();
+        });
+        server.start();
+        serverLoop = &loop;
+        ready = true;
+        loop.loop();
+    });
+    while (!ready)
+    {
+        usleep(1000);
+    }
+    std::vector<int> fds = connectAll(port, conns);
+
+    auto setTiming = [&](bool on) {
+        std::atomic<bool> set(false);
+        serverLoop->runInLoop([&]() {
+            serverLoop->setSlowCallbackThreshold(on ? 0.02 : 0, [&](const char* kind, const std::string& owner,
+                double wallSeconds, double cpuSeconds) {
+                char line[256];
+                snprintf(line, sizeof(line), "slow %s callback of %s: %.1f ms wall, %.1f ms cpu", kind, owner.c_str(),
+                    wallSeconds * 1e3, cpuSeconds * 1e3);
+                std::lock_guard<std::mutex> lock(mutex);
+                slowReports.push_back(line);
+            });
+            set = true;
+        });
+        while (!set)
+        {
+            usleep(100);
+        }
+    };
+
+    double best[2] = {0, 0};
+    for (int r = 0; r < rounds * 2; ++r)
+    {
+        bool on = r % 2 == 1;
+        setTiming(on);
+        int64_t elapsed = 0;
+        for (int m = 0; m < messages; ++m)
+        {
+            elapsed += pingAll(fds, 0);
+        }
+        best[on] = std::max(best[on], static_cast<double>(messages) * conns / (elapsed / 1e9));
+    }
+    printf("timing off %9.0f msg/s\n", best[0]);
+    printf("timing on  %9.0f msg/s  (%+.2f%%)\n", best[1], (best[1] / best[0] - 1) * 100);
+    int64_t begin = nowNs();
+    for (int i = 0; i < 1000000; ++i)
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+    }
+    printf("timing cost %.0f ns per callback (two thread-cpu and two monotonic clock reads)\n", (nowNs() - begin) / 1e6);
+
+    //诊断场景
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        slowReports.clear();
+    }
+    setTiming(true);
+    LoopWatchdog watchdog(0.1);
+    watchdog.setStuckCallback([&](EventLoop*, const char* kind, int fd, double seconds) {
+        char line[256];
+        snprintf(line, sizeof(line), "stuck in %s callback of fd %d for %.0f ms", kind, fd, seconds * 1e3);
+        std::lock_guard<std::mutex> lock(mutex);
+        stuckReports.push_back(line);
+    });
+    watchdog.watch(serverLoop);
+    watchdog.start();
+    diagnose = true;
+    int64_t worst = 0;
+    for (int m = 0; m < 50; ++m)
+    {
+        worst = std::max(worst, pingAll(fds, m == 25 ? 'B' : 0));
+    }
+    diagnose = false;
+    watchdog.unwatch(serverLoop);
+    watchdog.stop();
+
+    std::vector<std::pair<double, std::string>> cpu;
+    std::atomic<bool> collected(false);
+    serverLoop->runInLoop([&]() {
+        for (const TcpConnectionPtr& conn : serverConns)
+        {
+            cpu.emplace_back(conn->callbackCpuSeconds(), conn->name());
+        }
+        collected = true;
+    });
+    while (!collected)
+    {
+        usleep(100);
+    }
+    std::sort(cpu.begin(), cpu.end(), [](const std::pair<double, std::string>& a, const std::pair<double, std::string>& b) {
+        return a.first > b.first;
+    });
+
+    printf("diagnosis: worst round %.0f ms\n", worst / 1e6);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const std::string& line : stuckReports)
+        {
+            printf("  watchdog: %s\n", line.c_str());
+        }
+        printf("  %zu slow callbacks:\n", slowReports.size());
+        for (const std::string& line : slowReports)
+        {
+            printf("    %s\n", line.c_str());
+        }
+    }
+    printf("  cpu by connection (whole run with timing on):\n");
+    for (size_t i = 0; i < cpu.size() && i < 3; ++i)
+    {
+        printf("    %-28s %8.1f ms\n", cpu[i].second.c_str(), cpu[i].first * 1e3);
+    }
+
+    for (int fd : fds)
+    {
+        ::close(fd);
+    }
+    usleep(100 * 1000);
+    serverLoop->quit();
+    serverThread.join();
+    return 0;
+}
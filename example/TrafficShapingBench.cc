@@ -0,0 +1,170 @@
+#include <Kenmuduo/TcpServer.h>
+#include <Kenmuduo/TcpConnection.h>
+#include <Kenmuduo/TrafficShaper.h>
+#include <Kenmuduo/Logger.h>
+#include "BenchUtil.h"
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+/**
+ * 一个租户批量上传时其他连接的延迟
+ * 重连接(第一个字节'H')连续写64KB的块，服务器逐字节计算校验和后丢弃；轻连接(第一个字节'L')一问一答，统计延迟
+ * 服务器只有一个loop，none：不限速；conn：每个重连接限速limitMBps；group：所有重连接属于一个租户组，共享limitMBps
+ * TrafficShapingBench [port] [seconds] [heavyConns] [lightConns] [limitMBps]
+*/
+static const size_t kLightSize = 64;
+static const size_t kChunkSize = 64 * 1024;
+
+static void run(const char* mode, uint16_t port, double seconds, int heavyConns, int lightConns, double limitMBps)
+{
+    std::shared_ptr<TrafficGroup> group = std::make_shared<TrafficGroup>(limitMBps * 1e6, 256 * 1024, 0, 0);
+    std::atomic<long> heavyBytes(0);
+    EventLoop* serverLoop = nullptr;
+    std::atomic<bool> ready(false);
+    std::thread serverThread([&]() {
+        EventLoop loop;
+        TcpServer server(&loop, InetAddress(port), "shaping");
+        server.setConnectionCallback([](const TcpConnectionPtr& conn) {
+            if (conn->connected())
+            {
+                conn->setTcpNoDelay(true);
+            }
+        });
+        server.setMessageCallback([&, mode](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+            if (!conn->getContext())
+            {
+                bool heavy = buf->peek()[0] == 'H';
+                conn->setContext(std::make_shared<bool>(heavy));
+                if (heavy && mode[0] == 'c')
+                {
+                    conn->setReadRateLimit(limitMBps * 1e6, 256 * 1024);
+                }
+                else if (heavy && mode[0] == 'g')
+                {
+                    conn->setTrafficGroup(group);
+                }
+            }
+            if (*std::static_pointer_cast<bool>(conn->getContext()))
+            {
+                unsigned sum = 0;
+                const unsigned char* p = reinterpret_cast<const unsigned char*>(buf->peek());
+                for (size_t i = 0; i < buf->readableBytes(); ++i)
+                {
+                    sum = sum * 31 + p[i];
+                }
+                heavyBytes += buf->readableBytes() + (sum == 1);
+                buf->retrieveAll();
+                return;
+            }
+            while (buf->readableBytes() >= kLightSize)
+            {
+                conn->send(buf->peek(), kLightSize);
+                buf->retrieve(kLightSize);
+            }
+        });
+        server.start();
+        serverLoop = &loop;
+        ready = true;
+        loop.loop();
+    });
+    while (!ready)
+    {
+        usleep(1000);
+    }
+
+    std::atomic<bool> stop(false);
+    std::vector<std::thread> clients;
+    for (int i = 0; i < heavyConns; ++i)
+    {
+        clients.emplace_back([&]() {
+            int fd = connectTo(port);
+            std::vector<char> chunk(kChunkSize, 'H');
+            while (!stop)
+            {
+                if (::write(fd, chunk.data(), chunk.size()) <= 0)
+                {
+                    break;
+                }
+            }
+            ::close(fd);
+        });
+    }
+    usleep(100 * 1000);
+
+    std::vector<std::vector<int64_t>> latencies(lightConns);
+    for (int i = 0; i < lightConns; ++i)
+    {
+        clients.emplace_back([&, i]() {
+            int fd = connectTo(port);
+            char buf[kLightSize];
+            std::fill(buf, buf + sizeof(buf), 'L');
+            while (!stop)
+            {
+                int64_t start = nowNs();
+                if (::write(fd, buf, sizeof(buf)) != sizeof(buf))
+                {
+                    break;
+                }
+                size_t got = 0;
+                while (got < sizeof(buf))
+                {
+                    ssize_t n = ::read(fd, buf + got, sizeof(buf) - got);
+                    if (n <= 0)
+                    {
+                        ::close(fd);
+                        return;
+                    }
+                    got += n;
+                }
+                latencies[i].push_back(nowNs() - start);
+                usleep(500);
+            }
+            ::close(fd);
+        });
+    }
+
+    long heavyStart = heavyBytes;
+    usleep(static_cast<useconds_t>(seconds * 1e6));
+    long heavyEnd = heavyBytes;
+    stop = true;
+    serverLoop->quit();
+    serverThread.join();
+    for (auto& t : clients)
+    {
+        t.join();
+    }
+
+    std::vector<int64_t> all;
+    for (auto& v : latencies)
+    {
+        all.insert(all.end(), v.begin(), v.end());
+    }
+    std::sort(all.begin(), all.end());
+    size_t n = all.size();
+    printf("%-6s light requests=%-7zu p50=%-8.1f p99=%-8.1f us  heavy upload=%.1f MB/s\n",
+        mode, n, n ? all[n / 2] / 1e3 : 0, n ? all[n * 99 / 100] / 1e3 : 0, (heavyEnd - heavyStart) / seconds / 1e6);
+}
+
+int main(int argc, char* argv[])
+{
+    uint16_t port = static_cast<uint16_t>(argc > 1 ? atoi(argv[1]) : 9980);
+    double seconds = argc > 2 ? atof(argv[2]) : 3;
+    int heavyConns = argc > 3 ? atoi(argv[3]) : 4;
+    int lightConns = argc > 4 ? atoi(argv[4]) : 16;
+    double limitMBps = argc > 5 ? atof(argv[5]) : 50;
+
+    run("none", port, seconds, heavyConns, lightConns, limitMBps);
+    run("conn", static_cast<uint16_t>(port + 1), seconds, heavyConns, lightConns, limitMBps);
+    run("group", static_cast<uint16_t>(port + 2), seconds, heavyConns, lightConns, limitMBps);
+    return 0;
+}
@@ -0,0 +1,146 @@
+#include <Kenmuduo/UdpServer.h>
+#include <Kenmuduo/EventLoopThread.h>
+#include <Kenmuduo/EventLoop.h>
+#include "BenchUtil.h"
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <thread>
+#include <atomic>
+
+/**
+ * UdpServer每秒收发数据报数的基准
+ * 若干发送线程用sendmmsg向服务端灌64字节的数据报，分别测试recvmmsg批大小为1和64时服务端的收包速率
+ * echo模式下服务端原样回复，回复经sendmmsg批量发出，客户端统计收到的回复数
+ * UdpBench [port] [seconds] [senders] [serverThreads]
+*/
+static void sender(uint16_t port, int64_t deadline, bool echo, std::atomic<uint64_t>* sent, std::atomic<uint64_t>* echoed)
+{
+    int fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    int rcvbuf = 4 * 1024 * 1024;
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    const int kBatch = 64;
+    char payload[64];
+    memset(payload, 'u', sizeof(payload));
+    iovec iov[kBatch];
+    mmsghdr msgs[kBatch];
+    memset(msgs, 0, sizeof(msgs));
+    for (int i = 0; i < kBatch; ++i)
+    {
+        iov[i].iov_base = payload;
+        iov[i].iov_len = sizeof(payload);
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    char rxbuf[kBatch][128];
+    iovec rxiov[kBatch];
+    mmsghdr rxmsgs[kBatch];
+    memset(rxmsgs, 0, sizeof(rxmsgs));
+    for (int i = 0; i < kBatch; ++i)
+    {
+        rxiov[i].iov_base = rxbuf[i];
+        rxiov[i].iov_len = sizeof(rxbuf[i]);
+        rxmsgs[i].msg_hdr.msg_iov = &rxiov[i];
+        rxmsgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    uint64_t localSent = 0;
+    uint64_t localEchoed = 0;
+    while (nowNs() < deadline)
+    {
+        int n = ::sendmmsg(fd, msgs, kBatch, 0);
+        if (n > 0)
+        {
+            localSent += n;
+        }
+        if (echo)
+        {
+            int r;
+            while ((r = ::recvmmsg(fd, rxmsgs, kBatch, MSG_DONTWAIT, nullptr)) > 0)
+            {
+                localEchoed += r;
+            }
+        }
+        else
+        {
+            //给服务端留一点CPU，避免单核机器上发送线程独占
+            sched_yield();
+        }
+    }
+    sent->fetch_add(localSent);
+    echoed->fetch_add(localEchoed);
+    ::close(fd);
+}
+
+static void runCase(uint16_t port, double seconds, int senders, int serverThreads, int batchSize, bool echo)
+{
+    EventLoopThread baseThread;
+    EventLoop* baseLoop = baseThread.startLoop();
+    std::unique_ptr<UdpServer> server(new UdpServer(baseLoop, InetAddress(port, "127.0.0.1"), "UdpBench"));
+    server->setThreadNum(serverThreads);
+    server->setBatchSize(batchSize);
+    if (echo)
+    {
+        server->setMessageCallback([](UdpChannel* channel, const char* data, size_t len, const InetAddress& peer, Timestamp) {
+            channel->send(peer, data, len);
+        });
+    }
+    server->start();
+    usleep(100 * 1000);
+
+    std::atomic<uint64_t> sent(0);
+    std::atomic<uint64_t> echoed(0);
+    int64_t start = nowNs();
+    int64_t deadline = start + static_cast<int64_t>(seconds * 1e9);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < senders; ++i)
+    {
+        threads.emplace_back(sender, port, deadline, echo, &sent, &echoed);
+    }
+    for (std::thread& t : threads)
+    {
+        t.join();
+    }
+    double elapsed = (nowNs() - start) / 1e9;
+    usleep(100 * 1000);
+
+    uint64_t received = server->packetsReceived();
+    uint64_t batches = server->recvBatches();
+    printf("%-4s batch=%-3d loops=%d sent=%.0f pps  server recv=%.0f pps  datagrams/recvmmsg=%.1f",
+        echo ? "echo" : "sink", batchSize, serverThreads > 0 ? serverThreads : 1,
+        sent / elapsed, received / elapsed, batches ? static_cast<double>(received) / batches : 0.0);
+    if (echo)
+    {
+        printf("  server sent=%.0f pps  client recv=%.0f pps", server->packetsSent() / elapsed, echoed / elapsed);
+    }
+    printf("\n");
+    server.reset();
+}
+
+int main(int argc, char* argv[])
+{
+    uint16_t port = static_cast<uint16_t>(argc > 1 ? atoi(argv[1]) : 9999);
+    double seconds = argc > 2 ? atof(argv[2]) : 2.0;
+    int senders = argc > 3 ? atoi(argv[3]) : 2;
+    int serverThreads = argc > 4 ? atoi(argv[4]) : 0;
+
+    runCase(port, seconds, senders, serverThreads, 1, false);
+    runCase(port, seconds, senders, serverThreads, 64, false);
+    runCase(port, seconds, senders, serverThreads, 1, true);
+    runCase(port, seconds, senders, serverThreads, 64, true);
+    return 0;
+}
@@ -0,0 +1,122 @@
+#include <Kenmuduo/TcpServer.h>
+#include <Kenmuduo/Logger.h>
+#include "BenchUtil.h"
+
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+/**
+ * 同一份echo处理代码分别监听TCP回环、Unix域文件路径和Unix域抽象地址，比较ping-pong往返延迟
+ * 服务端在子进程中运行，客户端用阻塞socket一次发一个消息，收齐回复后再发下一个
+ * UdsBench [port] [iterations]
+*/
+//和具体的地址族无关的echo服务
+class EchoServer
+{
+public:
+    EchoServer(EventLoop* loop, const InetAddress& addr, const std::string& name)
+        :server_(loop, addr, name)
+    {
+        server_.setConnectionCallback([](const TcpConnectionPtr& conn) {
+            if (conn->connected())
+            {
+                conn->setTcpNoDelay(true);
+            }
+        });
+        server_.setMessageCallback([](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+            conn->send(buf->retrieveAllAsString());
+        });
+    }
+
+    void start() { server_.start(); }
+private:
+    TcpServer server_;
+};
+
+static void runServer(const std::vector<InetAddress>& addrs)
+{
+    EventLoop loop;
+    std::vector<std::unique_ptr<EchoServer>> servers;
+    for (const InetAddress& addr : addrs)
+    {
+        servers.emplace_back(new EchoServer(&loop, addr, addr.toIpPort()));
+        servers.back()->start();
+    }
+    loop.loop();
+}
+
+static void pingPong(const InetAddress& addr, size_t msgSize, int iterations)
+{
+    int fd = ::socket(addr.family(), SOCK_STREAM, 0);
+    if (::connect(fd, addr.getSockAddr(), addr.getSockAddrLen()) < 0)
+    {
+        perror("connect");
+        exit(1);
+    }
+    if (!addr.isUnix())
+    {
+        int one = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+
+    std::string msg(msgSize, 'p');
+    std::vector<char> buf(msgSize);
+    std::vector<int64_t> rtts;
+    rtts.reserve(iterations);
+    int64_t start = nowNs();
+    for (int i = 0; i < iterations; ++i)
+    {
+        int64_t t0 = nowNs();
+        ::write(fd, msg.data(), msg.size());
+        readExactly(fd, buf.data(), msgSize);
+        rtts.push_back(nowNs() - t0);
+    }
+    double elapsed = (nowNs() - start) / 1e9;
+    ::close(fd);
+
+    std::sort(rtts.begin(), rtts.end());
+    auto pct = [&rtts](double p) { return rtts[static_cast<size_t>(p / 100 * (rtts.size() - 1))] / 1000.0; };
+    printf("%-22s size=%-6zu msgs/s=%-8.0f rtt p50=%6.1fus p99=%6.1fus p99.9=%6.1fus\n",
+        addr.toIpPort().c_str(), msgSize, iterations / elapsed, pct(50), pct(99), pct(99.9));
+}
+
+int main(int argc, char* argv[])
+{
+    uint16_t port = static_cast<uint16_t>(argc > 1 ? atoi(argv[1]) : 9100);
+    int iterations = argc > 2 ? atoi(argv[2]) : 20000;
+
+    std::vector<InetAddress> addrs;
+    addrs.push_back(InetAddress(port));
+    addrs.push_back(InetAddress::fromUnixPath("/tmp/kenmuduo-udsbench.sock"));
+    addrs.push_back(InetAddress::fromUnixPath("kenmuduo-udsbench", true));
+
+    pid_t child = fork();
+    if (child == 0)
+    {
+        runServer(addrs);
+        return 0;
+    }
+    usleep(200 * 1000);
+
+    size_t sizes[] = {64, 4096};
+    for (size_t size : sizes)
+    {
+        for (const InetAddress& addr : addrs)
+        {
+            pingPong(addr, size, iterations);
+        }
+    }
+
+    kill(child, SIGTERM);
+    waitpid(child, nullptr, 0);
+    return 0;
+}
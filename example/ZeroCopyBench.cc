@@ -0,0 +1,115 @@
+#include <Kenmuduo/TcpServer.h>
+#include <Kenmuduo/TcpConnection.h>
+#include <Kenmuduo/ZeroCopy.h>
+#include <Kenmuduo/Logger.h>
+#include "BenchUtil.h"
+
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+/**
+ * 服务器向一个客户端反复发送同一个共享的payload，比较拷贝发送和MSG_ZEROCOPY发送时服务器线程每GB消耗的CPU时间
+ * 上一个payload写进内核以后(writeComplete)再发下一个，客户端只读取不处理
+ * loopback上接收方会把zerocopy的页拷贝一份，copied一栏是内核报告没能避免拷贝的发送比例
+ * ZeroCopyBench [port] [totalMB]
+*/
+static void run(uint16_t port, size_t payloadSize, size_t totalBytes, bool zeroCopy)
+{
+    SharedPayload payload = std::make_shared<const std::string>(payloadSize, 'z');
+    size_t count = (totalBytes + payloadSize - 1) / payloadSize;
+    std::atomic<double> cpuSeconds(0);
+    std::atomic<double> copiedRatio(0);
+    EventLoop* serverLoop = nullptr;
+    std::atomic<bool> ready(false);
+    std::thread serverThread([&]() {
+        EventLoop loop;
+        TcpServer server(&loop, InetAddress(port), "zerocopy");
+        size_t sent = 0;
+        double cpuStart = 0;
+        server.setConnectionCallback([&](const TcpConnectionPtr& conn) {
+            if (conn->connected())
+            {
+                if (zeroCopy && !conn->enableZeroCopy(16 * 1024))
+                {
+                    exit(1);
+                }
+                cpuStart = threadCpuSeconds();
+                sent = 1;
+                conn->send(payload);
+            }
+        });
+        server.setWriteCompleteCallback([&](const TcpConnectionPtr& conn) {
+            if (sent < count)
+            {
+                ++sent;
+                conn->send(payload);
+            }
+            else if (sent == count)
+            {
+                ++sent;
+                cpuSeconds = threadCpuSeconds() - cpuStart;
+                const ZeroCopySender* zc = conn->zeroCopySender();
+                if (zc != nullptr && zc->zeroCopySends() > 0)
+                {
+                    copiedRatio = static_cast<double>(zc->copiedSends()) / zc->zeroCopySends();
+                }
+            }
+        });
+        server.setMessageCallback([](const TcpConnectionPtr&, Buffer* buf, Timestamp) { buf->retrieveAll(); });
+        server.start();
+        serverLoop = &loop;
+        ready = true;
+        loop.loop();
+    });
+    while (!ready)
+    {
+        usleep(1000);
+    }
+
+    int fd = connectTo(port);
+    std::vector<char> buf(256 * 1024);
+    size_t expected = count * payloadSize;
+    size_t got = 0;
+    int64_t start = nowNs();
+    while (got < expected)
+    {
+        ssize_t n = ::read(fd, buf.data(), buf.size());
+        if (n <= 0)
+        {
+            break;
+        }
+        got += n;
+    }
+    double elapsed = (nowNs() - start) / 1e9;
+    //等服务器处理完最后一个writeComplete
+    usleep(50 * 1000);
+    ::close(fd);
+    serverLoop->quit();
+    serverThread.join();
+
+    double gb = got / 1e9;
+    printf("payload=%-8zu %-5s %.2f GB/s  server cpu %.3f s/GB  copied=%.0f%%\n", payloadSize, zeroCopy ? "zcopy" : "copy",
+        gb / elapsed, cpuSeconds / gb, copiedRatio * 100);
+}
+
+int main(int argc, char* argv[])
+{
+    uint16_t port = static_cast<uint16_t>(argc > 1 ? atoi(argv[1]) : 9990);
+    size_t totalBytes = static_cast<size_t>(argc > 2 ? atoi(argv[2]) : 2048) * 1024 * 1024;
+
+    const size_t sizes[] = {16 * 1024, 64 * 1024, 256 * 1024, 1024 * 1024};
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i)
+    {
+        run(static_cast<uint16_t>(port + 2 * i), sizes[i], totalBytes, false);
+        run(static_cast<uint16_t>(port + 2 * i + 1), sizes[i], totalBytes, true);
+    }
+    return 0;
+}